@@ -92,9 +92,16 @@
 /**  In-flight translation. */
 struct inflight;
 
-/** Number of read cache slots. */
+/** Default and minimum number of read cache slots.
+ * A page table walk may recursively read other pages (e.g. to translate
+ * the address of a page table), so there must be enough slots to keep
+ * the pages which are being read.
+ */
 #define READ_CACHE_SLOTS	4
 
+/** Log2 of the address granularity of the read cache hash. */
+#define READ_CACHE_HASH_SHIFT	12
+
 /** Cache slot (buffer plus cache metadata). */
 struct read_cache_slot {
 	/** Buffer metadata */
@@ -102,20 +109,141 @@ struct read_cache_slot {
 
 	/** MRU chain. */
 	struct read_cache_slot *prev, *next;
+
+	/** Next slot in the same hash bucket. */
+	struct read_cache_slot *hnext;
+
+	/** Hash table bucket index. */
+	unsigned hidx;
+
+	/** Non-zero if the buffer is counted in @c nspill. */
+	bool spill;
 };
 
-/** Read cache storage and metadata. */
+/** Read cache storage and metadata.
+ *
+ * Cache slots are hashed by the start address of their buffer. Buffers
+ * which cross a hash granule boundary are counted in @c nspill. If
+ * there are any such buffers, a lookup which does not find a match
+ * in the hash table falls back to a linear search.
+ */
 struct read_cache {
 	/** Most recently used cache slot. */
 	struct read_cache_slot *mru;
 
+	/** Number of cache slots. */
+	unsigned nslots;
+
+	/** Hash table index mask (number of buckets minus one). */
+	unsigned hmask;
+
+	/** Number of hashed buffers which cross a granule boundary. */
+	unsigned nspill;
+
+	/** Hash table buckets. */
+	struct read_cache_slot **hash;
+
 	/** Cache slots. */
-	struct read_cache_slot slot[READ_CACHE_SLOTS];
+	struct read_cache_slot *slot;
 };
 
 INTERNAL_DECL(void, bury_cache_buffer,
 	      (struct read_cache *cache, const addrxlat_fulladdr_t *addr));
 
+/** Number of TLB slots for base pages. */
+#define TLB_SLOTS	64
+
+/** Number of TLB slots for huge pages. */
+#define TLB_HUGE_SLOTS	8
+
+/** Translation lookaside buffer entry.
+ * The entry is valid only if @c gen matches the current TLB generation.
+ */
+struct tlb_entry {
+	/** Generation when this entry was filled. */
+	unsigned long gen;
+
+	/** Translation system used for the translation. */
+	const addrxlat_sys_t *sys;
+
+	/** Page table translation method. */
+	const addrxlat_meth_t *meth;
+
+	/** Source address space. */
+	addrxlat_addrspace_t as;
+
+	/** Log2 of the page size. */
+	unsigned short shift;
+
+	/** Source page address (aligned to the page size). */
+	addrxlat_addr_t addr;
+
+	/** Target page address. */
+	addrxlat_fulladdr_t base;
+};
+
+/** Translation lookaside buffer.
+ *
+ * Page table walks are cached here. Base pages are stored in a
+ * direct-mapped table indexed by the page number. Huge pages are
+ * stored in a small fully associative table, so that a single entry
+ * covers the whole huge page.
+ */
+struct tlb {
+	/** Local generation (incremented on every flush). */
+	unsigned long gen;
+
+	/** Non-zero if the TLB is temporarily disabled. */
+	unsigned disabled;
+
+	/** Next huge page slot to be replaced. */
+	unsigned huge_next;
+
+	/** Number of TLB hits. */
+	unsigned long hits;
+
+	/** Number of TLB misses. */
+	unsigned long misses;
+
+	/** Base page slots. */
+	struct tlb_entry slot[TLB_SLOTS];
+
+	/** Huge page slots. */
+	struct tlb_entry huge[TLB_HUGE_SLOTS];
+};
+
+/** Page table walk cache.
+ *
+ * This structure keeps the step state of a page table walk at each
+ * level, so that a walk for a nearby address can continue from the
+ * deepest page table which is shared with the previous walk.
+ */
+struct walk_cache {
+	/** Translation method of the cached walk. */
+	const addrxlat_meth_t *meth;
+
+	/** Translation system of the cached walk. */
+	const addrxlat_sys_t *sys;
+
+	/** Source address of the cached walk. */
+	addrxlat_addr_t addr;
+
+	/** Bit mask of valid entries in @c state. */
+	unsigned valid;
+
+	/** Step state before reading a table entry, indexed by
+	 * the number of remaining steps.
+	 */
+	addrxlat_step_t state[ADDRXLAT_FIELDS_MAX + 1];
+};
+
+INTERNAL_DECL(addrxlat_status, tlb_walk,
+	      (addrxlat_step_t *step, addrxlat_addrspace_t as));
+INTERNAL_DECL(addrxlat_status, tlb_walk_range,
+	      (addrxlat_step_t *step, addrxlat_addrspace_t as,
+	       struct walk_cache *wc, unsigned short *pshift));
+INTERNAL_DECL(void, tlb_invalidate_all, (void));
+
 /**  Representation of address translation.
  *
  * This structure contains all internal state needed to perform address
@@ -143,6 +271,9 @@ struct _addrxlat_ctx {
 	/** Read cache. */
 	struct read_cache cache;
 
+	/** Translation lookaside buffer. */
+	struct tlb tlb;
+
 	/** Error message buffer.
 	 * This must be the last member. */
 	kdump_errmsg_t err;
@@ -204,8 +335,24 @@ struct _addrxlat_map {
 
 	/** Actual range definitions. */
 	addrxlat_range_t *ranges;
+
+	/** Start addresses of all ranges, or @c NULL.
+	 *
+	 * This index is built lazily by the first search which needs it
+	 * and freed whenever the map is modified.
+	 */
+	addrxlat_addr_t *index;
 };
 
+/** Minimum number of ranges in a map to build a search index.
+ * Smaller maps are searched linearly.
+ */
+#define MAP_INDEX_MIN	8
+
+/* Translation map */
+
+INTERNAL_DECL(void, map_drop_index, (addrxlat_map_t *map));
+
 /** Clear a translation map.
  * @param map  Address translation map.
  *
@@ -215,6 +362,7 @@ struct _addrxlat_map {
 static inline void
 map_clear(addrxlat_map_t *map)
 {
+	map_drop_index(map);
 	map->n = 0;
 }
 
@@ -229,8 +377,37 @@ struct _addrxlat_sys {
 
 	/** Address translation methods. */
 	addrxlat_meth_t meth[ADDRXLAT_SYS_METH_NUM];
+
+	/** Reverse mapping of @ref ADDRXLAT_SYS_METH_PGT (built lazily). */
+	struct rmap *rmap;
+};
+
+/** Reverse mapping index entry. */
+struct rmap_entry {
+	addrxlat_addr_t paddr;	/**< First target address. */
+	addrxlat_addr_t size;	/**< Size of the mapped extent. */
+	addrxlat_addr_t vaddr;	/**< Source address which maps @c paddr. */
+};
+
+/** Reverse mapping index.
+ *
+ * Overlapping extents are split, so that entries either cover exactly
+ * the same target range, or do not overlap at all. Entries are sorted
+ * by target address, then by source address.
+ */
+struct rmap {
+	/** Target address space. */
+	addrxlat_addrspace_t as;
+
+	/** Number of entries. */
+	size_t n;
+
+	/** Index entries. */
+	struct rmap_entry entry[];
 };
 
+INTERNAL_DECL(void, rmap_free, (addrxlat_sys_t *sys));
+
 /* vtop */
 
 /** Get the pteval shift for a PTE format.
@@ -501,12 +678,17 @@ DECLARE_ALIAS(map_new);
 DECLARE_ALIAS(map_incref);
 DECLARE_ALIAS(map_decref);
 DECLARE_ALIAS(map_set);
+DECLARE_ALIAS(map_set_ranges);
 DECLARE_ALIAS(map_search);
+DECLARE_ALIAS(map_find);
 DECLARE_ALIAS(map_copy);
 DECLARE_ALIAS(launch);
 DECLARE_ALIAS(step);
 DECLARE_ALIAS(walk);
 DECLARE_ALIAS(op);
+DECLARE_ALIAS(op_range);
+DECLARE_ALIAS(pgt_iter);
+DECLARE_ALIAS(sys_rmap);
 DECLARE_ALIAS(fulladdr_conv);
 
 /** Clear the error message.
@@ -38,20 +38,38 @@
 #define ERRBUF	64
 
 /**  Initialize the read cache.
- * @param cache  Read cache.
+ * @param cache   Read cache.
+ * @param nslots  Number of cache slots.
+ * @returns       @c true on success, @c false on allocation failure.
  */
-static void
-init_cache(struct read_cache *cache)
+static bool
+init_cache(struct read_cache *cache, unsigned nslots)
 {
 	struct read_cache_slot *slot, *end;
+	unsigned nbuckets;
+
+	/* Keep the hash table at most half full. */
+	nbuckets = 1;
+	while (nbuckets < 2 * nslots)
+		nbuckets <<= 1;
+
+	cache->slot = calloc(1, nslots * sizeof(*cache->slot) +
+			     nbuckets * sizeof(*cache->hash));
+	if (!cache->slot)
+		return false;
+	cache->hash = (struct read_cache_slot **)&cache->slot[nslots];
+	cache->hmask = nbuckets - 1;
+	cache->nslots = nslots;
+	cache->nspill = 0;
 
 	slot = &cache->slot[0];
-	end  = &cache->slot[READ_CACHE_SLOTS];
+	end  = &cache->slot[nslots];
 	cache->mru = slot;
 	do {
 		slot->next = slot + 1 < end ? slot + 1 : &cache->slot[0];
 		slot->next->prev = slot;
 	} while (++slot < end);
+	return true;
 }
 
 /**  Clean up the read cache.
@@ -69,7 +87,101 @@ cleanup_cache(struct read_cache *cache)
 		addrxlat_buffer_t *buf = &slot->buffer;
 		if (buf->size)
 			buf->put_page(buf);
-	} while (++slot < &cache->slot[READ_CACHE_SLOTS]);
+	} while (++slot < &cache->slot[cache->nslots]);
+	free(cache->slot);
+}
+
+/** Get the hash table index for an address.
+ * @param cache  Read cache.
+ * @param addr   Full address.
+ * @returns      Bucket index.
+ */
+static inline unsigned
+cache_hash(const struct read_cache *cache, const addrxlat_fulladdr_t *addr)
+{
+	return ((addr->addr >> READ_CACHE_HASH_SHIFT) + addr->as) &
+		cache->hmask;
+}
+
+/** Check whether a buffer crosses a hash granule boundary.
+ * @param buf  Buffer metadata.
+ * @returns    @c true if @p buf spans more than one hash granule.
+ */
+static inline bool
+buffer_spills(const addrxlat_buffer_t *buf)
+{
+	return buf->size > 1 &&
+		(buf->addr.addr & ADDR_MASK(READ_CACHE_HASH_SHIFT)) >
+		ADDR_MASK(READ_CACHE_HASH_SHIFT) - (buf->size - 1);
+}
+
+/** Check whether a buffer contains an address.
+ * @param buf   Buffer metadata.
+ * @param addr  Full address.
+ * @returns     @c true if @p addr is inside @p buf.
+ */
+static inline bool
+buffer_contains(const addrxlat_buffer_t *buf, const addrxlat_fulladdr_t *addr)
+{
+	return buf->size > addr->addr - buf->addr.addr &&
+		buf->addr.as == addr->as;
+}
+
+/** Add a cache slot to the hash table.
+ * @param cache  Read cache.
+ * @param slot   Cache slot.
+ */
+static void
+hash_cache_slot(struct read_cache *cache, struct read_cache_slot *slot)
+{
+	slot->hidx = cache_hash(cache, &slot->buffer.addr);
+	slot->hnext = cache->hash[slot->hidx];
+	cache->hash[slot->hidx] = slot;
+	slot->spill = buffer_spills(&slot->buffer);
+	if (slot->spill)
+		++cache->nspill;
+}
+
+/** Remove a cache slot from the hash table.
+ * @param cache  Read cache.
+ * @param slot   Cache slot.
+ */
+static void
+unhash_cache_slot(struct read_cache *cache, struct read_cache_slot *slot)
+{
+	struct read_cache_slot **pprev = &cache->hash[slot->hidx];
+
+	while (*pprev != slot)
+		pprev = &(*pprev)->hnext;
+	*pprev = slot->hnext;
+	if (slot->spill)
+		--cache->nspill;
+}
+
+/** Find the cache slot which contains an address.
+ * @param cache  Read cache.
+ * @param addr   Full address.
+ * @returns      Cache slot, or @c NULL if not found.
+ */
+static struct read_cache_slot *
+find_cache_slot(struct read_cache *cache, const addrxlat_fulladdr_t *addr)
+{
+	struct read_cache_slot *slot;
+
+	for (slot = cache->hash[cache_hash(cache, addr)]; slot;
+	     slot = slot->hnext)
+		if (buffer_contains(&slot->buffer, addr))
+			return slot;
+
+	if (!cache->nspill)
+		return NULL;
+
+	slot = &cache->slot[0];
+	do {
+		if (buffer_contains(&slot->buffer, addr))
+			return slot;
+	} while (++slot < &cache->slot[cache->nslots]);
+	return NULL;
 }
 
 /** Mark a slot as most recently used.
@@ -114,34 +226,48 @@ addrxlat_status
 get_cache_buf(addrxlat_ctx_t *ctx, const addrxlat_fulladdr_t *addr,
 	      addrxlat_buffer_t **pbuf)
 {
+	struct read_cache *cache = &ctx->cache;
 	addrxlat_status status;
 	struct read_cache_slot *slot;
+	bool hashed;
 
 	/* Try to reuse a cache slot */
-	slot = &ctx->cache.slot[0];
-	do {
-		addrxlat_buffer_t *buf = &slot->buffer;
-		if (buf->size > addr->addr - buf->addr.addr &&
-		    buf->addr.as == addr->as)
-			goto out;
-	} while (++slot < &ctx->cache.slot[READ_CACHE_SLOTS]);
+	slot = find_cache_slot(cache, addr);
+	if (slot)
+		goto out;
 
 	/* Not found - use the LRU slot */
-	slot = ctx->cache.mru->prev;
+	slot = cache->mru->prev;
 
 	/* Free up the slot if necessary */
-	if (slot->buffer.size)
+	if (slot->buffer.size) {
+		unhash_cache_slot(cache, slot);
 		slot->buffer.put_page(&slot->buffer);
+	}
 
-	/* Get the new page */
+	/* Get the new page. The slot is hashed with its old size while
+	 * the page is being read, so recursive reads can be detected.
+	 * It is also marked as most recently used, so recursive reads
+	 * do not evict it.
+	 */
 	slot->buffer.addr = *addr;
 	slot->buffer.ptr = NULL;
 	slot->buffer.put_page = def_put_page_cb;
+	hashed = slot->buffer.size != 0;
+	if (hashed)
+		hash_cache_slot(cache, slot);
+	touch_cache_slot(cache, slot);
 	status = ctx->cb->get_page(ctx->cb, &slot->buffer);
+	if (hashed)
+		unhash_cache_slot(cache, slot);
 	if (status != ADDRXLAT_OK) {
 		slot->buffer.size = 0;
+		if (slot == cache->mru)
+			cache->mru = slot->next;
 		return status;
 	}
+	if (slot->buffer.size)
+		hash_cache_slot(cache, slot);
 
  out:
 	if (!slot->buffer.ptr)
@@ -149,7 +275,7 @@ get_cache_buf(addrxlat_ctx_t *ctx, const addrxlat_fulladdr_t *addr,
 				 "Infinite read recursion");
 
 	*pbuf = &slot->buffer;
-	touch_cache_slot(&ctx->cache, slot);
+	touch_cache_slot(cache, slot);
 	return ADDRXLAT_OK;
 }
 
@@ -168,30 +294,24 @@ bury_cache_buffer(struct read_cache *cache, const addrxlat_fulladdr_t *addr)
 	struct read_cache_slot *slot;
 
 	/* Find the corresponding cache slot */
-	slot = &cache->slot[0];
-	do {
-		addrxlat_buffer_t *buf = &slot->buffer;
-		if (buf->size > addr->addr - buf->addr.addr &&
-		    buf->addr.as == addr->as) {
-			/* FOUND */
-
-			/* If already marked, do nothing. */
-			if (slot->next == cache->mru)
-				break;
-
-			/* Reorder the MRU chain if needed */
-			if (slot != cache->mru) {
-				slot->prev->next = slot->next;
-				slot->next->prev = slot->prev;
-				slot->next = cache->mru;
-				slot->prev = cache->mru->prev;
-				slot->prev->next = slot->next->prev = slot;
-			} else
-				/* Move the MRU pointer. */
-				cache->mru = slot->next;
-			break;
-		}
-	} while (++slot < &cache->slot[READ_CACHE_SLOTS]);
+	slot = find_cache_slot(cache, addr);
+	if (!slot)
+		return;
+
+	/* If already marked, do nothing. */
+	if (slot->next == cache->mru)
+		return;
+
+	/* Reorder the MRU chain if needed */
+	if (slot != cache->mru) {
+		slot->prev->next = slot->next;
+		slot->next->prev = slot->prev;
+		slot->next = cache->mru;
+		slot->prev = cache->mru->prev;
+		slot->prev->next = slot->next->prev = slot;
+	} else
+		/* Move the MRU pointer. */
+		cache->mru = slot->next;
 }
 
 /** Missing callback handler.
@@ -309,7 +429,10 @@ addrxlat_ctx_new(void)
 		ctx->def_cb.sym_sizeof = def_sym_sizeof_cb;
 		ctx->def_cb.sym_offsetof = def_sym_offsetof_cb;
 		ctx->def_cb.num_value = def_num_value_cb;
-		init_cache(&ctx->cache);
+		if (!init_cache(&ctx->cache, READ_CACHE_SLOTS)) {
+			free(ctx);
+			return NULL;
+		}
 		err_init(&ctx->err, ERRBUF);
 	}
 	return ctx;
@@ -339,6 +462,35 @@ addrxlat_ctx_decref(addrxlat_ctx_t *ctx)
 	return refcnt;
 }
 
+addrxlat_status
+addrxlat_ctx_set_read_cache_size(addrxlat_ctx_t *ctx, unsigned nslots)
+{
+	struct read_cache cache;
+
+	clear_error(ctx);
+
+	if (nslots < READ_CACHE_SLOTS)
+		return set_error(ctx, ADDRXLAT_ERR_INVALID,
+				 "Read cache size too small: %u (min %u)",
+				 nslots, READ_CACHE_SLOTS);
+	if (nslots == ctx->cache.nslots)
+		return ADDRXLAT_OK;
+
+	if (!init_cache(&cache, nslots))
+		return set_error(ctx, ADDRXLAT_ERR_NOMEM,
+				 "Cannot allocate %u read cache slots",
+				 nslots);
+	cleanup_cache(&ctx->cache);
+	ctx->cache = cache;
+	return ADDRXLAT_OK;
+}
+
+unsigned
+addrxlat_ctx_get_read_cache_size(const addrxlat_ctx_t *ctx)
+{
+	return ctx->cache.nslots;
+}
+
 void addrxlat_ctx_clear_err(addrxlat_ctx_t *ctx)
 {
 	clear_error(ctx);
@@ -463,6 +615,7 @@ addrxlat_ctx_add_cb(addrxlat_ctx_t *ctx)
 	cb->num_value = next_num_value_cb;
 
 	ctx->cb = cb;
+	++ctx->tlb.gen;	/* Flush the TLB. */
 
 	return cb;
 }
@@ -480,6 +633,7 @@ addrxlat_ctx_del_cb(addrxlat_ctx_t *ctx, addrxlat_cb_t *cb)
 	if (p) {
 		*pprev = cb->next;
 		free(cb);
+		++ctx->tlb.gen;	/* Flush the TLB. */
 	}
 }
 
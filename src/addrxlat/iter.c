@@ -0,0 +1,479 @@
+/** @internal @file src/addrxlat/iter.c
+ * @brief Page table enumeration.
+ */
+/* Copyright (C) Petr Tesarik <petr@tesarici.cz>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "addrxlat-priv.h"
+#include "../threads.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/** A unit of work: one top-level page table entry. */
+struct pgt_item {
+	addrxlat_addr_t first;	/**< First address in the subtree. */
+	addrxlat_addr_t last;	/**< Last address in the subtree. */
+};
+
+/** Shared iteration state. */
+struct pgt_iter_state {
+	/** Iteration parameters. */
+	const addrxlat_pgt_iter_t *iter;
+
+	/** Top-level subtrees. */
+	struct pgt_item *items;
+
+	/** Number of elements in @c items. */
+	size_t nitems;
+
+	/** Index of the next unclaimed item in @c items. */
+	size_t next;
+
+	/** Non-zero if all walkers should stop. */
+	int stop;
+
+	/** Non-zero if pending extents are flushed after each item. */
+	int flush_items;
+
+#if USE_PTHREAD
+	/** Lock which serializes calls to the extent callback. */
+	mutex_t fnlock;
+#endif
+};
+
+/** Per-thread walker state. */
+struct pgt_walker {
+	/** Shared iteration state. */
+	struct pgt_iter_state *state;
+
+	/** Context used by this walker. */
+	addrxlat_ctx_t *ctx;
+
+	/** Pending (not yet reported) extent. Unused if size is zero. */
+	addrxlat_pgt_extent_t pending;
+
+	/** Final status of the walker. */
+	addrxlat_status status;
+
+#if USE_PTHREAD
+	/** Worker thread. */
+	pthread_t thread;
+
+	/** Non-zero if @c thread is running. */
+	int started;
+#endif
+};
+
+/** Pass an extent to the user callback.
+ * @param w    Walker state.
+ * @param ext  Extent.
+ * @returns    Error status.
+ */
+static addrxlat_status
+call_fn(struct pgt_walker *w, const addrxlat_pgt_extent_t *ext)
+{
+	struct pgt_iter_state *state = w->state;
+	const addrxlat_pgt_iter_t *iter = state->iter;
+	addrxlat_status status;
+
+#if USE_PTHREAD
+	mutex_lock(&state->fnlock);
+#endif
+	status = __atomic_load_n(&state->stop, __ATOMIC_RELAXED)
+		? ADDRXLAT_OK
+		: iter->fn(iter->data, ext);
+#if USE_PTHREAD
+	mutex_unlock(&state->fnlock);
+#endif
+	return status;
+}
+
+/** Report the pending extent (if any).
+ * @param w  Walker state.
+ * @returns  Error status.
+ */
+static addrxlat_status
+flush_extent(struct pgt_walker *w)
+{
+	addrxlat_status status;
+
+	if (!w->pending.size)
+		return ADDRXLAT_OK;
+	status = call_fn(w, &w->pending);
+	w->pending.size = 0;
+	return status;
+}
+
+/** Add a mapped extent.
+ * @param w     Walker state.
+ * @param step  Completed translation step.
+ * @param addr  First source address.
+ * @param size  Size of the extent.
+ * @returns     Error status.
+ */
+static addrxlat_status
+add_extent(struct pgt_walker *w, const addrxlat_step_t *step,
+	   addrxlat_addr_t addr, addrxlat_addr_t size)
+{
+	addrxlat_pgt_extent_t *pend = &w->pending;
+	addrxlat_status status;
+
+	if (pend->size &&
+	    pend->addr + pend->size == addr &&
+	    pend->target.as == step->base.as &&
+	    pend->target.addr + pend->size == step->base.addr &&
+	    pend->size + size > pend->size) {
+		pend->size += size;
+		return ADDRXLAT_OK;
+	}
+
+	status = flush_extent(w);
+	if (status != ADDRXLAT_OK)
+		return status;
+
+	pend->addr = addr;
+	pend->target = step->base;
+	pend->size = size;
+	pend->pte = step->raw.pte;
+	if (!(w->state->iter->flags & ADDRXLAT_PGT_ITER_MERGE))
+		return flush_extent(w);
+	return ADDRXLAT_OK;
+}
+
+static addrxlat_status walk_tbl(struct pgt_walker *w, addrxlat_step_t *step,
+				addrxlat_addr_t first, addrxlat_addr_t last);
+
+/** Walk one page table entry.
+ * @param w      Walker state.
+ * @param step   Step state; the entry is selected by the table indices.
+ * @param first  First address covered by the entry.
+ * @param last   Last address covered by the entry.
+ * @returns      Error status.
+ *
+ * Non-present entries are silently skipped.
+ */
+static addrxlat_status
+walk_entry(struct pgt_walker *w, addrxlat_step_t *step,
+	   addrxlat_addr_t first, addrxlat_addr_t last)
+{
+	addrxlat_status status;
+
+	status = internal_step(step);
+	if (status == ADDRXLAT_ERR_NOTPRESENT) {
+		clear_error(step->ctx);
+		return ADDRXLAT_OK;
+	} else if (status != ADDRXLAT_OK)
+		return status;
+
+	if (step->remain > 1)
+		return walk_tbl(w, step, first, last);
+
+	/* Last-level entry or a huge page. */
+	status = internal_step(step);
+	if (status != ADDRXLAT_OK)
+		return status;
+	return add_extent(w, step, first, last - first + 1);
+}
+
+/** Check whether a page table read error should be ignored.
+ * @param w       Walker state.
+ * @param status  Status of reading a table entry.
+ * @returns       @c true if the table should be skipped.
+ *
+ * If the error is ignored, it is also cleared from the context.
+ */
+static bool
+skip_table(struct pgt_walker *w, addrxlat_status status)
+{
+	if (status != ADDRXLAT_ERR_NODATA ||
+	    !(w->state->iter->flags & ADDRXLAT_PGT_ITER_SKIP_NODATA))
+		return false;
+	clear_error(w->ctx);
+	return true;
+}
+
+/** Walk all entries of a page table.
+ * @param w      Walker state.
+ * @param step   Step state pointing to the page table.
+ * @param first  First address to walk.
+ * @param last   Last address to walk.
+ * @returns      Error status.
+ *
+ * If the table cannot be read and @ref ADDRXLAT_PGT_ITER_SKIP_NODATA
+ * is set, the remaining entries of the table are skipped.
+ */
+static addrxlat_status
+walk_tbl(struct pgt_walker *w, addrxlat_step_t *step,
+	 addrxlat_addr_t first, addrxlat_addr_t last)
+{
+	const addrxlat_paging_form_t *pf = &step->meth->param.pgt.pf;
+	addrxlat_addr_t tblmask = pf_table_mask(pf, step->remain - 1);
+	addrxlat_addr_t addr = first;
+	addrxlat_step_t mystep;
+	addrxlat_status status;
+
+	for (;;) {
+		addrxlat_addr_t elast = addr | tblmask;
+		addrxlat_addr_t rest;
+		unsigned short i;
+
+		if (elast > last)
+			elast = last;
+
+		memcpy(&mystep, step, sizeof mystep);
+		rest = addr;
+		for (i = 0; i < step->remain; ++i) {
+			mystep.idx[i] = rest & (pf_table_size(pf, i) - 1);
+			rest >>= pf->fieldsz[i];
+		}
+
+		status = walk_entry(w, &mystep, addr, elast);
+		if (skip_table(w, status))
+			break;
+		if (status != ADDRXLAT_OK)
+			return status;
+		if (elast == last ||
+		    __atomic_load_n(&w->state->stop, __ATOMIC_RELAXED))
+			break;
+		addr = elast + 1;
+	}
+
+	bury_cache_buffer(&step->ctx->cache, &step->base);
+	return ADDRXLAT_OK;
+}
+
+/** Walk one top-level subtree.
+ * @param w     Walker state.
+ * @param item  Subtree to be walked.
+ * @returns     Error status.
+ */
+static addrxlat_status
+walk_item(struct pgt_walker *w, const struct pgt_item *item)
+{
+	const addrxlat_pgt_iter_t *iter = w->state->iter;
+	addrxlat_step_t step;
+	addrxlat_status status;
+
+	step.ctx = w->ctx;
+	step.sys = iter->sys;
+	step.meth = iter->meth;
+	status = internal_launch(&step, item->first);
+	if (status == ADDRXLAT_ERR_INVALID) {
+		/* Address not translatable by this method. */
+		clear_error(w->ctx);
+		return ADDRXLAT_OK;
+	} else if (status != ADDRXLAT_OK)
+		return status;
+
+	status = walk_entry(w, &step, item->first, item->last);
+	return skip_table(w, status) ? ADDRXLAT_OK : status;
+}
+
+/** Claim and walk subtrees until there are none left.
+ * @param w  Walker state.
+ */
+static void
+run_walker(struct pgt_walker *w)
+{
+	struct pgt_iter_state *state = w->state;
+	int savednoerr = w->ctx->noerr.notpresent;
+	addrxlat_status status = ADDRXLAT_OK;
+
+	w->ctx->noerr.notpresent = 1;
+	w->pending.size = 0;
+	while (!__atomic_load_n(&state->stop, __ATOMIC_RELAXED)) {
+		size_t idx = __atomic_fetch_add(&state->next, 1,
+						__ATOMIC_RELAXED);
+		if (idx >= state->nitems)
+			break;
+
+		status = walk_item(w, &state->items[idx]);
+		if (status == ADDRXLAT_OK && state->flush_items)
+			status = flush_extent(w);
+		if (status != ADDRXLAT_OK) {
+			__atomic_store_n(&state->stop, 1, __ATOMIC_RELAXED);
+			break;
+		}
+	}
+	if (status == ADDRXLAT_OK)
+		status = flush_extent(w);
+	w->ctx->noerr.notpresent = savednoerr;
+	w->status = status;
+}
+
+#if USE_PTHREAD
+static void *
+walker_thread(void *arg)
+{
+	run_walker(arg);
+	return NULL;
+}
+#endif
+
+/** Split a range into top-level subtrees.
+ * @param state  Iteration state.
+ * @param first  First address of the range.
+ * @param last   Last address of the range.
+ * @param span   Address span of a top-level entry.
+ *
+ * The @c items array must be large enough.
+ */
+static void
+add_items(struct pgt_iter_state *state, addrxlat_addr_t first,
+	  addrxlat_addr_t last, addrxlat_addr_t span)
+{
+	for (;;) {
+		struct pgt_item *item = &state->items[state->nitems++];
+		item->first = first;
+		item->last = first | (span - 1);
+		if (item->last >= last) {
+			item->last = last;
+			break;
+		}
+		first = item->last + 1;
+	}
+}
+
+/** Count top-level subtrees in a range.
+ * @param first  First address of the range.
+ * @param last   Last address of the range.
+ * @param span   Address span of a top-level entry.
+ * @returns      Number of top-level entries.
+ */
+static inline size_t
+count_items(addrxlat_addr_t first, addrxlat_addr_t last,
+	    addrxlat_addr_t span)
+{
+	return (last / span) - (first / span) + 1;
+}
+
+DEFINE_ALIAS(pgt_iter);
+
+addrxlat_status
+addrxlat_pgt_iter(const addrxlat_pgt_iter_t *iter)
+{
+	addrxlat_ctx_t *ctx = iter->ctx;
+	const addrxlat_paging_form_t *pf;
+	struct pgt_iter_state state;
+	struct pgt_walker *walkers;
+	addrxlat_addr_t span, vmask;
+	unsigned nwalkers, i;
+	addrxlat_status status;
+
+	clear_error(ctx);
+
+	if (iter->meth->kind != ADDRXLAT_PGT)
+		return set_error(ctx, ADDRXLAT_ERR_NOTIMPL,
+				 "Not a page table translation method");
+	pf = &iter->meth->param.pgt.pf;
+	if (pf->nfields < 2)
+		return set_error(ctx, ADDRXLAT_ERR_NOTIMPL,
+				 "Paging form has no page tables");
+	if (iter->first > iter->last)
+		return ADDRXLAT_OK;
+
+	span = pf_table_span(pf, pf->nfields - 1);
+	vmask = paging_max_index(pf);
+
+	/* Addresses which differ only above the paging bits are never
+	 * translatable, except (possibly) the regions which contain
+	 * the first and the last address.
+	 */
+	state.iter = iter;
+	state.nitems = count_items(iter->first, iter->first | vmask, span);
+	if ((iter->first & ~vmask) != (iter->last & ~vmask))
+		state.nitems += count_items(iter->last & ~vmask,
+					    iter->last, span);
+	state.items = malloc(state.nitems * sizeof(*state.items));
+	if (!state.items)
+		return set_error(ctx, ADDRXLAT_ERR_NOMEM,
+				 "Cannot allocate %zu page table subtrees",
+				 state.nitems);
+	state.nitems = 0;
+	if ((iter->first & ~vmask) != (iter->last & ~vmask)) {
+		add_items(&state, iter->first, iter->first | vmask, span);
+		add_items(&state, iter->last & ~vmask, iter->last, span);
+	} else
+		add_items(&state, iter->first, iter->last, span);
+	state.next = 0;
+	state.stop = 0;
+
+#if USE_PTHREAD
+	nwalkers = iter->nworkers + 1;
+	if (nwalkers > state.nitems)
+		nwalkers = state.nitems;
+#else
+	nwalkers = 1;
+#endif
+	state.flush_items = (nwalkers > 1);
+
+	walkers = calloc(nwalkers, sizeof(*walkers));
+	if (!walkers) {
+		free(state.items);
+		return set_error(ctx, ADDRXLAT_ERR_NOMEM,
+				 "Cannot allocate %u page table walkers",
+				 nwalkers);
+	}
+	for (i = 0; i < nwalkers; ++i) {
+		walkers[i].state = &state;
+		walkers[i].ctx = i ? iter->workers[i - 1] : ctx;
+		walkers[i].status = ADDRXLAT_OK;
+	}
+
+#if USE_PTHREAD
+	mutex_init(&state.fnlock, NULL);
+	for (i = 1; i < nwalkers; ++i) {
+		clear_error(walkers[i].ctx);
+		/* If a thread cannot be created, fewer threads do the work. */
+		walkers[i].started = !pthread_create(
+			&walkers[i].thread, NULL, walker_thread, &walkers[i]);
+	}
+#endif
+
+	run_walker(&walkers[0]);
+	status = walkers[0].status;
+
+#if USE_PTHREAD
+	for (i = 1; i < nwalkers; ++i) {
+		if (!walkers[i].started)
+			continue;
+		pthread_join(walkers[i].thread, NULL);
+		if (status == ADDRXLAT_OK && walkers[i].status != ADDRXLAT_OK) {
+			const char *msg = err_str(&walkers[i].ctx->err);
+			status = msg
+				? set_error(ctx, walkers[i].status, "%s", msg)
+				: walkers[i].status;
+		}
+	}
+	mutex_destroy(&state.fnlock);
+#endif
+
+	free(walkers);
+	free(state.items);
+	return status;
+}
@@ -200,25 +200,148 @@ addrxlat_map_set(addrxlat_map_t *map, addrxlat_addr_t addr,
 
 	first->endoff = range->endoff + extend;
 	first->meth = range->meth;
+	map_drop_index(map);
+	tlb_invalidate_all();
 	return ADDRXLAT_OK;
 }
 
+DEFINE_ALIAS(map_set_ranges);
+
+addrxlat_status
+addrxlat_map_set_ranges(addrxlat_map_t *map, const addrxlat_range_t *ranges,
+			size_t n)
+{
+	addrxlat_range_t *newranges;
+	addrxlat_addr_t pos;
+	size_t i;
+
+	/* The ranges must cover the whole address space. */
+	pos = 0;
+	for (i = 0; i < n; ++i) {
+		if (i && !pos)
+			return ADDRXLAT_ERR_INVALID;
+		pos += ranges[i].endoff + 1;
+	}
+	if (pos)
+		return ADDRXLAT_ERR_INVALID;
+
+	newranges = malloc((n ?: 1) * sizeof(newranges[0]));
+	if (!newranges)
+		return ADDRXLAT_ERR_NOMEM;
+	memcpy(newranges, ranges, n * sizeof(newranges[0]));
+
+	map_clear(map);
+	if (map->ranges)
+		free(map->ranges);
+	map->ranges = newranges;
+	map->n = n;
+	tlb_invalidate_all();
+	return ADDRXLAT_OK;
+}
+
+/** Discard the search index of a translation map.
+ * @param map  Address translation map.
+ *
+ * This function must be called whenever the ranges of a map change.
+ */
+void
+map_drop_index(addrxlat_map_t *map)
+{
+	if (map->index) {
+		free(map->index);
+		map->index = NULL;
+	}
+}
+
+/** Get the search index of a translation map.
+ * @param map  Address translation map.
+ * @returns    Start addresses of all ranges, or @c NULL.
+ *
+ * If the index does not exist yet, it is built now. Concurrent
+ * searches may race to build the index; only one of them is stored
+ * in the map, and the others are freed. If there is not enough memory
+ * for the index, this function returns @c NULL, and the caller should
+ * fall back to a linear search.
+ */
+static const addrxlat_addr_t *
+map_get_index(const addrxlat_map_t *map)
+{
+	addrxlat_addr_t **pindex = (addrxlat_addr_t **)&map->index;
+	addrxlat_addr_t *index, *expect;
+	addrxlat_addr_t raddr;
+	size_t i;
+
+	index = __atomic_load_n(pindex, __ATOMIC_ACQUIRE);
+	if (index)
+		return index;
+
+	index = malloc(map->n * sizeof(index[0]));
+	if (!index)
+		return NULL;
+	raddr = 0;
+	for (i = 0; i < map->n; ++i) {
+		index[i] = raddr;
+		raddr += map->ranges[i].endoff + 1;
+	}
+
+	expect = NULL;
+	if (!__atomic_compare_exchange_n(pindex, &expect, index, false,
+					 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		free(index);
+		index = expect;
+	}
+	return index;
+}
+
+DEFINE_ALIAS(map_find);
+
+size_t
+addrxlat_map_find(const addrxlat_map_t *map, addrxlat_addr_t addr,
+		  addrxlat_addr_t *start)
+{
+	const addrxlat_addr_t *index;
+	addrxlat_addr_t raddr;
+	size_t i, lo, hi;
+
+	if (map->n < MAP_INDEX_MIN || !(index = map_get_index(map))) {
+		raddr = 0;
+		for (i = 0; i < map->n; ++i) {
+			if (addr <= raddr + map->ranges[i].endoff) {
+				*start = raddr;
+				return i;
+			}
+			raddr += map->ranges[i].endoff + 1;
+		}
+		return map->n;
+	}
+
+	/* Find the last range which starts at or below addr. */
+	lo = 0;
+	hi = map->n;
+	while (hi - lo > 1) {
+		i = lo + (hi - lo) / 2;
+		if (index[i] <= addr)
+			lo = i;
+		else
+			hi = i;
+	}
+	if (addr - index[lo] > map->ranges[lo].endoff)
+		return map->n;
+	*start = index[lo];
+	return lo;
+}
+
 DEFINE_ALIAS(map_search);
 
 addrxlat_sys_meth_t
 addrxlat_map_search(const addrxlat_map_t *map, addrxlat_addr_t addr)
 {
-	const addrxlat_range_t *r = map->ranges;
-	addrxlat_addr_t raddr = 0;
-	size_t left = map->n;
-
-	while (left-- > 0) {
-		if (addr <= raddr + r->endoff)
-			return r->meth;
-		raddr += r->endoff + 1;
-		++r;
-	}
-	return ADDRXLAT_SYS_METH_NONE;
+	addrxlat_addr_t start;
+	size_t i = internal_map_find(map, addr, &start);
+
+	return i < map->n
+		? map->ranges[i].meth
+		: ADDRXLAT_SYS_METH_NONE;
 }
 
 DEFINE_ALIAS(map_copy);
@@ -0,0 +1,315 @@
+/** @internal @file src/addrxlat/rmap.c
+ * @brief Reverse (target-to-source) mapping index.
+ */
+/* Copyright (C) Petr Tesarik <petr@tesarici.cz>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+
+#include "addrxlat-priv.h"
+
+/** Temporary list of page table extents. */
+struct rmap_extents {
+	/** Extents in the order of their source addresses. */
+	struct rmap_entry *ext;
+
+	/** Number of used elements in @c ext. */
+	size_t n;
+
+	/** Number of allocated elements in @c ext. */
+	size_t alloc;
+};
+
+/** Free the reverse mapping index of a translation system.
+ * @param sys  Translation system.
+ */
+void
+rmap_free(addrxlat_sys_t *sys)
+{
+	free(sys->rmap);
+	sys->rmap = NULL;
+}
+
+/** Page table iteration callback to collect extents.
+ * @param data  Extent list (@ref rmap_extents).
+ * @param ext   Mapped extent.
+ * @returns     Error status.
+ */
+static addrxlat_status
+add_extent(void *data, const addrxlat_pgt_extent_t *ext)
+{
+	struct rmap_extents *exts = data;
+	struct rmap_entry *entry;
+
+	if (exts->n == exts->alloc) {
+		size_t alloc = exts->alloc ? 2 * exts->alloc : 256;
+		entry = realloc(exts->ext, alloc * sizeof(*entry));
+		if (!entry)
+			return ADDRXLAT_ERR_NOMEM;
+		exts->ext = entry;
+		exts->alloc = alloc;
+	}
+
+	entry = &exts->ext[exts->n++];
+	entry->paddr = ext->target.addr;
+	entry->size = ext->size;
+	entry->vaddr = ext->addr;
+	return ADDRXLAT_OK;
+}
+
+static int
+addr_cmp(const void *a, const void *b)
+{
+	addrxlat_addr_t aa = *(const addrxlat_addr_t *)a;
+	addrxlat_addr_t ab = *(const addrxlat_addr_t *)b;
+	return aa < ab ? -1 : aa > ab;
+}
+
+static int
+entry_cmp(const void *a, const void *b)
+{
+	const struct rmap_entry *ea = a, *eb = b;
+	if (ea->paddr != eb->paddr)
+		return ea->paddr < eb->paddr ? -1 : 1;
+	return ea->vaddr < eb->vaddr ? -1 : ea->vaddr > eb->vaddr;
+}
+
+/** Find the first boundary above an address.
+ * @param bound  Sorted array of boundaries.
+ * @param n      Number of elements in @p bound.
+ * @param addr   Address.
+ * @returns      Index of the first element greater than @p addr.
+ */
+static size_t
+upper_bound(const addrxlat_addr_t *bound, size_t n, addrxlat_addr_t addr)
+{
+	size_t lo = 0, hi = n;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (bound[mid] <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/** Build a reverse mapping index from page table extents.
+ * @param exts   Page table extents.
+ * @param as     Target address space.
+ * @returns      Reverse mapping index, or @c NULL on allocation failure.
+ *
+ * Each extent is split at the start and end of all other extents,
+ * so that any two resulting entries either cover exactly the same
+ * target range or do not overlap.
+ */
+static struct rmap *
+make_rmap(const struct rmap_extents *exts, addrxlat_addrspace_t as)
+{
+	addrxlat_addr_t *bound;
+	struct rmap *rmap;
+	size_t nbound, nentry;
+	size_t i, j, k;
+
+	bound = malloc((2 * exts->n + 1) * sizeof(*bound));
+	if (!bound)
+		return NULL;
+	nbound = 0;
+	for (i = 0; i < exts->n; ++i) {
+		const struct rmap_entry *ext = &exts->ext[i];
+		bound[nbound++] = ext->paddr;
+		if (ext->paddr + ext->size)
+			bound[nbound++] = ext->paddr + ext->size;
+	}
+	qsort(bound, nbound, sizeof(*bound), addr_cmp);
+	for (i = j = 0; i < nbound; ++i)
+		if (!j || bound[i] != bound[j - 1])
+			bound[j++] = bound[i];
+	nbound = j;
+
+	nentry = 0;
+	for (i = 0; i < exts->n; ++i) {
+		const struct rmap_entry *ext = &exts->ext[i];
+		addrxlat_addr_t last = ext->paddr + ext->size - 1;
+		j = upper_bound(bound, nbound, ext->paddr);
+		k = upper_bound(bound, nbound, last);
+		nentry += k - j + 1;
+	}
+
+	rmap = malloc(sizeof(*rmap) + nentry * sizeof(*rmap->entry));
+	if (!rmap) {
+		free(bound);
+		return NULL;
+	}
+	rmap->as = as;
+	rmap->n = 0;
+	for (i = 0; i < exts->n; ++i) {
+		const struct rmap_entry *ext = &exts->ext[i];
+		addrxlat_addr_t last = ext->paddr + ext->size - 1;
+		addrxlat_addr_t start = ext->paddr;
+
+		j = upper_bound(bound, nbound, start);
+		for (;;) {
+			struct rmap_entry *entry = &rmap->entry[rmap->n++];
+			entry->paddr = start;
+			entry->vaddr = ext->vaddr + (start - ext->paddr);
+			if (j >= nbound || bound[j] > last) {
+				entry->size = last - start + 1;
+				break;
+			}
+			entry->size = bound[j] - start;
+			start = bound[j++];
+		}
+	}
+	free(bound);
+
+	qsort(rmap->entry, rmap->n, sizeof(*rmap->entry), entry_cmp);
+	return rmap;
+}
+
+/** Get the reverse mapping index of a translation system.
+ * @param sys    Translation system.
+ * @param ctx    Address translation context.
+ * @param prmap  Reverse mapping index (set on successful return).
+ * @returns      Error status.
+ *
+ * If the index does not exist yet, it is built by walking all page
+ * tables of @ref ADDRXLAT_SYS_METH_PGT.
+ */
+static addrxlat_status
+get_rmap(addrxlat_sys_t *sys, addrxlat_ctx_t *ctx, struct rmap **prmap)
+{
+	const addrxlat_meth_t *meth = &sys->meth[ADDRXLAT_SYS_METH_PGT];
+	struct rmap_extents exts;
+	addrxlat_pgt_iter_t iter;
+	struct rmap *rmap, *expect;
+	addrxlat_status status;
+
+	rmap = __atomic_load_n(&sys->rmap, __ATOMIC_ACQUIRE);
+	if (rmap) {
+		*prmap = rmap;
+		return ADDRXLAT_OK;
+	}
+
+	exts.ext = NULL;
+	exts.n = 0;
+	exts.alloc = 0;
+
+	iter.ctx = ctx;
+	iter.sys = sys;
+	iter.meth = meth;
+	iter.first = 0;
+	iter.last = ADDRXLAT_ADDR_MAX;
+	iter.fn = add_extent;
+	iter.data = &exts;
+	iter.flags = ADDRXLAT_PGT_ITER_MERGE | ADDRXLAT_PGT_ITER_SKIP_NODATA;
+	iter.nworkers = 0;
+	iter.workers = NULL;
+	status = internal_pgt_iter(&iter);
+	if (status == ADDRXLAT_ERR_NOMEM)
+		status = set_error(ctx, status, "Cannot allocate %s",
+				   "page table extents");
+	if (status != ADDRXLAT_OK) {
+		free(exts.ext);
+		return set_error(ctx, status,
+				 "Cannot build reverse mapping index");
+	}
+
+	rmap = make_rmap(&exts, meth->target_as);
+	free(exts.ext);
+	if (!rmap)
+		return set_error(ctx, ADDRXLAT_ERR_NOMEM,
+				 "Cannot allocate %s", "reverse mapping index");
+
+	/* Another thread may have built the index meanwhile. */
+	expect = NULL;
+	if (!__atomic_compare_exchange_n(&sys->rmap, &expect, rmap, false,
+					 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		free(rmap);
+		rmap = expect;
+	}
+	*prmap = rmap;
+	return ADDRXLAT_OK;
+}
+
+DEFINE_ALIAS(sys_rmap);
+
+addrxlat_status
+addrxlat_sys_rmap(addrxlat_sys_t *sys, addrxlat_ctx_t *ctx,
+		  const addrxlat_fulladdr_t *paddr,
+		  addrxlat_rmap_fn *fn, void *data)
+{
+	const struct rmap_entry *entry;
+	addrxlat_fulladdr_t addr;
+	struct rmap *rmap;
+	addrxlat_addr_t off;
+	size_t lo, hi;
+	addrxlat_status status;
+
+	clear_error(ctx);
+
+	status = get_rmap(sys, ctx, &rmap);
+	if (status != ADDRXLAT_OK)
+		return status;
+
+	addr = *paddr;
+	if (addr.as != rmap->as) {
+		status = internal_fulladdr_conv(&addr, rmap->as, ctx, sys);
+		if (status != ADDRXLAT_OK)
+			return status;
+	}
+
+	/* Find the last entry which starts at or below the address. */
+	lo = 0;
+	hi = rmap->n;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (rmap->entry[mid].paddr <= addr.addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (!hi || addr.addr - rmap->entry[hi - 1].paddr >=
+	    rmap->entry[hi - 1].size)
+		return set_error(ctx, ADDRXLAT_ERR_NOTPRESENT,
+				 "No mapping of %s:0x%" ADDRXLAT_PRIxADDR,
+				 internal_addrspace_name(addr.as),
+				 addr.addr);
+
+	/* All entries with the same start cover the same range. */
+	entry = &rmap->entry[hi - 1];
+	off = addr.addr - entry->paddr;
+	while (entry > rmap->entry && entry[-1].paddr == entry->paddr)
+		--entry;
+	for ( ; entry < &rmap->entry[hi]; ++entry) {
+		status = fn(data, entry->vaddr + off);
+		if (status != ADDRXLAT_OK)
+			return status;
+	}
+
+	return ADDRXLAT_OK;
+}
@@ -64,6 +64,7 @@ sys_cleanup(addrxlat_sys_t *sys)
 			internal_map_decref(sys->map[i]);
 			sys->map[i] = NULL;
 		}
+	rmap_free(sys);
 }
 
 unsigned long
@@ -73,6 +74,7 @@ addrxlat_sys_decref(addrxlat_sys_t *sys)
 	if (!refcnt) {
 		sys_cleanup(sys);
 		free(sys);
+		tlb_invalidate_all();
 	}
 	return refcnt;
 }
@@ -216,7 +218,14 @@ addrxlat_sys_os_init(addrxlat_sys_t *sys, addrxlat_ctx_t *ctx,
 			ctl.os_type = OS_XEN;
 	}
 
-	return arch_fn(&ctl);
+	/* Methods and maps are modified directly during initialization,
+	 * so page table walks must not be cached until it is finished.
+	 */
+	++ctx->tlb.disabled;
+	status = arch_fn(&ctl);
+	--ctx->tlb.disabled;
+	tlb_invalidate_all();
+	return status;
 }
 
 void
@@ -228,6 +237,7 @@ addrxlat_sys_set_map(addrxlat_sys_t *sys, addrxlat_sys_map_t idx,
 	if (sys->map[idx])
 		internal_map_decref(sys->map[idx]);
 	sys->map[idx] = map;
+	tlb_invalidate_all();
 }
 
 addrxlat_map_t *
@@ -241,6 +251,9 @@ addrxlat_sys_set_meth(addrxlat_sys_t *sys,
 		      addrxlat_sys_meth_t idx, const addrxlat_meth_t *meth)
 {
 	sys->meth[idx] = *meth;
+	if (idx == ADDRXLAT_SYS_METH_PGT)
+		rmap_free(sys);
+	tlb_invalidate_all();
 }
 
 const addrxlat_meth_t *
@@ -530,7 +543,7 @@ do_op(const addrxlat_op_ctl_t *ctl, const addrxlat_fulladdr_t *paddr,
 
 			step.meth = meth;
 			step.base.addr = paddr->addr;
-			status = internal_walk(&step);
+			status = tlb_walk(&step, paddr->as);
 			if (status == ADDRXLAT_OK) {
 				if (ctl->caps & ADDRXLAT_CAPS(step.base.as))
 					return ctl->op(ctl->data, &step.base);
@@ -546,20 +559,16 @@ do_op(const addrxlat_op_ctl_t *ctl, const addrxlat_fulladdr_t *paddr,
 	return set_error(ctl->ctx, ADDRXLAT_ERR_NOMETH, "No way to translate");
 }
 
-DEFINE_ALIAS(op);
-
-addrxlat_status
-addrxlat_op(const addrxlat_op_ctl_t *ctl, const addrxlat_fulladdr_t *paddr)
+/** Choose the translation chain for an operation.
+ * @param ctl    Control structure.
+ * @param as     Source address space.
+ * @param chain  Set to the translation chain on success.
+ * @returns      Error status.
+ */
+static addrxlat_status
+select_chain(const addrxlat_op_ctl_t *ctl, addrxlat_addrspace_t as,
+	     const struct xlat_chain **chain)
 {
-	struct inflight inflight, *pif;
-	const struct xlat_chain *chain;
-	addrxlat_status status;
-
-	clear_error(ctl->ctx);
-
-	if (ctl->caps & ADDRXLAT_CAPS(paddr->as))
-		return ctl->op(ctl->data, paddr);
-
 	/* Check that some translation is possible. */
 	if ((ctl->caps & (ADDRXLAT_CAPS(ADDRXLAT_KVADDR) |
 			  ADDRXLAT_CAPS(ADDRXLAT_KPHYSADDR) |
@@ -571,21 +580,21 @@ addrxlat_op(const addrxlat_op_ctl_t *ctl, const addrxlat_fulladdr_t *paddr)
 		return set_error(ctl->ctx, ADDRXLAT_ERR_NOMETH,
 				 "No translation system");
 
-	switch (paddr->as) {
+	switch (as) {
 	case ADDRXLAT_KVADDR:
-		chain = &kv2phys;
+		*chain = &kv2phys;
 		break;
 
 	case ADDRXLAT_KPHYSADDR:
-		chain = (ctl->caps & ADDRXLAT_CAPS(ADDRXLAT_MACHPHYSADDR)
-			 ? (ctl->caps & ADDRXLAT_CAPS(ADDRXLAT_KVADDR)
-			    ? &kphys2any
-			    : &kphys2machphys)
-			 : &kphys2direct);
+		*chain = (ctl->caps & ADDRXLAT_CAPS(ADDRXLAT_MACHPHYSADDR)
+			  ? (ctl->caps & ADDRXLAT_CAPS(ADDRXLAT_KVADDR)
+			     ? &kphys2any
+			     : &kphys2machphys)
+			  : &kphys2direct);
 		break;
 
 	case ADDRXLAT_MACHPHYSADDR:
-		chain = &machphys2direct;
+		*chain = &machphys2direct;
 		break;
 
 	default:
@@ -593,15 +602,51 @@ addrxlat_op(const addrxlat_op_ctl_t *ctl, const addrxlat_fulladdr_t *paddr)
 				 "Unrecognized address space");
 	}
 
+	return ADDRXLAT_OK;
+}
+
+/** Check whether a translation is already in progress.
+ * @param inflight  Translation to be checked.
+ * @returns         @c true if the same translation is found in the list
+ *                  of in-flight translations following @p inflight.
+ */
+static bool
+is_inflight(const struct inflight *inflight)
+{
+	const struct inflight *pif;
+
+	for (pif = inflight->next; pif; pif = pif->next)
+		if (pif->faddr.addr == inflight->faddr.addr &&
+		    pif->faddr.as == inflight->faddr.as &&
+		    pif->chain == inflight->chain)
+			return true;
+	return false;
+}
+
+DEFINE_ALIAS(op);
+
+addrxlat_status
+addrxlat_op(const addrxlat_op_ctl_t *ctl, const addrxlat_fulladdr_t *paddr)
+{
+	struct inflight inflight;
+	const struct xlat_chain *chain;
+	addrxlat_status status;
+
+	clear_error(ctl->ctx);
+
+	if (ctl->caps & ADDRXLAT_CAPS(paddr->as))
+		return ctl->op(ctl->data, paddr);
+
+	status = select_chain(ctl, paddr->as, &chain);
+	if (status != ADDRXLAT_OK)
+		return status;
+
 	inflight.faddr = *paddr;
 	inflight.chain = chain;
-	for (pif = ctl->ctx->inflight; pif; pif = pif->next)
-		if (pif->faddr.addr == inflight.faddr.addr &&
-		    pif->faddr.as == inflight.faddr.as &&
-		    pif->chain == inflight.chain)
-			return set_error(ctl->ctx, ADDRXLAT_ERR_NOMETH,
-					 "Infinite recursion loop");
 	inflight.next = ctl->ctx->inflight;
+	if (is_inflight(&inflight))
+		return set_error(ctl->ctx, ADDRXLAT_ERR_NOMETH,
+				 "Infinite recursion loop");
 	ctl->ctx->inflight = &inflight;
 
 	status = do_op(ctl, paddr, chain);
@@ -610,6 +655,257 @@ addrxlat_op(const addrxlat_op_ctl_t *ctl, const addrxlat_fulladdr_t *paddr)
 	return status;
 }
 
+/** Maximum length of a translation chain. */
+#define XLAT_CHAIN_MAX	2
+
+/** State of a range translation.
+ * @sa addrxlat_op_range
+ */
+struct range_op {
+	/** Control structure. */
+	const addrxlat_op_ctl_t *ctl;
+
+	/** Translation chain. */
+	const struct xlat_chain *chain;
+
+	/** Page table walk cache for each chain element. */
+	struct walk_cache wc[XLAT_CHAIN_MAX];
+};
+
+/** Get the size of a translation method's linear part.
+ * @param sys    Translation system.
+ * @param step   Step state after a successful walk.
+ * @param shift  Log2 of the page size, or zero if unknown.
+ * @param addr   Source address.
+ * @returns      Number of bytes after @p addr which are translated
+ *               to addresses following the translation of @p addr.
+ */
+static addrxlat_addr_t
+meth_lenm1(const addrxlat_sys_t *sys, const addrxlat_step_t *step,
+	   unsigned short shift, addrxlat_addr_t addr)
+{
+	const addrxlat_meth_t *meth = step->meth;
+
+	switch (meth->kind) {
+	case ADDRXLAT_PGT:
+		break;
+
+	case ADDRXLAT_LOOKUP:
+		return meth->param.lookup.endoff - step->idx[0];
+
+	case ADDRXLAT_MEMARR:
+		shift = meth->param.memarr.shift;
+		break;
+
+	case ADDRXLAT_CUSTOM:
+		/* Assume the page size of the page table method. */
+		meth = &sys->meth[ADDRXLAT_SYS_METH_PGT];
+		shift = meth->kind == ADDRXLAT_PGT
+			? meth->param.pgt.pf.fieldsz[0]
+			: 0;
+		break;
+
+	default:
+		return 0;
+	}
+
+	if (shift >= 8 * sizeof(addrxlat_addr_t))
+		return ADDRXLAT_ADDR_MAX - addr;
+	return ADDR_MASK(shift) - (addr & ADDR_MASK(shift));
+}
+
+/** Translate an address and find the end of its linear part.
+ * @param rop     Range translation state.
+ * @param paddr   Address to be translated.
+ * @param target  Set to the translated address on success.
+ * @param plenm1  Set to the number of following bytes which are
+ *                translated contiguously after @p target.
+ * @returns       Error status.
+ *
+ * This function follows the same path as @ref do_op, but it also
+ * takes the map range and the page size of each translation step
+ * into account.
+ */
+static addrxlat_status
+range_xlat(struct range_op *rop, const addrxlat_fulladdr_t *paddr,
+	   addrxlat_fulladdr_t *target, addrxlat_addr_t *plenm1)
+{
+	const addrxlat_op_ctl_t *ctl = rop->ctl;
+	const struct xlat_chain *chain = rop->chain;
+	addrxlat_addr_t lenm1, partm1, extm1, rstart;
+	addrxlat_fulladdr_t lastbase;
+	addrxlat_step_t step;
+	unsigned short shift;
+	addrxlat_status status;
+	unsigned i, j;
+
+	step.ctx = ctl->ctx;
+	step.sys = ctl->sys;
+
+	lenm1 = ADDRXLAT_ADDR_MAX;
+	for (i = 0; i < chain->len; ++i) {
+		const struct xlat_alt *alt = &chain->alt[i];
+
+		for (j = 0; j < alt->num; ++j) {
+			addrxlat_sys_map_t mapidx = alt->map[j];
+			addrxlat_map_t *map;
+			addrxlat_sys_meth_t methidx;
+			addrxlat_meth_t *meth;
+			size_t ridx;
+
+			if (paddr->as != map_expect_as[mapidx])
+				continue;
+
+			map = ctl->sys->map[mapidx];
+			if (!map)
+				continue;
+
+			clear_error(ctl->ctx);
+			ridx = internal_map_find(map, paddr->addr, &rstart);
+			if (ridx >= map->n)
+				continue;
+			methidx = map->ranges[ridx].meth;
+			if (methidx == ADDRXLAT_SYS_METH_NONE)
+				continue;
+			partm1 = rstart + map->ranges[ridx].endoff -
+				paddr->addr;
+
+			meth = &ctl->sys->meth[methidx];
+			if (meth->kind == ADDRXLAT_LINEAR) {
+				lastbase.as = meth->target_as;
+				lastbase.addr =
+					paddr->addr + meth->param.linear.off;
+			} else {
+				step.meth = meth;
+				step.base.addr = paddr->addr;
+				status = tlb_walk_range(&step, paddr->as,
+							&rop->wc[i], &shift);
+				if (status == ADDRXLAT_ERR_NOMETH ||
+				    status == ADDRXLAT_ERR_NODATA)
+					continue;
+				if (status != ADDRXLAT_OK)
+					return status;
+				extm1 = meth_lenm1(ctl->sys, &step, shift,
+						   paddr->addr);
+				if (extm1 < partm1)
+					partm1 = extm1;
+				lastbase = step.base;
+			}
+
+			if (partm1 < lenm1)
+				lenm1 = partm1;
+			if (ctl->caps & ADDRXLAT_CAPS(lastbase.as)) {
+				*target = lastbase;
+				*plenm1 = lenm1;
+				return ADDRXLAT_OK;
+			}
+			paddr = &lastbase;
+			break;
+		}
+	}
+
+	return set_error(ctl->ctx, ADDRXLAT_ERR_NOMETH, "No way to translate");
+}
+
+/** Translate all addresses of a range.
+ * @param rop       Range translation state.
+ * @param fn        Extent callback.
+ * @param inflight  In-flight translation entry (linked to the context).
+ * @param remain    Size of the range in bytes.
+ * @returns         Error status.
+ *
+ * The start address is taken from @c inflight->faddr, and it is
+ * updated as the translation proceeds.
+ */
+static addrxlat_status
+range_op(struct range_op *rop, addrxlat_op_range_fn *fn,
+	 struct inflight *inflight, addrxlat_addr_t remain)
+{
+	addrxlat_fulladdr_t *pos = &inflight->faddr;
+	addrxlat_fulladdr_t target, ext;
+	addrxlat_addr_t lenm1, extlen;
+	addrxlat_status status;
+
+	extlen = 0;
+	for (;;) {
+		if (is_inflight(inflight))
+			status = set_error(rop->ctl->ctx, ADDRXLAT_ERR_NOMETH,
+					   "Infinite recursion loop");
+		else
+			status = range_xlat(rop, pos, &target, &lenm1);
+		if (status != ADDRXLAT_OK)
+			break;
+
+		if (lenm1 > remain - 1)
+			lenm1 = remain - 1;
+		if (extlen && target.as == ext.as &&
+		    target.addr == ext.addr + extlen)
+			extlen += lenm1 + 1;
+		else {
+			if (extlen) {
+				status = fn(rop->ctl->data, &ext, extlen);
+				if (status != ADDRXLAT_OK)
+					return status;
+			}
+			ext = target;
+			extlen = lenm1 + 1;
+		}
+
+		if (lenm1 == remain - 1)
+			return fn(rop->ctl->data, &ext, extlen);
+		pos->addr += lenm1 + 1;
+		remain -= lenm1 + 1;
+	}
+
+	/* Pass the successfully translated part to the callback before
+	 * reporting the error. The callback may change the error message,
+	 * so translate the failing address again if necessary.
+	 */
+	if (extlen) {
+		status = fn(rop->ctl->data, &ext, extlen);
+		if (status == ADDRXLAT_OK)
+			status = range_xlat(rop, pos, &target, &lenm1);
+	}
+	return status;
+}
+
+DEFINE_ALIAS(op_range);
+
+addrxlat_status
+addrxlat_op_range(const addrxlat_op_ctl_t *ctl, addrxlat_op_range_fn *fn,
+		  const addrxlat_fulladdr_t *paddr, addrxlat_addr_t size)
+{
+	struct inflight inflight;
+	struct range_op rop;
+	addrxlat_status status;
+	unsigned i;
+
+	clear_error(ctl->ctx);
+
+	if (!size)
+		return ADDRXLAT_OK;
+
+	if (ctl->caps & ADDRXLAT_CAPS(paddr->as))
+		return fn(ctl->data, paddr, size);
+
+	rop.ctl = ctl;
+	status = select_chain(ctl, paddr->as, &rop.chain);
+	if (status != ADDRXLAT_OK)
+		return status;
+	for (i = 0; i < XLAT_CHAIN_MAX; ++i)
+		rop.wc[i].meth = NULL;
+
+	inflight.faddr = *paddr;
+	inflight.chain = rop.chain;
+	inflight.next = ctl->ctx->inflight;
+	ctl->ctx->inflight = &inflight;
+
+	status = range_op(&rop, fn, &inflight, size);
+
+	ctl->ctx->inflight = inflight.next;
+	return status;
+}
+
 static addrxlat_status
 storeaddr(void *data, const addrxlat_fulladdr_t *paddr)
 {
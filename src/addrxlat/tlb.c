@@ -0,0 +1,291 @@
+/** @internal @file src/addrxlat/tlb.c
+ * @brief Translation lookaside buffer.
+ */
+/* Copyright (C) Petr Tesarik <petr@tesarici.cz>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "addrxlat-priv.h"
+
+/** Global TLB generation.
+ *
+ * This counter is incremented whenever a translation map or system
+ * is modified, which invalidates all TLB entries in all contexts.
+ * The effective generation of a TLB is the sum of this value and the
+ * local generation. Both counters only grow, so the sum changes with
+ * every modification and can never return to an old value.
+ */
+static unsigned long global_gen;
+
+/** Invalidate all TLB entries in all contexts.
+ */
+void
+tlb_invalidate_all(void)
+{
+	__atomic_add_fetch(&global_gen, 1, __ATOMIC_RELAXED);
+}
+
+/** Get the current effective generation of a TLB.
+ * @param tlb  Translation lookaside buffer.
+ * @returns    Generation of valid entries.
+ */
+static inline unsigned long
+tlb_gen(const struct tlb *tlb)
+{
+	return tlb->gen + __atomic_load_n(&global_gen, __ATOMIC_RELAXED);
+}
+
+/** Check whether a TLB entry translates a given address.
+ * @param entry  TLB entry.
+ * @param gen    Current TLB generation.
+ * @param step   Step state with the method and translation system.
+ * @param as     Source address space.
+ * @param addr   Source address.
+ * @returns      @c true if @p entry can be used for @p addr.
+ */
+static inline bool
+tlb_match(const struct tlb_entry *entry, unsigned long gen,
+	  const addrxlat_step_t *step, addrxlat_addrspace_t as,
+	  addrxlat_addr_t addr)
+{
+	return entry->gen == gen &&
+		entry->meth == step->meth &&
+		entry->sys == step->sys &&
+		entry->as == as &&
+		((addr ^ entry->addr) >> entry->shift) == 0;
+}
+
+/** Get the total size of the lowest address fields.
+ * @param pf     Paging form.
+ * @param level  Number of fields.
+ * @returns      Number of address bits in the lowest @p level fields.
+ */
+static inline unsigned short
+fields_shift(const addrxlat_paging_form_t *pf, unsigned short level)
+{
+	unsigned short shift = 0, i;
+
+	for (i = 0; i < level; ++i)
+		shift += pf->fieldsz[i];
+	return shift;
+}
+
+/** Launch a page table walk, reusing cached upper-level tables.
+ * @param step  Step state with the context, system and method set.
+ * @param addr  Address to be translated.
+ * @param wc    Walk cache (may be @c NULL).
+ * @returns     Error status.
+ *
+ * If @p wc holds the state of a walk which went through the same
+ * page table at some level, the walk continues from that table
+ * instead of starting at the root. Only the table indices below
+ * that level are recalculated for @p addr.
+ *
+ * The root table is never reused from the cache. Launching a walk at
+ * the root does not read any page tables, and it checks that @p addr
+ * is valid (e.g. canonical), which cannot be inferred from the cached
+ * address, because the two may differ in the highest translated bit.
+ */
+static addrxlat_status
+launch_cached(addrxlat_step_t *step, addrxlat_addr_t addr,
+	      struct walk_cache *wc)
+{
+	const addrxlat_paging_form_t *pf = &step->meth->param.pgt.pf;
+	unsigned short level, shift, i;
+
+	if (!wc || wc->meth != step->meth || wc->sys != step->sys) {
+		if (wc) {
+			wc->meth = step->meth;
+			wc->sys = step->sys;
+			wc->valid = 0;
+		}
+		return internal_launch(step, addr);
+	}
+
+	for (level = 2; level < pf->nfields; ++level) {
+		if (!(wc->valid & (1U << level)))
+			continue;
+		shift = fields_shift(pf, level);
+		if (shift < 8 * sizeof(addrxlat_addr_t) &&
+		    (addr >> shift) != (wc->addr >> shift))
+			continue;
+
+		*step = wc->state[level];
+		for (i = 0, shift = 0; i < level; ++i) {
+			step->idx[i] = (addr >> shift) &
+				ADDR_MASK(pf->fieldsz[i]);
+			shift += pf->fieldsz[i];
+		}
+		wc->valid &= ~ADDR_MASK(level);
+		return ADDRXLAT_OK;
+	}
+
+	wc->valid = 0;
+	return internal_launch(step, addr);
+}
+
+/** Page table walk with result caching.
+ * @param step    Step state with the context, system and method set,
+ *                and the source address in @c base.addr.
+ * @param as      Source address space.
+ * @param wc      Walk cache for neighbouring addresses (may be @c NULL).
+ * @param pshift  Set to the log2 of the translated page size, or zero
+ *                if the page size is not known.
+ * @returns       Error status.
+ *
+ * This function is equivalent to @ref internal_walk, but the result of
+ * a page table walk is looked up in (and stored to) the translation
+ * lookaside buffer of the context. Only @ref ADDRXLAT_PGT methods
+ * are cached; other methods are cheap enough without caching.
+ *
+ * If a walk cache is given, page table states at each level are saved
+ * there, so that a subsequent walk for a nearby address can skip the
+ * upper-level tables.
+ *
+ * On a TLB hit, only @c step->base is valid on return.
+ */
+addrxlat_status
+tlb_walk_range(addrxlat_step_t *step, addrxlat_addrspace_t as,
+	       struct walk_cache *wc, unsigned short *pshift)
+{
+	struct tlb *tlb = &step->ctx->tlb;
+	const addrxlat_paging_form_t *pf;
+	addrxlat_addr_t addr, mask;
+	struct tlb_entry *entry;
+	addrxlat_fulladdr_t base;
+	unsigned short shift, level, i;
+	unsigned long gen;
+	addrxlat_status status;
+
+	*pshift = 0;
+	if (step->meth->kind != ADDRXLAT_PGT)
+		return internal_walk(step);
+
+	addr = step->base.addr;
+	gen = tlb_gen(tlb);
+	pf = &step->meth->param.pgt.pf;
+	if (!tlb->disabled) {
+		entry = &tlb->slot[(addr >> pf->fieldsz[0]) % TLB_SLOTS];
+		if (tlb_match(entry, gen, step, as, addr))
+			goto hit;
+		for (i = 0; i < TLB_HUGE_SLOTS; ++i) {
+			entry = &tlb->huge[i];
+			if (tlb_match(entry, gen, step, as, addr))
+				goto hit;
+		}
+		++tlb->misses;
+	} else if (!wc)
+		return internal_walk(step);
+
+	/* Walk the page tables, remembering the level of the last
+	 * table which was read, so the page size can be determined.
+	 */
+	status = launch_cached(step, addr, wc);
+	level = 0;
+	while (status == ADDRXLAT_OK && step->remain > 1) {
+		level = step->remain;
+		if (wc && level <= ADDRXLAT_FIELDS_MAX) {
+			wc->state[level] = *step;
+			wc->valid |= 1U << level;
+		}
+		status = internal_step(step);
+	}
+	if (wc)
+		wc->addr = addr;
+	if (status != ADDRXLAT_OK || !step->remain)
+		return status;
+
+	base = step->base;
+	status = internal_step(step);
+	if (status != ADDRXLAT_OK || level < 2)
+		return status;
+
+	/* The page offset spans all fields below the last table. */
+	shift = fields_shift(pf, level - 1);
+	if (shift >= 8 * sizeof(addrxlat_addr_t))
+		return status;
+	mask = ADDR_MASK(shift);
+	if (step->base.addr != base.addr + (addr & mask))
+		return status;
+	*pshift = shift;
+
+	if (tlb->disabled)
+		return status;
+
+	if (level == 2)
+		entry = &tlb->slot[(addr >> shift) % TLB_SLOTS];
+	else {
+		entry = &tlb->huge[tlb->huge_next];
+		tlb->huge_next = (tlb->huge_next + 1) % TLB_HUGE_SLOTS;
+	}
+	entry->gen = gen;
+	entry->sys = step->sys;
+	entry->meth = step->meth;
+	entry->as = as;
+	entry->shift = shift;
+	entry->addr = addr & ~mask;
+	entry->base.as = step->base.as;
+	entry->base.addr = base.addr;
+	return status;
+
+ hit:
+	++tlb->hits;
+	step->base.as = entry->base.as;
+	step->base.addr = entry->base.addr +
+		(addr & ADDR_MASK(entry->shift));
+	*pshift = entry->shift;
+	return ADDRXLAT_OK;
+}
+
+/** Page table walk with result caching.
+ * @param step  Step state with the context, system and method set, and
+ *              the source address in @c base.addr.
+ * @param as    Source address space.
+ * @returns     Error status.
+ *
+ * This is a shorthand for @ref tlb_walk_range without a walk cache.
+ */
+addrxlat_status
+tlb_walk(addrxlat_step_t *step, addrxlat_addrspace_t as)
+{
+	unsigned short shift;
+
+	return tlb_walk_range(step, as, NULL, &shift);
+}
+
+void
+addrxlat_ctx_flush_tlb(addrxlat_ctx_t *ctx)
+{
+	++ctx->tlb.gen;
+}
+
+void
+addrxlat_ctx_get_tlb_stats(const addrxlat_ctx_t *ctx,
+			   addrxlat_tlb_stats_t *stats)
+{
+	stats->hits = ctx->tlb.hits;
+	stats->misses = ctx->tlb.misses;
+}
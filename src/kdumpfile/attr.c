@@ -160,71 +160,115 @@ keycmp(const struct attr_data *attr, const struct attr_data *dir,
 	return attr->template == dir->template ? 0 : 1;
 }
 
-/**  Update a partial hash with an attribute directory path.
- * @param ph   Partial hash state.
- * @param dir  (Leaf) attribute directory attribute.
+/**  Initialize the path hashes of an attribute.
+ * @param attr  Attribute data with @c parent and @c template set.
  *
- * Note that this function's intended use is a lookup under the
- * directory, and the hash includes a terminating dot ("."). This
- * may not be particularly useful for other purposes, but is good
- * enough for the intended one and simplifies the implementation.
+ * The hash of a child path can then be calculated without walking
+ * the directory hierarchy up to the root.
+ *
+ * Note that the partial hash of a directory includes a terminating
+ * dot ("."), because its intended use is a lookup under the directory.
  */
 static void
-path_hash(struct phash *ph, const struct attr_data *dir)
-{
-	const struct attr_template *tmpl;
-	if (dir->parent) {
-		path_hash(ph, dir->parent);
-		tmpl = dir->template;
-		phash_update(ph, tmpl->key, strlen(tmpl->key));
-		phash_update(ph, ".", 1);
+init_attr_hash(struct attr_data *attr)
+{
+	const struct attr_template *tmpl = attr->template;
+
+	if (attr->parent) {
+		attr->dirhash = attr->parent->dirhash;
+		phash_update(&attr->dirhash, tmpl->key, strlen(tmpl->key));
+		attr->hash = phash_value(&attr->dirhash);
+		phash_update(&attr->dirhash, ".", 1);
+	} else {
+		phash_init(&attr->dirhash);
+		attr->hash = phash_value(&attr->dirhash);
 	}
 }
 
-/**  Calculate the hash index of an attribute.
- * @param attr  Attribute.
- * @returns     Desired index in the hash table.
+/**  Calculate the path hash of a key under a directory.
+ * @param dir     Directory attribute.
+ * @param key     Key name relative to @p dir.
+ * @param keylen  Initial portion of @c key to be considered.
+ * @returns       Hash of the full path.
  */
-static unsigned
-attr_hash_index(const struct attr_data *attr)
+static inline unsigned long
+key_hash(const struct attr_data *dir, const char *key, size_t keylen)
 {
-	const struct attr_template *tmpl;
-	struct phash ph;
+	struct phash ph = dir->dirhash;
 
-	phash_init(&ph);
-	if (attr->parent)
-		path_hash(&ph, attr->parent);
-	tmpl = attr->template;
-	phash_update(&ph, tmpl->key, strlen(tmpl->key));
-	return fold_hash(phash_value(&ph), ATTR_HASH_BITS);
+	phash_update(&ph, key, keylen);
+	return phash_value(&ph);
 }
 
-/**  Look up a child attribute of a given directory (no fallback).
+/**  Look up a child attribute in a dictionary hash table.
  * @param dict    Attribute dictionary.
  * @param dir     Directory attribute.
  * @param key     Key name relative to @p dir.
  * @param keylen  Initial portion of @c key to be considered.
+ * @param hash    Path hash, as returned by @ref key_hash.
  * @returns       Stored attribute or @c NULL if not found.
  */
 static struct attr_data *
-lookup_dir_attr_no_fallback(struct attr_dict *dict,
-			    const struct attr_data *dir,
-			    const char *key, size_t keylen)
+lookup_hash_attr(struct attr_dict *dict, const struct attr_data *dir,
+		 const char *key, size_t keylen, unsigned long hash)
 {
 	struct attr_data *d;
-	struct phash ph;
-	unsigned hash;
 
-	phash_init(&ph);
-	path_hash(&ph, dir);
-	phash_update(&ph, key, keylen);
-	hash = fold_hash(phash_value(&ph), ATTR_HASH_BITS);
-	hlist_for_each_entry(d, &dict->attr.table[hash], list)
-		if (!keycmp(d, dir, key, keylen))
+	hlist_for_each_entry(d, &dict->attr.table[
+				     fold_hash(hash, ATTR_HASH_BITS)], list)
+		if (d->hash == hash && !keycmp(d, dir, key, keylen))
 			return d;
 	return NULL;
 }
 
+/* Linear probing in the global key index needs at least one free slot. */
+_Static_assert(NR_GLOBAL_ATTRS < ATTR_GINDEX_SIZE,
+	       "Global key index is too small");
+
+/**  Look up a global attribute.
+ * @param dict    Attribute dictionary.
+ * @param dir     Directory attribute.
+ * @param key     Key name relative to @p dir.
+ * @param keylen  Initial portion of @c key to be considered.
+ * @param hash    Path hash, as returned by @ref key_hash.
+ * @returns       Global attribute or @c NULL if not found.
+ *
+ * The global attributes of a cloned dictionary resolve to the same
+ * data as a search through the fallback dictionaries, so only one
+ * search is needed.
+ */
+static struct attr_data *
+lookup_global_attr(struct attr_dict *dict, const struct attr_data *dir,
+		   const char *key, size_t keylen, unsigned long hash)
+{
+	unsigned slot = fold_hash(hash, ATTR_GINDEX_BITS);
+	unsigned idx;
+
+	while ( (idx = dict->gindex[slot]) ) {
+		struct attr_data *d = dict->global_attrs[idx - 1];
+		if (d->hash == hash && !keycmp(d, dir, key, keylen))
+			return d;
+		slot = (slot + 1) % ATTR_GINDEX_SIZE;
+	}
+	return NULL;
+}
+
+/**  Look up a child attribute of a given directory (no fallback).
+ * @param dict    Attribute dictionary.
+ * @param dir     Directory attribute.
+ * @param key     Key name relative to @p dir.
+ * @param keylen  Initial portion of @c key to be considered.
+ * @returns       Stored attribute or @c NULL if not found.
+ */
+static struct attr_data *
+lookup_dir_attr_no_fallback(struct attr_dict *dict,
+			    const struct attr_data *dir,
+			    const char *key, size_t keylen)
+{
+	return lookup_hash_attr(dict, dir, key, keylen,
+				key_hash(dir, key, keylen));
+}
+
 /**  Look up a child attribute of a given directory.
  * @param dict    Attribute dictionary.
  * @param dir     Directory attribute.
@@ -240,21 +284,21 @@ lookup_dir_attr(struct attr_dict *dict,
 		const struct attr_data *dir,
 		const char *key, size_t keylen)
 {
-	struct phash ph;
-	unsigned hash;
+	struct attr_data *d;
+	unsigned long hash;
 
 	if (*key == '.')
 		return lookup_dir_attr_no_fallback(dict, dir, ++key, --keylen);
 
-	phash_init(&ph);
-	path_hash(&ph, dir);
-	phash_update(&ph, key, keylen);
-	hash = fold_hash(phash_value(&ph), ATTR_HASH_BITS);
+	hash = key_hash(dir, key, keylen);
+	d = lookup_global_attr(dict, dir, key, keylen, hash);
+	if (d)
+		return d;
+
 	do {
-		struct attr_data *d;
-		hlist_for_each_entry(d, &dict->attr.table[hash], list)
-			if (!keycmp(d, dir, key, keylen))
-				return d;
+		d = lookup_hash_attr(dict, dir, key, keylen, hash);
+		if (d)
+			return d;
 		dict = dict->fallback;
 	} while (dict);
 
@@ -335,7 +379,8 @@ alloc_attr(struct attr_dict *dict, struct attr_data *parent,
 
 	d->parent = parent;
 	d->template = tmpl;
-	hash = attr_hash_index(d);
+	init_attr_hash(d);
+	hash = fold_hash(d->hash, ATTR_HASH_BITS);
 	hlist_add_head(&d->list, &dict->attr.table[hash]);
 
 	return d;
@@ -827,6 +872,14 @@ attr_dict_new(struct kdump_shared *shared)
 		}
 	}
 
+	for (i = 0; i < NR_GLOBAL_ATTRS; ++i) {
+		unsigned slot = fold_hash(dict->global_attrs[i]->hash,
+					  ATTR_GINDEX_BITS);
+		while (dict->gindex[slot])
+			slot = (slot + 1) % ATTR_GINDEX_SIZE;
+		dict->gindex[slot] = i + 1;
+	}
+
 	dict->shared = shared;
 	shared_incref_locked(dict->shared);
 
@@ -853,6 +906,7 @@ attr_dict_clone(struct attr_dict *orig)
 
 	memcpy(dict->global_attrs, orig->global_attrs,
 	       sizeof(orig->global_attrs));
+	memcpy(dict->gindex, orig->gindex, sizeof(orig->gindex));
 
 	rootdir = new_attr(dict, NULL, &global_keys[GKI_dir_root]);
 	if (!rootdir) {
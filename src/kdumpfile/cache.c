@@ -34,6 +34,11 @@
 
 #include <stdlib.h>
 #include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
+
+/**  Empty slot in the cache hash index. */
+#define HASH_EMPTY	(~0U)
 
 /**  Simple cache.
  *
@@ -47,45 +52,40 @@
  * Cached entries have a non-NULL data pointer. Ghost entries do not have
  * any data, so their data pointer is NULL.
  *
- * The cache is implemented as a circular list. This allows to move around
- * entries without copying much data even if the cache is large.
- * The list is organized as follows:
- *
- *               <-- ngprobe --> <- nprobe -> <- nprec -> <--- ngprec --->
- *     +--------+---------------+------------+-----------+----------------+
- *     | unused | ghost probed  |   probed   | precious  | ghost precious |
- *     +--------+---------------+------------+-----------+----------------+
- *             ^               ^            ^             ^                ^
- *             eprobe          gprobe     split       gprec            eprec
- *
- *
- * Only the @ref split index and the four sizes are stored in the data
- * structure. The remaining pointers are found as a side effect of searching
- * the cache, and they are stored in @ref cache_search.
- *
- * Any partition may be empty; some pointers will share the same value in
- * that case.
+ * Each partition is a circular list with a sentinel entry. The sentinels
+ * are stored after the regular entries in @ref ce, so all links can be
+ * stored as indices. This allows to move around entries without copying
+ * much data even if the cache is large. In all partitions, the most
+ * recently used entry is at the head of the list (right after the
+ * sentinel), and the least recently used entry is at the tail.
  *
- * Note that since the list is circular, the unused partition is between
- * the ghost probed and ghost precious partitions. This part of the cache is
- * usually empty after it has been used for some time.
+ * The unused partition is an exception. It contains entries which have
+ * a data buffer at the head, and entries without data at the tail.
  *
  * Entries that have been allocated for I/O but not yet committed back,
- * are removed from the main list and added to an in-flight list.
- * They are returned back to the list later when the user calls
+ * are removed from their partition and added to an in-flight list.
+ * They are returned back to a partition later when the user calls
  * @ref cache_insert or @ref cache_discard on the in-flight entry.
+ *
+ * All entries which have a valid key (i.e. cached, ghost and in-flight
+ * entries) are also stored in a hash index, so any key can be found
+ * in constant time regardless of cache size. The index uses open
+ * addressing with linear probing. Its size is at least twice the total
+ * number of entries, so the load factor never exceeds 50%.
+ *
+ * If waiting is enabled with @ref cache_set_wait, callers of
+ * @ref cache_get_entry_wait can sleep until an entry is released or
+ * until another thread finishes loading the requested key.
  */
 struct cache {
-	unsigned split;		 /**< Split point between probed and precious
-				  *   entries (index of MRU probed entry) */
-	unsigned nprec;		 /**< Number of cached precious entries */
-	unsigned ngprec;	 /**< Number of ghost precious entries */
-	unsigned nprobe;	 /**< Number of cached probe entries */
-	unsigned ngprobe;	 /**< Number of ghost probe entries */
+	/** Number of entries in each partition. */
+	unsigned nent[NR_CACHE_PARTS];
+
 	unsigned dprobe;	 /**< Desired number of cached probe entries */
 	unsigned cap;		 /**< Total cache capacity */
-	unsigned inflight;	 /**< Index of first in-flight entry */
-	unsigned ninflight;	 /**< Number of in-flight entries */
+
+	unsigned hbits;		 /**< Hash index size (log2) */
+	unsigned *hash;		 /**< Hash index (entry indices) */
 
 	kdump_attr_value_t hits;   /**< Cache hits */
 	kdump_attr_value_t misses; /**< Cache misses */
@@ -97,30 +97,70 @@ struct cache {
 	cache_entry_cleanup_fn *entry_cleanup;
 	void *cleanup_data;	 /**< User-supplied data for the destructor. */
 
+	struct cache_waitq *waitq; /**< Wait queue, or @c NULL. */
+
 	struct cache_entry ce[]; /**< Cache entries */
 };
 
-/**  Temporary information needed during a cache search.
+/**  Cache wait queue.
+ *
+ * The queue has its own lock, because entries may be released by
+ * threads which do not hold the lock that protects the cache itself.
+ * Waiters sample the generation counter before they look into the
+ * cache, and sleep until it changes, so no wakeup can be missed.
+ *
+ * The lock is taken only if waiting is enabled or somebody waits.
+ * A waiter is counted in @c waiters before it looks into the cache,
+ * and a thread which releases an entry changes the entry before it
+ * reads @c waiters, so either the waiter sees the change, or the
+ * releasing thread sees the waiter.
+ */
+struct cache_waitq {
+	mutex_t lock;		/**< Protects @c gen and the condition. */
+	cond_t cond;		/**< Signalled when @c gen changes. */
+	unsigned long gen;	/**< Incremented on every state change. */
+	unsigned long timeout;	/**< Maximum wait in ms, zero for infinite. */
+	int enabled;		/**< Non-zero if waiting is enabled. */
+	unsigned long waiters;	/**< Number of waiting threads. */
+};
+
+/**  Eviction candidates.
  * This is grouped in a structure to avoid passing an inordinate number
  * of parameters among the various helper functions.
+ *
+ * Eviction candidates are only searched when the cache has no free data
+ * buffer. If there is no candidate in a partition, the corresponding
+ * field contains the index of the partition's sentinel.
  */
 struct cache_search {
-	unsigned gprec;		/**< Index of MRU precious ghost entry */
-	unsigned eprec;		/**< End of precious entries; this is the
-				 *   index of the first unused entry. */
 	unsigned zprec;		/**< Index of the least recently used precious
 				 *   entry with zero reference count. */
-	unsigned nzprec;	/**< Number of precious entries with zero
-				 *   reference count. */
-	unsigned gprobe;	/**< Index of MRU probed ghost entry */
-	unsigned eprobe;	/**< End of probed entries; this is the
-				 *   index of the last unused entry. */
 	unsigned zprobe;	/**< Index of the least recently used probed
 				 *   entry with zero reference count. */
-	unsigned nzprobe;	/**< Number of probed entries with zero
-				 *   reference count. */
 };
 
+/**  Get the index of a partition's sentinel entry.
+ * @param cache  Cache object.
+ * @param part   Cache partition.
+ * @returns      Index of the sentinel entry in @c cache->ce.
+ */
+static inline unsigned
+part_head(const struct cache *cache, enum cache_part part)
+{
+	return 2 * cache->cap + part;
+}
+
+/**  Get the number of entries which hold a data buffer in use.
+ * @param cache  Cache object.
+ * @returns      Number of cached and in-flight entries.
+ */
+static inline unsigned
+cache_nused(const struct cache *cache)
+{
+	return cache->nent[cp_probe] + cache->nent[cp_prec] +
+		cache->nent[cp_inflight];
+}
+
 /**  Insert an entry to the list after a given position.
  * @param cache   Cache object.
  * @param entry   Cache entry to be added.
@@ -177,6 +217,121 @@ remove_entry(struct cache *cache, struct cache_entry *entry)
 	prev->next = entry->next;
 }
 
+/**  Move an entry to the head of a partition.
+ * @param cache  Cache object.
+ * @param entry  Cache entry to be moved.
+ * @param idx    Index of @p entry.
+ * @param part   Target partition.
+ */
+static void
+move_to_head(struct cache *cache, struct cache_entry *entry, unsigned idx,
+	     enum cache_part part)
+{
+	remove_entry(cache, entry);
+	--cache->nent[entry->part];
+	add_entry_after(cache, entry, idx, part_head(cache, part));
+	++cache->nent[part];
+	entry->part = part;
+}
+
+/**  Move an entry to the tail of a partition.
+ * @param cache  Cache object.
+ * @param entry  Cache entry to be moved.
+ * @param idx    Index of @p entry.
+ * @param part   Target partition.
+ */
+static void
+move_to_tail(struct cache *cache, struct cache_entry *entry, unsigned idx,
+	     enum cache_part part)
+{
+	remove_entry(cache, entry);
+	--cache->nent[entry->part];
+	add_entry_before(cache, entry, idx, part_head(cache, part));
+	++cache->nent[part];
+	entry->part = part;
+}
+
+/**  Get the home slot of a key in the hash index.
+ * @param cache  Cache object.
+ * @param key    Cache entry key.
+ * @returns      Preferred slot in the hash index.
+ */
+static inline unsigned
+key_hash(const struct cache *cache, cache_key_t key)
+{
+#if SIZEOF_LONG == 8
+	return fold_hash(key, cache->hbits);
+#else
+	return fold_hash(key ^ (key >> 32), cache->hbits);
+#endif
+}
+
+/**  Look up a key in the hash index.
+ * @param cache  Cache object.
+ * @param key    Key to be searched.
+ * @returns      Index of the entry, or @ref HASH_EMPTY if not found.
+ */
+static unsigned
+hash_find(const struct cache *cache, cache_key_t key)
+{
+	unsigned mask = (1U << cache->hbits) - 1;
+	unsigned slot = key_hash(cache, key);
+	unsigned idx;
+
+	while ((idx = cache->hash[slot]) != HASH_EMPTY) {
+		if (cache->ce[idx].key == key)
+			return idx;
+		slot = (slot + 1) & mask;
+	}
+	return HASH_EMPTY;
+}
+
+/**  Add an entry to the hash index.
+ * @param cache  Cache object.
+ * @param idx    Index of the entry (with a valid key).
+ */
+static void
+hash_add(struct cache *cache, unsigned idx)
+{
+	unsigned mask = (1U << cache->hbits) - 1;
+	unsigned slot = key_hash(cache, cache->ce[idx].key);
+
+	while (cache->hash[slot] != HASH_EMPTY)
+		slot = (slot + 1) & mask;
+	cache->hash[slot] = idx;
+}
+
+/**  Remove an entry from the hash index.
+ * @param cache  Cache object.
+ * @param idx    Index of the entry.
+ *
+ * Entries that follow the removed entry in the same cluster are shifted
+ * back to fill the hole, so there is no need for tombstones.
+ */
+static void
+hash_del(struct cache *cache, unsigned idx)
+{
+	unsigned mask = (1U << cache->hbits) - 1;
+	unsigned slot = key_hash(cache, cache->ce[idx].key);
+	unsigned next, home;
+
+	while (cache->hash[slot] != idx)
+		slot = (slot + 1) & mask;
+
+	next = slot;
+	for (;;) {
+		next = (next + 1) & mask;
+		if (cache->hash[next] == HASH_EMPTY)
+			break;
+		home = key_hash(cache, cache->ce[cache->hash[next]].key);
+		if (((next - home) & mask) >= ((next - slot) & mask)) {
+			cache->hash[slot] = cache->hash[next];
+			slot = next;
+		}
+	}
+	cache->hash[slot] = HASH_EMPTY;
+}
+
 /**  Add an entry to the in-flight list.
  *
  * @param cache  Cache object.
@@ -186,10 +341,7 @@ remove_entry(struct cache *cache, struct cache_entry *entry)
 static void
 add_inflight(struct cache *cache, struct cache_entry *entry, unsigned idx)
 {
-	if (cache->ninflight++)
-		add_entry_before(cache, entry, idx, cache->inflight);
-	else
-		cache->inflight = entry->next = entry->prev = idx;
+	move_to_tail(cache, entry, idx, cp_inflight);
 }
 
 /**  Reuse a cached entry.
@@ -205,17 +357,47 @@ static struct cache_entry *
 reuse_cached_entry(struct cache *cache, struct cache_entry *entry,
 		   unsigned idx)
 {
-	if (cache->split != idx && cache->split != entry->prev) {
-		remove_entry(cache, entry);
-		add_entry_after(cache, entry, idx, cache->split);
-	}
-
-	cache->split = entry->prev;
-
+	move_to_head(cache, entry, idx, cp_prec);
 	++cache->hits.number;
 	return entry;
 }
 
+/**  Find the least recently used entry with zero reference count.
+ * @param cache  Cache object.
+ * @param part   Cache partition.
+ * @returns      Index of the entry, or the index of the partition
+ *               sentinel if all entries in @p part are in use.
+ *
+ * The search starts at the LRU end of the partition, so it usually
+ * stops immediately. Only entries which are currently referenced must
+ * be skipped, and there are not many of them.
+ */
+static unsigned
+find_unused_lru(const struct cache *cache, enum cache_part part)
+{
+	unsigned head = part_head(cache, part);
+	unsigned idx = cache->ce[head].prev;
+
+	while (idx != head &&
+	       __atomic_load_n(&cache->ce[idx].refcnt, __ATOMIC_SEQ_CST))
+		idx = cache->ce[idx].prev;
+	return idx;
+}
+
+/**  Search eviction candidates.
+ * @param cache  Cache object.
+ * @param cs     Cache search info, updated on return.
+ * @returns      @c true if there is at least one candidate.
+ */
+static bool
+search_evictable(const struct cache *cache, struct cache_search *cs)
+{
+	cs->zprobe = find_unused_lru(cache, cp_probe);
+	cs->zprec = find_unused_lru(cache, cp_prec);
+	return cs->zprobe != part_head(cache, cp_probe) ||
+		cs->zprec != part_head(cache, cp_prec);
+}
+
 /**  Evict an entry from the probe partition.
  * @param cache  Cache object.
  * @param cs     Cache search info.
@@ -225,14 +407,7 @@ static struct cache_entry *
 evict_probe(struct cache *cache, struct cache_search *cs)
 {
 	struct cache_entry *entry = &cache->ce[cs->zprobe];
-	if (entry->prev != cs->gprobe) {
-		if (cs->zprobe == cache->split)
-			cache->split = entry->prev;
-		remove_entry(cache, entry);
-		add_entry_after(cache, entry, cs->zprobe, cs->gprobe);
-	}
-	--cache->nprobe;
-	++cache->ngprobe;
+	move_to_head(cache, entry, cs->zprobe, cp_gprobe);
 	return entry;
 }
 
@@ -245,12 +420,7 @@ static struct cache_entry *
 evict_prec(struct cache *cache, struct cache_search *cs)
 {
 	struct cache_entry *entry = &cache->ce[cs->zprec];
-	if (entry->next != cs->gprec) {
-		remove_entry(cache, entry);
-		add_entry_before(cache, entry, cs->zprec, cs->gprec);
-	}
-	--cache->nprec;
-	++cache->ngprec;
+	move_to_head(cache, entry, cs->zprec, cp_gprec);
 	return entry;
 }
 
@@ -270,8 +440,9 @@ evict_entry(struct cache *cache, struct cache_search *cs, unsigned bias)
 {
 	struct cache_entry *entry;
 
-	if (cs->nzprobe != 0 &&
-	    (cs->nzprec == 0 || cache->nprobe + bias > cache->dprobe))
+	if (cs->zprobe != part_head(cache, cp_probe) &&
+	    (cs->zprec == part_head(cache, cp_prec) ||
+	     cache->nent[cp_probe] + bias > cache->dprobe))
 		entry = evict_probe(cache, cs);
 	else
 		entry = evict_prec(cache, cs);
@@ -294,15 +465,14 @@ static void *
 reclaim_data(struct cache *cache, struct cache_search *cs)
 {
 	struct cache_entry *entry;
+	unsigned idx;
 	void *data;
 
-	if (cache->nprec + cache->nprobe + cache->ninflight < cache->cap) {
+	if (cache_nused(cache) < cache->cap) {
 		/* Get an entry from the unused partition. */
-		unsigned eprobe = cs->gprobe;
-		unsigned n = cache->ngprobe;
-		while (n--)
-			eprobe = cache->ce[eprobe].prev;
-		entry = &cache->ce[eprobe];
+		idx = cache->ce[part_head(cache, cp_unused)].next;
+		entry = &cache->ce[idx];
+		move_to_tail(cache, entry, idx, cp_unused);
 	} else {
 		entry = evict_entry(cache, cs, 0);
 	}
@@ -325,28 +495,24 @@ get_missed_entry(struct cache *cache, cache_key_t key,
 	struct cache_entry *entry;
 	unsigned idx;
 
-	idx = cs->eprobe;
-	entry = &cache->ce[idx];
-	if (entry->next == cs->eprec) {
-		if (cache->ngprobe) {
-			/* Full cache and non-empty ghost probe partition.
-			 * Use an entry from that partition instead.
-			 */
-			idx = entry->next;
-			entry = &cache->ce[idx];
-			--cache->ngprobe;
-		} else if (cache->ngprec) {
-			/* Full cache and empty ghost probe partition.
-			 * Entry is from the ghost precious partition,
-			 * so its size must be adjusted.
-			 */
-			--cache->ngprec;
-		}
-		/* Else empty cache. Entry is from the unused partition. */
+	if (cache->nent[cp_unused]) {
+		/* Prefer an unused entry. Entries with a data buffer
+		 * are at the head of the unused partition.
+		 */
+		idx = cache->ce[part_head(cache, cp_unused)].next;
+		entry = &cache->ce[idx];
+	} else {
+		/* Recycle the LRU ghost entry. Prefer the ghost probe
+		 * partition. Since there are twice as many entries as
+		 * data buffers, at least one of the ghost partitions
+		 * must be non-empty here.
+		 */
+		idx = cache->nent[cp_gprobe]
+			? cache->ce[part_head(cache, cp_gprobe)].prev
+			: cache->ce[part_head(cache, cp_gprec)].prev;
+		entry = &cache->ce[idx];
+		hash_del(cache, idx);
 	}
-	/* Else ghost probe and ghost precious partitions do not touch,
-	 * so entry must be from the unused partition in between.
-	 */
 
 	if (!entry->data) {
 		struct cache_entry *evict = evict_entry(cache, cs, 1);
@@ -354,13 +520,10 @@ get_missed_entry(struct cache *cache, cache_key_t key,
 		evict->data = NULL;
 	}
 
-	if (cache->split == idx)
-		cache->split = entry->prev;
-
-	remove_entry(cache, entry);
 	add_inflight(cache, entry, idx);
 	entry->key = key;
 	entry->state = cs_probe;
+	hash_add(cache, idx);
 
 	return entry;
 }
@@ -376,187 +539,310 @@ static struct cache_entry *
 reuse_ghost_entry(struct cache *cache, struct cache_entry *entry,
 		  unsigned idx)
 {
-	if (cache->split == idx)
-		cache->split = entry->prev;
-
-	remove_entry(cache, entry);
 	add_inflight(cache, entry, idx);
 	entry->state = cs_precious;
 	return entry;
 }
 
-/**  Get an entry for a given non-cached key.
+/**  Get an entry for a ghost key.
  *
  * @param cache  Cache object.
- * @param key    Key to be searched.
+ * @param entry  Ghost entry with the requested key.
+ * @param idx    Index of @p entry.
  * @param cs     Cache search info.
  * @returns      An in-flight entry.
+ *
+ * Adjust the desired size of the probe partition according to the
+ * ghost partition that was hit, and reclaim a data buffer for the entry.
  */
 static struct cache_entry *
-get_ghost_or_missed_entry(struct cache *cache, cache_key_t key,
-			  struct cache_search *cs)
+get_ghost_entry(struct cache *cache, struct cache_entry *entry,
+		unsigned idx, struct cache_search *cs)
 {
-	struct cache_entry *entry;
-	unsigned n, idx;
-
-	/* Search precious ghost entries */
-	n = cache->ngprec;
-	idx = cs->gprec;
-	while (n--) {
-		entry = &cache->ce[idx];
-		if (entry->key == key) {
-			int delta = cache->ngprobe > cache->ngprec
-				? cache->ngprobe / cache->ngprec
-				: 1;
-			if (cache->dprobe > delta)
-				cache->dprobe -= delta;
-			else
-				cache->dprobe = 0;
-			entry->data = reclaim_data(cache, cs);
-			--cache->ngprec;
-			return reuse_ghost_entry(cache, entry, idx);
-		}
-		idx = entry->next;
-	}
-	cs->eprec = idx;
-
-	/* Search probed ghost entries */
-	n = cache->ngprobe;
-	idx = cs->gprobe;
-	while (n--) {
-		entry = &cache->ce[idx];
-		if (entry->key == key) {
-			int delta = cache->ngprec > cache->ngprobe
-				? cache->ngprec / cache->ngprobe
-				: 1;
-			if (cache->dprobe + delta < cache->cap)
-				cache->dprobe += delta;
-			else
-				cache->dprobe = cache->cap;
-			entry->data = reclaim_data(cache, cs);
-			--cache->ngprobe;
-			return reuse_ghost_entry(cache, entry, idx);
-		}
-		idx = entry->prev;
+	unsigned ngprec = cache->nent[cp_gprec];
+	unsigned ngprobe = cache->nent[cp_gprobe];
+	int delta;
+
+	if (entry->part == cp_gprec) {
+		delta = ngprobe > ngprec
+			? ngprobe / ngprec
+			: 1;
+		if (cache->dprobe > delta)
+			cache->dprobe -= delta;
+		else
+			cache->dprobe = 0;
+	} else {
+		delta = ngprec > ngprobe
+			? ngprec / ngprobe
+			: 1;
+		if (cache->dprobe + delta < cache->cap)
+			cache->dprobe += delta;
+		else
+			cache->dprobe = cache->cap;
 	}
-	cs->eprobe = idx;
-
-	return get_missed_entry(cache, key, cs);
+	entry->data = reclaim_data(cache, cs);
+	return reuse_ghost_entry(cache, entry, idx);
 }
 
-/**  Get the in-flight entry for a given key.
+/**  Wake up all threads waiting for a cache entry.
  *
  * @param cache  Cache object.
- * @param key    Key to be searched.
- * @returns      In-flight entry, or @c NULL if there is none.
  */
-static struct cache_entry *
-get_inflight_entry(struct cache *cache, cache_key_t key)
+static void
+cache_wake(struct cache *cache)
 {
-	struct cache_entry *entry;
-	unsigned idx, n;
+	struct cache_waitq *wq = cache->waitq;
 
-	idx = cache->inflight;
-	for (n = cache->ninflight; n; --n) {
-		entry = &cache->ce[idx];
-		if (entry->key == key) {
-			entry->state = cs_precious;
-			return entry;
-		}
-		idx = entry->next;
-	}
+	if (!wq || !__atomic_load_n(&wq->waiters, __ATOMIC_SEQ_CST))
+		return;
 
-	return NULL;
+	mutex_lock(&wq->lock);
+	++wq->gen;
+	cond_broadcast(&wq->cond);
+	mutex_unlock(&wq->lock);
 }
 
-/**  Search the cache for an entry.
+/**  Get the cache entry for a given key.
  *
  * @param cache  Cache object.
  * @param key    Key to be searched.
  * @returns      Pointer to a cache entry, or @c NULL if cache is full.
+ *
+ * On a cache hit (corresponding entry is found in the cache), the returned
+ * entry denotes the cached data.
+ * On a cache miss, the returned entry can be used to load data into the
+ * cache and store it for later use with @ref cache_insert.
+ *
+ * The reference count of the returned entry is incremented.
  */
-static struct cache_entry *
-cache_get_entry_noref(struct cache *cache, cache_key_t key)
+struct cache_entry *
+cache_get_entry(struct cache *cache, cache_key_t key)
 {
 	struct cache_search cs;
 	struct cache_entry *entry;
-	unsigned n, idx;
+	unsigned idx;
 
-	cs.nzprec = 0;
-	cs.nzprobe = 0;
+	idx = hash_find(cache, key);
+	entry = idx != HASH_EMPTY ? &cache->ce[idx] : NULL;
+	if (entry) {
+		switch (entry->part) {
+		case cp_probe:
+		case cp_prec:
+			reuse_cached_entry(cache, entry, idx);
+			goto out;
 
-	/* Search precious entries */
-	n = cache->nprec;
-	idx = cache->ce[cache->split].next;
-	while (n--) {
-		entry = &cache->ce[idx];
-		if (entry->key == key)
-			return reuse_cached_entry(cache, entry, idx);
-		if (entry->refcnt == 0) {
-			cs.zprec = idx;
-			++cs.nzprec;
-		}
-		idx = entry->next;
-	}
-	cs.gprec = idx;
+		case cp_inflight:
+			entry->state = cs_precious;
+			++cache->misses.number;
+			goto out;
 
-	/* Search probed entries */
-	n = cache->nprobe;
-	idx = cache->split;
-	while (n--) {
-		entry = &cache->ce[idx];
-		if (entry->key == key) {
-			--cache->nprobe;
-			++cache->nprec;
-			return reuse_cached_entry(cache, entry, idx);
-		}
-		if (entry->refcnt == 0) {
-			cs.zprobe = idx;
-			++cs.nzprobe;
+		default:	/* Ghost entry. */
+			break;
 		}
-		idx = entry->prev;
 	}
-	cs.gprobe = idx;
 
-	entry = get_inflight_entry(cache, key);
+	if (cache_nused(cache) >= cache->cap &&
+	    !search_evictable(cache, &cs))
+		return NULL;
+
+	entry = entry
+		? get_ghost_entry(cache, entry, idx, &cs)
+		: get_missed_entry(cache, key, &cs);
+	++cache->misses.number;
+
+ out:
+	__atomic_add_fetch(&entry->refcnt, 1, __ATOMIC_SEQ_CST);
+	return entry;
+}
+
+/**  Set up waiting for cache entries.
+ *
+ * @param cache    Cache object.
+ * @param wait     Non-zero to enable waiting, zero to disable.
+ * @param timeout  Maximum time to wait in milliseconds (zero means
+ *                 wait indefinitely).
+ *
+ * Threads which are already waiting when waiting gets disabled are
+ * woken up and fall back to @ref cache_get_entry. Waiting is never
+ * enabled without thread support, because there would be nobody to
+ * release an entry.
+ */
+void
+cache_set_wait(struct cache *cache, int wait, unsigned long timeout)
+{
+	struct cache_waitq *wq = cache->waitq;
+
+	if (!wq)
+		return;
 
-	if (!entry) {
-		unsigned inuse = (cache->nprec - cs.nzprec) +
-			(cache->nprobe - cs.nzprobe) +
-			cache->ninflight;
-		if (inuse >= cache->cap)
-			return NULL;
+	mutex_lock(&wq->lock);
+	__atomic_store_n(&wq->timeout, timeout, __ATOMIC_RELAXED);
+	__atomic_store_n(&wq->enabled, wait, __ATOMIC_RELAXED);
+	++wq->gen;
+	cond_broadcast(&wq->cond);
+	mutex_unlock(&wq->lock);
+}
 
-		entry = get_ghost_or_missed_entry(cache, key, &cs);
+#if USE_PTHREAD
+/**  Allocate a cache wait queue.
+ *
+ * @returns  Newly allocated wait queue (with waiting disabled),
+ *           or @c NULL on failure.
+ */
+static struct cache_waitq *
+waitq_alloc(void)
+{
+	struct cache_waitq *wq;
+
+	wq = malloc(sizeof *wq);
+	if (!wq)
+		return NULL;
+	if (mutex_init(&wq->lock, NULL)) {
+		free(wq);
+		return NULL;
 	}
+	if (cond_init(&wq->cond, NULL)) {
+		mutex_destroy(&wq->lock);
+		free(wq);
+		return NULL;
+	}
+	wq->gen = 0;
+	wq->timeout = 0;
+	wq->enabled = 0;
+	wq->waiters = 0;
+	return wq;
+}
+#endif
 
-	++cache->misses.number;
+/**  Free a cache wait queue.
+ *
+ * @param wq  Wait queue, or @c NULL.
+ */
+static void
+waitq_free(struct cache_waitq *wq)
+{
+	if (wq) {
+		cond_destroy(&wq->cond);
+		mutex_destroy(&wq->lock);
+		free(wq);
+	}
+}
 
-	return entry;
+/**  Check whether a key is being loaded by another user.
+ *
+ * @param cache  Cache object.
+ * @param key    Key to be searched.
+ * @returns      Non-zero if there is an in-flight entry for @p key.
+ */
+static int
+key_inflight(const struct cache *cache, cache_key_t key)
+{
+	unsigned idx = hash_find(cache, key);
+	return idx != HASH_EMPTY && cache->ce[idx].part == cp_inflight;
 }
 
-/**  Get the cache entry for a given key.
+/**  Check whether a key is present in the cache.
  *
  * @param cache  Cache object.
  * @param key    Key to be searched.
- * @returns      Pointer to a cache entry, or @c NULL if cache is full.
+ * @returns      Non-zero if @p key is cached or being loaded.
  *
- * On a cache hit (corresponding entry is found in the cache), the returned
- * entry denotes the cached data.
- * On a cache miss, the returned entry can be used to load data into the
- * cache and store it for later use with @ref cache_insert.
+ * Unlike @ref cache_get_entry, this function does not change the
+ * cache state or statistics.
+ */
+int
+cache_has_key(const struct cache *cache, cache_key_t key)
+{
+	unsigned idx = hash_find(cache, key);
+	if (idx == HASH_EMPTY)
+		return 0;
+	switch (cache->ce[idx].part) {
+	case cp_probe:
+	case cp_prec:
+	case cp_inflight:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/**  Get the cache entry for a given key, waiting if necessary.
  *
- * The reference count of the returned entry is incremented.
+ * @param cache  Cache object.
+ * @param key    Key to be searched.
+ * @param lock   Lock held by the caller to protect @p cache, or @c NULL.
+ * @returns      Pointer to a cache entry, or @c NULL if the cache is
+ *               still full after the configured timeout.
+ *
+ * This function behaves like @ref cache_get_entry if waiting is not
+ * enabled for @p cache. Otherwise, it sleeps while the cache is full.
+ * Additionally, if another user is loading data for @p key, it waits
+ * until that entry is inserted or discarded instead of returning the
+ * in-flight entry, so the same data is never loaded twice.
+ *
+ * If @p lock is not @c NULL, it is released while sleeping and
+ * re-acquired before looking into the cache again.
  */
 struct cache_entry *
-cache_get_entry(struct cache *cache, cache_key_t key)
+cache_get_entry_wait(struct cache *cache, cache_key_t key, mutex_t *lock)
 {
+	struct cache_waitq *wq = cache->waitq;
 	struct cache_entry *entry;
+	struct timespec deadline;
+	unsigned long gen, timeout;
+	int err;
+
+	if (!wq || !__atomic_load_n(&wq->enabled, __ATOMIC_RELAXED))
+		return cache_get_entry(cache, key);
+
+	timeout = __atomic_load_n(&wq->timeout, __ATOMIC_RELAXED);
+
+	if (timeout) {
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += timeout / 1000;
+		deadline.tv_nsec += (timeout % 1000) * 1000000;
+		if (deadline.tv_nsec >= 1000000000) {
+			++deadline.tv_sec;
+			deadline.tv_nsec -= 1000000000;
+		}
+	}
 
-	entry = cache_get_entry_noref(cache, key);
-	if (entry)
-		++entry->refcnt;
+	__atomic_add_fetch(&wq->waiters, 1, __ATOMIC_SEQ_CST);
+	for (;;) {
+		mutex_lock(&wq->lock);
+		gen = wq->gen;
+		mutex_unlock(&wq->lock);
 
+		if (!__atomic_load_n(&wq->enabled, __ATOMIC_RELAXED)) {
+			entry = cache_get_entry(cache, key);
+			break;
+		}
+
+		if (!key_inflight(cache, key)) {
+			entry = cache_get_entry(cache, key);
+			if (entry)
+				break;
+		}
+
+		if (lock)
+			mutex_unlock(lock);
+		err = 0;
+		mutex_lock(&wq->lock);
+		while (wq->gen == gen && !err)
+			err = timeout
+				? cond_timedwait(&wq->cond, &wq->lock,
+						 &deadline)
+				: cond_wait(&wq->cond, &wq->lock);
+		mutex_unlock(&wq->lock);
+		if (lock)
+			mutex_lock(lock);
+
+		if (err) {
+			entry = NULL;
+			break;
+		}
+	}
+	__atomic_sub_fetch(&wq->waiters, 1, __ATOMIC_SEQ_CST);
 	return entry;
 }
 
@@ -578,38 +864,25 @@ cache_insert(struct cache *cache, struct cache_entry *entry)
 		return;
 
 	idx = entry - cache->ce;
-	if (cache->ninflight--) {
-		if (cache->inflight == idx)
-			cache->inflight = entry->next;
-		remove_entry(cache, entry);
-	}
-	add_entry_after(cache, entry, idx, cache->split);
-
-	switch (entry->state) {
-	case cs_probe:
-		++cache->nprobe;
-		cache->split = idx;
-		break;
-
-	case cs_precious:
-		++cache->nprec;
-		break;
-
-	default:		/* Make -Wswitch happy. */
-		break;
-	}
+	move_to_head(cache, entry, idx,
+		     entry->state == cs_probe ? cp_probe : cp_prec);
 	entry->state = cs_valid;
+	cache_wake(cache);
 }
 
 /**  Drop a reference to a cache entry.
  *
  * @param cache  Cache object.
  * @param entry  Cache entry.
+ *
+ * The reference count is updated atomically, so this function may be
+ * called without holding the lock that protects @p cache.
  */
 void
 cache_put_entry(struct cache *cache, struct cache_entry *entry)
 {
-	--entry->refcnt;
+	__atomic_sub_fetch(&entry->refcnt, 1, __ATOMIC_SEQ_CST);
+	cache_wake(cache);
 }
 
 /**  Discard an entry.
@@ -628,27 +901,35 @@ cache_put_entry(struct cache *cache, struct cache_entry *entry)
 void
 cache_discard(struct cache *cache, struct cache_entry *entry)
 {
-	unsigned n, idx, eprobe;
+	unsigned idx;
 
-	if (--entry->refcnt)
-		return;
+	if (__atomic_sub_fetch(&entry->refcnt, 1, __ATOMIC_SEQ_CST))
+		goto out;
 	if (cache_entry_valid(entry))
-		return;
-	--cache->ninflight;
+		goto out;
 
 	idx = entry - cache->ce;
-	if (cache->inflight == idx)
-		cache->inflight = entry->next;
-	remove_entry(cache, entry);
+	hash_del(cache, idx);
+	move_to_head(cache, entry, idx, cp_unused);
 
-	eprobe = cache->split;
-	n = cache->nprobe + cache->ngprobe;
-	if (!n)
-		cache->split = idx;
-	else while (n--)
-		eprobe = cache->ce[eprobe].prev;
+ out:
+	cache_wake(cache);
+}
 
-	add_entry_after(cache, entry, idx, eprobe);
+/**  Clean up all entries in a partition.
+ *
+ * @param cache  Cache object.
+ * @param part   Cache partition.
+ */
+static void
+cleanup_part(struct cache *cache, enum cache_part part)
+{
+	unsigned head = part_head(cache, part);
+	unsigned idx;
+
+	for (idx = cache->ce[head].next; idx != head;
+	     idx = cache->ce[idx].next)
+		cache->entry_cleanup(cache->cleanup_data, &cache->ce[idx]);
 }
 
 /**  Clean up all cache entries.
@@ -660,29 +941,11 @@ cache_discard(struct cache *cache, struct cache_entry *entry)
 static void
 cleanup_entries(struct cache *cache)
 {
-	unsigned n, idx;
-	struct cache_entry *entry;
-
 	if (!cache->entry_cleanup)
 		return;
 
-	/* Clean up precious entries */
-	n = cache->nprec;
-	idx = cache->ce[cache->split].next;
-	while (n--) {
-		entry = &cache->ce[idx];
-		cache->entry_cleanup(cache->cleanup_data, entry);
-		idx = entry->next;
-	}
-
-	/* Clean up probed entries */
-	n = cache->nprobe;
-	idx = cache->split;
-	while (n--) {
-		entry = &cache->ce[idx];
-		cache->entry_cleanup(cache->cleanup_data, entry);
-		idx = entry->prev;
-	}
+	cleanup_part(cache, cp_prec);
+	cleanup_part(cache, cp_probe);
 }
 
 /**  Flush all cache entries.
@@ -696,24 +959,32 @@ cache_flush(struct cache *cache)
 
 	cleanup_entries(cache);
 
+	for (i = 0; i < NR_CACHE_PARTS; ++i) {
+		struct cache_entry *head = &cache->ce[part_head(cache, i)];
+		head->next = head->prev = part_head(cache, i);
+		head->part = i;
+		cache->nent[i] = 0;
+	}
+
+	/* Entries with data must be at the head of the unused partition. */
 	n = 2 * cache->cap;
 	for (i = 0; i < n; ++i) {
 		struct cache_entry *entry = &cache->ce[i];
-		entry->next = (i > 0) ? (i - 1) : (n - 1);
-		entry->prev = (i < n - 1) ? (i + 1) : 0;
+		add_entry_before(cache, entry, i,
+				 part_head(cache, cp_unused));
+		entry->part = cp_unused;
 		entry->refcnt = 0;
 		entry->data = i < cache->cap
 			? cache->data + i * cache->elemsize
 			: NULL;
 	}
+	cache->nent[cp_unused] = n;
+
+	n = 1U << cache->hbits;
+	for (i = 0; i < n; ++i)
+		cache->hash[i] = HASH_EMPTY;
 
-	cache->split = 0;
-	cache->nprec = 0;
-	cache->ngprec = 0;
-	cache->nprobe = 0;
-	cache->ngprobe = 0;
 	cache->dprobe = 0;
-	cache->ninflight = 0;
 }
 
 /**  Allocate a cache object.
@@ -728,9 +999,10 @@ struct cache *
 cache_alloc(unsigned n, size_t size)
 {
 	struct cache *cache;
+	unsigned hbits;
 
 	cache = malloc(sizeof(struct cache) +
-		       2 * n * sizeof(struct cache_entry));
+		       (2 * n + NR_CACHE_PARTS) * sizeof(struct cache_entry));
 	if (!cache)
 		return cache;
 
@@ -739,18 +1011,41 @@ cache_alloc(unsigned n, size_t size)
 	cache->hits.number = 0;
 	cache->misses.number = 0;
 	cache->entry_cleanup = NULL;
+#if USE_PTHREAD
+	cache->waitq = waitq_alloc();
+	if (!cache->waitq) {
+		free(cache);
+		return NULL;
+	}
+#else
+	cache->waitq = NULL;
+#endif
+
+	/* Keep the load factor of the hash index below 50%. */
+	for (hbits = 2; hbits < 8 * sizeof(unsigned) - 1; ++hbits)
+		if ((1UL << hbits) >= 4UL * n)
+			break;
+	cache->hbits = hbits;
+	cache->hash = malloc(sizeof(unsigned) << hbits);
+	if (!cache->hash)
+		goto err_waitq;
 
 	if (cache->elemsize) {
 		cache->data = malloc(cache->cap * cache->elemsize);
 		if (!cache->data) {
-			free(cache);
-			return NULL;
+			free(cache->hash);
+			goto err_waitq;
 		}
 	} else
 		cache->data = cache; /* Any non-NULL pointer */
 
 	cache_flush(cache);
 	return cache;
+
+ err_waitq:
+	waitq_free(cache->waitq);
+	free(cache);
+	return NULL;
 }
 
 /** Set cache entry destructor.
@@ -784,6 +1079,8 @@ cache_free(struct cache *cache)
 	cleanup_entries(cache);
 	if (cache->data != cache)
 		free(cache->data);
+	free(cache->hash);
+	waitq_free(cache->waitq);
 	free(cache);
 }
 
@@ -830,3 +1127,197 @@ cache_set_attrs(struct cache *cache, kdump_ctx_t *ctx,
 
 	return KDUMP_OK;
 }
+
+/**  Get the configured number of page cache shards.
+ * @param ctx  Dump file object.
+ * @returns    Number of shards.
+ *
+ * Get the number of shards from "cache.shards" attribute. If not set,
+ * return @ref DEFAULT_CACHE_SHARDS.
+ */
+unsigned
+get_cache_shards(kdump_ctx_t *ctx)
+{
+	struct attr_data *attr = gattr(ctx, GKI_cache_shards);
+	return attr_isset(attr) && attr_revalidate(ctx, attr) == KDUMP_OK
+		? attr_value(attr)->number
+		: DEFAULT_CACHE_SHARDS;
+}
+
+/**  Apply the cache wait settings to all shared caches.
+ * @param ctx  Dump file object.
+ * @returns    Error status.
+ *
+ * Enable or disable waiting for cache entries in all page cache shards
+ * and in the file cache according to "cache.wait" and
+ * "cache.wait_timeout". Caches which have not been allocated yet
+ * are skipped; this function is called again when they are created.
+ */
+kdump_status
+update_cache_wait(kdump_ctx_t *ctx)
+{
+	struct attr_data *attr;
+	struct page_cache *pc;
+	struct fcache *fc;
+	unsigned long timeout;
+	unsigned i;
+	int wait;
+
+	attr = gattr(ctx, GKI_cache_wait);
+	wait = attr_isset(attr) && attr_value(attr)->number;
+	attr = gattr(ctx, GKI_cache_wait_timeout);
+	timeout = attr_isset(attr) ? attr_value(attr)->number : 0;
+
+	pc = ctx->shared->cache;
+	if (pc)
+		for (i = 0; i < pc->nshards; ++i)
+			cache_set_wait(pc->shard[i].cache, wait, timeout);
+	fc = ctx->shared->fcache;
+	if (fc) {
+		cache_set_wait(fc->cache, wait, timeout);
+		cache_set_wait(fc->fbcache, wait, timeout);
+	}
+
+	return KDUMP_OK;
+}
+
+/**  Allocate a page cache.
+ *
+ * @param nshards  Number of shards.
+ * @param n        Total number of elements in the cache.
+ * @param size     Data size for each element.
+ * @returns        Newly allocated page cache, or @c NULL on failure.
+ *
+ * The elements are split evenly among the shards, rounding up, so
+ * the total capacity may be slightly higher than @p n.
+ *
+ * A read-only zero page of @p size bytes is allocated as well. It is
+ * mapped anonymously, so it does not take any memory until it is read.
+ */
+struct page_cache *
+page_cache_alloc(unsigned nshards, unsigned n, size_t size)
+{
+	struct page_cache *pc;
+	unsigned shardsize;
+	unsigned i;
+
+	pc = malloc(sizeof(struct page_cache) +
+		    nshards * sizeof(struct cache_shard));
+	if (!pc)
+		return pc;
+
+	pc->nshards = nshards;
+	pc->hits.number = 0;
+	pc->misses.number = 0;
+
+	pc->zero_size = size;
+	pc->zero_page = mmap(NULL, size, PROT_READ,
+			     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pc->zero_page == MAP_FAILED) {
+		free(pc);
+		return NULL;
+	}
+
+	shardsize = n / nshards + (n % nshards != 0);
+	for (i = 0; i < nshards; ++i) {
+		struct cache_shard *shard = &pc->shard[i];
+		shard->cache = cache_alloc(shardsize, size);
+		if (!shard->cache)
+			goto err;
+		if (mutex_init(&shard->lock, NULL)) {
+			cache_free(shard->cache);
+			goto err;
+		}
+	}
+
+	return pc;
+
+ err:
+	pc->nshards = i;
+	page_cache_free(pc);
+	return NULL;
+}
+
+/**  Free a page cache.
+ * @param pc  Page cache.
+ *
+ * All shards, their cache objects and the zero page are freed.
+ */
+void
+page_cache_free(struct page_cache *pc)
+{
+	unsigned i;
+
+	for (i = 0; i < pc->nshards; ++i) {
+		mutex_destroy(&pc->shard[i].lock);
+		cache_free(pc->shard[i].cache);
+	}
+	munmap(pc->zero_page, pc->zero_size);
+	free(pc);
+}
+
+/**  Aggregate page cache statistics.
+ * @param ctx   Dump file object.
+ * @param attr  Attribute "cache.hits" or "cache.misses".
+ * @returns     Error status.
+ *
+ * Sum up hits and misses of all shards. The attribute stays invalid,
+ * so the sum is recomputed whenever the value is requested.
+ */
+static kdump_status
+cache_stats_revalidate(kdump_ctx_t *ctx, struct attr_data *attr)
+{
+	struct page_cache *pc = ctx->shared->cache;
+	kdump_num_t hits, misses;
+	unsigned i;
+
+	if (!pc)
+		return KDUMP_OK;
+
+	hits = misses = 0;
+	for (i = 0; i < pc->nshards; ++i) {
+		hits += pc->shard[i].cache->hits.number;
+		misses += pc->shard[i].cache->misses.number;
+	}
+	pc->hits.number = hits;
+	pc->misses.number = misses;
+	return KDUMP_OK;
+}
+
+const struct attr_ops cache_stats_ops = {
+	.revalidate = cache_stats_revalidate,
+};
+
+/**  Set up page cache statistics attributes.
+ * @param pc      Page cache.
+ * @param ctx     Dump file object containing the attributes.
+ * @param hits    Attribute for cache hits.
+ * @param misses  Attribute for cache misses.
+ * @returns       Error status.
+ *
+ * The attributes must use @ref cache_stats_ops, so the values of all
+ * shards are summed up when the attribute is read.
+ */
+kdump_status
+page_cache_set_attrs(struct page_cache *pc, kdump_ctx_t *ctx,
+		     struct attr_data *hits, struct attr_data *misses)
+{
+	struct attr_flags flags = ATTR_PERSIST_INDIRECT;
+	kdump_status status;
+
+	flags.invalid = true;
+
+	status = set_attr(ctx, hits, flags, &pc->hits);
+	if (status != KDUMP_OK)
+		return set_error(ctx, status,
+				 "Cannot set up cache '%s' attribute",
+				 "hits");
+
+	status = set_attr(ctx, misses, flags, &pc->misses);
+	if (status != KDUMP_OK)
+		return set_error(ctx, status,
+				 "Cannot set up cache '%s' attribute",
+				 "misses");
+
+	return KDUMP_OK;
+}
@@ -73,16 +73,12 @@ alloc_shared(void)
 	list_init(&shared->ctx);
 
 	if (rwlock_init(&shared->lock, NULL))
-		goto err1;
-
-	if (mutex_init(&shared->cache_lock, NULL))
-		goto err2;
+		goto err;
 
 	shared->refcnt = 1;
 	return shared;
 
- err2:	rwlock_destroy(&shared->lock);
- err1:	free(shared);
+ err:	free(shared);
 	return NULL;
 }
 
@@ -96,16 +92,17 @@ shared_free(struct kdump_shared *shared)
 {
 	rwlock_unlock(&shared->lock);
 
+	readahead_stop(shared);
 	if (shared->ops && shared->ops->cleanup)
 		shared->ops->cleanup(shared);
 	if (shared->arch_ops && shared->arch_ops->cleanup)
 		shared->arch_ops->cleanup(shared);
 	if (shared->cache)
-		cache_free(shared->cache);
+		page_cache_free(shared->cache);
 	flatmap_free(shared->flatmap);
+	stats_free(shared->stats);
 	if (shared->fcache)
 		fcache_decref(shared->fcache);
-	mutex_destroy(&shared->cache_lock);
 	rwlock_destroy(&shared->lock);
 	free(shared);
 }
@@ -155,12 +152,20 @@ kdump_new(void)
 		{ GKI_cache_hits, 0 },
 		{ GKI_cache_misses, 0 },
 		{ GKI_cache_size, DEFAULT_CACHE_SIZE },
+		{ GKI_cache_shards, DEFAULT_CACHE_SHARDS },
+		{ GKI_cache_wait, 0 },
+		{ GKI_cache_wait_timeout, 0 },
+		{ GKI_cache_readahead, 0 },
+		{ GKI_cache_readahead_threads, DEFAULT_READAHEAD_THREADS },
 		{ GKI_file_mmap_policy, KDUMP_MMAP_TRY },
 		{ GKI_mmap_cache_hits, 0 },
 		{ GKI_mmap_cache_misses, 0 },
 		{ GKI_read_cache_hits, 0 },
 		{ GKI_read_cache_misses, 0 },
+		{ GKI_stats_enabled, 0 },
 		{ GKI_num_files, 0 },
+		{ GKI_xlat_tlb_hits, 0 },
+		{ GKI_xlat_tlb_misses, 0 },
 	};
 
 	kdump_ctx_t *ctx;
@@ -191,6 +196,15 @@ kdump_new(void)
 		set_attr_number(ctx, gattr(ctx, numeric_attrs[i].key),
 				ATTR_PERSIST, numeric_attrs[i].val);
 
+	/* TLB statistics are fetched from the translation context. */
+	gattr(ctx, GKI_xlat_tlb_hits)->flags.invalid = true;
+	gattr(ctx, GKI_xlat_tlb_misses)->flags.invalid = true;
+
+	/* So is the page table read cache size. */
+	set_attr_number(ctx, gattr(ctx, GKI_xlat_read_cache_size),
+			ATTR_PERSIST,
+			addrxlat_ctx_get_read_cache_size(ctx->xlatctx));
+
 	return ctx;
 
  err_dict:
@@ -231,12 +245,21 @@ kdump_clone(const kdump_ctx_t *orig, unsigned long flags)
 	if (!ctx)
 		return ctx;
 
+	if (addrxlat_ctx_set_read_cache_size(
+		    ctx->xlatctx,
+		    addrxlat_ctx_get_read_cache_size(orig->xlatctx))
+	    != ADDRXLAT_OK) {
+		addrxlat_ctx_decref(ctx->xlatctx);
+		free(ctx);
+		return NULL;
+	}
+
 	rwlock_rdlock(&orig->shared->lock);
 	for (slot = 0; slot < PER_CTX_SLOTS; ++slot) {
 		size_t sz = orig->shared->per_ctx_size[slot];
 		if (!sz)
 			continue;
-		if (! (ctx->data[slot] = malloc(sz)) ) {
+		if (! (ctx->data[slot] = calloc(1, sz)) ) {
 			while (slot-- > 0)
 				if (orig->shared->per_ctx_size[slot])
 					free(ctx->data[slot]);
@@ -297,9 +320,13 @@ kdump_free(kdump_ctx_t *ctx)
 
 	rwlock_wrlock(&shared->lock);
 
-	for (slot = 0; slot < PER_CTX_SLOTS; ++slot)
-		if (shared->per_ctx_size[slot])
-			free(ctx->data[slot]);
+	for (slot = 0; slot < PER_CTX_SLOTS; ++slot) {
+		if (!shared->per_ctx_size[slot])
+			continue;
+		if (shared->per_ctx_cleanup[slot])
+			shared->per_ctx_cleanup[slot](ctx->data[slot]);
+		free(ctx->data[slot]);
+	}
 
 	addrxlat_ctx_decref(ctx->xlatctx);
 
@@ -316,6 +343,74 @@ kdump_free(kdump_ctx_t *ctx)
 	free(ctx);
 }
 
+/**  Create a helper context.
+ * @param shared  Dump file shared data.
+ * @returns       New context, or @c NULL on allocation failure.
+ *
+ * A helper context is used by internal threads to read pages with
+ * a format-specific read function. It has its own error buffer and
+ * per-context data, but no attribute dictionary or translation, and
+ * it does not hold a reference to @p shared. The owner must free it
+ * with @ref helper_ctx_free before @p shared is cleaned up.
+ *
+ * The shared data must be locked for writing by the caller.
+ */
+kdump_ctx_t *
+helper_ctx_new(struct kdump_shared *shared)
+{
+	kdump_ctx_t *ctx;
+	int slot;
+
+	ctx = alloc_ctx();
+	if (!ctx)
+		return ctx;
+
+	for (slot = 0; slot < PER_CTX_SLOTS; ++slot) {
+		size_t sz = shared->per_ctx_size[slot];
+		if (!sz)
+			continue;
+		if (! (ctx->data[slot] = calloc(1, sz)) ) {
+			while (slot-- > 0)
+				if (shared->per_ctx_size[slot])
+					free(ctx->data[slot]);
+			addrxlat_ctx_decref(ctx->xlatctx);
+			err_cleanup(&ctx->err);
+			free(ctx);
+			return NULL;
+		}
+	}
+
+	ctx->shared = shared;
+	list_add(&ctx->list, &shared->ctx);
+	return ctx;
+}
+
+/**  Free a helper context.
+ * @param ctx  Helper context created by @ref helper_ctx_new.
+ *
+ * The shared data must be locked for writing by the caller, unless
+ * it is being freed.
+ */
+void
+helper_ctx_free(kdump_ctx_t *ctx)
+{
+	struct kdump_shared *shared = ctx->shared;
+	int slot;
+
+	for (slot = 0; slot < PER_CTX_SLOTS; ++slot) {
+		if (!shared->per_ctx_size[slot])
+			continue;
+		if (shared->per_ctx_cleanup[slot])
+			shared->per_ctx_cleanup[slot](ctx->data[slot]);
+		free(ctx->data[slot]);
+	}
+
+	addrxlat_ctx_decref(ctx->xlatctx);
+	list_del(&ctx->list);
+	err_cleanup(&ctx->err);
+	free(ctx);
+}
+
 const char *
 kdump_get_err(kdump_ctx_t *ctx)
 {
@@ -355,16 +450,22 @@ kdump_get_addrxlat(kdump_ctx_t *ctx,
 }
 
 /**  Allocate per-context data.
- * @param shared  Dump file shared data.
- * @param sz      Size of per-context data.
- * @returns       Per-context slot number, or -1 on error.
+ * @param shared   Dump file shared data.
+ * @param sz       Size of per-context data.
+ * @param cleanup  Cleanup function, or @c NULL.
+ * @returns        Per-context slot number, or -1 on error.
+ *
+ * The data is initialized to all zeroes, both here and when a context
+ * is cloned. If @p cleanup is not @c NULL, it is called for the data
+ * of each context before it is freed.
  *
  * On error, @c errno is set to:
  * - @c EAGAIN  All slots are already in use.
  * - @c ENOMEM  Memory allocation failure.
  */
 int
-per_ctx_alloc(struct kdump_shared *shared, size_t sz)
+per_ctx_alloc(struct kdump_shared *shared, size_t sz,
+	      per_ctx_cleanup_fn *cleanup)
 {
 	kdump_ctx_t *ctx;
 	int slot;
@@ -378,10 +479,11 @@ per_ctx_alloc(struct kdump_shared *shared, size_t sz)
 		return -1;
 	}
 	shared->per_ctx_size[slot] = sz;
+	shared->per_ctx_cleanup[slot] = cleanup;
 
 	/* Allocate memory. */
 	list_for_each_entry(ctx, &shared->ctx, list)
-		if (! (ctx->data[slot] = malloc(sz)) ) {
+		if (! (ctx->data[slot] = calloc(1, sz)) ) {
 			while (ctx->list.prev != &shared->ctx) {
 				ctx = list_entry(ctx->list.prev,
 						 kdump_ctx_t, list);
@@ -403,9 +505,13 @@ per_ctx_free(struct kdump_shared *shared, int slot)
 {
 	kdump_ctx_t *ctx;
 
-	list_for_each_entry(ctx, &shared->ctx, list)
+	list_for_each_entry(ctx, &shared->ctx, list) {
+		if (shared->per_ctx_cleanup[slot])
+			shared->per_ctx_cleanup[slot](ctx->data[slot]);
 		free(ctx->data[slot]);
+	}
 	shared->per_ctx_size[slot] = 0;
+	shared->per_ctx_cleanup[slot] = NULL;
 }
 
 const char *
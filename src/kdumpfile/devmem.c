@@ -183,6 +183,7 @@ devmem_get_page(struct page_io *pio)
 	struct devmem_priv *dmp = ctx->shared->fmtdata;
 	struct cache_entry *ce;
 	unsigned i;
+	uint64_t start;
 	kdump_status ret;
 
 	ce = NULL;
@@ -200,10 +201,14 @@ devmem_get_page(struct page_io *pio)
 	++ce->refcnt;
 
 	ce->key = pio->addr.addr;
-	mutex_lock(&ctx->shared->cache_lock);
+
+	/* Page tables of live memory may change at any time. */
+	addrxlat_ctx_flush_tlb(ctx->xlatctx);
+
+	start = stats_start(ctx->shared);
 	ret = fcache_get_chunk(ctx->shared->fcache, &pio->chunk,
 			       get_page_size(ctx), 0, pio->addr.addr);
-	mutex_unlock(&ctx->shared->cache_lock);
+	stats_end(ctx->shared, STAGE_io, start);
 	if (ret != KDUMP_OK) {
 		--ce->refcnt;
 		return set_error(ctx, ret,
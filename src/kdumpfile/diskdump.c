@@ -36,16 +36,6 @@
 #include <unistd.h>
 #include <string.h>
 
-#if USE_LZO
-# include <lzo/lzo1x.h>
-#endif
-#if USE_SNAPPY
-# include <snappy-c.h>
-#endif
-#if USE_ZSTD
-# include <zstd.h>
-#endif
-
 #define SIG_LEN	8
 
 /** @cond TARGET_ABI */
@@ -194,10 +184,40 @@ struct disk_dump_priv {
 	/** Memory region mapping. */
 	struct pfn_file_map mem_pagemap;
 
+	/** Per-context slot for decompression state. */
+	int decomp_slot;
+
+	/** Lock which protects @c pd_cache and @c dedup_cache. */
+	mutex_t pd_lock;
+
+	/** Cache of page descriptor blocks (in host byte order). */
+	struct cache *pd_cache;
+
+	/** Cache of uncompressed data shared by multiple pages. */
+	struct cache *dedup_cache;
+
+	/** Key of shared data which contains only zeroes, or zero.
+	 * The key is made of the file offset and the file index in the
+	 * same way as the @c dedup_cache key.
+	 */
+	cache_key_t zero_key;
+
 	/** Page descriptor mapping. */
 	struct pfn_file_map pdmap[];
 };
 
+/** Number of page descriptors in a cached block. */
+#define PD_BLOCK_DESCS	256
+
+/** Size of a cached page descriptor block in bytes. */
+#define PD_BLOCK_SIZE	(PD_BLOCK_DESCS * sizeof(struct page_desc))
+
+/** Number of cached page descriptor blocks. */
+#define PD_CACHE_BLOCKS	64
+
+/** Number of cached pages with shared data. */
+#define DEDUP_CACHE_PAGES	32
+
 struct setup_data {
 	kdump_ctx_t *ctx;
 	off_t note_off;
@@ -212,6 +232,12 @@ struct setup_data {
 #define DUMP_DH_COMPRESSED_SNAPPY 0x4	/* page is compressed with snappy */
 #define DUMP_DH_COMPRESSED_ZSTD	0x20	/* page is compressed with zstd */
 
+/* Internal flag: page data may be shared with another page */
+#define PD_SHARED		0x80000000
+
+/* Internal flag: page data is known to contain only zeroes */
+#define PD_ZERO			0x40000000
+
 /* Any compression flag */
 #define DUMP_DH_COMPRESSED	( 0	\
 	| DUMP_DH_COMPRESSED_ZLIB	\
@@ -349,143 +375,455 @@ static const struct kdump_bmp_ops mem_pagemap_ops = {
 	.cleanup = diskdump_bmp_cleanup,
 };
 
+/** Read a single page descriptor, bypassing the descriptor cache.
+ * @param ctx     Dump file object.
+ * @param pdmap   Page descriptor mapping.
+ * @param pd_pos  File offset of the page descriptor.
+ * @param pd      Page descriptor (in host byte order on success).
+ * @returns       Error status.
+ */
 static kdump_status
-diskdump_read_page(struct page_io *pio)
+read_page_desc(kdump_ctx_t *ctx, const struct pfn_file_map *pdmap,
+	       off_t pd_pos, struct page_desc *pd)
 {
-	kdump_ctx_t *ctx = pio->ctx;
-	struct disk_dump_priv *ddp = ctx->shared->fmtdata;
-	kdump_pfn_t pfn;
-	const struct pfn_file_map *pdmap;
-	struct fcache_chunk fch;
-	struct page_desc pd;
-	off_t pd_pos;
+	uint64_t start;
 	kdump_status ret;
 
-	pfn = pio->addr.addr >> get_page_shift(ctx);
-	if (pfn >= get_max_pfn(ctx))
-		return set_error(ctx, KDUMP_ERR_NODATA, "Out-of-bounds PFN");
-
-	pdmap = find_pfn_file_map(ddp->pdmap, ddp->num_files, pfn);
-	pd_pos = pdmap && pdmap->start_pfn <= pfn
-		? pfn_to_pdpos(pdmap, pfn)
-		: (off_t) -1;
-	if (pd_pos == (off_t)-1) {
-		if (get_zero_excluded(ctx)) {
-			memset(pio->chunk.data, 0, get_page_size(ctx));
-			return KDUMP_OK;
-		}
-		return set_error(ctx, KDUMP_ERR_NODATA, "Excluded page");
-	}
-
-	mutex_lock(&ctx->shared->cache_lock);
-	ret = flatmap_pread(ctx->shared->flatmap, &pd, sizeof pd,
+	start = stats_start(ctx->shared);
+	ret = flatmap_pread(ctx->shared->flatmap, pd, sizeof *pd,
 			    pdmap->fidx, pd_pos);
-	mutex_unlock(&ctx->shared->cache_lock);
+	stats_end(ctx->shared, STAGE_desc, start);
 	if (ret != KDUMP_OK)
 		return set_error(ctx, ret,
 				 "Cannot read page descriptor at %llu",
 				 (unsigned long long) pd_pos);
 
-	pd.offset = dump64toh(ctx, pd.offset);
-	pd.size = dump32toh(ctx, pd.size);
-	pd.flags = dump32toh(ctx, pd.flags);
-	pd.page_flags = dump64toh(ctx, pd.page_flags);
-
-	/* read page data */
-	if (pd.flags & DUMP_DH_COMPRESSED) {
-		mutex_lock(&ctx->shared->cache_lock);
-		ret = flatmap_get_chunk(ctx->shared->flatmap, &fch, pd.size,
-					pdmap->fidx, pd.offset);
-		mutex_unlock(&ctx->shared->cache_lock);
+	pd->offset = dump64toh(ctx, pd->offset);
+	pd->size = dump32toh(ctx, pd->size);
+	pd->flags = dump32toh(ctx, pd->flags);
+	pd->page_flags = dump64toh(ctx, pd->page_flags);
+	return KDUMP_OK;
+}
+
+/** Convert page descriptors to host byte order.
+ * @param ctx    Dump file object.
+ * @param dst    Destination (host byte order).
+ * @param src    Source (dump file byte order).
+ * @param n      Number of page descriptors.
+ * @param nprev  Number of preceding page descriptors in @p src.
+ *
+ * Page data is written in PFN order, so a data offset which is not
+ * above that of a preceding page means that the data is shared (e.g.
+ * the zero page written by makedumpfile). Such descriptors are marked
+ * with @ref PD_SHARED.
+ *
+ * The first @p nprev descriptors in @p src are not converted. They
+ * precede the converted descriptors in the file, and they are used
+ * only to find the highest data offset so far, so that shared data
+ * is also detected across block boundaries.
+ */
+static void
+decode_page_descs(kdump_ctx_t *ctx, struct page_desc *dst,
+		  const struct page_desc *src, size_t n, size_t nprev)
+{
+	bool seen = nprev > 0;
+	uint64_t maxoff = 0;
+	uint64_t off;
+
+	while (nprev--) {
+		off = dump64toh(ctx, src->offset);
+		if (off > maxoff)
+			maxoff = off;
+		++src;
+	}
+
+	while (n--) {
+		dst->offset = dump64toh(ctx, src->offset);
+		dst->size = dump32toh(ctx, src->size);
+		dst->flags = dump32toh(ctx, src->flags);
+		dst->page_flags = dump64toh(ctx, src->page_flags);
+		if (seen && dst->offset <= maxoff)
+			dst->flags |= PD_SHARED;
+		else
+			maxoff = dst->offset;
+		seen = true;
+		++dst;
+		++src;
+	}
+}
+
+/** Get the shared data key of a page descriptor.
+ * @param ddp   Diskdump private data.
+ * @param fidx  File index.
+ * @param pd    Page descriptor.
+ * @returns     Key in @c dedup_cache.
+ */
+static inline cache_key_t
+shared_data_key(const struct disk_dump_priv *ddp, unsigned fidx,
+		const struct page_desc *pd)
+{
+	return (cache_key_t)pd->offset * ddp->num_files + fidx;
+}
+
+/** Mark a page descriptor with @ref PD_ZERO if appropriate.
+ * @param ddp   Diskdump private data.
+ * @param fidx  File index.
+ * @param pd    Page descriptor (in host byte order).
+ */
+static inline void
+check_zero_desc(const struct disk_dump_priv *ddp, unsigned fidx,
+		struct page_desc *pd)
+{
+	cache_key_t zero_key = __atomic_load_n(&ddp->zero_key,
+					       __ATOMIC_RELAXED);
+	if (zero_key && shared_data_key(ddp, fidx, pd) == zero_key)
+		pd->flags |= PD_ZERO;
+}
+
+/** Get a page descriptor.
+ * @param ctx     Dump file object.
+ * @param pdmap   Page descriptor mapping.
+ * @param pd_pos  File offset of the page descriptor.
+ * @param pd      Page descriptor (in host byte order on success).
+ * @returns       Error status.
+ *
+ * Page descriptors are read in blocks of @ref PD_BLOCK_DESCS, counted
+ * from the first descriptor in the file, and kept in a cache after
+ * conversion to host byte order. If all cache entries are in use,
+ * the descriptor is read directly from the file.
+ *
+ * The preceding block is read together with a block, so that shared
+ * data can be detected for descriptors at the start of the block.
+ * This is exact unless all pages of the preceding block share data
+ * with even earlier pages; the data of the first pages is then read
+ * without looking in the shared data cache, which is still correct.
+ *
+ * If the page data is known to contain only zeroes, @ref PD_ZERO is
+ * set in the returned descriptor.
+ */
+static kdump_status
+get_page_desc(kdump_ctx_t *ctx, const struct pfn_file_map *pdmap,
+	      off_t pd_pos, struct page_desc *pd)
+{
+	struct disk_dump_priv *ddp = ctx->shared->fmtdata;
+	const struct pfn_region *lastrgn;
+	struct cache_entry *ce;
+	off_t base, end, blkpos;
+	size_t idx, blksize;
+	cache_key_t key;
+
+	base = pdmap->regions[0].pos;
+	lastrgn = &pdmap->regions[pdmap->nregions - 1];
+	end = lastrgn->pos + lastrgn->cnt * sizeof(struct page_desc);
+	idx = (pd_pos - base) / sizeof(struct page_desc);
+	blkpos = base + (idx - idx % PD_BLOCK_DESCS) * sizeof(struct page_desc);
+	blksize = end - blkpos < PD_BLOCK_SIZE
+		? end - blkpos
+		: PD_BLOCK_SIZE;
+	key = (cache_key_t)(idx / PD_BLOCK_DESCS) * ddp->num_files +
+		pdmap->fidx;
+
+	mutex_lock(&ddp->pd_lock);
+	ce = cache_get_entry(ddp->pd_cache, key);
+	if (!ce) {
+		kdump_status ret;
+
+		mutex_unlock(&ddp->pd_lock);
+		ret = read_page_desc(ctx, pdmap, pd_pos, pd);
+		if (ret == KDUMP_OK)
+			check_zero_desc(ddp, pdmap->fidx, pd);
+		return ret;
+	}
+
+	if (!cache_entry_valid(ce)) {
+		struct fcache_chunk fch;
+		off_t prevpos;
+		uint64_t start;
+		kdump_status ret;
+
+		prevpos = blkpos > base ? blkpos - PD_BLOCK_SIZE : blkpos;
+
+		/* Do not block other users while the read is in flight. */
+		mutex_unlock(&ddp->pd_lock);
+		start = stats_start(ctx->shared);
+		ret = flatmap_get_chunk(ctx->shared->flatmap, &fch,
+					blkpos - prevpos + blksize,
+					pdmap->fidx, prevpos);
+		stats_end(ctx->shared, STAGE_desc, start);
+		mutex_lock(&ddp->pd_lock);
+		if (ret != KDUMP_OK) {
+			cache_discard(ddp->pd_cache, ce);
+			mutex_unlock(&ddp->pd_lock);
+			return set_error(ctx, ret,
+					 "Cannot read page descriptors at %llu",
+					 (unsigned long long) blkpos);
+		}
+		decode_page_descs(ctx, ce->data, fch.data,
+				  blksize / sizeof(struct page_desc),
+				  (blkpos - prevpos) / sizeof(struct page_desc));
+		fcache_put_chunk(&fch);
+		cache_insert(ddp->pd_cache, ce);
+	}
+
+	*pd = ((const struct page_desc *) ce->data)[idx % PD_BLOCK_DESCS];
+	cache_put_entry(ddp->pd_cache, ce);
+	mutex_unlock(&ddp->pd_lock);
+	check_zero_desc(ddp, pdmap->fidx, pd);
+	return KDUMP_OK;
+}
+
+/** Read and uncompress page data.
+ * @param ctx   Dump file object.
+ * @param fidx  File index.
+ * @param pd    Page descriptor.
+ * @param buf   Page data buffer.
+ * @returns     Error status.
+ */
+static kdump_status
+read_page_data(kdump_ctx_t *ctx, unsigned fidx, const struct page_desc *pd,
+	       void *buf)
+{
+	struct disk_dump_priv *ddp = ctx->shared->fmtdata;
+	struct fcache_chunk fch;
+	uint64_t start;
+	kdump_status ret;
+
+	start = stats_start(ctx->shared);
+	if (pd->flags & DUMP_DH_COMPRESSED) {
+		ret = flatmap_get_chunk(ctx->shared->flatmap, &fch, pd->size,
+					fidx, pd->offset);
 	} else {
-		if (pd.size != get_page_size(ctx))
+		if (pd->size != get_page_size(ctx))
 			return set_error(ctx, KDUMP_ERR_CORRUPT,
 					 "Wrong page size: %"PRIu32,
-					 pd.size);
-		mutex_lock(&ctx->shared->cache_lock);
-		ret = flatmap_pread(ctx->shared->flatmap, pio->chunk.data,
-				    pd.size, pdmap->fidx, pd.offset);
-		mutex_unlock(&ctx->shared->cache_lock);
+					 pd->size);
+		ret = flatmap_pread(ctx->shared->flatmap, buf,
+				    pd->size, fidx, pd->offset);
 	}
+	stats_end(ctx->shared, STAGE_io, start);
 
 	if (ret != KDUMP_OK)
 		return set_error(ctx, ret,
 				 "Cannot read page data at %llu",
-				 (unsigned long long) pd.offset);
+				 (unsigned long long) pd->offset);
 
-	if (pd.flags & DUMP_DH_COMPRESSED_ZLIB) {
-		ret = uncompress_page_gzip(ctx, pio->chunk.data,
-					   fch.data, pd.size);
+	if (pd->flags & DUMP_DH_COMPRESSED_ZLIB) {
+		ret = uncompress_page_gzip(ctx, ctx->data[ddp->decomp_slot],
+					   buf, fch.data, pd->size);
 		fcache_put_chunk(&fch);
 		if (ret != KDUMP_OK)
 			return ret;
-	} else if (pd.flags & DUMP_DH_COMPRESSED_LZO) {
-#if USE_LZO
-		lzo_uint retlen = get_page_size(ctx);
-		int ret = lzo1x_decompress_safe(fch.data, pd.size,
-						pio->chunk.data,
-						&retlen,
-						LZO1X_MEM_DECOMPRESS);
+	} else if (pd->flags & DUMP_DH_COMPRESSED_LZO) {
+		ret = uncompress_page_lzo(ctx, ctx->data[ddp->decomp_slot],
+					  buf, fch.data, pd->size);
 		fcache_put_chunk(&fch);
-		if (ret != LZO_E_OK)
-			return set_error(ctx, KDUMP_ERR_CORRUPT,
-					 "Decompression failed: %d", ret);
-		if (retlen != get_page_size(ctx))
-			return set_error(ctx, KDUMP_ERR_CORRUPT,
-					 "Wrong uncompressed size: %lu",
-					 (unsigned long) retlen);
-#else
-		return set_error(ctx, KDUMP_ERR_NOTIMPL,
-				 "Unsupported compression method: %s",
-				 "lzo");
-#endif
-	} else if (pd.flags & DUMP_DH_COMPRESSED_SNAPPY) {
-#if USE_SNAPPY
-		size_t retlen = get_page_size(ctx);
-		snappy_status ret;
-		ret = snappy_uncompress(fch.data, pd.size,
-					pio->chunk.data, &retlen);
+		if (ret != KDUMP_OK)
+			return ret;
+	} else if (pd->flags & DUMP_DH_COMPRESSED_SNAPPY) {
+		ret = uncompress_page_snappy(ctx, ctx->data[ddp->decomp_slot],
+					     buf, fch.data, pd->size);
 		fcache_put_chunk(&fch);
-		if (ret != SNAPPY_OK)
-			return set_error(ctx, KDUMP_ERR_CORRUPT,
-					 "Decompression failed: %d",
-					 (int) ret);
-		if (retlen != get_page_size(ctx))
-			return set_error(ctx, KDUMP_ERR_CORRUPT,
-					 "Wrong uncompressed size: %lu",
-					 (unsigned long) retlen);
-#else
-		return set_error(ctx, KDUMP_ERR_NOTIMPL,
-				 "Unsupported compression method: %s",
-				 "snappy");
-#endif
-	} else if (pd.flags & DUMP_DH_COMPRESSED_ZSTD) {
-#if USE_ZSTD
-		size_t ret;
-		ret = ZSTD_decompress(pio->chunk.data, get_page_size(ctx),
-				      fch.data, pd.size);
+		if (ret != KDUMP_OK)
+			return ret;
+	} else if (pd->flags & DUMP_DH_COMPRESSED_ZSTD) {
+		ret = uncompress_page_zstd(ctx, ctx->data[ddp->decomp_slot],
+					   buf, fch.data, pd->size);
 		fcache_put_chunk(&fch);
-		if (ZSTD_isError(ret))
-			return set_error(ctx, KDUMP_ERR_CORRUPT,
-					 "Decompression failed: %s",
-					 ZSTD_getErrorName(ret));
-		if (ret != get_page_size(ctx))
-			return set_error(ctx, KDUMP_ERR_CORRUPT,
-					 "Wrong uncompressed size: %zu", ret);
-#else
-		return set_error(ctx, KDUMP_ERR_NOTIMPL,
-				 "Unsupported compression method: %s",
-				 "zstd");
-#endif
+		if (ret != KDUMP_OK)
+			return ret;
 	}
 
 	return KDUMP_OK;
 }
 
+/** Check whether a page contains only zeroes.
+ * @param buf   Page data.
+ * @param size  Page size.
+ * @returns     @c true if all bytes in @p buf are zero.
+ */
+static bool
+page_is_zero(const void *buf, size_t size)
+{
+	const unsigned long *p = buf;
+	const unsigned long *endp = buf + size;
+
+	while (p < endp)
+		if (*p++)
+			return false;
+	return true;
+}
+
+/** Read page data which may be shared with other pages.
+ * @param ctx   Dump file object.
+ * @param fidx  File index.
+ * @param pd    Page descriptor.
+ * @param buf   Page data buffer.
+ * @returns     Error status.
+ *
+ * The uncompressed data is looked up in the shared data cache, which
+ * is keyed by the file index and the data offset, so that data shared
+ * by many pages is read and uncompressed only once.
+ *
+ * If the shared data contains only zeroes, its key is remembered, so
+ * that all pages which share it can use the zero page.
+ */
+static kdump_status
+read_shared_page(kdump_ctx_t *ctx, unsigned fidx, const struct page_desc *pd,
+		 void *buf)
+{
+	struct disk_dump_priv *ddp = ctx->shared->fmtdata;
+	struct cache_entry *ce;
+	cache_key_t key;
+	kdump_status ret;
+
+	key = shared_data_key(ddp, fidx, pd);
+	mutex_lock(&ddp->pd_lock);
+	ce = cache_get_entry(ddp->dedup_cache, key);
+	if (!ce) {
+		mutex_unlock(&ddp->pd_lock);
+		return read_page_data(ctx, fidx, pd, buf);
+	}
+	if (cache_entry_valid(ce)) {
+		memcpy(buf, ce->data, get_page_size(ctx));
+		cache_put_entry(ddp->dedup_cache, ce);
+		mutex_unlock(&ddp->pd_lock);
+		return KDUMP_OK;
+	}
+	mutex_unlock(&ddp->pd_lock);
+
+	ret = read_page_data(ctx, fidx, pd, buf);
+
+	mutex_lock(&ddp->pd_lock);
+	if (ret == KDUMP_OK) {
+		memcpy(ce->data, buf, get_page_size(ctx));
+		if (!ddp->zero_key && page_is_zero(buf, get_page_size(ctx)))
+			__atomic_store_n(&ddp->zero_key, key,
+					 __ATOMIC_RELAXED);
+		cache_insert(ddp->dedup_cache, ce);
+		cache_put_entry(ddp->dedup_cache, ce);
+	} else
+		cache_discard(ddp->dedup_cache, ce);
+	mutex_unlock(&ddp->pd_lock);
+	return ret;
+}
+
+static kdump_status
+diskdump_read_page(struct page_io *pio)
+{
+	kdump_ctx_t *ctx = pio->ctx;
+	struct disk_dump_priv *ddp = ctx->shared->fmtdata;
+	kdump_pfn_t pfn;
+	const struct pfn_file_map *pdmap;
+	struct page_desc pd;
+	off_t pd_pos;
+	kdump_status ret;
+
+	pfn = pio->addr.addr >> get_page_shift(ctx);
+	if (pfn >= get_max_pfn(ctx))
+		return set_error(ctx, KDUMP_ERR_NODATA, "Out-of-bounds PFN");
+
+	pdmap = find_pfn_file_map(ddp->pdmap, ddp->num_files, pfn);
+	pd_pos = pdmap && pdmap->start_pfn <= pfn
+		? pfn_to_pdpos(pdmap, pfn)
+		: (off_t) -1;
+	if (pd_pos == (off_t)-1) {
+		if (get_zero_excluded(ctx))
+			return get_zero_page(pio);
+		return set_error(ctx, KDUMP_ERR_NODATA, "Excluded page");
+	}
+
+	ret = get_page_desc(ctx, pdmap, pd_pos, &pd);
+	if (ret != KDUMP_OK)
+		return ret;
+
+	if (pd.flags & PD_ZERO)
+		return get_zero_page(pio);
+
+	return (pd.flags & PD_SHARED) && ddp->dedup_cache
+		? read_shared_page(ctx, pdmap->fidx, &pd, pio->chunk.data)
+		: read_page_data(ctx, pdmap->fidx, &pd, pio->chunk.data);
+}
+
+/** Check whether a page is excluded and read as zeroes.
+ * @param pio  Page I/O control.
+ * @returns    @c true if the page can be served from the zero page.
+ *
+ * This check does not need any page descriptor, so it is done before
+ * looking up the page in the cache. Pages whose data is shared with
+ * a known zero page are detected on a cache miss.
+ */
+static bool
+diskdump_excluded_zero(struct page_io *pio)
+{
+	kdump_ctx_t *ctx = pio->ctx;
+	struct disk_dump_priv *ddp = ctx->shared->fmtdata;
+	const struct pfn_file_map *pdmap;
+	kdump_pfn_t pfn;
+
+	if (!get_zero_excluded(ctx))
+		return false;
+
+	pfn = pio->addr.addr >> get_page_shift(ctx);
+	if (pfn >= get_max_pfn(ctx))
+		return false;
+
+	pdmap = find_pfn_file_map(ddp->pdmap, ddp->num_files, pfn);
+	return !pdmap || pdmap->start_pfn > pfn ||
+		pfn_to_pdpos(pdmap, pfn) == (off_t)-1;
+}
+
+/** Check whether a page shares its data with a known zero page.
+ * @param pio  Page I/O control.
+ * @returns    @c true if the page is known to contain only zeroes.
+ *
+ * This is called only for pages which are not in the cache. Errors
+ * are ignored here; they are reported when the page is read.
+ */
+static bool
+diskdump_zero_desc(struct page_io *pio)
+{
+	kdump_ctx_t *ctx = pio->ctx;
+	struct disk_dump_priv *ddp = ctx->shared->fmtdata;
+	const struct pfn_file_map *pdmap;
+	struct page_desc pd;
+	kdump_pfn_t pfn;
+	off_t pd_pos;
+
+	/* No need to look at the descriptor before a zero page is found. */
+	if (!__atomic_load_n(&ddp->zero_key, __ATOMIC_RELAXED))
+		return false;
+
+	pfn = pio->addr.addr >> get_page_shift(ctx);
+	if (pfn >= get_max_pfn(ctx))
+		return false;
+
+	pdmap = find_pfn_file_map(ddp->pdmap, ddp->num_files, pfn);
+	pd_pos = pdmap && pdmap->start_pfn <= pfn
+		? pfn_to_pdpos(pdmap, pfn)
+		: (off_t) -1;
+	if (pd_pos == (off_t)-1)
+		return false;
+
+	if (get_page_desc(ctx, pdmap, pd_pos, &pd) != KDUMP_OK) {
+		clear_error(ctx);
+		return false;
+	}
+	return pd.flags & PD_ZERO;
+}
+
 static kdump_status
 diskdump_get_page(struct page_io *pio)
 {
-	return cache_get_page(pio, diskdump_read_page);
+	if (diskdump_excluded_zero(pio))
+		return get_zero_page(pio);
+	return cache_get_page(pio, diskdump_read_page, diskdump_zero_desc);
+}
+
+static bool
+diskdump_next_pfn(kdump_ctx_t *ctx, kdump_pfn_t *pfn)
+{
+	struct disk_dump_priv *ddp = ctx->shared->fmtdata;
+	return find_mapped_pfn(ddp->pdmap, ddp->num_files, pfn);
 }
 
 /** Read VMCOREINFO into its blob attribute.
@@ -1030,9 +1368,31 @@ init_private(kdump_ctx_t *ctx)
 	if (!ddp)
 		return set_error(ctx, KDUMP_ERR_SYSTEM,
 				 "Cannot allocate diskdump private data");
-	ctx->shared->fmtdata = ddp;
 	ddp->num_files = get_num_files(ctx);
 
+	ddp->decomp_slot = decomp_alloc(ctx->shared);
+	if (ddp->decomp_slot < 0) {
+		free(ddp);
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot allocate decompression state");
+	}
+
+	ddp->pd_cache = cache_alloc(PD_CACHE_BLOCKS, PD_BLOCK_SIZE);
+	if (!ddp->pd_cache) {
+		per_ctx_free(ctx->shared, ddp->decomp_slot);
+		free(ddp);
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot allocate page descriptor cache");
+	}
+	if (mutex_init(&ddp->pd_lock, NULL)) {
+		cache_free(ddp->pd_cache);
+		per_ctx_free(ctx->shared, ddp->decomp_slot);
+		free(ddp);
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot initialize page descriptor lock");
+	}
+	ctx->shared->fmtdata = ddp;
+
 	return KDUMP_OK;
 }
 
@@ -1066,6 +1426,13 @@ open_common(kdump_ctx_t *ctx, void *hdr)
 
 	sort_pfn_file_maps(ddp->pdmap, ddp->num_files);
 
+	ddp->dedup_cache = cache_alloc(DEDUP_CACHE_PAGES, get_page_size(ctx));
+	if (!ddp->dedup_cache) {
+		ret = set_error(ctx, KDUMP_ERR_SYSTEM,
+				"Cannot allocate shared page cache");
+		goto err_cleanup;
+	}
+
 	bmp = kdump_bmp_new(&diskdump_bmp_ops);
 	if (!bmp) {
 		ret = set_error(ctx, KDUMP_ERR_SYSTEM,
@@ -1177,6 +1544,11 @@ diskdump_cleanup(struct kdump_shared *shared)
 			if (pdmap->regions)
 				free(pdmap->regions);
 		}
+		per_ctx_free(shared, ddp->decomp_slot);
+		mutex_destroy(&ddp->pd_lock);
+		cache_free(ddp->pd_cache);
+		if (ddp->dedup_cache)
+			cache_free(ddp->dedup_cache);
 		free(ddp);
 		shared->fmtdata = NULL;
 	}
@@ -1188,6 +1560,7 @@ const struct format_ops diskdump_ops = {
 	.get_page = diskdump_get_page,
 	.put_page = cache_put_page,
 	.realloc_caches = def_realloc_caches,
+	.next_pfn = diskdump_next_pfn,
 	.attr_cleanup = diskdump_attr_cleanup,
 	.cleanup = diskdump_cleanup,
 };
@@ -71,6 +71,26 @@ struct load_segment {
 	kdump_vaddr_t virt;
 };
 
+/** Search index for sorted LOAD segments.
+ * Element @c i of each array is the highest address covered by any
+ * of the segments @c 0 to @c i. These values never decrease, so the
+ * first segment which ends at or above a given address can be found
+ * with a binary search, even if the segments overlap.
+ */
+struct load_index {
+	kdump_addr_t *mem;	/**< Highest address in memory. */
+	kdump_addr_t *file;	/**< Highest file-backed address. */
+};
+
+/** Per-context LOAD segment lookup hint.
+ * Consecutive lookups usually hit the same segment. Keeping the hint
+ * per context avoids contention between threads.
+ */
+struct load_hint {
+	struct load_segment *last_load;	/**< Last physical lookup. */
+	struct load_segment *last_vload; /**< Last virtual lookup. */
+};
+
 struct section {
 	off_t file_offset;
 	uint64_t size;
@@ -119,11 +139,14 @@ struct elfdump_priv {
 
 	int num_load_sorted;
 	struct load_segment *load_sorted;
-	struct load_segment *last_load;
+	struct load_index load_index;
 
 	int num_load_vsorted;
 	struct load_segment *load_vsorted;
-	struct load_segment  *last_vload;
+	struct load_index load_vindex;
+
+	/** Per-context slot for @c struct @ref load_hint, or -1. */
+	int hint_slot;
 
 	int num_note_segments;
 	struct load_segment *note_segments;
@@ -146,6 +169,11 @@ struct elfdump_priv {
 
 	/** File offset of Xen page map (xc_core) */
 	off_t xen_map_offset;
+
+	/** Copy of the Xen page map in host byte order, or @c NULL.
+	 * This table is indexed by the page index in .xen_pages.
+	 */
+	struct xen_p2m *xen_p2m;
 };
 
 static void elf_cleanup(struct kdump_shared *shared);
@@ -194,116 +222,222 @@ mach2arch(unsigned mach, int elfclass)
 	}
 }
 
+/**  Get the lowest address of a LOAD segment.
+ * @param pls   LOAD segment.
+ * @param virt  @c true for virtual address, @c false for physical.
+ * @returns     Start address of @p pls.
+ */
+static inline kdump_addr_t
+seg_start(const struct load_segment *pls, bool virt)
+{
+	return virt ? pls->virt : pls->phys;
+}
+
+/**  Get the size of a LOAD segment.
+ * @param pls   LOAD segment.
+ * @param file  @c true for the file-backed size, @c false for memory.
+ * @returns     Size of @p pls.
+ */
+static inline kdump_addr_t
+seg_size(const struct load_segment *pls, bool file)
+{
+	return file ? pls->filesz : pls->memsz;
+}
+
+/**  Build a search index for sorted LOAD segments.
+ * @param idx   Search index (arrays must be allocated by the caller).
+ * @param segs  LOAD segments, sorted by start address.
+ * @param n     Number of segments in @p segs.
+ * @param virt  @c true if @p segs are sorted by virtual address.
+ */
+static void
+load_index_init(struct load_index *idx, const struct load_segment *segs,
+		int n, bool virt)
+{
+	kdump_addr_t memlast = 0, filelast = 0;
+	kdump_addr_t start;
+	int i;
+
+	for (i = 0; i < n; ++i) {
+		start = seg_start(&segs[i], virt);
+		if (segs[i].memsz && memlast < start + segs[i].memsz - 1)
+			memlast = start + segs[i].memsz - 1;
+		if (segs[i].filesz && filelast < start + segs[i].filesz - 1)
+			filelast = start + segs[i].filesz - 1;
+		idx->mem[i] = memlast;
+		idx->file[i] = filelast;
+	}
+}
+
+/**  Find the LOAD segment that is closest to an address.
+ * @param segs  LOAD segments, sorted by start address.
+ * @param idx   Search index for @p segs.
+ * @param n     Number of segments in @p segs.
+ * @param addr  Requested address.
+ * @param dist  Maximum allowed distance from @c addr.
+ * @param virt  @c true if @p addr is a virtual address.
+ * @param file  @c true to search only the file-backed part of segments.
+ * @returns     Pointer to the closest LOAD segment, or @c NULL if none.
+ *
+ * This is the first segment which ends at or above @p addr.
+ */
+static struct load_segment *
+find_closest_load(struct load_segment *segs, const struct load_index *idx,
+		  int n, kdump_addr_t addr, unsigned long dist,
+		  bool virt, bool file)
+{
+	const kdump_addr_t *last = file ? idx->file : idx->mem;
+	struct load_segment *pls;
+	kdump_addr_t start, size;
+	int lo, hi, mid;
+
+	lo = 0;
+	hi = n;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (last[mid] < addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* Skip empty segments if @c addr is zero. */
+	for ( ; lo < n; ++lo) {
+		pls = &segs[lo];
+		start = seg_start(pls, virt);
+		size = seg_size(pls, file);
+		if (size && addr <= start + size - 1) {
+			if (addr < start && start - addr > dist)
+				break;
+			return pls;
+		}
+	}
+	return NULL;
+}
+
+/**  Check whether a LOAD segment contains an address.
+ * @param pls   LOAD segment, or @c NULL.
+ * @param addr  Address.
+ * @param virt  @c true if @p addr is a virtual address.
+ * @param file  @c true to check only the file-backed part of @p pls.
+ * @returns     @c true if @p pls contains @p addr.
+ */
+static inline bool
+load_contains(const struct load_segment *pls, kdump_addr_t addr,
+	      bool virt, bool file)
+{
+	return pls &&
+		addr >= seg_start(pls, virt) &&
+		addr - seg_start(pls, virt) < seg_size(pls, file);
+}
+
 /**  Find the LOAD segment that is closest to a physical address.
  * @param edp	 ELF dump private data.
+ * @param hint	 Per-context lookup hint, or @c NULL.
  * @param paddr	 Requested physical address.
  * @param dist	 Maximum allowed distance from @c paddr.
  * @returns	 Pointer to the closest LOAD segment, or @c NULL if none.
  */
 static struct load_segment *
-find_closest_mem_load(struct elfdump_priv *edp, kdump_paddr_t paddr,
-		      unsigned long dist)
+find_closest_mem_load(struct elfdump_priv *edp, struct load_hint *hint,
+		      kdump_paddr_t paddr, unsigned long dist)
 {
-	int i;
+	struct load_segment *pls;
 
-	if (edp->last_load &&
-	    paddr >= edp->last_load->phys &&
-	    paddr - edp->last_load->phys < edp->last_load->memsz)
-		return edp->last_load;
+	if (hint && load_contains(hint->last_load, paddr, false, false))
+		return hint->last_load;
 
-	for (i = 0; i < edp->num_load_sorted; i++) {
-		struct load_segment *pls = &edp->load_sorted[i];
-		if (pls->memsz && paddr <= pls->phys + pls->memsz - 1) {
-			if (paddr < pls->phys && pls->phys - paddr > dist)
-				break;
-			return edp->last_load = pls;
-		}
-	}
-	return NULL;
+	pls = find_closest_load(edp->load_sorted, &edp->load_index,
+				edp->num_load_sorted, paddr, dist,
+				false, false);
+	if (pls && hint)
+		hint->last_load = pls;
+	return pls;
 }
 
 /**  Find the file-backed LOAD segment that is closest to a physical address.
  * @param edp	 ELF dump private data.
+ * @param hint	 Per-context lookup hint, or @c NULL.
  * @param paddr	 Requested physical address.
  * @param dist	 Maximum allowed distance from @c paddr.
  * @returns	 Pointer to the closest LOAD segment, or @c NULL if none.
  */
 static struct load_segment *
-find_closest_file_load(struct elfdump_priv *edp, kdump_paddr_t paddr,
-		       unsigned long dist)
+find_closest_file_load(struct elfdump_priv *edp, struct load_hint *hint,
+		       kdump_paddr_t paddr, unsigned long dist)
 {
-	int i;
+	struct load_segment *pls;
 
-	if (edp->last_load &&
-	    paddr >= edp->last_load->phys &&
-	    paddr - edp->last_load->phys < edp->last_load->filesz)
-		return edp->last_load;
+	if (hint && load_contains(hint->last_load, paddr, false, true))
+		return hint->last_load;
 
-	for (i = 0; i < edp->num_load_sorted; i++) {
-		struct load_segment *pls = &edp->load_sorted[i];
-		if (pls->filesz && paddr <= pls->phys + pls->filesz - 1) {
-			if (paddr < pls->phys && pls->phys - paddr > dist)
-				break;
-			return edp->last_load = pls;
-		}
-	}
-	return NULL;
+	pls = find_closest_load(edp->load_sorted, &edp->load_index,
+				edp->num_load_sorted, paddr, dist,
+				false, true);
+	if (pls && hint)
+		hint->last_load = pls;
+	return pls;
 }
 
 /**  Find the LOAD segment that is closest to a virtual address.
  * @param edp	 ELF dump private data.
+ * @param hint	 Per-context lookup hint, or @c NULL.
  * @param vaddr	 Requested virtual address.
  * @param dist	 Maximum allowed distance from @c vaddr.
  * @returns	 Pointer to the closest LOAD segment, or @c NULL if none.
  */
 static struct load_segment *
-find_closest_mem_vload(struct elfdump_priv *edp, kdump_vaddr_t vaddr,
-		       unsigned long dist)
+find_closest_mem_vload(struct elfdump_priv *edp, struct load_hint *hint,
+		       kdump_vaddr_t vaddr, unsigned long dist)
 {
-	int i;
+	struct load_segment *pls;
 
-	if (edp->last_vload &&
-	    vaddr >= edp->last_vload->virt &&
-	    vaddr - edp->last_vload->virt < edp->last_vload->memsz)
-		return edp->last_vload;
+	if (hint && load_contains(hint->last_vload, vaddr, true, false))
+		return hint->last_vload;
 
-	for (i = 0; i < edp->num_load_vsorted; i++) {
-		struct load_segment *pls = &edp->load_vsorted[i];
-		if (pls->memsz && vaddr <= pls->virt + pls->memsz - 1) {
-			if (vaddr < pls->virt && pls->virt - vaddr > dist)
-				break;
-			return edp->last_load = pls;
-		}
-	}
-	return NULL;
+	pls = find_closest_load(edp->load_vsorted, &edp->load_vindex,
+				edp->num_load_vsorted, vaddr, dist,
+				true, false);
+	if (pls && hint)
+		hint->last_vload = pls;
+	return pls;
 }
 
 /**  Find the file-backed LOAD segment that is closest to a virtual address.
  * @param edp	 ELF dump private data.
+ * @param hint	 Per-context lookup hint, or @c NULL.
  * @param vaddr	 Requested virtual address.
  * @param dist	 Maximum allowed distance from @c vaddr.
  * @returns	 Pointer to the closest LOAD segment, or @c NULL if none.
  */
 static struct load_segment *
-find_closest_file_vload(struct elfdump_priv *edp, kdump_vaddr_t vaddr,
-			unsigned long dist)
+find_closest_file_vload(struct elfdump_priv *edp, struct load_hint *hint,
+			kdump_vaddr_t vaddr, unsigned long dist)
 {
-	int i;
+	struct load_segment *pls;
 
-	if (edp->last_vload &&
-	    vaddr >= edp->last_vload->virt &&
-	    vaddr - edp->last_vload->virt < edp->last_vload->filesz)
-		return edp->last_vload;
+	if (hint && load_contains(hint->last_vload, vaddr, true, true))
+		return hint->last_vload;
 
-	for (i = 0; i < edp->num_load_vsorted; i++) {
-		struct load_segment *pls = &edp->load_vsorted[i];
-		if (pls->filesz && vaddr <= pls->virt + pls->filesz - 1) {
-			if (vaddr < pls->virt && pls->virt - vaddr > dist)
-				break;
-			return edp->last_load = pls;
-		}
-	}
-	return NULL;
+	pls = find_closest_load(edp->load_vsorted, &edp->load_vindex,
+				edp->num_load_vsorted, vaddr, dist,
+				true, true);
+	if (pls && hint)
+		hint->last_vload = pls;
+	return pls;
+}
+
+/**  Get the per-context LOAD segment lookup hint.
+ * @param ctx  Dump file object.
+ * @returns    Lookup hint, or @c NULL if not available.
+ */
+static inline struct load_hint *
+get_load_hint(kdump_ctx_t *ctx)
+{
+	struct elfdump_priv *edp = ctx->shared->fmtdata;
+	return edp->hint_slot >= 0
+		? ctx->data[edp->hint_slot]
+		: NULL;
 }
 
 static kdump_status
@@ -311,23 +445,23 @@ elf_read_page(struct page_io *pio)
 {
 	kdump_ctx_t *ctx = pio->ctx;
 	struct elfdump_priv *edp = ctx->shared->fmtdata;
+	struct load_hint *hint = get_load_hint(ctx);
 	kdump_addr_t addr;
 	struct load_segment *pls;
 	kdump_addr_t loadaddr;
 	void *p, *endp;
 	off_t pos;
 	size_t size;
+	uint64_t start;
 	kdump_status status;
 
-	mutex_lock(&ctx->shared->cache_lock);
-
 	addr = pio->addr.addr;
 	p = pio->chunk.data;
 	endp = p + get_page_size(ctx);
 	while (p < endp) {
 		pls = (pio->addr.as == ADDRXLAT_KVADDR
-		       ? find_closest_mem_vload(edp, addr, endp - p)
-		       : find_closest_mem_load(edp, addr, endp - p));
+		       ? find_closest_mem_vload(edp, hint, addr, endp - p)
+		       : find_closest_mem_load(edp, hint, addr, endp - p));
 		if (!pls) {
 			memset(p, 0, endp - p);
 			break;
@@ -348,8 +482,10 @@ elf_read_page(struct page_io *pio)
 			if (size > loadaddr + pls->filesz - addr)
 				size = loadaddr + pls->filesz - addr;
 
+			start = stats_start(ctx->shared);
 			status = flatmap_pread(ctx->shared->flatmap, p, size,
 					       0, pos);
+			stats_end(ctx->shared, STAGE_io, start);
 			if (status != KDUMP_OK)
 				goto err_read;
 			p += size;
@@ -365,11 +501,9 @@ elf_read_page(struct page_io *pio)
 		}
 	}
 
-	mutex_unlock(&ctx->shared->cache_lock);
 	return KDUMP_OK;
 
  err_read:
-	mutex_unlock(&ctx->shared->cache_lock);
 	return set_read_error(ctx, status, "page data", pos);
 }
 
@@ -378,19 +512,21 @@ elf_get_page(struct page_io *pio)
 {
 	kdump_ctx_t *ctx = pio->ctx;
 	struct elfdump_priv *edp = ctx->shared->fmtdata;
+	struct load_hint *hint = get_load_hint(ctx);
 	struct load_segment *pls;
 	kdump_paddr_t addr, loadaddr;
 	size_t sz;
+	uint64_t start;
 	kdump_status status;
 
 	sz = get_page_size(ctx);
 	pls = pio->addr.as == ADDRXLAT_KVADDR
 		? (get_zero_excluded(ctx)
-		   ? find_closest_mem_vload(edp, pio->addr.addr, sz)
-		   : find_closest_file_vload(edp, pio->addr.addr, sz))
+		   ? find_closest_mem_vload(edp, hint, pio->addr.addr, sz)
+		   : find_closest_file_vload(edp, hint, pio->addr.addr, sz))
 		: (get_zero_excluded(ctx)
-		   ? find_closest_mem_load(edp, pio->addr.addr, sz)
-		   : find_closest_file_load(edp, pio->addr.addr, sz));
+		   ? find_closest_mem_load(edp, hint, pio->addr.addr, sz)
+		   : find_closest_file_load(edp, hint, pio->addr.addr, sz));
 	if (!pls && pio->addr.as == ADDRXLAT_KVADDR) {
 		addrxlat_status status;
 		kdump_status ret;
@@ -405,7 +541,7 @@ elf_get_page(struct page_io *pio)
 		if (status != ADDRXLAT_OK)
 			return addrxlat2kdump(ctx, status);
 
-		pls = find_closest_mem_load(edp, pio->addr.addr, sz);
+		pls = find_closest_mem_load(edp, hint, pio->addr.addr, sz);
 	}
 	if (!pls)
 		return set_error(ctx, KDUMP_ERR_NODATA, "Page not found");
@@ -415,14 +551,20 @@ elf_get_page(struct page_io *pio)
 		    ? pls->virt
 		    : pls->phys);
 
+	/* Pages beyond the file-backed part of a LOAD are all zeroes. */
+	if (loadaddr <= addr && addr - loadaddr >= pls->filesz &&
+	    addr - loadaddr < pls->memsz &&
+	    pls->memsz - (addr - loadaddr) >= sz)
+		return get_zero_page(pio);
+
 	/* Handle reads crossing a LOAD boundary. */
 	if (! (loadaddr <= addr && pls->filesz >= addr - loadaddr + sz))
-		return cache_get_page(pio, elf_read_page);
+		return cache_get_page(pio, elf_read_page, NULL);
 
-	mutex_lock(&ctx->shared->cache_lock);
+	start = stats_start(ctx->shared);
 	status = flatmap_get_chunk(ctx->shared->flatmap, &pio->chunk, sz,
 				   0, pls->file_offset + addr - loadaddr);
-	mutex_unlock(&ctx->shared->cache_lock);
+	stats_end(ctx->shared, STAGE_io, start);
 	return status;
 }
 
@@ -438,8 +580,8 @@ elf_get_bits(struct kdump_shared *shared,
 	cur = pfn_to_addr(shared, first);
 	next = pfn_to_addr(shared, last - first  + 1);
 	pls = ismem
-		? find_closest_mem_load(edp, cur, next)
-		: find_closest_file_load(edp, cur, next);
+		? find_closest_mem_load(edp, NULL, cur, next)
+		: find_closest_file_load(edp, NULL, cur, next);
 	if (!pls) {
 		memset(bits, 0, ((last - first) >> 3) + 1);
 		return;
@@ -505,9 +647,9 @@ elf_find_set(kdump_errmsg_t *err, struct kdump_shared *shared,
 	kdump_paddr_t pfn;
 
 	pls = ismem
-		? find_closest_mem_load(edp, pfn_to_addr(shared, *idx),
+		? find_closest_mem_load(edp, NULL, pfn_to_addr(shared, *idx),
 					KDUMP_ADDR_MAX)
-		: find_closest_file_load(edp, pfn_to_addr(shared, *idx),
+		: find_closest_file_load(edp, NULL, pfn_to_addr(shared, *idx),
 					 KDUMP_ADDR_MAX);
 	if (!pls)
 		return status_err(err, KDUMP_ERR_NODATA,
@@ -552,9 +694,9 @@ elf_find_clear(kdump_errmsg_t *err, struct kdump_shared *shared,
 	const struct load_segment *pls;
 
 	pls = ismem
-		? find_closest_mem_load(edp, pfn_to_addr(shared, *idx),
+		? find_closest_mem_load(edp, NULL, pfn_to_addr(shared, *idx),
 					KDUMP_ADDR_MAX)
-		: find_closest_file_load(edp, pfn_to_addr(shared, *idx),
+		: find_closest_file_load(edp, NULL, pfn_to_addr(shared, *idx),
 					 KDUMP_ADDR_MAX);
 	if (!pls)
 		return;
@@ -722,28 +864,70 @@ pfn2idx_map_end(struct pfn2idx_map *map, struct pfn2idx_range *range)
 	return KDUMP_OK;
 }
 
+/** Get the lowest PFN in a PFN-to-index range.
+ * @param r  PFN-to-index range.
+ * @returns  Lowest PFN in @p r.
+ */
+static inline kdump_pfn_t
+pfn2idx_range_first(const struct pfn2idx_range *r)
+{
+	return r->len >= 0 ? r->pfn - r->len + 1 : r->pfn;
+}
+
+/** Get the highest PFN in a PFN-to-index range.
+ * @param r  PFN-to-index range.
+ * @returns  Highest PFN in @p r.
+ */
+static inline kdump_pfn_t
+pfn2idx_range_last(const struct pfn2idx_range *r)
+{
+	return r->len >= 0 ? r->pfn : r->pfn - r->len - 1;
+}
+
+/** Translate a PFN to a page index.
+ * @param map  PFN-to-index map.
+ * @param pfn  PFN to be translated.
+ * @returns    Page index, or @ref IDX_NONE if not found.
+ *
+ * Both ranges and single pages are sorted by @ref pfn2idx_map_end,
+ * and they do not overlap, so they can be searched with a binary
+ * search.
+ */
 static uint_fast64_t
-pfn2idx_map_search(struct pfn2idx_map *map, kdump_pfn_t pfn)
+pfn2idx_map_search(const struct pfn2idx_map *map, kdump_pfn_t pfn)
 {
-	size_t i;
-	for (i = 0; i < map->nranges; ++i) {
-		struct pfn2idx_range *r = &map->ranges[i];
-		if (r->len >= 0) {
-			if (pfn < r->pfn - r->len + 1)
-				break;
-			if (pfn <= r->pfn)
-				return r->idx + pfn - r->pfn;
-		} else {
-			if (pfn < r->pfn)
-				break;
-			if (pfn <= r->pfn - r->len - 1)
-				return r->idx + r->pfn - pfn;
-		}
+	const struct pfn2idx_range *r;
+	size_t lo, hi, mid;
+
+	/* Find the first range which ends at or above @p pfn. */
+	lo = 0;
+	hi = map->nranges;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (pfn2idx_range_last(&map->ranges[mid]) < pfn)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < map->nranges) {
+		r = &map->ranges[lo];
+		if (pfn >= pfn2idx_range_first(r))
+			return r->len >= 0
+				? r->idx + pfn - r->pfn
+				: r->idx + r->pfn - pfn;
 	}
 
-	for (i = 0; i < map->nsingles && pfn >= map->singles[i].pfn; ++i)
-		if (map->singles[i].pfn == pfn)
-			return map->singles[i].idx;
+	lo = 0;
+	hi = map->nsingles;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (map->singles[mid].pfn < pfn)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < map->nsingles && map->singles[lo].pfn == pfn)
+		return map->singles[lo].idx;
 
 	return IDX_NONE;
 }
@@ -813,8 +997,9 @@ make_xen_pfn_map_nonauto(kdump_ctx_t *ctx, const struct section *sect)
 {
 	struct elfdump_priv *edp = ctx->shared->fmtdata;
 	kdump_pfn_t max_pfn = 0;
-	struct xen_p2m p2m;
+	struct xen_p2m p2m, *p2mp;
 	struct pfn2idx_range pfnrange, mfnrange;
+	struct attr_data *attr;
 	off_t pos, endpos;
 	struct fcache_entry fce;
 	kdump_status status;
@@ -822,6 +1007,16 @@ make_xen_pfn_map_nonauto(kdump_ctx_t *ctx, const struct section *sect)
 	pfn2idx_map_start(&edp->xen_pfnmap, &pfnrange);
 	pfn2idx_map_start(&edp->xen_mfnmap, &mfnrange);
 
+	attr = gattr(ctx, GKI_xen_p2m_preload);
+	if (attr_isset(attr) && attr_value(attr)->number &&
+	    sect->size >= sizeof p2m) {
+		edp->xen_p2m = ctx_malloc(sect->size / sizeof p2m * sizeof p2m,
+					  ctx, "Xen p2m table");
+		if (!edp->xen_p2m)
+			return KDUMP_ERR_SYSTEM;
+	}
+	p2mp = edp->xen_p2m;
+
 	pos = edp->xen_map_offset = sect->file_offset;
 	endpos = pos + sect->size - sizeof p2m;
 	fce.len = 0;
@@ -846,6 +1041,8 @@ make_xen_pfn_map_nonauto(kdump_ctx_t *ctx, const struct section *sect)
 		status = pfn2idx_map_add(&edp->xen_mfnmap, &mfnrange, p2m.gmfn);
 		if (status != KDUMP_OK)
 			goto err_mfn;
+		if (p2mp)
+			*p2mp++ = p2m;
 
 		fce.data += sizeof p2m;
 		fce.len -= sizeof p2m;
@@ -891,6 +1088,43 @@ addrxlat_read_error(addrxlat_ctx_t *ctx, const char *what, off_t offset)
 				what, (unsigned long long) offset);
 }
 
+/** Get a Xen page map entry.
+ * @param shared  Dump file shared data.
+ * @param idx     Page index in .xen_pages.
+ * @param p2m     Map entry (in host byte order), filled in on success.
+ * @returns       Error status.
+ *
+ * If the page map has been loaded into memory, this function needs
+ * no I/O and no locking. Otherwise, the entry is read from the file.
+ */
+static kdump_status
+xen_p2m_entry(struct kdump_shared *shared, uint_fast64_t idx,
+	      struct xen_p2m *p2m)
+{
+	struct elfdump_priv *edp = shared->fmtdata;
+	kdump_status status;
+	off_t pos;
+
+	if (edp->xen_p2m) {
+		*p2m = edp->xen_p2m[idx];
+		return KDUMP_OK;
+	}
+
+	pos = edp->xen_map_offset + idx * sizeof(struct xen_p2m);
+	status = flatmap_pread(shared->flatmap, p2m, sizeof *p2m, 0, pos);
+	if (status != KDUMP_OK)
+		return status;
+
+	if (sget_byte_order(shared) == KDUMP_BIG_ENDIAN) {
+		p2m->pfn = be64toh(p2m->pfn);
+		p2m->gmfn = be64toh(p2m->gmfn);
+	} else {
+		p2m->pfn = le64toh(p2m->pfn);
+		p2m->gmfn = le64toh(p2m->gmfn);
+	}
+	return KDUMP_OK;
+}
+
 /** xc_core physical-to-machine first step function.
  * @param step  Step state.
  * @param addr  Address to be translated.
@@ -904,7 +1138,6 @@ xc_p2m_first_step(addrxlat_step_t *step, addrxlat_addr_t addr)
 	struct elfdump_priv *edp = shared->fmtdata;
 	struct xen_p2m p2m;
 	uint_fast64_t idx;
-	off_t pos;
 	kdump_status status;
 
 	idx = pfn2idx_map_search(&edp->xen_pfnmap,
@@ -913,12 +1146,11 @@ xc_p2m_first_step(addrxlat_step_t *step, addrxlat_addr_t addr)
 		return addrxlat_ctx_err(step->ctx, ADDRXLAT_ERR_NODATA,
 					"PFN not found");
 
-	pos = edp->xen_map_offset + idx * sizeof(struct xen_p2m);
-	mutex_lock(&shared->cache_lock);
-	status = flatmap_pread(shared->flatmap, &p2m, sizeof p2m, 0, pos);
-	mutex_unlock(&shared->cache_lock);
+	status = xen_p2m_entry(shared, idx, &p2m);
 	if (status != KDUMP_OK)
-		return addrxlat_read_error(step->ctx, "p2m entry", pos);
+		return addrxlat_read_error(step->ctx, "p2m entry",
+					   edp->xen_map_offset +
+					   idx * sizeof(struct xen_p2m));
 
 	step->base.addr = p2m.gmfn << shared->page_shift.number;
 	step->idx[0] = addr & (shared->page_size.number - 1);
@@ -940,7 +1172,6 @@ xc_m2p_first_step(addrxlat_step_t *step, addrxlat_addr_t addr)
 	struct elfdump_priv *edp = shared->fmtdata;
 	struct xen_p2m p2m;
 	uint_fast64_t idx;
-	off_t pos;
 	kdump_status status;
 
 	idx = pfn2idx_map_search(&edp->xen_mfnmap,
@@ -949,12 +1180,11 @@ xc_m2p_first_step(addrxlat_step_t *step, addrxlat_addr_t addr)
 		return addrxlat_ctx_err(step->ctx, ADDRXLAT_ERR_NODATA,
 					"MFN not found");
 
-	pos = edp->xen_map_offset + idx * sizeof(struct xen_p2m);
-	mutex_lock(&shared->cache_lock);
-	status = flatmap_pread(shared->flatmap, &p2m, sizeof p2m, 0, pos);
-	mutex_unlock(&shared->cache_lock);
+	status = xen_p2m_entry(shared, idx, &p2m);
 	if (status != KDUMP_OK)
-		return addrxlat_read_error(step->ctx, "m2p entry", pos);
+		return addrxlat_read_error(step->ctx, "m2p entry",
+					   edp->xen_map_offset +
+					   idx * sizeof(struct xen_p2m));
 
 	step->base.addr = p2m.pfn << shared->page_shift.number;
 	step->idx[0] = addr & (shared->page_size.number - 1);
@@ -1042,6 +1272,7 @@ xc_get_page(struct page_io *pio)
 	kdump_pfn_t pfn = pio->addr.addr >> get_page_shift(ctx);
 	uint_fast64_t idx;
 	off_t offset;
+	uint64_t start;
 	kdump_status status;
 
 	idx = ( (get_xen_xlat(ctx) == KDUMP_XEN_NONAUTO &&
@@ -1053,10 +1284,10 @@ xc_get_page(struct page_io *pio)
 
 	offset = edp->xen_pages_offset + ((off_t)idx << get_page_shift(ctx));
 
-	mutex_lock(&ctx->shared->cache_lock);
+	start = stats_start(ctx->shared);
 	status = flatmap_get_chunk(ctx->shared->flatmap, &pio->chunk,
 				   get_page_size(ctx), 0, offset);
-	mutex_unlock(&ctx->shared->cache_lock);
+	stats_end(ctx->shared, STAGE_io, start);
 	return status;
 }
 
@@ -1400,7 +1631,7 @@ static int
 seg_virt_cmp(const void *a, const void *b)
 {
 	const struct load_segment *la = a, *lb = b;
-	return la->phys != lb->phys ? (la->phys < lb->phys ? -1 : 1) : 0;
+	return la->virt != lb->virt ? (la->virt < lb->virt ? -1 : 1) : 0;
 }
 
 static kdump_status
@@ -1508,6 +1739,24 @@ open_common(kdump_ctx_t *ctx)
 	qsort(edp->load_vsorted, edp->num_load_segments,
 	      sizeof(struct load_segment), seg_virt_cmp);
 
+	/* Build search indices. */
+	edp->load_index.mem = ctx_malloc(
+		2 * (edp->num_load_sorted + edp->num_load_vsorted) *
+		sizeof(kdump_addr_t), ctx, "LOAD segment index");
+	if (!edp->load_index.mem)
+		return KDUMP_ERR_SYSTEM;
+	edp->load_index.file = edp->load_index.mem + edp->num_load_sorted;
+	edp->load_vindex.mem = edp->load_index.file + edp->num_load_sorted;
+	edp->load_vindex.file = edp->load_vindex.mem + edp->num_load_vsorted;
+	load_index_init(&edp->load_index, edp->load_sorted,
+			edp->num_load_sorted, false);
+	load_index_init(&edp->load_vindex, edp->load_vsorted,
+			edp->num_load_vsorted, true);
+
+	/* Lookups work without a hint, so ignore failures here. */
+	edp->hint_slot = per_ctx_alloc(ctx->shared, sizeof(struct load_hint),
+				       NULL);
+
 	free(edp->load_segments);
 	edp->load_segments = edp->note_segments = NULL;
 
@@ -1643,6 +1892,7 @@ elf_probe(kdump_ctx_t *ctx)
 		return set_error(ctx, KDUMP_ERR_SYSTEM,
 				 "Cannot allocate ELF dump private data");
 	ctx->shared->fmtdata = edp;
+	edp->hint_slot = -1;
 
 	ret = flatmap_get_chunk(ctx->shared->flatmap, &fch, sizeof(Elf64_Ehdr),
 				0, 0);
@@ -1667,8 +1917,11 @@ elf_cleanup(struct kdump_shared *shared)
 	struct elfdump_priv *edp = shared->fmtdata;
 
 	if (edp) {
+		if (edp->hint_slot >= 0)
+			per_ctx_free(shared, edp->hint_slot);
 		if (edp->load_sorted)
 			free(edp->load_sorted);
+		free(edp->load_index.mem);
 		if (edp->load_segments)
 			free(edp->load_segments);
 		if (edp->sections)
@@ -1677,6 +1930,7 @@ elf_cleanup(struct kdump_shared *shared)
 			free(edp->strtab);
 		pfn2idx_map_free(&edp->xen_pfnmap);
 		pfn2idx_map_free(&edp->xen_mfnmap);
+		free(edp->xen_p2m);
 		free(edp);
 		shared->fmtdata = NULL;
 	}
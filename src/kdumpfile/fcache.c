@@ -34,11 +34,18 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
 
+/** Number of io_uring submission queue entries. */
+#define FCACHE_URING_ENTRIES	64
+
+/** Maximum number of blocks read in one batch. */
+#define FCACHE_BATCH		16
+
 /** Destructor for mmapped cache entries.
  * @param ce  Cache entry.
  */
@@ -77,13 +84,19 @@ fcache_new(unsigned nfds, const int *fd, unsigned n, unsigned order)
 		return fc;
 
 	fc->refcnt = 1;
+	fc->uring = NULL;
+	fc->sequential = false;
+	fc->nfds = nfds;
 	fc->mmap_policy.number = KDUMP_MMAP_TRY;
 	fc->pgsz = pgsz;
 	fc->mmapsz = fc->pgsz << order;
 
+	if (mutex_init(&fc->lock, NULL))
+		goto err;
+
 	fc->cache = cache_alloc(n, 0);
 	if (!fc->cache)
-		goto err;
+		goto err_lock;
 	set_cache_entry_cleanup(fc->cache, unmap_entry, fc);
 
 	fc->fbcache = cache_alloc(n, fc->pgsz);
@@ -96,12 +109,15 @@ fcache_new(unsigned nfds, const int *fd, unsigned n, unsigned order)
 			fstat(fd[i], &st) == 0 && S_ISREG(st.st_mode)
 			? st.st_size
 			: ((unsigned long long) ~(off_t)0) >> 1);
+		fc->info[i].map = NULL;
 	}
 
 	return fc;
 
  err_cache:
 	cache_free(fc->cache);
+ err_lock:
+	mutex_destroy(&fc->lock);
  err:
 	free(fc);
 	return NULL;
@@ -113,11 +129,176 @@ fcache_new(unsigned nfds, const int *fd, unsigned n, unsigned order)
 void
 fcache_free(struct fcache *fc)
 {
+	unsigned i;
+
+	for (i = 0; i < fc->nfds; ++i)
+		if (fc->info[i].map && fc->info[i].map != MAP_FAILED)
+			munmap(fc->info[i].map, fc->info[i].filesz);
+	if (fc->uring)
+		uring_free(fc->uring);
 	cache_free(fc->fbcache);
 	cache_free(fc->cache);
+	mutex_destroy(&fc->lock);
 	free(fc);
 }
 
+/** Select the I/O engine for reads.
+ * @param fc      File cache object.
+ * @param enable  Use io_uring if @c true, pread(2) otherwise.
+ * @returns       Zero on success, -1 on failure (with @c errno set).
+ *
+ * If io_uring cannot be set up, pread(2) is used for all reads.
+ * No reads may be in progress when this function is called.
+ */
+int
+fcache_use_uring(struct fcache *fc, bool enable)
+{
+	if (!enable) {
+		if (fc->uring)
+			uring_free(fc->uring);
+		fc->uring = NULL;
+		return 0;
+	}
+
+	if (!fc->uring)
+		fc->uring = uring_new(FCACHE_URING_ENTRIES);
+	return fc->uring ? 0 : -1;
+}
+
+/** Set the expected access pattern of whole-file maps.
+ * @param fc          File cache object.
+ * @param sequential  @c true if data is read mostly sequentially.
+ *
+ * The hint is applied to files which are already mapped, and it is
+ * remembered for files which are mapped later.
+ */
+void
+fcache_advise(struct fcache *fc, bool sequential)
+{
+	int advice = sequential ? MADV_SEQUENTIAL : MADV_RANDOM;
+	unsigned i;
+
+	mutex_lock(&fc->lock);
+	fc->sequential = sequential;
+	for (i = 0; i < fc->nfds; ++i)
+		if (fc->info[i].map && fc->info[i].map != MAP_FAILED)
+			madvise(fc->info[i].map, fc->info[i].filesz, advice);
+	mutex_unlock(&fc->lock);
+}
+
+/** Get the mapping of a whole file.
+ * @param fc    File cache object.
+ * @param fidx  Index of the file.
+ * @returns     Address of the mapping, or @c NULL if not available.
+ *
+ * The file is mapped on first use. Once the mapping is published,
+ * it stays valid until the file cache is freed, so no lock is needed
+ * to access it.
+ */
+static void *
+get_whole_map(struct fcache *fc, unsigned fidx)
+{
+	struct fcache_fileinfo *info = &fc->info[fidx];
+	void *map;
+
+	map = __atomic_load_n(&info->map, __ATOMIC_ACQUIRE);
+	if (map)
+		return map != MAP_FAILED ? map : NULL;
+
+	mutex_lock(&fc->lock);
+	map = info->map;
+	if (!map) {
+		/* Only 64-bit hosts have enough address space. */
+		if (sizeof(void *) >= 8 && info->filesz > 0)
+			map = mmap(NULL, info->filesz, PROT_READ,
+				   MAP_SHARED, info->fd, 0);
+		else
+			map = MAP_FAILED;
+		if (map != MAP_FAILED)
+			madvise(map, info->filesz, fc->sequential
+				? MADV_SEQUENTIAL : MADV_RANDOM);
+		__atomic_store_n(&info->map, map, __ATOMIC_RELEASE);
+	}
+	mutex_unlock(&fc->lock);
+
+	return map != MAP_FAILED ? map : NULL;
+}
+
+/** Get file cache content from a whole-file mapping.
+ * @param fc   File cache object.
+ * @param fce  File cache entry, updated on success.
+ * @param fidx Index of the file to read from.
+ * @param pos  File position.
+ * @returns    Error status.
+ *
+ * The returned entry is not reference-counted, so it is not necessary
+ * (but allowed) to release it with @ref fcache_put. Data beyond the
+ * end of file is returned as zeroes up to the next page boundary,
+ * like with the other read methods.
+ */
+static kdump_status
+fcache_get_whole(struct fcache *fc, struct fcache_entry *fce,
+		 unsigned fidx, off_t pos)
+{
+	off_t end;
+	void *map;
+
+	map = get_whole_map(fc, fidx);
+	if (!map)
+		return KDUMP_ERR_NOTIMPL;
+	if (pos < 0 || pos >= fc->info[fidx].filesz)
+		return KDUMP_ERR_NODATA;
+
+	end = (fc->info[fidx].filesz + fc->pgsz - 1) &
+		~(off_t)(fc->pgsz - 1);
+	fce->data = map + pos;
+	fce->len = end - pos;
+	fce->ce = NULL;
+	fce->cache = NULL;
+	return KDUMP_OK;
+}
+
+/** Initialize a read request for a file cache entry.
+ * @param fc    File cache object.
+ * @param fidx  Index of the file to read from.
+ * @param ce    Cache entry (not yet valid).
+ * @param pos   File position of the block.
+ * @param req   Read request, initialized by this function.
+ */
+static void
+init_read_req(struct fcache *fc, unsigned fidx,
+	      struct cache_entry *ce, off_t pos, struct uring_req *req)
+{
+	req->fd = fc->info[fidx].fd;
+	req->buf = ce->data;
+	req->len = fc->pgsz;
+	req->pos = pos;
+}
+
+/** Finish reading a block into a file cache entry.
+ * @param fc   File cache object.
+ * @param ce   Cache entry.
+ * @param req  Completed read request.
+ * @returns    Error status.
+ *
+ * On success, the entry is inserted into the cache, otherwise it is
+ * discarded. The caller must hold @c fc->lock.
+ */
+static kdump_status
+finish_read_req(struct fcache *fc, struct cache_entry *ce,
+		const struct uring_req *req)
+{
+	if (req->res < 0) {
+		cache_discard(fc->fbcache, ce);
+		errno = -req->res;
+		return KDUMP_ERR_SYSTEM;
+	}
+	if (req->res < fc->pgsz)
+		memset(ce->data + req->res, 0, fc->pgsz - req->res);
+	cache_insert(fc->fbcache, ce);
+	return KDUMP_OK;
+}
+
 /** Get file cache content using mmap(2).
  * @param fc   File cache object.
  * @param fce  File cache entry, updated on success.
@@ -138,15 +319,19 @@ fcache_get_mmap(struct fcache *fc, struct fcache_entry *fce,
 		return KDUMP_ERR_NODATA;
 
 	blkpos = pos & ~(off_t)(fc->mmapsz - 1);
-	ce = cache_get_entry(fc->cache, blkpos | fidx);
-	if (!ce)
+	mutex_lock(&fc->lock);
+	ce = cache_get_entry_wait(fc->cache, blkpos | fidx, &fc->lock);
+	if (!ce) {
+		mutex_unlock(&fc->lock);
 		return KDUMP_ERR_BUSY;
+	}
 
 	if (!cache_entry_valid(ce)) {
 		ce->data = mmap(NULL, fc->mmapsz, PROT_READ,
 				MAP_SHARED, fc->info[fidx].fd, blkpos);
 		cache_insert(fc->cache, ce);
 	}
+	mutex_unlock(&fc->lock);
 
 	if (ce->data == MAP_FAILED)
 		return KDUMP_ERR_SYSTEM;
@@ -175,21 +360,29 @@ fcache_get_read(struct fcache *fc, struct fcache_entry *fce,
 	size_t off;
 
 	blkpos = pos & ~(off_t)(fc->pgsz - 1);
-	ce = cache_get_entry(fc->fbcache, blkpos | fidx);
-	if (!ce)
+	mutex_lock(&fc->lock);
+	ce = cache_get_entry_wait(fc->fbcache, blkpos | fidx, &fc->lock);
+	if (!ce) {
+		mutex_unlock(&fc->lock);
 		return KDUMP_ERR_BUSY;
+	}
 
 	if (!cache_entry_valid(ce)) {
-		ssize_t rd = pread(fc->info[fidx].fd,
-				   ce->data, fc->pgsz, blkpos);
-		if (rd < 0) {
-			cache_discard(fc->fbcache, ce);
-			return KDUMP_ERR_SYSTEM;
+		struct uring_req req;
+		kdump_status status;
+
+		/* Do not block other users while the read is in flight. */
+		mutex_unlock(&fc->lock);
+		init_read_req(fc, fidx, ce, blkpos, &req);
+		uring_read(fc->uring, &req, 1);
+		mutex_lock(&fc->lock);
+		status = finish_read_req(fc, ce, &req);
+		if (status != KDUMP_OK) {
+			mutex_unlock(&fc->lock);
+			return status;
 		}
-		if (rd < fc->pgsz)
-			memset(ce->data + rd, 0, fc->pgsz - rd);
-		cache_insert(fc->fbcache, ce);
 	}
+	mutex_unlock(&fc->lock);
 
 	fce->ce = ce;
 	off = pos & (fc->pgsz - 1);
@@ -213,14 +406,23 @@ fcache_get(struct fcache *fc, struct fcache_entry *fce,
 	kdump_mmap_policy_t policy = fc->mmap_policy.number;
 	kdump_status status;
 
+	if (policy == KDUMP_MMAP_WHOLE) {
+		if (fcache_get_whole(fc, fce, fidx, pos) == KDUMP_OK)
+			return KDUMP_OK;
+		policy = KDUMP_MMAP_TRY;
+	}
+
 	if (policy != KDUMP_MMAP_NEVER) {
 		status = fcache_get_mmap(fc, fce, fidx, pos);
 
-		if (policy == KDUMP_MMAP_TRY_ONCE)
+		if (policy == KDUMP_MMAP_TRY_ONCE) {
+			mutex_lock(&fc->lock);
 			fc->mmap_policy.number =
 				(status == KDUMP_OK
 				 ? KDUMP_MMAP_ALWAYS
 				 : KDUMP_MMAP_NEVER);
+			mutex_unlock(&fc->lock);
+		}
 
 		if (status == KDUMP_OK ||
 		    policy == KDUMP_MMAP_ALWAYS)
@@ -339,6 +541,56 @@ copy_data(void *data, struct fcache_entry *fces, size_t n)
 	return data;
 }
 
+/** Read missing blocks into the file cache in one batch.
+ * @param fc    File cache object.
+ * @param fidx  Index of the file to read from.
+ * @param pos   File position of the first block.
+ * @param nblk  Number of blocks.
+ *
+ * Blocks which are already cached or being read by another user are
+ * skipped. If there are not enough free cache entries, only some
+ * blocks are read. Errors are ignored; they are reported when the
+ * data is actually requested.
+ */
+static void
+fcache_read_batch(struct fcache *fc, unsigned fidx, off_t pos, size_t nblk)
+{
+	struct cache_entry *ces[FCACHE_BATCH];
+	struct uring_req reqs[FCACHE_BATCH];
+	struct cache_entry *ce;
+	cache_key_t key;
+	unsigned n, i;
+
+	if (nblk > FCACHE_BATCH)
+		nblk = FCACHE_BATCH;
+
+	n = 0;
+	mutex_lock(&fc->lock);
+	while (nblk--) {
+		key = pos | fidx;
+		if (!cache_has_key(fc->fbcache, key)) {
+			ce = cache_get_entry(fc->fbcache, key);
+			if (!ce)
+				break;
+			ces[n] = ce;
+			init_read_req(fc, fidx, ce, pos, &reqs[n]);
+			++n;
+		}
+		pos += fc->pgsz;
+	}
+	mutex_unlock(&fc->lock);
+	if (!n)
+		return;
+
+	uring_read(fc->uring, reqs, n);
+
+	mutex_lock(&fc->lock);
+	for (i = 0; i < n; ++i)
+		if (finish_read_req(fc, ces[i], &reqs[i]) == KDUMP_OK)
+			cache_put_entry(fc->fbcache, ces[i]);
+	mutex_unlock(&fc->lock);
+}
+
 /** Get a contiguous data chunk using a file cache.
  * @param fc   File cache.
  * @param fch  File cache chunk, updated on success.
@@ -365,9 +617,22 @@ fcache_get_chunk(struct fcache *fc, struct fcache_chunk *fch,
 		return KDUMP_OK;
 	}
 
+	/* Fast path: the whole chunk is inside a whole-file mapping. */
+	if (fc->mmap_policy.number == KDUMP_MMAP_WHOLE &&
+	    fcache_get_whole(fc, fch->embed_fces, fidx, pos) == KDUMP_OK &&
+	    fch->embed_fces->len >= len) {
+		fch->embed_fces->len = len;
+		fch->data = fch->embed_fces->data;
+		fch->nent = 1;
+		return KDUMP_OK;
+	}
+
 	first = pos & ~(off_t)(fc->pgsz - 1);
 	last = (pos + len - 1) & ~(off_t)(fc->pgsz - 1);
 	nent = (last - first) / fc->pgsz + 1;
+	if (nent > 1 && fc->uring &&
+	    fc->mmap_policy.number == KDUMP_MMAP_NEVER)
+		fcache_read_batch(fc, fidx, first, nent);
 	if (nent > MAX_EMBED_FCES) {
 		fces = malloc(nent * sizeof(*fces));
 		if (!fces)
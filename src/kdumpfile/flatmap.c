@@ -33,6 +33,8 @@
 #include "kdumpfile-priv.h"
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 
 #define MDF_SIGNATURE		"makedumpfile"
 #define MDF_SIG_LEN		16
@@ -57,6 +59,39 @@ struct makedumpfile_data_header {
 
 #define ALLOC_INC	32
 
+/** Magic string at the beginning of a flattened index file. */
+#define FLATIDX_MAGIC		"KDFLTIDX"
+#define FLATIDX_MAGIC_LEN	8
+
+/** Flattened index file format version.
+ * The index is stored in host byte order, so the version also serves
+ * as a byte order check.
+ */
+#define FLATIDX_VERSION		1
+
+/** Number of bytes at the beginning of a file used to identify it.
+ * This must be big enough to include the first segment after the
+ * flattened header, which contains the dump header.
+ */
+#define FLATIDX_HASH_SIZE	65536
+
+/** Flattened index file header. */
+struct flatidx_header {
+	char magic[FLATIDX_MAGIC_LEN]; /**< @ref FLATIDX_MAGIC */
+	uint32_t version;	/**< @ref FLATIDX_VERSION */
+	uint32_t reserved;	/**< Must be zero. */
+	struct file_key key;	/**< Identification of the indexed file. */
+	uint64_t nranges;	/**< Number of map ranges. */
+	uint64_t nsegs;		/**< Number of segment offsets. */
+	uint64_t datahash;	/**< Hash of the data after the header. */
+};
+
+/** Flattened index map range. */
+struct flatidx_range {
+	uint64_t endoff;	/**< Range end offset. */
+	int64_t meth;		/**< Segment index or ADDRXLAT_SYS_METH_NONE. */
+};
+
 /** Initialize flattened dump maps for one file.
  * @param fmap  Flattened format mapping to be initialized.
  * @param ctx   Dump file object.
@@ -149,6 +184,159 @@ flatmap_file_cleanup(struct flattened_file_map *fmap)
 		free(fmap->offs);
 }
 
+/** Get the path of a flattened index file.
+ * @param dir  Index directory.
+ * @param key  Identification of the indexed file.
+ * @returns    Newly allocated path, or @c NULL on allocation failure.
+ */
+static char *
+flatidx_path(const char *dir, const struct file_key *key)
+{
+	char *path;
+
+	if (asprintf(&path, "%s/%016"PRIx64"-%"PRIx64".flatidx",
+		     dir, key->hash, key->filesz) < 0)
+		return NULL;
+	return path;
+}
+
+/** Load a flattened file map from an index file.
+ * @param fmap  Flattened format mapping to be initialized.
+ * @param dir   Index directory.
+ * @param key   Identification of the flattened file.
+ * @returns     @c true on success, @c false if there is no valid index.
+ *
+ * If this function fails, @p fmap may be partially initialized. Like
+ * @ref flatmap_file_init, it must be released with
+ * @ref flatmap_file_cleanup (and zeroed) before it is initialized
+ * again.
+ */
+static bool
+flatidx_load(struct flattened_file_map *fmap, const char *dir,
+	     const struct file_key *key)
+{
+	const struct flatidx_header *hdr;
+	const struct flatidx_range *ranges;
+	const int64_t *offs;
+	addrxlat_range_t *maprange = NULL;
+	char *path, *buf;
+	size_t size, i;
+	bool ret = false;
+
+	path = flatidx_path(dir, key);
+	if (!path)
+		return false;
+	buf = slurp_file(path, &size);
+	free(path);
+	if (!buf)
+		return false;
+
+	hdr = (const struct flatidx_header *) buf;
+	if (size < sizeof *hdr ||
+	    memcmp(hdr->magic, FLATIDX_MAGIC, FLATIDX_MAGIC_LEN) ||
+	    hdr->version != FLATIDX_VERSION || hdr->reserved ||
+	    memcmp(&hdr->key, key, sizeof *key) ||
+	    hdr->nranges > (size - sizeof *hdr) / sizeof *ranges ||
+	    hdr->nsegs > (size - sizeof *hdr) / sizeof *offs ||
+	    size != sizeof *hdr + hdr->nranges * sizeof *ranges +
+		    hdr->nsegs * sizeof *offs ||
+	    hdr->datahash != fnv64_update(FNV64_OFFSET, hdr + 1,
+					  size - sizeof *hdr))
+		goto out;
+	ranges = (const struct flatidx_range *) (hdr + 1);
+	offs = (const int64_t *) (ranges + hdr->nranges);
+
+	fmap->offs = malloc((hdr->nsegs ?: 1) * sizeof(*fmap->offs));
+	if (!fmap->offs)
+		goto out;
+	for (i = 0; i < hdr->nsegs; ++i)
+		fmap->offs[i] = offs[i];
+
+	maprange = malloc((hdr->nranges ?: 1) * sizeof(*maprange));
+	if (!maprange)
+		goto out;
+	for (i = 0; i < hdr->nranges; ++i) {
+		if (ranges[i].meth != ADDRXLAT_SYS_METH_NONE &&
+		    (ranges[i].meth < 0 || ranges[i].meth >= hdr->nsegs))
+			goto out;
+		maprange[i].endoff = ranges[i].endoff;
+		maprange[i].meth = ranges[i].meth;
+	}
+
+	fmap->map = addrxlat_map_new();
+	if (!fmap->map)
+		goto out;
+	if (addrxlat_map_set_ranges(fmap->map, maprange, hdr->nranges)
+	    != ADDRXLAT_OK)
+		goto out;
+	ret = true;
+
+ out:
+	free(maprange);
+	free(buf);
+	return ret;
+}
+
+/** Save a flattened file map to an index file.
+ * @param fmap  Flattened format mapping.
+ * @param dir   Index directory.
+ * @param key   Identification of the flattened file.
+ *
+ * The index is written to a temporary file, which is then renamed,
+ * so concurrent users never see an incomplete index. Errors are
+ * ignored, because the index is only an optimization.
+ */
+static void
+flatidx_save(const struct flattened_file_map *fmap, const char *dir,
+	     const struct file_key *key)
+{
+	const addrxlat_range_t *range, *end;
+	struct flatidx_header *hdr;
+	struct flatidx_range *ranges;
+	int64_t *offs;
+	char *path;
+	size_t size, nranges, nsegs, i;
+
+	range = addrxlat_map_ranges(fmap->map);
+	nranges = addrxlat_map_len(fmap->map);
+	end = range + nranges;
+	nsegs = 0;
+	for ( ; range < end; ++range)
+		if (range->meth != ADDRXLAT_SYS_METH_NONE &&
+		    range->meth >= nsegs)
+			nsegs = range->meth + 1;
+
+	size = sizeof *hdr + nranges * sizeof *ranges + nsegs * sizeof *offs;
+	hdr = calloc(1, size);
+	if (!hdr)
+		return;
+	memcpy(hdr->magic, FLATIDX_MAGIC, FLATIDX_MAGIC_LEN);
+	hdr->version = FLATIDX_VERSION;
+	hdr->key = *key;
+	hdr->nranges = nranges;
+	hdr->nsegs = nsegs;
+
+	ranges = (struct flatidx_range *) (hdr + 1);
+	range = addrxlat_map_ranges(fmap->map);
+	for (i = 0; i < nranges; ++i) {
+		ranges[i].endoff = range[i].endoff;
+		ranges[i].meth = range[i].meth;
+	}
+	offs = (int64_t *) (ranges + nranges);
+	for (i = 0; i < nsegs; ++i)
+		offs[i] = fmap->offs[i];
+	hdr->datahash = fnv64_update(FNV64_OFFSET, hdr + 1,
+				     size - sizeof *hdr);
+
+	path = flatidx_path(dir, key);
+	if (path) {
+		save_file(path, hdr, size);
+		free(path);
+	}
+
+	free(hdr);
+}
+
 /** Allocate a flattened dump map.
  * @param nfiles  Number of mapped files.
  * @returns       Flattened offset map, or @c NULL on error.
@@ -178,6 +366,12 @@ err_notimpl(kdump_ctx_t *ctx, const char *what, int_fast64_t value)
  * @returns    Error status.
  *
  * Initialize flattened dump maps for all files.
+ *
+ * If the "file.flat_index_dir" attribute is set, the maps are loaded
+ * from index files in that directory if possible. An index file is
+ * used only if the size, modification time and a hash of the first
+ * @ref FLATIDX_HASH_SIZE bytes match the flattened file. Otherwise,
+ * all segment headers are read, and a new index file is written.
  */
 kdump_status
 flatmap_init(struct flattened_map *map, kdump_ctx_t *ctx)
@@ -185,9 +379,16 @@ flatmap_init(struct flattened_map *map, kdump_ctx_t *ctx)
 	static const char magic[MDF_SIG_LEN] = MDF_SIGNATURE;
 
 	struct makedumpfile_header hdr;
+	struct file_key key;
+	struct attr_data *attr;
+	const char *idxdir;
+	bool use_index;
 	unsigned fidx;
 	kdump_status status;
 
+	attr = gattr(ctx, GKI_file_flat_index_dir);
+	idxdir = attr_isset(attr) ? attr_value(attr)->string : NULL;
+
 	map->fcache = ctx->shared->fcache;
 	fcache_incref(map->fcache);
 
@@ -207,11 +408,24 @@ flatmap_init(struct flattened_map *map, kdump_ctx_t *ctx)
 			return err_notimpl(ctx, "version",
 					   be64toh(hdr.version));
 
+		use_index = idxdir &&
+			get_file_key(map->fcache, fidx, FLATIDX_HASH_SIZE,
+				     &key);
+		if (use_index) {
+			if (flatidx_load(&map->fmap[fidx], idxdir, &key))
+				continue;
+			flatmap_file_cleanup(&map->fmap[fidx]);
+			memset(&map->fmap[fidx], 0, sizeof map->fmap[fidx]);
+		}
+
 		status = flatmap_file_init(&map->fmap[fidx], ctx, fidx);
 		if (status != KDUMP_OK)
 			return set_error(ctx, status,
 					 "Cannot rearrange %s",
 					 err_filename(ctx, fidx));
+
+		if (use_index)
+			flatidx_save(&map->fmap[fidx], idxdir, &key);
 	}
 
 	return KDUMP_OK;
@@ -251,12 +465,18 @@ flatmap_pread_flat(struct flattened_map *map, void *buf, size_t len,
 {
 	struct flattened_file_map *fmap = &map->fmap[fidx];
 	const addrxlat_range_t *range, *end;
+	addrxlat_addr_t start;
 	off_t off;
 
 	range = addrxlat_map_ranges(fmap->map);
 	end = range + addrxlat_map_len(fmap->map);
-	for (off = pos; range < end && off > range->endoff; ++range)
-		off -= range->endoff + 1;
+	range += addrxlat_map_find(fmap->map, pos, &start);
+	if (range == end) {
+		/* Beyond the end of the flattened data. */
+		memset(buf, 0, len);
+		return KDUMP_OK;
+	}
+	off = pos - start;
 	while (range < end && len) {
 		size_t seglen;
 
@@ -303,17 +523,23 @@ flatmap_get_chunk_flat(struct flattened_map *map, struct fcache_chunk *fch,
 {
 	struct flattened_file_map *fmap = &map->fmap[fidx];
 	const addrxlat_range_t *range, *end;
+	addrxlat_addr_t start;
 	off_t off;
 
 	range = addrxlat_map_ranges(fmap->map);
 	end = range + addrxlat_map_len(fmap->map);
-	for (off = pos; range < end && off > range->endoff; ++range)
-		off -= range->endoff + 1;
-	if (len <= range->endoff + 1 - off) {
-		pos += fmap->offs[range->meth];
-		return fcache_get_chunk(map->fcache, fch, len, fidx, pos);
+	range += addrxlat_map_find(fmap->map, pos, &start);
+	if (range < end && range->meth != ADDRXLAT_SYS_METH_NONE) {
+		off = pos - start;
+		if (len <= range->endoff + 1 - off) {
+			pos += fmap->offs[range->meth];
+			return fcache_get_chunk(map->fcache, fch,
+						len, fidx, pos);
+		}
 	}
 
+	/* Holes and data beyond the end are read as zeroes. */
+
 	fch->data = malloc(len);
 	if (!fch->data)
 		return KDUMP_ERR_SYSTEM;
@@ -204,6 +204,20 @@ struct format_ops {
 	 */
 	kdump_status (*realloc_caches)(kdump_ctx_t *ctx);
 
+	/** Find the next page stored in the dump file.
+	 * @param ctx  Dump file object.
+	 * @param pfn  On input, the first PFN to check. On success,
+	 *             set to the lowest stored PFN at or above that.
+	 * @returns    @c true on success, @c false if there are no
+	 *             more stored pages.
+	 *
+	 * This method is optional. It is used by readahead to skip
+	 * pages which are not stored in the file, and readahead is
+	 * disabled if the method is not implemented. The caller must
+	 * hold the shared lock.
+	 */
+	bool (*next_pfn)(kdump_ctx_t *ctx, kdump_pfn_t *pfn);
+
 	/** Clean up attribute hooks.
 	 * @param dict    Attribute dictionary.
 	 */
@@ -452,6 +466,20 @@ struct attr_template {
 	const struct attr_ops *ops;
 };
 
+/* hashing */
+INTERNAL_DECL(unsigned long, mem_hash, (const char *s, size_t len));
+
+/**  Partial hash.
+ * This structure is used to store the state of the hashing algorithm,
+ * while making incremental updates.
+ */
+struct phash {
+	unsigned long val;	/**< Current hash value. */
+	unsigned idx;		/**< Index in @ref part. */
+	/** Partial data as bytes. */
+	unsigned char part[sizeof(unsigned long)];
+};
+
 /**  Attribute value flags.
  */
 struct attr_flags {
@@ -501,6 +529,12 @@ struct attr_data {
 	struct attr_data *next, *parent;
 	const struct attr_template *template;
 
+	/** Hash of the full attribute path. */
+	unsigned long hash;
+
+	/** Partial hash of the path of children, including the dot. */
+	struct phash dirhash;
+
 	/** Attribute value flags */
 	struct attr_flags flags;
 
@@ -521,6 +555,12 @@ struct attr_data {
 #define ATTR_HASH_BITS	10
 #define ATTR_HASH_SIZE	(1U<<ATTR_HASH_BITS)
 
+/**  Size of the global key index.
+ * The index must have more slots than @ref NR_GLOBAL_ATTRS.
+ */
+#define ATTR_GINDEX_BITS	9
+#define ATTR_GINDEX_SIZE	(1U<<ATTR_GINDEX_BITS)
+
 /**  Attribute hash table.
  */
 struct attr_hash {
@@ -541,6 +581,13 @@ struct attr_dict {
 	/** Global attributes. */
 	struct attr_data *global_attrs[NR_GLOBAL_ATTRS];
 
+	/** Global key index.
+	 * Open-addressing hash table of global attributes, indexed by
+	 * their path hash. Each slot contains the global key index plus
+	 * one, or zero if the slot is empty.
+	 */
+	unsigned short gindex[ATTR_GINDEX_SIZE];
+
 	/** Dump file shared data. */
 	struct kdump_shared *shared;
 };
@@ -551,12 +598,21 @@ INTERNAL_DECL(kdump_status, ostype_attr,
 DECLARE_ALIAS(open_fdset);
 
 struct cache;
+struct page_cache;
 
 /** Number of per-context data slots.
  * If needed, this number can be increased without breaking public ABI.
  */
 #define PER_CTX_SLOTS	16
 
+/** Per-context data cleanup function.
+ * @param data  Per-context data.
+ *
+ * This function is called before per-context data is freed. It should
+ * release any resources referenced by @p data, but not @p data itself.
+ */
+typedef void per_ctx_cleanup_fn(void *data);
+
 /**  Shared state of the dump file object.
  *
  * This structure describes the data portion of the dump file object,
@@ -584,13 +640,23 @@ struct kdump_shared {
 	int arch_init_done;	/**< Non-zero if arch init has been called. */
 
 	size_t pendfiles;	/**< Number of unspecified files. */
-	struct cache *cache;	/**< Page cache. */
+	struct page_cache *cache; /**< Page cache. */
 	struct fcache *fcache;	/**< File cache. */
-	mutex_t cache_lock;	/**< Cache access lock. */
+
+	/** Number of page references held by the user.
+	 * The page cache must not be re-allocated while this is non-zero.
+	 */
+	unsigned long page_refs;
 
 	/** File offset mappings for flattened files. */
 	struct flattened_map *flatmap;
 
+	/** Readahead worker pool, or @c NULL if readahead is off. */
+	struct readahead *readahead;
+
+	/** Read statistics, or @c NULL if statistics are disabled. */
+	struct read_stats *stats;
+
 	/** Static attributes. */
 #define ATTR(dir, key, field, type, ctype, ...)	\
 	kdump_attr_value_t field;
@@ -599,6 +665,9 @@ struct kdump_shared {
 
 	/** Size of per-context data. Zero means unallocated. */
 	size_t per_ctx_size[PER_CTX_SLOTS];
+
+	/** Cleanup functions for per-context data (may be @c NULL). */
+	per_ctx_cleanup_fn *per_ctx_cleanup[PER_CTX_SLOTS];
 };
 
 INTERNAL_DECL(void, shared_free,
@@ -695,6 +764,14 @@ xlat_decref(struct kdump_xlat *xlat)
 	return 0;
 }
 
+/**  Sequential access detection state.
+ */
+struct readahead_state {
+	addrxlat_fulladdr_t next; /**< Page address expected next. */
+	kdump_addr_t end;	  /**< End of queued readahead requests. */
+	unsigned seq;		  /**< Number of sequential page reads. */
+};
+
 /**  Representation of a dump file.
  *
  * This structure contains state information and a pointer to @c struct
@@ -723,6 +800,9 @@ struct _kdump_ctx {
 	/** Per-context data. */
 	void *data[PER_CTX_SLOTS];
 
+	/** Sequential access state for readahead. */
+	struct readahead_state ra;
+
 	/** Temporary buffer for file names in error messages. */
 	char err_filename[sizeof("File #") + 20];
 
@@ -733,9 +813,13 @@ struct _kdump_ctx {
 
 /* Per-context data */
 
-INTERNAL_DECL(int, per_ctx_alloc, (struct kdump_shared *shared, size_t sz));
+INTERNAL_DECL(int, per_ctx_alloc, (struct kdump_shared *shared, size_t sz,
+				   per_ctx_cleanup_fn *cleanup));
 INTERNAL_DECL(void, per_ctx_free, (struct kdump_shared *shared, int slot));
 
+INTERNAL_DECL(kdump_ctx_t *, helper_ctx_new, (struct kdump_shared *shared));
+INTERNAL_DECL(void, helper_ctx_free, (kdump_ctx_t *ctx));
+
 /* File formats */
 
 INTERNAL_DECL(extern const struct format_ops, elfdump_ops, );
@@ -807,8 +891,20 @@ INTERNAL_DECL(int, uts_looks_sane, (struct new_utsname *uts));
 INTERNAL_DECL(int, uncompress_rle,
 	      (unsigned char *dst, size_t *pdstlen,
 	       const unsigned char *src, size_t srclen));
+
+struct decomp_state;
+INTERNAL_DECL(int, decomp_alloc, (struct kdump_shared *shared));
 INTERNAL_DECL(kdump_status, uncompress_page_gzip,
-	      (kdump_ctx_t *ctx, unsigned char *dst,
+	      (kdump_ctx_t *ctx, struct decomp_state *ds, unsigned char *dst,
+	       unsigned char *src, size_t srclen));
+INTERNAL_DECL(kdump_status, uncompress_page_lzo,
+	      (kdump_ctx_t *ctx, struct decomp_state *ds, unsigned char *dst,
+	       unsigned char *src, size_t srclen));
+INTERNAL_DECL(kdump_status, uncompress_page_snappy,
+	      (kdump_ctx_t *ctx, struct decomp_state *ds, unsigned char *dst,
+	       unsigned char *src, size_t srclen));
+INTERNAL_DECL(kdump_status, uncompress_page_zstd,
+	      (kdump_ctx_t *ctx, struct decomp_state *ds, unsigned char *dst,
 	       unsigned char *src, size_t srclen));
 
 INTERNAL_DECL(uint32_t, cksum32, (void *buffer, size_t size, uint32_t csum));
@@ -903,20 +999,6 @@ get_unaligned_uint64_t(const unsigned char *p)
 	return ((struct unaligned_uint64_t*)p)->val;
 }
 
-/* hashing */
-INTERNAL_DECL(unsigned long, mem_hash, (const char *s, size_t len));
-
-/**  Partial hash.
- * This structure is used to store the state of the hashing algorithm,
- * while making incremental updates.
- */
-struct phash {
-	unsigned long val;	/**< Current hash value. */
-	unsigned idx;		/**< Index in @ref part. */
-	/** Partial data as bytes. */
-	unsigned char part[sizeof(unsigned long)];
-};
-
 /**  Initialize a partial hash.
  * @param[out] phash  Partial hash state.
  */
@@ -1223,10 +1305,16 @@ INTERNAL_DECL(struct attr_data *, clone_attr_path,
 
 /* Attribute ops */
 INTERNAL_DECL(extern const struct attr_ops, file_fd_ops, );
+INTERNAL_DECL(extern const struct attr_ops, io_engine_ops, );
 INTERNAL_DECL(extern const struct attr_ops, num_files_ops, );
 INTERNAL_DECL(extern const struct attr_ops, page_size_ops, );
 INTERNAL_DECL(extern const struct attr_ops, page_shift_ops, );
 INTERNAL_DECL(extern const struct attr_ops, cache_size_ops, );
+INTERNAL_DECL(extern const struct attr_ops, cache_shards_ops, );
+INTERNAL_DECL(extern const struct attr_ops, cache_stats_ops, );
+INTERNAL_DECL(extern const struct attr_ops, cache_wait_ops, );
+INTERNAL_DECL(extern const struct attr_ops, readahead_ops, );
+INTERNAL_DECL(extern const struct attr_ops, stats_enabled_ops, );
 INTERNAL_DECL(extern const struct attr_ops, arch_name_ops, );
 INTERNAL_DECL(extern const struct attr_ops, ostype_ops, );
 INTERNAL_DECL(extern const struct attr_ops, uts_machine_ops, );
@@ -1234,6 +1322,8 @@ INTERNAL_DECL(extern const struct attr_ops, vmcoreinfo_raw_ops, );
 INTERNAL_DECL(extern const struct attr_ops, dirty_xlat_ops, );
 INTERNAL_DECL(extern const struct attr_ops, linux_dirty_xlat_ops, );
 INTERNAL_DECL(extern const struct attr_ops, xen_dirty_xlat_ops, );
+INTERNAL_DECL(extern const struct attr_ops, xlat_tlb_ops, );
+INTERNAL_DECL(extern const struct attr_ops, xlat_read_cache_ops, );
 INTERNAL_DECL(extern const struct attr_ops, linux_version_code_ops, );
 INTERNAL_DECL(extern const struct attr_ops, linux_ver_ops, );
 INTERNAL_DECL(extern const struct attr_ops, xen_version_code_ops, );
@@ -1287,6 +1377,17 @@ typedef kdump_addr_t	cache_key_t;
  */
 #define DEFAULT_CACHE_SIZE	1024
 
+/** Default number of page cache shards.
+ * A single shard gives the best hit ratio for a given cache size.
+ * Multi-threaded users may want to increase it to reduce lock contention.
+ */
+#define DEFAULT_CACHE_SHARDS	1
+
+/** Default number of readahead threads.
+ * Readahead itself is off by default (see "cache.readahead").
+ */
+#define DEFAULT_READAHEAD_THREADS	1
+
 /**  Cache entry state.
  */
 enum cache_state {
@@ -1295,11 +1396,25 @@ enum cache_state {
 	cs_precious,		/**< In flight, target precious list */
 };
 
+/**  Cache partition.
+ */
+enum cache_part {
+	cp_unused,		/**< Unused entries */
+	cp_gprobe,		/**< Ghost probed entries */
+	cp_probe,		/**< Probed entries */
+	cp_prec,		/**< Precious entries */
+	cp_gprec,		/**< Ghost precious entries */
+	cp_inflight,		/**< In-flight entries */
+
+	NR_CACHE_PARTS		/**< Total number of cache partitions */
+};
+
 /**  Cache entry.
  */
 struct cache_entry {
 	cache_key_t key;	/**< Cache entry key. */
 	enum cache_state state;	/**< Cache entry state. */
+	enum cache_part part;	/**< Partition which contains the entry. */
 	unsigned next;		/**< Index of next entry in evict list. */
 	unsigned prev;		/**< Index of previous entry in evict list. */
 	unsigned refcnt;	/**< Reference count. */
@@ -1325,11 +1440,66 @@ INTERNAL_DECL(void, cache_put_entry,
 	      (struct cache *cache, struct cache_entry *entry));
 INTERNAL_DECL(void, cache_insert, (struct cache *, struct cache_entry *));
 INTERNAL_DECL(void, cache_discard, (struct cache *, struct cache_entry *));
+INTERNAL_DECL(void, cache_set_wait,
+	      (struct cache *cache, int wait, unsigned long timeout));
+INTERNAL_DECL(struct cache_entry *, cache_get_entry_wait,
+	      (struct cache *cache, cache_key_t key, mutex_t *lock));
+INTERNAL_DECL(int, cache_has_key,
+	      (const struct cache *cache, cache_key_t key));
 
 INTERNAL_DECL(kdump_status, cache_set_attrs,
 	      (struct cache *cache, kdump_ctx_t *ctx,
 	       struct attr_data *hits, struct attr_data *misses));
 
+/**  One shard of a page cache.
+ */
+struct cache_shard {
+	mutex_t lock;		/**< Lock for all operations on @c cache. */
+	struct cache *cache;	/**< Cache object of this shard. */
+};
+
+/**  Page cache.
+ *
+ * The page cache is split into independent shards to allow concurrent
+ * access from multiple threads. Each key is always stored in the same
+ * shard, selected by a hash of the key. Each shard has its own lock,
+ * replacement state and statistics.
+ */
+struct page_cache {
+	unsigned nshards;	   /**< Number of shards. */
+	kdump_attr_value_t hits;   /**< Cache hits (sum of all shards). */
+	kdump_attr_value_t misses; /**< Cache misses (sum of all shards). */
+	void *zero_page;	   /**< Read-only page filled with zeroes. */
+	size_t zero_size;	   /**< Size of @c zero_page. */
+	struct cache_shard shard[]; /**< Shards. */
+};
+
+INTERNAL_DECL(unsigned, get_cache_shards, (kdump_ctx_t *ctx));
+INTERNAL_DECL(kdump_status, update_cache_wait, (kdump_ctx_t *ctx));
+INTERNAL_DECL(struct page_cache *, page_cache_alloc,
+	      (unsigned nshards, unsigned n, size_t size));
+INTERNAL_DECL(void, page_cache_free, (struct page_cache *pc));
+INTERNAL_DECL(kdump_status, page_cache_set_attrs,
+	      (struct page_cache *pc, kdump_ctx_t *ctx,
+	       struct attr_data *hits, struct attr_data *misses));
+
+/**  Get the page cache shard for a given key.
+ * @param pc   Page cache.
+ * @param key  Cache entry key.
+ * @returns    Shard which may contain @p key.
+ */
+static inline struct cache_shard *
+page_cache_shard(struct page_cache *pc, cache_key_t key)
+{
+	if (pc->nshards == 1)
+		return &pc->shard[0];
+#if SIZEOF_LONG == 8
+	return &pc->shard[fold_hash(key, 16) % pc->nshards];
+#else
+	return &pc->shard[fold_hash(key ^ (key >> 32), 16) % pc->nshards];
+#endif
+}
+
 /**  Check if a cache entry is valid.
  *
  * @param entry  Cache entry.
@@ -1341,6 +1511,26 @@ cache_entry_valid(struct cache_entry *entry)
 	return entry->state == cs_valid;
 }
 
+/* Asynchronous I/O */
+
+/** Asynchronous read request.
+ */
+struct uring_req {
+	int fd;			/**< File descriptor. */
+	void *buf;		/**< Target buffer. */
+	size_t len;		/**< Number of bytes to read. */
+	off_t pos;		/**< File position. */
+	ssize_t res;		/**< Bytes read, or negative error number. */
+	bool done;		/**< Set when @c res is valid. */
+};
+
+struct uring;
+
+INTERNAL_DECL(struct uring *, uring_new, (unsigned entries));
+INTERNAL_DECL(void, uring_free, (struct uring *ur));
+INTERNAL_DECL(void, uring_read,
+	      (struct uring *ur, struct uring_req *reqs, unsigned n));
+
 /* File cache */
 
 /** File cache entry.
@@ -1367,6 +1557,12 @@ struct fcache_fileinfo {
 
 	/** File size (if known) or maximum off_t. */
 	off_t filesz;
+
+	/** Mapping of the whole file, @c NULL if not yet mapped,
+	 *  or @c MAP_FAILED if the file cannot be mapped.
+	 *  @sa KDUMP_MMAP_WHOLE
+	 */
+	void *map;
 };
 
 /** File cache.
@@ -1383,6 +1579,15 @@ struct fcache {
 	/** Reference counter. */
 	unsigned long refcnt;
 
+	/** Lock which protects the caches.
+	 * This lock is not held during read I/O, so multiple reads
+	 * can be in flight at the same time.
+	 */
+	mutex_t lock;
+
+	/** io_uring instance for reads, or @c NULL to use pread(2). */
+	struct uring *uring;
+
 	/** Policy for using mmap(2) vs. read(2).
 	 * @sa kdump_mmap_policy_t
 	 */
@@ -1400,6 +1605,14 @@ struct fcache {
 	/** Fallback cache (for read regions). */
 	struct cache *fbcache;
 
+	/** Non-zero if whole-file maps are expected to be read
+	 *  sequentially (passed to madvise(2)).
+	 */
+	bool sequential;
+
+	/** Number of files. */
+	unsigned nfds;
+
 	/** Information about the files. */
 	struct fcache_fileinfo info[];
 };
@@ -1408,6 +1621,8 @@ INTERNAL_DECL(struct fcache *, fcache_new,
 	      (unsigned nfds, const int *fd, unsigned n, unsigned order));
 INTERNAL_DECL(void, fcache_free,
 	      (struct fcache *fc));
+INTERNAL_DECL(int, fcache_use_uring, (struct fcache *fc, bool enable));
+INTERNAL_DECL(void, fcache_advise, (struct fcache *fc, bool sequential));
 
 /** Increment file cache reference counter.
  * @param fc  File cache.
@@ -1504,12 +1719,114 @@ struct page_io {
 	struct fcache_chunk chunk; /**< File cache chunk. */
 };
 
+/**  Page reference returned by @ref kdump_get_page_ref.
+ */
+struct _kdump_page_ref {
+	struct page_io pio;	/**< Page I/O of the referenced page. */
+};
+
 typedef kdump_status read_page_fn(struct page_io *pio);
+typedef bool zero_page_fn(struct page_io *pio);
 
 INTERNAL_DECL(kdump_status, cache_get_page,
-	      (struct page_io *pio, read_page_fn *fn));
+	      (struct page_io *pio, read_page_fn *fn, zero_page_fn *zerofn));
 INTERNAL_DECL(void, cache_put_page,
 	      (struct page_io *pio));
+INTERNAL_DECL(kdump_status, get_zero_page,
+	      (struct page_io *pio));
+
+/* Readahead */
+
+INTERNAL_DECL(kdump_status, update_readahead, (kdump_ctx_t *ctx));
+INTERNAL_DECL(void, readahead_stop, (struct kdump_shared *shared));
+INTERNAL_DECL(void, readahead_note,
+	      (struct page_io *pio, read_page_fn *fn));
+
+/* Read statistics */
+
+/** Read stages with latency statistics. */
+enum stats_stage {
+#define STAGE(id)	STAGE_ ## id,
+#include "stats.def"
+#undef STAGE
+	NR_STATS_STAGES		/**< Total number of read stages. */
+};
+
+/** Number of buckets in a latency histogram.
+ * Bucket @c n counts operations which took between 2^n and 2^(n+1)-1
+ * nanoseconds. Bucket zero also counts operations which took less
+ * than one nanosecond.
+ */
+#define STATS_HIST_BUCKETS	64
+
+/** Statistics of a single read stage.
+ */
+struct stage_stats {
+	kdump_attr_value_t count; /**< Number of operations. */
+	kdump_attr_value_t time;  /**< Total time in nanoseconds. */
+	kdump_blob_t *hist;	  /**< Latency histogram. */
+};
+
+/** Read statistics.
+ *
+ * All counters are updated with relaxed atomic operations. The object
+ * is allocated and freed only while the shared lock is held for writing,
+ * so it is safe to use while holding the shared lock for reading.
+ */
+struct read_stats {
+	struct stage_stats stage[NR_STATS_STAGES];
+};
+
+INTERNAL_DECL(void, stats_free, (struct read_stats *stats));
+INTERNAL_DECL(uint64_t, stats_clock, (void));
+INTERNAL_DECL(void, stats_record,
+	      (struct read_stats *stats, enum stats_stage stage,
+	       uint64_t ns));
+
+/** Start measuring a read stage.
+ * @param shared  Shared data of a dump file object.
+ * @returns       Start timestamp, or zero if statistics are disabled.
+ *
+ * This function may be called without holding the shared lock.
+ */
+static inline uint64_t
+stats_start(struct kdump_shared *shared)
+{
+	return __atomic_load_n(&shared->stats, __ATOMIC_RELAXED)
+		? stats_clock()
+		: 0;
+}
+
+/** Finish measuring a read stage.
+ * @param shared  Shared data of a dump file object.
+ * @param stage   Measured read stage.
+ * @param start   Start timestamp returned by @ref stats_start.
+ *
+ * The caller must hold the shared lock (for reading or writing).
+ */
+static inline void
+stats_end(struct kdump_shared *shared, enum stats_stage stage,
+	  uint64_t start)
+{
+	struct read_stats *stats;
+
+	if (start &&
+	    (stats = __atomic_load_n(&shared->stats, __ATOMIC_RELAXED)))
+		stats_record(stats, stage, stats_clock() - start);
+}
+
+/** Acquire the shared lock for reading.
+ * @param shared  Shared data of a dump file object.
+ *
+ * The time spent waiting for the lock is accounted to the lock stage.
+ */
+static inline void
+shared_rdlock(struct kdump_shared *shared)
+{
+	uint64_t start = stats_start(shared);
+	rwlock_rdlock(&shared->lock);
+	stats_end(shared, STAGE_lock, start);
+}
 
 /** Get page data.
  * @param pio  Page I/O control.
@@ -1752,6 +2069,28 @@ find_pfn_file_map(const struct pfn_file_map *maps, size_t nmaps,
 	return NULL;
 }
 
+/* Index files. */
+
+#define FNV64_OFFSET	0xcbf29ce484222325ULL
+#define FNV64_PRIME	0x100000001b3ULL
+
+/** Identification of a dump file in an index file. */
+struct file_key {
+	uint64_t filesz;	/**< File size. */
+	int64_t mtime_sec;	/**< Modification time (seconds). */
+	int64_t mtime_nsec;	/**< Modification time (nanoseconds). */
+	uint64_t hash;		/**< Hash of the beginning of the file. */
+};
+
+INTERNAL_DECL(uint64_t, fnv64_update,
+	      (uint64_t hash, const void *data, size_t len));
+INTERNAL_DECL(bool, get_file_key,
+	      (struct fcache *fc, unsigned fidx, off_t hashsize,
+	       struct file_key *key));
+INTERNAL_DECL(void *, slurp_file, (const char *path, size_t *psize));
+INTERNAL_DECL(void, save_file,
+	      (const char *path, const void *data, size_t size));
+
 /* Flattened files. */
 
 /** Offset mapping for a file in the flattened format. */
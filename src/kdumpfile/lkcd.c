@@ -310,6 +310,45 @@ struct pfn_block {
 
 #define MAX_PFN_GAP 15
 
+/** Magic string at the beginning of a page index file. */
+#define LKCDIDX_MAGIC		"KDLKCIDX"
+#define LKCDIDX_MAGIC_LEN	8
+
+/** Page index file format version.
+ * The index is stored in host byte order, so the version also serves
+ * as a byte order check.
+ */
+#define LKCDIDX_VERSION		1
+
+/** Number of bytes at the beginning of a dump file used to identify it.
+ * This includes the whole dump header.
+ */
+#define LKCDIDX_HASH_SIZE	LKCD_OFFSET_TO_FIRST_PAGE
+
+/** Page index file header. */
+struct lkcdidx_header {
+	char magic[LKCDIDX_MAGIC_LEN]; /**< @ref LKCDIDX_MAGIC */
+	uint32_t version;	/**< @ref LKCDIDX_VERSION */
+	uint32_t page_shift;	/**< Page shift used to compute PFNs. */
+	struct file_key key;	/**< Identification of the dump file. */
+	int64_t data_offset;	/**< Offset of the first page. */
+	int64_t end_offset;	/**< Offset of the end marker. */
+	uint64_t max_pfn;	/**< Maximum PFN plus one. */
+	uint64_t nblocks;	/**< Number of PFN blocks. */
+	uint64_t noffs;		/**< Total number of page offsets. */
+	uint64_t datahash;	/**< Hash of the data after the header. */
+};
+
+/** PFN block in a page index file.
+ * The page offsets of all blocks follow after the last block.
+ */
+struct lkcdidx_block {
+	uint64_t pfn;		/**< First PFN in the block. */
+	int64_t filepos;	/**< File offset of the first page. */
+	uint32_t n;		/**< Number of page offsets. */
+	uint32_t reserved;	/**< Must be zero. */
+};
+
 /* Maximum size of the format name: the version field is a 32-bit integer,
  * so it cannot be longer than 10 decimal digits.
  */
@@ -331,15 +370,32 @@ struct lkcd_priv {
 	/** Overridden methods for arch.page_size attribute. */
 	struct attr_override page_size_override;
 	int cbuf_slot;		/**< Compressed data per-context slot. */
+	int decomp_slot;	/**< Decompression state per-context slot. */
 
 	/** Overridden methods for max.pfn attribute. */
 	struct attr_override max_pfn_override;
 	kdump_pfn_t max_pfn;	/**< Maximum PFN seen so far. */
 
+	/** Page index file path, or @c NULL. */
+	char *index_path;
+	/** Identification of the dump file in the page index file. */
+	struct file_key index_key;
+	/** Page index to be saved to the index file, or @c NULL. */
+	struct lkcdidx_header *index_data;
+	size_t index_size;	/**< Size of @c index_data in bytes. */
+
+#if USE_PTHREAD
+	/** Helper context of the index builder, or @c NULL if not running. */
+	kdump_ctx_t *indexer_ctx;
+	pthread_t indexer;	/**< Index builder thread. */
+	bool indexer_stop;	/**< Set to stop the index builder. */
+#endif
+
 	char format[MAX_FORMAT_NAME];
 };
 
 static void lkcd_cleanup(struct kdump_shared *shared);
+static void free_level1(struct pfn_block ***level1, unsigned long n);
 
 static struct pfn_block **
 get_pfn_slot(kdump_ctx_t *ctx, kdump_pfn_t pfn)
@@ -544,9 +600,12 @@ idx_fits_block(unsigned idx, struct pfn_block *block)
 static kdump_status
 read_page_desc(kdump_ctx_t *ctx, struct dump_page *dp, off_t off)
 {
+	uint64_t start;
 	kdump_status ret;
 
+	start = stats_start(ctx->shared);
 	ret = fcache_pread(ctx->shared->fcache, dp, sizeof *dp, 0, off);
+	stats_end(ctx->shared, STAGE_desc, start);
 	if (ret != KDUMP_OK)
 		return set_error(ctx, ret,
 				 "Cannot read page descriptor at %llu",
@@ -572,87 +631,328 @@ error_dup(kdump_ctx_t *ctx, off_t off, struct pfn_block *block, kdump_pfn_t pfn)
 			 (unsigned long long) prevoff);
 }
 
-static kdump_status
-search_page_desc(kdump_ctx_t *ctx, kdump_pfn_t pfn,
-		 struct dump_page *dp, off_t *dataoff)
+/** Serialize the PFN block tree for the page index file.
+ * @param ctx  Dump file object.
+ *
+ * This function should be called when the PFN block tree is complete.
+ * The result is stored in @c index_data, and it is written to the file
+ * by @ref unlock_pfn_blocks. Errors are ignored, because the index is
+ * only an optimization.
+ *
+ * The PFN block mutex must be held by the caller.
+ */
+static void
+lkcdidx_serialize(kdump_ctx_t *ctx)
 {
 	struct lkcd_priv *lkcdp = ctx->shared->fmtdata;
-	off_t off;
-	kdump_pfn_t curpfn, blocktbl;
+	struct lkcdidx_header *hdr;
+	struct lkcdidx_block *blk;
+	const struct pfn_block *block;
+	uint32_t *offs;
+	size_t nblocks, noffs, size;
+	unsigned i, j;
+
+	nblocks = noffs = 0;
+	for (i = 0; i < lkcdp->l1_size; ++i) {
+		if (!lkcdp->pfn_level1[i])
+			continue;
+		for (j = 0; j < PFN_IDX2_SIZE; ++j)
+			for (block = lkcdp->pfn_level1[i][j]; block;
+			     block = block->next) {
+				++nblocks;
+				noffs += block->n;
+			}
+	}
+
+	size = sizeof *hdr + nblocks * sizeof *blk + noffs * sizeof *offs;
+	hdr = calloc(1, size);
+	if (!hdr)
+		return;
+	memcpy(hdr->magic, LKCDIDX_MAGIC, LKCDIDX_MAGIC_LEN);
+	hdr->version = LKCDIDX_VERSION;
+	hdr->page_shift = get_page_shift(ctx);
+	hdr->key = lkcdp->index_key;
+	hdr->data_offset = lkcdp->data_offset;
+	hdr->end_offset = lkcdp->end_offset;
+	hdr->max_pfn = lkcdp->max_pfn;
+	hdr->nblocks = nblocks;
+	hdr->noffs = noffs;
+
+	blk = (struct lkcdidx_block *) (hdr + 1);
+	offs = (uint32_t *) (blk + nblocks);
+	for (i = 0; i < lkcdp->l1_size; ++i) {
+		if (!lkcdp->pfn_level1[i])
+			continue;
+		for (j = 0; j < PFN_IDX2_SIZE; ++j)
+			for (block = lkcdp->pfn_level1[i][j]; block;
+			     block = block->next) {
+				blk->pfn = ((kdump_pfn_t) i <<
+					    (PFN_IDX2_BITS + PFN_IDX3_BITS)) |
+					(j << PFN_IDX3_BITS) | block->idx3;
+				blk->filepos = block->filepos;
+				blk->n = block->n;
+				++blk;
+				memcpy(offs, block->offs,
+				       block->n * sizeof *offs);
+				offs += block->n;
+			}
+	}
+	hdr->datahash = fnv64_update(FNV64_OFFSET, hdr + 1,
+				     size - sizeof *hdr);
+
+	lkcdp->index_data = hdr;
+	lkcdp->index_size = size;
+}
+
+/** Unlock the PFN block mutex.
+ * @param lkcdp  LKCD private data.
+ *
+ * If the page index has been serialized while the mutex was held, save
+ * it to the page index file after unlocking, so that other threads are
+ * not blocked by the file I/O.
+ */
+static void
+unlock_pfn_blocks(struct lkcd_priv *lkcdp)
+{
+	struct lkcdidx_header *data = lkcdp->index_data;
+	size_t size = lkcdp->index_size;
+
+	lkcdp->index_data = NULL;
+	mutex_unlock(&lkcdp->pfn_block_mutex);
+
+	if (data) {
+		save_file(lkcdp->index_path, data, size);
+		free(data);
+	}
+}
+
+/** Load the PFN block tree from the page index file.
+ * @param ctx  Dump file object.
+ * @returns    @c true on success, @c false if there is no valid index.
+ *
+ * On success, the PFN block tree is complete, so the dump file never
+ * has to be scanned.
+ */
+static bool
+lkcdidx_load(kdump_ctx_t *ctx)
+{
+	struct lkcd_priv *lkcdp = ctx->shared->fmtdata;
+	const struct lkcdidx_header *hdr;
+	const struct lkcdidx_block *blk;
+	const uint32_t *offs;
 	struct pfn_block *block;
+	size_t size, noffs, i;
+	char *buf;
+	bool ret = false;
+
+	buf = slurp_file(lkcdp->index_path, &size);
+	if (!buf)
+		return false;
+
+	hdr = (const struct lkcdidx_header *) buf;
+	if (size < sizeof *hdr ||
+	    memcmp(hdr->magic, LKCDIDX_MAGIC, LKCDIDX_MAGIC_LEN) ||
+	    hdr->version != LKCDIDX_VERSION ||
+	    hdr->page_shift != get_page_shift(ctx) ||
+	    memcmp(&hdr->key, &lkcdp->index_key, sizeof hdr->key) ||
+	    hdr->data_offset != lkcdp->data_offset ||
+	    hdr->end_offset < hdr->data_offset ||
+	    hdr->nblocks > (size - sizeof *hdr) / sizeof *blk ||
+	    hdr->noffs > (size - sizeof *hdr) / sizeof *offs ||
+	    size != sizeof *hdr + hdr->nblocks * sizeof *blk +
+		    hdr->noffs * sizeof *offs ||
+	    hdr->datahash != fnv64_update(FNV64_OFFSET, hdr + 1,
+					  size - sizeof *hdr))
+		goto out;
+
+	blk = (const struct lkcdidx_block *) (hdr + 1);
+	offs = (const uint32_t *) (blk + hdr->nblocks);
+	noffs = 0;
+	for (i = 0; i < hdr->nblocks; ++i, ++blk) {
+		if (blk->reserved || blk->pfn > UINT32_MAX ||
+		    pfn_idx3(blk->pfn) + blk->n >= PFN_IDX3_SIZE ||
+		    blk->n > hdr->noffs - noffs)
+			goto err;
+		block = alloc_pfn_block(ctx, blk->pfn);
+		if (!block)
+			goto err;
+		block->filepos = blk->filepos;
+		if (realloc_pfn_offs(block, blk->n) != KDUMP_OK)
+			goto err;
+		block->n = blk->n;
+		memcpy(block->offs, offs + noffs, blk->n * sizeof *offs);
+		noffs += blk->n;
+	}
+
+	lkcdp->last_offset = hdr->end_offset;
+	lkcdp->end_offset = hdr->end_offset;
+	lkcdp->max_pfn = hdr->max_pfn;
+	ret = true;
+	goto out;
+
+ err:
+	free_level1(lkcdp->pfn_level1, lkcdp->l1_size);
+	lkcdp->pfn_level1 = NULL;
+	lkcdp->l1_size = 0;
+	clear_error(ctx);
+ out:
+	free(buf);
+	return ret;
+}
+
+/** Page descriptor scan state. */
+struct desc_scan {
+	struct pfn_block *block; /**< Current PFN block, or @c NULL. */
+	kdump_pfn_t blocktbl;	 /**< First PFN of the level-3 table. */
+};
+
+/** Finish a page descriptor scan.
+ * @param scan  Scan state.
+ *
+ * Free unused space in the current PFN block.
+ */
+static void
+end_scan(struct desc_scan *scan)
+{
+	if (scan->block)
+		realloc_pfn_offs(scan->block, scan->block->n);
+	scan->block = NULL;
+}
+
+/** Add a page descriptor to the PFN index.
+ * @param ctx   Dump file object.
+ * @param scan  Scan state.
+ * @param dp    Page descriptor at @c last_offset.
+ * @param pfn   PFN of the page, set on success.
+ * @returns     Error status.
+ *
+ * Add the page descriptor to the PFN block tree and move @c last_offset
+ * past the page data. The descriptor must not be an end marker.
+ *
+ * The PFN block mutex must be held by the caller.
+ */
+static kdump_status
+index_page_desc(kdump_ctx_t *ctx, struct desc_scan *scan,
+		const struct dump_page *dp, kdump_pfn_t *pfn)
+{
+	struct lkcd_priv *lkcdp = ctx->shared->fmtdata;
+	struct pfn_block *block = scan->block;
+	off_t off = lkcdp->last_offset;
+	kdump_pfn_t curpfn;
 	unsigned short idx;
 	kdump_status res;
 
-	off = lkcdp->last_offset;
+	curpfn = dp->dp_address >> get_page_shift(ctx);
+	if (!block)
+		block = lookup_pfn_block(ctx, curpfn, MAX_PFN_GAP);
+	else if (scan->blocktbl != (curpfn & ~PFN_IDX3_MASK) ||
+		 !idx_fits_block(pfn_idx3(curpfn), block)) {
+		realloc_pfn_offs(block, block->n);
+		block = lookup_pfn_block(ctx, curpfn, MAX_PFN_GAP);
+	}
+	scan->block = block;
+	if (block && off - block->filepos > UINT32_MAX) {
+		idx = pfn_idx3(curpfn) - block->idx3;
+		res = split_pfn_block(ctx, block, idx);
+		if (res != KDUMP_OK)
+			return set_error(ctx, res,
+					 "Cannot split PFN block");
+		block = NULL;
+	}
+	if (block) {
+		idx = pfn_idx3(curpfn) - block->idx3;
+		if (!idx--)
+			return error_dup(ctx, off, block, curpfn);
+		if (idx >= block->n)
+			block->n = idx + 1;
+		if (block->n >= block->alloc) {
+			res = realloc_pfn_offs(block, PFN_IDX3_SIZE);
+			if (res != KDUMP_OK)
+				return error_pfn_offs(ctx, res);
+		}
+	}
+
+	scan->blocktbl = curpfn & ~PFN_IDX3_MASK;
+	if (!block) {
+		block = alloc_pfn_block(ctx, curpfn);
+		if (!block)
+			return KDUMP_ERR_SYSTEM;
+		block->filepos = off;
+	} else if (block->offs[idx] == 0)
+		block->offs[idx] = off - block->filepos;
+	else
+		return error_dup(ctx, off, block, curpfn);
+	scan->block = block;
+
+	if (curpfn >= lkcdp->max_pfn)
+		lkcdp->max_pfn = curpfn + 1;
+
+	lkcdp->last_offset = off + sizeof(struct dump_page) + dp->dp_size;
+	*pfn = curpfn;
+	return KDUMP_OK;
+}
+
+/** Add the next page descriptor to the PFN index.
+ * @param ctx   Dump file object.
+ * @param scan  Scan state.
+ * @param dp    Page descriptor, filled in on success.
+ * @param pfn   PFN of the page, set on success.
+ * @returns     Error status.
+ *
+ * Read the page descriptor at @c last_offset, add it to the PFN block
+ * tree and move @c last_offset past the page data. If the end of the
+ * dump has been reached, return @ref KDUMP_ERR_NODATA.
+ *
+ * The PFN block mutex must be held by the caller, and it must be
+ * released with @ref unlock_pfn_blocks to save the page index.
+ */
+static kdump_status
+scan_page_desc(kdump_ctx_t *ctx, struct desc_scan *scan,
+	       struct dump_page *dp, kdump_pfn_t *pfn)
+{
+	struct lkcd_priv *lkcdp = ctx->shared->fmtdata;
+	off_t off = lkcdp->last_offset;
+	kdump_status res;
+
 	if (off == lkcdp->end_offset)
 		return set_error(ctx, KDUMP_ERR_NODATA, "Page not found");
 
-	block = NULL;
-	do {
-		res = read_page_desc(ctx, dp, off);
-		if (res != KDUMP_OK) {
-			if (res == KDUMP_ERR_EOF)
-				lkcdp->end_offset = off;
-			if (block)
-				realloc_pfn_offs(block, block->n);
-			return res;
-		}
-
-		if (dp->dp_flags & DUMP_END) {
+	res = read_page_desc(ctx, dp, off);
+	if (res != KDUMP_OK) {
+		if (res == KDUMP_ERR_EOF)
 			lkcdp->end_offset = off;
-			if (block)
-				realloc_pfn_offs(block, block->n);
-			return set_error(ctx, KDUMP_ERR_NODATA, "Page not found");
-		}
+		end_scan(scan);
+		return res;
+	}
 
-		curpfn = dp->dp_address >> get_page_shift(ctx);
-		if (!block)
-			block = lookup_pfn_block(ctx, curpfn, MAX_PFN_GAP);
-		else if (blocktbl != (curpfn & ~PFN_IDX3_MASK) ||
-			 !idx_fits_block(pfn_idx3(curpfn), block)) {
-			realloc_pfn_offs(block, block->n);
-			block = lookup_pfn_block(ctx, curpfn, MAX_PFN_GAP);
-		}
-		if (block && off - block->filepos > UINT32_MAX) {
-			idx = pfn_idx3(curpfn) - block->idx3;
-			res = split_pfn_block(ctx, block, idx);
-			if (res != KDUMP_OK)
-				return set_error(ctx, res,
-						 "Cannot split PFN block");
-			block = NULL;
-		}
-		if (block) {
-			idx = pfn_idx3(curpfn) - block->idx3;
-			if (!idx--)
-				return error_dup(ctx, off, block, curpfn);
-			if (idx >= block->n)
-				block->n = idx + 1;
-			if (block->n >= block->alloc) {
-				res = realloc_pfn_offs(block, PFN_IDX3_SIZE);
-				if (res != KDUMP_OK)
-					return error_pfn_offs(ctx, res);
-			}
-		}
+	if (dp->dp_flags & DUMP_END) {
+		lkcdp->end_offset = off;
+		end_scan(scan);
+		if (lkcdp->index_path)
+			lkcdidx_serialize(ctx);
+		return set_error(ctx, KDUMP_ERR_NODATA, "Page not found");
+	}
 
-		blocktbl = curpfn & ~PFN_IDX3_MASK;
-		if (!block) {
-			block = alloc_pfn_block(ctx, curpfn);
-			if (!block)
-				return KDUMP_ERR_SYSTEM;
-			block->filepos = off;
-		} else if (block->offs[idx] == 0)
-			block->offs[idx] = off - block->filepos;
-		else
-			return error_dup(ctx, off, block, curpfn);
+	return index_page_desc(ctx, scan, dp, pfn);
+}
 
-		if (curpfn >= lkcdp->max_pfn)
-			lkcdp->max_pfn = curpfn + 1;
+static kdump_status
+search_page_desc(kdump_ctx_t *ctx, kdump_pfn_t pfn,
+		 struct dump_page *dp, off_t *dataoff)
+{
+	struct lkcd_priv *lkcdp = ctx->shared->fmtdata;
+	struct desc_scan scan;
+	kdump_pfn_t curpfn;
+	kdump_status res;
 
-		off += sizeof(struct dump_page) + dp->dp_size;
-		lkcdp->last_offset = off;
+	scan.block = NULL;
+	do {
+		res = scan_page_desc(ctx, &scan, dp, &curpfn);
+		if (res != KDUMP_OK)
+			return res;
 	} while (curpfn != pfn);
 
-	*dataoff = off - dp->dp_size;
+	*dataoff = lkcdp->last_offset - dp->dp_size;
 	return KDUMP_OK;
 }
 
@@ -686,7 +986,7 @@ get_page_desc(kdump_ctx_t *ctx, kdump_pfn_t pfn,
 	} else
 		status = search_page_desc(ctx, pfn, dp, dataoff);
 
-	mutex_unlock(&lkcdp->pfn_block_mutex);
+	unlock_pfn_blocks(lkcdp);
 
 	return status;
 }
@@ -705,10 +1005,8 @@ lkcd_max_pfn_revalidate(kdump_ctx_t *ctx, struct attr_data *attr)
 		struct dump_page dummy_dp;
 		off_t dummy_off;
 
-		mutex_lock(&ctx->shared->cache_lock);
 		res = search_page_desc(ctx, ~(kdump_pfn_t)0,
 				       &dummy_dp, &dummy_off);
-		mutex_unlock(&ctx->shared->cache_lock);
 		if (res == KDUMP_ERR_NODATA) {
 			clear_error(ctx);
 			res = KDUMP_OK;
@@ -728,13 +1026,235 @@ lkcd_max_pfn_revalidate(kdump_ctx_t *ctx, struct attr_data *attr)
 		res = set_attr(ctx, attr, ATTR_DEFAULT, &val);
 	}
 
-	mutex_unlock(&lkcdp->pfn_block_mutex);
+	unlock_pfn_blocks(lkcdp);
 
 	if (res == KDUMP_OK && parent_revalidate)
 		res = parent_revalidate(ctx, attr);
 	return res;
 }
 
+#if USE_PTHREAD
+
+/** Number of page descriptors indexed by the index builder at once. */
+#define INDEXER_BATCH	256
+
+/** Page descriptor read by the index builder. */
+struct indexer_desc {
+	off_t off;		/**< File offset of the descriptor. */
+	struct dump_page dp;	/**< Page descriptor. */
+};
+
+/** Read a batch of page descriptors for the index builder.
+ * @param ctx    Helper context of the index builder.
+ * @param batch  Page descriptors, filled in on return.
+ * @returns      Number of page descriptors in @p batch.
+ *
+ * Read page descriptors from @c last_offset without holding the PFN
+ * block mutex. Reading stops before an end marker or an error, and
+ * the descriptors are not added to the PFN index.
+ */
+static unsigned
+indexer_read_batch(kdump_ctx_t *ctx, struct indexer_desc *batch)
+{
+	struct lkcd_priv *lkcdp = ctx->shared->fmtdata;
+	off_t off, end;
+	unsigned n;
+
+	mutex_lock(&lkcdp->pfn_block_mutex);
+	off = lkcdp->last_offset;
+	end = lkcdp->end_offset;
+	mutex_unlock(&lkcdp->pfn_block_mutex);
+
+	for (n = 0; n < INDEXER_BATCH && off != end; ++n) {
+		if (read_page_desc(ctx, &batch[n].dp, off) != KDUMP_OK) {
+			clear_error(ctx);
+			break;
+		}
+		if (batch[n].dp.dp_flags & DUMP_END)
+			break;
+		batch[n].off = off;
+		off += sizeof(struct dump_page) + batch[n].dp.dp_size;
+	}
+	return n;
+}
+
+/** Add a batch of page descriptors to the PFN index.
+ * @param ctx    Helper context of the index builder.
+ * @param batch  Page descriptors.
+ * @param n      Number of page descriptors in @p batch.
+ * @returns      Error status.
+ *
+ * A reader may have continued the scan since the batch was read, so
+ * descriptors before @c last_offset are skipped. If @p n is zero, the
+ * next descriptor is scanned with the PFN block mutex held to handle
+ * the end of the dump and errors.
+ */
+static kdump_status
+indexer_add_batch(kdump_ctx_t *ctx, const struct indexer_desc *batch,
+		  unsigned n)
+{
+	struct lkcd_priv *lkcdp = ctx->shared->fmtdata;
+	struct desc_scan scan;
+	struct dump_page dp;
+	kdump_pfn_t pfn;
+	kdump_status res;
+	unsigned i;
+
+	mutex_lock(&lkcdp->pfn_block_mutex);
+	scan.block = NULL;
+	res = KDUMP_OK;
+	if (!n)
+		res = scan_page_desc(ctx, &scan, &dp, &pfn);
+	for (i = 0; i < n && res == KDUMP_OK; ++i)
+		if (batch[i].off == lkcdp->last_offset)
+			res = index_page_desc(ctx, &scan, &batch[i].dp, &pfn);
+	end_scan(&scan);
+	unlock_pfn_blocks(lkcdp);
+
+	return res;
+}
+
+/** Index builder thread.
+ * @param arg  Helper context.
+ * @returns    Always @c NULL.
+ *
+ * Scan the dump file and add all page descriptors to the PFN block
+ * tree. Page descriptors are read in batches without holding the PFN
+ * block mutex, so pages which are already indexed can be read
+ * meanwhile. If a page is read which has not been indexed yet, the
+ * reader continues the same scan.
+ *
+ * The shared lock is taken for reading around each batch, so the thread
+ * waits while the shared data is locked for writing.
+ *
+ * Errors are ignored here. They will be reported if an affected page
+ * is actually read.
+ */
+static void *
+lkcd_indexer(void *arg)
+{
+	kdump_ctx_t *ctx = arg;
+	struct lkcd_priv *lkcdp = ctx->shared->fmtdata;
+	struct indexer_desc batch[INDEXER_BATCH];
+	kdump_status res;
+	unsigned n;
+
+	do {
+		rwlock_rdlock(&ctx->shared->lock);
+		n = indexer_read_batch(ctx, batch);
+		res = indexer_add_batch(ctx, batch, n);
+		rwlock_unlock(&ctx->shared->lock);
+	} while (res == KDUMP_OK &&
+		 !__atomic_load_n(&lkcdp->indexer_stop, __ATOMIC_RELAXED));
+
+	clear_error(ctx);
+	return NULL;
+}
+
+/** Start the index builder thread.
+ * @param ctx  Dump file object.
+ * @returns    Error status.
+ *
+ * The shared data must be locked for writing by the caller.
+ */
+static kdump_status
+start_indexer(kdump_ctx_t *ctx)
+{
+	struct lkcd_priv *lkcdp = ctx->shared->fmtdata;
+	int err;
+
+	lkcdp->indexer_ctx = helper_ctx_new(ctx->shared);
+	if (!lkcdp->indexer_ctx)
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot allocate %s", "index builder context");
+
+	lkcdp->indexer_stop = false;
+	err = pthread_create(&lkcdp->indexer, NULL, lkcd_indexer,
+			     lkcdp->indexer_ctx);
+	if (err) {
+		helper_ctx_free(lkcdp->indexer_ctx);
+		lkcdp->indexer_ctx = NULL;
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot create index builder thread: %s",
+				 strerror(err));
+	}
+
+	return KDUMP_OK;
+}
+
+/** Stop the index builder thread.
+ * @param lkcdp  LKCD private data.
+ *
+ * The index builder blocks on the shared lock, so the caller must not
+ * hold it. The thread is started as the last step of a successful
+ * probe, so it is stopped only when the shared data is freed.
+ */
+static void
+stop_indexer(struct lkcd_priv *lkcdp)
+{
+	if (!lkcdp->indexer_ctx)
+		return;
+
+	__atomic_store_n(&lkcdp->indexer_stop, true, __ATOMIC_RELAXED);
+	pthread_join(lkcdp->indexer, NULL);
+	helper_ctx_free(lkcdp->indexer_ctx);
+	lkcdp->indexer_ctx = NULL;
+}
+
+#else  /* USE_PTHREAD */
+
+static kdump_status
+start_indexer(kdump_ctx_t *ctx)
+{
+	/* Build the index on demand. */
+	return KDUMP_OK;
+}
+
+static void
+stop_indexer(struct lkcd_priv *lkcdp)
+{
+}
+
+#endif	/* USE_PTHREAD */
+
+/** Initialize the page index.
+ * @param ctx  Dump file object.
+ * @returns    Error status.
+ *
+ * Load the page index from the index file if "file.page_index_dir"
+ * is set and a valid index exists. Otherwise, start the index builder
+ * if "file.page_index_thread" is set.
+ */
+static kdump_status
+init_index(kdump_ctx_t *ctx)
+{
+	struct lkcd_priv *lkcdp = ctx->shared->fmtdata;
+	struct attr_data *attr;
+
+	attr = gattr(ctx, GKI_file_page_index_dir);
+	if (attr_isset(attr) &&
+	    get_file_key(ctx->shared->fcache, 0, LKCDIDX_HASH_SIZE,
+			 &lkcdp->index_key)) {
+		if (asprintf(&lkcdp->index_path, "%s/%016"PRIx64"-%"PRIx64
+			     ".lkcdidx", attr_value(attr)->string,
+			     lkcdp->index_key.hash,
+			     lkcdp->index_key.filesz) < 0) {
+			lkcdp->index_path = NULL;
+			return set_error(ctx, KDUMP_ERR_SYSTEM,
+					 "Cannot allocate %s",
+					 "page index file path");
+		}
+		if (lkcdidx_load(ctx))
+			return KDUMP_OK;
+	}
+
+	attr = gattr(ctx, GKI_file_page_index_thread);
+	if (attr_isset(attr) && attr_value(attr)->number)
+		return start_indexer(ctx);
+
+	return KDUMP_OK;
+}
+
 static kdump_status
 lkcd_read_page(struct page_io *pio)
 {
@@ -745,13 +1265,12 @@ lkcd_read_page(struct page_io *pio)
 	unsigned type;
 	off_t off;
 	void *buf;
+	uint64_t start;
 	kdump_status ret;
 
-	mutex_lock(&ctx->shared->cache_lock);
 	off = 0;
 	pfn = pio->addr.addr >> get_page_shift(ctx);
 	ret = get_page_desc(ctx, pfn, &dp, &off);
-	mutex_unlock(&ctx->shared->cache_lock);
 	if (ret != KDUMP_OK)
 		return ret;
 
@@ -777,9 +1296,9 @@ lkcd_read_page(struct page_io *pio)
 	}
 
 	/* read page data */
-	mutex_lock(&ctx->shared->cache_lock);
+	start = stats_start(ctx->shared);
 	ret = fcache_pread(ctx->shared->fcache, buf, dp.dp_size, 0, off);
-	mutex_unlock(&ctx->shared->cache_lock);
+	stats_end(ctx->shared, STAGE_io, start);
 	if (ret != KDUMP_OK)
 		return set_error(ctx, ret,
 				 "Cannot read page data at %llu",
@@ -790,7 +1309,11 @@ lkcd_read_page(struct page_io *pio)
 
 	if (lkcdp->compression == DUMP_COMPRESS_RLE) {
 		size_t retlen = get_page_size(ctx);
-		int ret = uncompress_rle(pio->chunk.data, &retlen, buf, dp.dp_size);
+		int ret;
+
+		start = stats_start(ctx->shared);
+		ret = uncompress_rle(pio->chunk.data, &retlen, buf, dp.dp_size);
+		stats_end(ctx->shared, STAGE_rle, start);
 		if (ret)
 			return set_error(ctx, KDUMP_ERR_CORRUPT,
 					 "Decompression failed: %d", ret);
@@ -799,7 +1322,8 @@ lkcd_read_page(struct page_io *pio)
 					 "Wrong uncompressed size: %lu",
 					 (unsigned long) retlen);
 	} else if (lkcdp->compression == DUMP_COMPRESS_GZIP) {
-		ret = uncompress_page_gzip(ctx, pio->chunk.data, buf, dp.dp_size);
+		ret = uncompress_page_gzip(ctx, ctx->data[lkcdp->decomp_slot],
+					   pio->chunk.data, buf, dp.dp_size);
 		if (ret != KDUMP_OK)
 			return ret;
 	} else
@@ -813,7 +1337,7 @@ lkcd_read_page(struct page_io *pio)
 static kdump_status
 lkcd_get_page(struct page_io *pio)
 {
-	return cache_get_page(pio, lkcd_read_page);
+	return cache_get_page(pio, lkcd_read_page, NULL);
 }
 
 /** Reallocate buffer for compressed data.
@@ -832,7 +1356,7 @@ lkcd_realloc_compressed(kdump_ctx_t *ctx, struct attr_data *attr)
 	struct lkcd_priv *lkcdp;
 	int newslot;
 
-	newslot = per_ctx_alloc(ctx->shared, attr_value(attr)->number);
+	newslot = per_ctx_alloc(ctx->shared, attr_value(attr)->number, NULL);
 	if (newslot < 0)
 		return set_error(ctx, KDUMP_ERR_SYSTEM,
 				 "Cannot allocate buffer for compressed data");
@@ -944,12 +1468,22 @@ open_common(kdump_ctx_t *ctx, void *hdr)
 	}
 	lkcdp->pfn_level1 = NULL;
 	lkcdp->l1_size = 0;
+	lkcdp->index_path = NULL;
+	lkcdp->index_data = NULL;
+#if USE_PTHREAD
+	lkcdp->indexer_ctx = NULL;
+#endif
 
 	attr_add_override(gattr(ctx, GKI_page_size),
 			  &lkcdp->page_size_override);
 	lkcdp->page_size_override.ops.post_set = lkcd_realloc_compressed;
 	lkcdp->cbuf_slot = -1;
 
+	lkcdp->decomp_slot = decomp_alloc(ctx->shared);
+	if (lkcdp->decomp_slot < 0)
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot allocate decompression state");
+
 	ret = set_page_size(ctx, dump32toh(ctx, dh->dh_page_size));
 	if (ret != KDUMP_OK)
 		return ret;
@@ -986,6 +1520,13 @@ open_common(kdump_ctx_t *ctx, void *hdr)
 				lkcdp->version);
 	}
 
+	if (ret != KDUMP_OK)
+		goto err_free;
+
+	/* This must be the last step, because the index builder
+	 * cannot be stopped while the shared lock is held.
+	 */
+	ret = init_index(ctx);
 	if (ret != KDUMP_OK)
 		goto err_free;
 
@@ -1073,10 +1614,15 @@ lkcd_cleanup(struct kdump_shared *shared)
 	if (!lkcdp)
 		return;
 
+	stop_indexer(lkcdp);
+	free(lkcdp->index_path);
+	free(lkcdp->index_data);
 	free_level1(lkcdp->pfn_level1, lkcdp->l1_size);
 	mutex_destroy(&lkcdp->pfn_block_mutex);
 	if (lkcdp->cbuf_slot >= 0)
 		per_ctx_free(shared, lkcdp->cbuf_slot);
+	if (lkcdp->decomp_slot >= 0)
+		per_ctx_free(shared, lkcdp->decomp_slot);
 	free(lkcdp);
 	shared->fmtdata = NULL;
 }
@@ -264,6 +264,49 @@ const struct attr_ops file_fd_ops = {
 	.post_set = file_fd_post_hook,
 };
 
+/**  Apply the I/O engine attribute to the file cache.
+ * @param ctx   Dump file object.
+ * @param name  I/O engine name, or @c NULL for the default.
+ *
+ * If io_uring cannot be used, reads silently fall back to pread(2).
+ */
+static void
+apply_io_engine(kdump_ctx_t *ctx, const char *name)
+{
+	if (ctx->shared->fcache)
+		fcache_use_uring(ctx->shared->fcache,
+				 name && !strcmp(name, "uring"));
+}
+
+static kdump_status
+io_engine_pre_hook(kdump_ctx_t *ctx, struct attr_data *attr,
+		   kdump_attr_value_t *val)
+{
+	if (strcmp(val->string, "pread") && strcmp(val->string, "uring"))
+		return set_error(ctx, KDUMP_ERR_INVALID,
+				 "Unknown I/O engine: %s", val->string);
+	return KDUMP_OK;
+}
+
+static kdump_status
+io_engine_post_hook(kdump_ctx_t *ctx, struct attr_data *attr)
+{
+	apply_io_engine(ctx, attr_value(attr)->string);
+	return KDUMP_OK;
+}
+
+static void
+io_engine_clear_hook(kdump_ctx_t *ctx, struct attr_data *attr)
+{
+	apply_io_engine(ctx, NULL);
+}
+
+const struct attr_ops io_engine_ops = {
+	.pre_set = io_engine_pre_hook,
+	.post_set = io_engine_post_hook,
+	.pre_clear = io_engine_clear_hook,
+};
+
 /**  Open the dump.
  * @param ctx   Dump file object.
  * @returns     Error status.
@@ -286,6 +329,8 @@ open_dump(kdump_ctx_t *ctx)
 	size_t nfiles = get_num_files(ctx);
 	struct attr_data *dir;
 	struct attr_data *mmap_attr;
+	struct attr_data *io_attr;
+	struct attr_data *ra_attr;
 	kdump_status ret;
 	int fdset[nfiles];
 	int i;
@@ -315,6 +360,14 @@ open_dump(kdump_ctx_t *ctx)
 	set_attr(ctx, mmap_attr, ATTR_PERSIST_INDIRECT,
 		 &ctx->shared->fcache->mmap_policy);
 
+	ra_attr = gattr(ctx, GKI_cache_readahead);
+	if (attr_isset(ra_attr) && attr_value(ra_attr)->number)
+		fcache_advise(ctx->shared->fcache, true);
+
+	io_attr = gattr(ctx, GKI_file_io_engine);
+	if (attr_isset(io_attr))
+		apply_io_engine(ctx, attr_value(io_attr)->string);
+
 	cache_set_attrs(ctx->shared->fcache->cache, ctx,
 			gattr(ctx, GKI_mmap_cache_hits),
 			gattr(ctx, GKI_mmap_cache_misses));
@@ -322,6 +375,10 @@ open_dump(kdump_ctx_t *ctx)
 			gattr(ctx, GKI_read_cache_hits),
 			gattr(ctx, GKI_read_cache_misses));
 
+	ret = update_cache_wait(ctx);
+	if (ret != KDUMP_OK)
+		return ret;
+
 	ctx->shared->flatmap = flatmap_alloc(nfiles);
 	if (!ctx->shared->flatmap)
 		return set_error(ctx, KDUMP_ERR_SYSTEM,
@@ -345,7 +402,7 @@ open_dump(kdump_ctx_t *ctx)
 
 		ctx->shared->ops = NULL;
 		if (ctx->shared->cache) {
-			cache_free(ctx->shared->cache);
+			page_cache_free(ctx->shared->cache);
 			ctx->shared->cache = NULL;
 		}
 		clear_volatile_attrs(ctx);
@@ -37,26 +37,50 @@
 
 /** Get a page from the default cache.
  *
- * @param pio  Page I/O control.
- * @param fn   Read function.
- * @returns    Error status.
+ * @param pio     Page I/O control.
+ * @param fn      Read function.
+ * @param zerofn  Zero page check, or @c NULL.
+ * @returns       Error status.
  *
  * If the page is not currently found in the cache, read it using
- * the read function.
+ * the read function. If readahead is enabled, sequential access is
+ * detected here and the following pages are queued for prefetching.
+ *
+ * If @p zerofn is not @c NULL, it is called for pages which are not
+ * in the cache before a cache entry is allocated. If it returns
+ * @c true, the page is served from the zero page. The read function
+ * may also call @ref get_zero_page instead of filling the cache entry;
+ * the entry is discarded in that case.
  */
 kdump_status
-cache_get_page(struct page_io *pio, read_page_fn *fn)
+cache_get_page(struct page_io *pio, read_page_fn *fn, zero_page_fn *zerofn)
 {
 	kdump_ctx_t *ctx = pio->ctx;
+	cache_key_t key = pio->addr.addr | pio->addr.as;
+	struct cache_shard *shard;
 	struct cache_entry *entry;
 	kdump_status ret;
-
-	mutex_lock(&ctx->shared->cache_lock);
+	uint64_t start;
+
+	if (ctx->shared->readahead)
+		readahead_note(pio, fn);
+
+	shard = page_cache_shard(ctx->shared->cache, key);
+	start = stats_start(ctx->shared);
+	mutex_lock(&shard->lock);
+	stats_end(ctx->shared, STAGE_lock, start);
+	if (zerofn && !cache_has_key(shard->cache, key)) {
+		mutex_unlock(&shard->lock);
+		if (zerofn(pio))
+			return get_zero_page(pio);
+		mutex_lock(&shard->lock);
+	}
 	pio->chunk.nent = 1;
-	pio->chunk.embed_fces->cache = ctx->shared->cache;
-	entry = cache_get_entry(pio->chunk.embed_fces->cache,
-				pio->addr.addr | pio->addr.as);
-	mutex_unlock(&ctx->shared->cache_lock);
+	pio->chunk.embed_fces->cache = shard->cache;
+	start = stats_start(ctx->shared);
+	entry = cache_get_entry_wait(shard->cache, key, &shard->lock);
+	stats_end(ctx->shared, STAGE_cache, start);
+	mutex_unlock(&shard->lock);
 	if (!entry)
 		return set_error(ctx, KDUMP_ERR_BUSY,
 				 "Cache is fully utilized");
@@ -67,12 +91,14 @@ cache_get_page(struct page_io *pio, read_page_fn *fn)
 		return KDUMP_OK;
 
 	ret = fn(pio);
-	mutex_lock(&ctx->shared->cache_lock);
-	if (ret == KDUMP_OK)
-		cache_insert(pio->chunk.embed_fces->cache, entry);
+	start = stats_start(ctx->shared);
+	mutex_lock(&shard->lock);
+	stats_end(ctx->shared, STAGE_lock, start);
+	if (ret == KDUMP_OK && pio->chunk.data == entry->data)
+		cache_insert(shard->cache, entry);
 	else
-		cache_discard(pio->chunk.embed_fces->cache, entry);
-	mutex_unlock(&ctx->shared->cache_lock);
+		cache_discard(shard->cache, entry);
+	mutex_unlock(&shard->lock);
 	return ret;
 }
 
@@ -82,7 +108,25 @@ cache_get_page(struct page_io *pio, read_page_fn *fn)
 void
 cache_put_page(struct page_io *pio)
 {
-	fcache_put_chunk(&pio->chunk);
+	if (pio->chunk.data != pio->ctx->shared->cache->zero_page)
+		fcache_put_chunk(&pio->chunk);
+}
+
+/** Get the shared zero page.
+ * @param pio  Page I/O control.
+ * @returns    Always @c KDUMP_OK.
+ *
+ * Use this for pages which are known to contain only zeroes. The
+ * zero page is read-only and does not occupy any cache entry, so
+ * reading empty memory does not evict other pages from the cache.
+ * The page must be released with @ref cache_put_page.
+ */
+kdump_status
+get_zero_page(struct page_io *pio)
+{
+	pio->chunk.data = pio->ctx->shared->cache->zero_page;
+	pio->chunk.nent = 0;
+	return KDUMP_OK;
 }
 
 static addrxlat_status
@@ -107,6 +151,7 @@ get_page_xlat(struct page_io *pio)
 	addrxlat_op_ctl_t ctl;
 	kdump_status status;
 	addrxlat_status xlaterr;
+	uint64_t start;
 
 	status = revalidate_xlat(ctx);
 	if (status != KDUMP_OK)
@@ -118,7 +163,9 @@ get_page_xlat(struct page_io *pio)
 	ctl.data = pio;
 	ctl.caps = ctx->xlat->xlat_caps;
 
+	start = stats_start(ctx->shared);
 	xlaterr = addrxlat_op(&ctl, &pio->addr);
+	stats_end(ctx->shared, STAGE_xlat, start);
 	if (xlaterr != ADDRXLAT_OK)
 		return set_error(ctx, addrxlat2kdump(ctx, xlaterr),
 				 "Cannot get page I/O address");
@@ -137,6 +184,115 @@ get_page_maybe_xlat(struct page_io *pio)
 		: get_page_xlat(pio);
 }
 
+/**  State of a translated range read.
+ */
+struct read_range {
+	kdump_ctx_t *ctx;	/**< Dump file object. */
+	void *buffer;		/**< Buffer for the next extent. */
+	size_t done;		/**< Number of bytes read so far. */
+	kdump_status status;	/**< Status of the last page read. */
+	uint64_t start;		/**< Start of address translation. */
+};
+
+/**  Read one extent of a translated range.
+ * @param data  Range read state.
+ * @param addr  Translated start address of the extent.
+ * @param size  Size of the extent.
+ * @returns     Error status.
+ *
+ * Time spent here is not accounted to address translation.
+ */
+static addrxlat_status
+read_range_op(void *data, const addrxlat_fulladdr_t *addr,
+	      addrxlat_addr_t size)
+{
+	struct read_range *rr = data;
+	kdump_ctx_t *ctx = rr->ctx;
+	kdump_addr_t pos = addr->addr;
+	struct page_io pio;
+	uint64_t start;
+
+	start = stats_start(ctx->shared);
+	while (size) {
+		size_t off, partlen;
+
+		pio.ctx = ctx;
+		pio.addr.as = addr->as;
+		pio.addr.addr = page_align(ctx, pos);
+		rr->status = get_page(&pio);
+		if (rr->status != KDUMP_OK)
+			break;
+
+		off = pos % get_page_size(ctx);
+		partlen = get_page_size(ctx) - off;
+		if (partlen > size)
+			partlen = size;
+		memcpy(rr->buffer, pio.chunk.data + off, partlen);
+		put_page(&pio);
+		pos += partlen;
+		rr->buffer += partlen;
+		rr->done += partlen;
+		size -= partlen;
+	}
+	if (start && rr->start)
+		rr->start += stats_clock() - start;
+
+	return kdump2addrxlat(ctx, rr->status);
+}
+
+/**  Read a range which needs address translation.
+ * @param         ctx      Dump file object.
+ * @param[in]     as       Address space of @p addr.
+ * @param[in]     addr     Any type of address.
+ * @param[out]    buffer   Buffer to receive data.
+ * @param[in,out] plength  Length of the buffer.
+ * @returns                Error status.
+ *
+ * The whole range is translated with one call to @ref addrxlat_op_range,
+ * so page tables are not walked again for each page.
+ */
+static kdump_status
+read_xlat_range(kdump_ctx_t *ctx, kdump_addrspace_t as, kdump_addr_t addr,
+		void *buffer, size_t *plength)
+{
+	struct read_range rr;
+	addrxlat_op_ctl_t ctl;
+	addrxlat_fulladdr_t faddr;
+	addrxlat_status xlaterr;
+	kdump_status status;
+
+	status = revalidate_xlat(ctx);
+	if (status != KDUMP_OK) {
+		*plength = 0;
+		return status;
+	}
+
+	rr.ctx = ctx;
+	rr.buffer = buffer;
+	rr.done = 0;
+	rr.status = KDUMP_OK;
+
+	ctl.ctx = ctx->xlatctx;
+	ctl.sys = ctx->xlat->xlatsys;
+	ctl.op = NULL;
+	ctl.data = &rr;
+	ctl.caps = ctx->xlat->xlat_caps;
+
+	faddr.as = as;
+	faddr.addr = addr;
+	rr.start = stats_start(ctx->shared);
+	xlaterr = addrxlat_op_range(&ctl, read_range_op, &faddr, *plength);
+	stats_end(ctx->shared, STAGE_xlat, rr.start);
+
+	*plength = rr.done;
+	if (rr.status != KDUMP_OK)
+		return addrxlat2kdump(ctx, xlaterr);
+	if (xlaterr != ADDRXLAT_OK)
+		return set_error(ctx, addrxlat2kdump(ctx, xlaterr),
+				 "Cannot get page I/O address");
+	return KDUMP_OK;
+}
+
 /**  Internal version of @ref kdump_read
  * @param         ctx      Dump file object.
  * @param[in]     as       Address space of @p addr.
@@ -158,6 +314,10 @@ read_locked(kdump_ctx_t *ctx, kdump_addrspace_t as, kdump_addr_t addr,
 	size_t remain;
 	kdump_status ret;
 
+	if (!(ctx->xlat->xlat_caps & ADDRXLAT_CAPS(as)) &&
+	    addr % get_page_size(ctx) + *plength > get_page_size(ctx))
+		return read_xlat_range(ctx, as, addr, buffer, plength);
+
 	ret = KDUMP_OK;
 	remain = *plength;
 	while (remain) {
@@ -192,12 +352,418 @@ kdump_read(kdump_ctx_t *ctx, kdump_addrspace_t as, kdump_addr_t addr,
 	kdump_status ret;
 
 	clear_error(ctx);
-	rwlock_rdlock(&ctx->shared->lock);
+	shared_rdlock(ctx->shared);
 	ret = read_locked(ctx, as, addr, buffer, plength);
 	rwlock_unlock(&ctx->shared->lock);
 	return ret;
 }
 
+/**  Part of a vectored read request within a single page.
+ */
+struct read_frag {
+	kdump_addrspace_t as;	/**< Address space of @c page. */
+	kdump_addr_t page;	/**< Page-aligned address. */
+	size_t idx;		/**< Index of the request element. */
+	size_t off;		/**< Offset in the element buffer. */
+	size_t pgoff;		/**< Offset in the page. */
+	size_t len;		/**< Length of the fragment. */
+};
+
+/**  Compare two read fragments by page.
+ * @param a  First fragment.
+ * @param b  Second fragment.
+ * @returns  Negative, zero or positive, as required by @c qsort.
+ *
+ * Fragments of the same page are ordered by their request element,
+ * so the sort order is fully deterministic.
+ */
+static int
+frag_cmp(const void *a, const void *b)
+{
+	const struct read_frag *fa = a, *fb = b;
+
+	if (fa->as != fb->as)
+		return fa->as < fb->as ? -1 : 1;
+	if (fa->page != fb->page)
+		return fa->page < fb->page ? -1 : 1;
+	if (fa->idx != fb->idx)
+		return fa->idx < fb->idx ? -1 : 1;
+	return fa->off < fb->off ? -1 : fa->off > fb->off;
+}
+
+/**  Split vectored read requests into page fragments.
+ * @param ctx  Dump file object.
+ * @param iov  Read requests.
+ * @param n    Number of elements in @p iov.
+ * @param pnfrags  Set to the number of fragments on success.
+ * @returns    Array of read fragments sorted by page, or @c NULL.
+ *
+ * The status of all request elements is reset to @ref KDUMP_OK.
+ * If there is nothing to read, this function returns @c NULL and
+ * sets @p pnfrags to zero.
+ */
+static struct read_frag *
+split_read_vec(kdump_ctx_t *ctx, struct kdump_iovec *iov, size_t n,
+	       size_t *pnfrags)
+{
+	size_t pgsz = get_page_size(ctx);
+	struct read_frag *frags, *frag;
+	size_t i, nfrags;
+
+	nfrags = 0;
+	for (i = 0; i < n; ++i) {
+		iov[i].status = KDUMP_OK;
+		if (iov[i].len)
+			nfrags += (iov[i].addr % pgsz + iov[i].len - 1) / pgsz
+				+ 1;
+	}
+	*pnfrags = nfrags;
+	if (!nfrags)
+		return NULL;
+
+	frags = malloc(nfrags * sizeof(*frags));
+	if (!frags)
+		return NULL;
+
+	frag = frags;
+	for (i = 0; i < n; ++i) {
+		kdump_addr_t addr = iov[i].addr;
+		size_t off = 0;
+
+		while (off < iov[i].len) {
+			frag->as = iov[i].as;
+			frag->page = page_align(ctx, addr);
+			frag->idx = i;
+			frag->off = off;
+			frag->pgoff = addr - frag->page;
+			frag->len = pgsz - frag->pgoff;
+			if (frag->len > iov[i].len - off)
+				frag->len = iov[i].len - off;
+			addr += frag->len;
+			off += frag->len;
+			++frag;
+		}
+	}
+
+	qsort(frags, nfrags, sizeof(*frags), frag_cmp);
+	return frags;
+}
+
+/**  State of a vectored read.
+ */
+struct read_vec {
+	kdump_ctx_t *ctx;	  /**< Dump file object. */
+	struct kdump_iovec *iov;  /**< Read requests. */
+	struct read_frag *frag;	  /**< First fragment of the current page. */
+	struct read_frag *end;	  /**< End of the fragment array. */
+	size_t pgpos;		  /**< Bytes of the current page done. */
+	size_t fail_idx;	  /**< Lowest index of a failed element. */
+	char *fail_msg;		  /**< Error message for @c fail_idx. */
+	uint64_t start;		  /**< Start of address translation. */
+};
+
+/**  Record the failure of a request element.
+ * @param rv      Vectored read state.
+ * @param idx     Index of the request element.
+ * @param off     Offset of the failure in the element buffer.
+ * @param status  Error status.
+ *
+ * Only the first failure of each element is kept. The error message
+ * is saved if this is the lowest failed element index so far.
+ */
+static void
+read_vec_fail(struct read_vec *rv, size_t idx, size_t off,
+	      kdump_status status)
+{
+	struct kdump_iovec *elem = &rv->iov[idx];
+
+	if (off >= elem->len)
+		return;
+	elem->len = off;
+	if (elem->status != KDUMP_OK)
+		return;
+	elem->status = status;
+
+	if (idx < rv->fail_idx) {
+		const char *msg = err_str(&rv->ctx->err);
+		rv->fail_idx = idx;
+		free(rv->fail_msg);
+		rv->fail_msg = strdup(msg ? msg : kdump_strerror(status));
+	}
+}
+
+/**  Process a part of the current page.
+ * @param rv      Vectored read state.
+ * @param status  Status of the page read.
+ * @param data    Page data at the current position (if successful).
+ * @param len     Length of the part.
+ *
+ * Copy data to all fragments of the current page which overlap the
+ * part, or mark them as failed. Then advance the current position,
+ * moving to the next page after the last part of the current page.
+ */
+static void
+read_vec_part(struct read_vec *rv, kdump_status status,
+	      const char *data, size_t len)
+{
+	struct read_frag *page = rv->frag, *frag;
+	size_t lo = rv->pgpos, hi = lo + len;
+
+	for (frag = page; frag < rv->end; ++frag) {
+		size_t fstart, fend;
+
+		if (frag->as != page->as || frag->page != page->page)
+			break;
+		fstart = frag->pgoff > lo ? frag->pgoff : lo;
+		fend = frag->pgoff + frag->len;
+		if (fend > hi)
+			fend = hi;
+		if (fstart >= fend)
+			continue;
+
+		if (status == KDUMP_OK)
+			memcpy(rv->iov[frag->idx].buf + frag->off +
+			       fstart - frag->pgoff,
+			       data + fstart - lo, fend - fstart);
+		else
+			read_vec_fail(rv, frag->idx,
+				      frag->off + fstart - frag->pgoff,
+				      status);
+	}
+	if (status != KDUMP_OK)
+		clear_error(rv->ctx);
+
+	rv->pgpos = hi;
+	if (hi >= get_page_size(rv->ctx)) {
+		rv->frag = frag;
+		rv->pgpos = 0;
+	}
+}
+
+/**  Read one extent of a translated fragment run.
+ * @param data  Vectored read state.
+ * @param addr  Translated start address of the extent.
+ * @param size  Size of the extent.
+ * @returns     Always @c ADDRXLAT_OK.
+ *
+ * Page read errors are recorded in the request elements, so the
+ * translation of the remaining pages continues.
+ * Time spent here is not accounted to address translation.
+ */
+static addrxlat_status
+read_vec_op(void *data, const addrxlat_fulladdr_t *addr,
+	    addrxlat_addr_t size)
+{
+	struct read_vec *rv = data;
+	kdump_ctx_t *ctx = rv->ctx;
+	size_t pgsz = get_page_size(ctx);
+	kdump_addr_t pos = addr->addr;
+	struct page_io pio;
+	kdump_status status;
+	uint64_t start;
+
+	start = stats_start(ctx->shared);
+	while (size) {
+		size_t off, partlen;
+
+		pio.ctx = ctx;
+		pio.addr.as = addr->as;
+		pio.addr.addr = page_align(ctx, pos);
+		status = get_page(&pio);
+
+		off = pos - pio.addr.addr;
+		partlen = pgsz - (off > rv->pgpos ? off : rv->pgpos);
+		if (partlen > size)
+			partlen = size;
+		if (status == KDUMP_OK) {
+			read_vec_part(rv, status, pio.chunk.data + off,
+				      partlen);
+			put_page(&pio);
+		} else
+			read_vec_part(rv, status, NULL, partlen);
+		pos += partlen;
+		size -= partlen;
+	}
+	if (start && rv->start)
+		rv->start += stats_clock() - start;
+
+	return ADDRXLAT_OK;
+}
+
+/**  Read a run of fragments which needs address translation.
+ * @param rv   Vectored read state.
+ * @param ctl  Address translation control.
+ * @param end  End of the run.
+ *
+ * The run covers consecutive pages, and it is translated with as few
+ * calls to @ref addrxlat_op_range as possible. If translation fails,
+ * the fragments at the failing address are marked as failed, and
+ * translation restarts after them.
+ */
+static void
+read_vec_xlat(struct read_vec *rv, addrxlat_op_ctl_t *ctl,
+	      struct read_frag *end)
+{
+	kdump_ctx_t *ctx = rv->ctx;
+	size_t pgsz = get_page_size(ctx);
+	addrxlat_fulladdr_t faddr;
+	addrxlat_status xlaterr;
+	kdump_addr_t last = end[-1].page;
+
+	while (rv->frag < end) {
+		faddr.as = rv->frag->as;
+		faddr.addr = rv->frag->page + rv->pgpos;
+		rv->start = stats_start(ctx->shared);
+		xlaterr = addrxlat_op_range(ctl, read_vec_op, &faddr,
+					    last + pgsz - faddr.addr);
+		stats_end(ctx->shared, STAGE_xlat, rv->start);
+		if (xlaterr == ADDRXLAT_OK)
+			break;
+
+		read_vec_part(rv, set_error(ctx, addrxlat2kdump(ctx, xlaterr),
+					    "Cannot get page I/O address"),
+			      NULL, pgsz - rv->pgpos);
+	}
+}
+
+kdump_status
+kdump_read_vec(kdump_ctx_t *ctx, struct kdump_iovec *iov, size_t n)
+{
+	struct read_frag *frags, *next;
+	struct read_vec rv;
+	addrxlat_op_ctl_t ctl;
+	size_t i, nfrags, nfail;
+	struct page_io pio;
+	kdump_status ret;
+
+	clear_error(ctx);
+	shared_rdlock(ctx->shared);
+
+	frags = split_read_vec(ctx, iov, n, &nfrags);
+	if (!frags) {
+		rwlock_unlock(&ctx->shared->lock);
+		if (!nfrags)
+			return KDUMP_OK;
+		for (i = 0; i < n; ++i) {
+			iov[i].len = 0;
+			iov[i].status = KDUMP_ERR_SYSTEM;
+		}
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot allocate %zu read fragments",
+				 nfrags);
+	}
+
+	rv.ctx = ctx;
+	rv.iov = iov;
+	rv.frag = frags;
+	rv.end = frags + nfrags;
+	rv.pgpos = 0;
+	rv.fail_idx = n;
+	rv.fail_msg = NULL;
+
+	ctl.ctx = ctx->xlatctx;
+	ctl.sys = ctx->xlat->xlatsys;
+	ctl.op = NULL;
+	ctl.data = &rv;
+	ctl.caps = ctx->xlat->xlat_caps;
+
+	while (rv.frag < rv.end) {
+		if (ctx->xlat->xlat_caps & ADDRXLAT_CAPS(rv.frag->as)) {
+			pio.ctx = ctx;
+			pio.addr.as = rv.frag->as;
+			pio.addr.addr = rv.frag->page;
+			ret = get_page(&pio);
+			if (ret == KDUMP_OK) {
+				read_vec_part(&rv, ret, pio.chunk.data,
+					      get_page_size(ctx));
+				put_page(&pio);
+			} else
+				read_vec_part(&rv, ret, NULL,
+					      get_page_size(ctx));
+			continue;
+		}
+
+		/* Find a run of consecutive pages. */
+		for (next = rv.frag + 1; next < rv.end; ++next)
+			if (next->as != next[-1].as ||
+			    (next->page != next[-1].page &&
+			     next->page != next[-1].page +
+			     get_page_size(ctx)))
+				break;
+
+		ret = revalidate_xlat(ctx);
+		if (ret == KDUMP_OK)
+			read_vec_xlat(&rv, &ctl, next);
+		else
+			while (rv.frag < next)
+				read_vec_part(&rv, ret, NULL,
+					      get_page_size(ctx));
+	}
+
+	rwlock_unlock(&ctx->shared->lock);
+	free(frags);
+
+	ret = KDUMP_OK;
+	nfail = 0;
+	for (i = 0; i < n; ++i)
+		if (iov[i].status != KDUMP_OK)
+			++nfail;
+	if (nfail) {
+		ret = iov[rv.fail_idx].status;
+		set_error(ctx, ret, "Cannot read %zu of %zu elements"
+			  " (element %zu: %s)", nfail, n, rv.fail_idx,
+			  rv.fail_msg ? rv.fail_msg : kdump_strerror(ret));
+	}
+	free(rv.fail_msg);
+	return ret;
+}
+
+kdump_status
+kdump_get_page_ref(kdump_ctx_t *ctx, kdump_addrspace_t as, kdump_addr_t addr,
+		   const void **pdata, kdump_page_ref_t **pref)
+{
+	kdump_page_ref_t *ref;
+	kdump_status ret;
+
+	clear_error(ctx);
+
+	ref = malloc(sizeof(*ref));
+	if (!ref)
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot allocate page reference");
+
+	shared_rdlock(ctx->shared);
+	ref->pio.ctx = ctx;
+	ref->pio.addr.as = as;
+	ref->pio.addr.addr = page_align(ctx, addr);
+	ret = get_page_maybe_xlat(&ref->pio);
+	if (ret == KDUMP_OK)
+		__atomic_add_fetch(&ctx->shared->page_refs, 1,
+				   __ATOMIC_RELAXED);
+	rwlock_unlock(&ctx->shared->lock);
+
+	if (ret != KDUMP_OK) {
+		free(ref);
+		return ret;
+	}
+
+	*pdata = ref->pio.chunk.data;
+	*pref = ref;
+	return KDUMP_OK;
+}
+
+void
+kdump_put_page_ref(kdump_page_ref_t *ref)
+{
+	kdump_ctx_t *ctx = ref->pio.ctx;
+
+	shared_rdlock(ctx->shared);
+	put_page(&ref->pio);
+	__atomic_sub_fetch(&ctx->shared->page_refs, 1, __ATOMIC_RELAXED);
+	rwlock_unlock(&ctx->shared->lock);
+	free(ref);
+}
+
 /**  Internal version of @ref kdump_read_string.
  * @param      ctx   Dump file object.
  * @param[in]  as    Address space of @c addr.
@@ -265,7 +831,7 @@ kdump_read_string(kdump_ctx_t *ctx, kdump_addrspace_t as, kdump_addr_t addr,
 	kdump_status ret;
 
 	clear_error(ctx);
-	rwlock_rdlock(&ctx->shared->lock);
+	shared_rdlock(ctx->shared);
 	ret = read_string_locked(ctx, as, addr, pstr);
 	rwlock_unlock(&ctx->shared->lock);
 	return ret;
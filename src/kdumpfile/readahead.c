@@ -0,0 +1,405 @@
+/** @internal @file src/kdumpfile/readahead.c
+ * @brief Prefetching of pages for sequential reads.
+ */
+/* Copyright (C) Petr Tesarik <petr@tesarici.cz>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include "kdumpfile-priv.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of sequential page reads which trigger readahead.
+ * The first read of a sequence does not count, so readahead starts
+ * with the third page of a sequential scan.
+ */
+#define READAHEAD_MIN_SEQ	2
+
+#if USE_PTHREAD
+
+/**  Readahead request.
+ */
+struct readahead_req {
+	addrxlat_fulladdr_t addr; /**< Page address. */
+	read_page_fn *fn;	  /**< Read function. */
+};
+
+/**  Readahead worker thread.
+ */
+struct readahead_worker {
+	struct readahead *ra;	/**< Worker pool. */
+	kdump_ctx_t *ctx;	/**< Helper context of this thread. */
+	pthread_t thread;	/**< Thread identifier. */
+};
+
+/**  Readahead worker pool.
+ *
+ * Requests are stored in a ring buffer. If the buffer is full, new
+ * requests are not queued, because readahead is only a hint.
+ */
+struct readahead {
+	mutex_t lock;		/**< Protects all fields below. */
+	cond_t cond;		/**< Signalled when requests are queued. */
+	bool stop;		/**< Set when workers should terminate. */
+
+	unsigned window;	/**< Readahead window (in pages). */
+	unsigned size;		/**< Size of the request queue. */
+	unsigned head;		/**< Index of the first queued request. */
+	unsigned count;		/**< Number of queued requests. */
+	struct readahead_req *queue; /**< Request queue. */
+
+	unsigned nthreads;	/**< Number of running workers. */
+	struct readahead_worker worker[]; /**< Worker threads. */
+};
+
+/**  Load a page into the page cache.
+ * @param ctx  Helper context.
+ * @param req  Readahead request.
+ *
+ * Nothing is done if the page is already cached or being loaded, or
+ * if there is no free cache entry. Errors are silently ignored; they
+ * will be reported if the page is actually read.
+ *
+ * The shared lock must be held by the caller.
+ */
+static void
+prefetch_page(kdump_ctx_t *ctx, const struct readahead_req *req)
+{
+	cache_key_t key = req->addr.addr | req->addr.as;
+	struct cache_shard *shard;
+	struct cache_entry *entry;
+	struct page_io pio;
+	kdump_status status;
+
+	shard = page_cache_shard(ctx->shared->cache, key);
+	mutex_lock(&shard->lock);
+	entry = cache_has_key(shard->cache, key)
+		? NULL
+		: cache_get_entry(shard->cache, key);
+	mutex_unlock(&shard->lock);
+	if (!entry)
+		return;
+
+	pio.ctx = ctx;
+	pio.addr = req->addr;
+	pio.chunk.data = entry->data;
+	pio.chunk.nent = 1;
+	pio.chunk.embed_fces->cache = shard->cache;
+	pio.chunk.embed_fces->ce = entry;
+	status = req->fn(&pio);
+
+	mutex_lock(&shard->lock);
+	if (status == KDUMP_OK && pio.chunk.data == entry->data) {
+		cache_insert(shard->cache, entry);
+		cache_put_entry(shard->cache, entry);
+	} else
+		cache_discard(shard->cache, entry);
+	mutex_unlock(&shard->lock);
+
+	clear_error(ctx);
+}
+
+/**  Readahead worker thread.
+ * @param arg  Worker (@c struct @ref readahead_worker).
+ * @returns    Always @c NULL.
+ */
+static void *
+readahead_worker(void *arg)
+{
+	struct readahead_worker *w = arg;
+	struct readahead *ra = w->ra;
+	struct kdump_shared *shared = w->ctx->shared;
+	struct readahead_req req;
+
+	mutex_lock(&ra->lock);
+	for (;;) {
+		while (!ra->stop && !ra->count)
+			cond_wait(&ra->cond, &ra->lock);
+		if (ra->stop)
+			break;
+
+		req = ra->queue[ra->head];
+		ra->head = (ra->head + 1) % ra->size;
+		--ra->count;
+		mutex_unlock(&ra->lock);
+
+		/* Never wait for a writer. It may be stopping this pool,
+		 * and the request is probably stale afterwards anyway.
+		 */
+		if (!rwlock_tryrdlock(&shared->lock)) {
+			prefetch_page(w->ctx, &req);
+			rwlock_unlock(&shared->lock);
+		}
+
+		mutex_lock(&ra->lock);
+	}
+	mutex_unlock(&ra->lock);
+
+	return NULL;
+}
+
+/**  Stop readahead.
+ * @param shared  Dump file shared data.
+ *
+ * Terminate all worker threads, drop any pending requests and free
+ * the worker pool. This function must be called either with the
+ * shared lock held for writing, or when the shared data is being
+ * freed (i.e. no other thread may access it).
+ */
+void
+readahead_stop(struct kdump_shared *shared)
+{
+	struct readahead *ra = shared->readahead;
+	unsigned i;
+
+	if (!ra)
+		return;
+
+	mutex_lock(&ra->lock);
+	ra->stop = true;
+	cond_broadcast(&ra->cond);
+	mutex_unlock(&ra->lock);
+
+	for (i = 0; i < ra->nthreads; ++i) {
+		pthread_join(ra->worker[i].thread, NULL);
+		helper_ctx_free(ra->worker[i].ctx);
+	}
+
+	cond_destroy(&ra->cond);
+	mutex_destroy(&ra->lock);
+	free(ra->queue);
+	free(ra);
+	shared->readahead = NULL;
+}
+
+/**  Start readahead.
+ * @param ctx       Dump file object.
+ * @param window    Readahead window (in pages).
+ * @param nthreads  Number of worker threads.
+ * @returns         Error status.
+ */
+static kdump_status
+readahead_start(kdump_ctx_t *ctx, unsigned window, unsigned nthreads)
+{
+	struct readahead *ra;
+	struct readahead_worker *w;
+	kdump_status status;
+	int err;
+
+	ra = calloc(1, sizeof(*ra) + nthreads * sizeof(ra->worker[0]));
+	if (!ra)
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot allocate %s", "readahead pool");
+	ra->queue = malloc(window * sizeof(*ra->queue));
+	if (!ra->queue) {
+		free(ra);
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot allocate %s", "readahead queue");
+	}
+	ra->window = window;
+	ra->size = window;
+
+	if (mutex_init(&ra->lock, NULL)) {
+		free(ra->queue);
+		free(ra);
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot initialize %s", "readahead lock");
+	}
+	if (cond_init(&ra->cond, NULL)) {
+		mutex_destroy(&ra->lock);
+		free(ra->queue);
+		free(ra);
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot initialize %s",
+				 "readahead condition variable");
+	}
+	ctx->shared->readahead = ra;
+
+	while (ra->nthreads < nthreads) {
+		w = &ra->worker[ra->nthreads];
+		w->ra = ra;
+		w->ctx = helper_ctx_new(ctx->shared);
+		if (!w->ctx) {
+			status = set_error(ctx, KDUMP_ERR_SYSTEM,
+					   "Cannot allocate %s",
+					   "readahead context");
+			goto err;
+		}
+		err = pthread_create(&w->thread, NULL, readahead_worker, w);
+		if (err) {
+			helper_ctx_free(w->ctx);
+			status = set_error(ctx, KDUMP_ERR_SYSTEM,
+					   "Cannot create readahead thread: %s",
+					   strerror(err));
+			goto err;
+		}
+		++ra->nthreads;
+	}
+
+	return KDUMP_OK;
+
+ err:
+	readahead_stop(ctx->shared);
+	return status;
+}
+
+/**  Apply the readahead settings.
+ * @param ctx  Dump file object.
+ * @returns    Error status.
+ *
+ * Stop any running readahead and restart it according to
+ * "cache.readahead" and "cache.readahead_threads". Readahead
+ * stays off if the file format cannot tell which pages are stored
+ * in the file, or if the page cache has not been allocated yet;
+ * this function is called again when it is allocated.
+ *
+ * The shared lock must be held for writing by the caller.
+ */
+kdump_status
+update_readahead(kdump_ctx_t *ctx)
+{
+	struct kdump_shared *shared = ctx->shared;
+	struct attr_data *attr;
+	unsigned window, nthreads;
+	unsigned cache_size;
+
+	readahead_stop(shared);
+
+	attr = gattr(ctx, GKI_cache_readahead);
+	window = attr_isset(attr) ? attr_value(attr)->number : 0;
+	attr = gattr(ctx, GKI_cache_readahead_threads);
+	nthreads = attr_isset(attr)
+		? attr_value(attr)->number
+		: DEFAULT_READAHEAD_THREADS;
+	if (!window || !nthreads || !shared->cache ||
+	    !shared->ops || !shared->ops->next_pfn)
+		return KDUMP_OK;
+
+	/* Prefetched pages must not evict each other before use. */
+	cache_size = get_cache_size(ctx);
+	if (window > cache_size / 2)
+		window = cache_size / 2;
+	if (!window)
+		return KDUMP_OK;
+
+	return readahead_start(ctx, window, nthreads);
+}
+
+/**  Track page accesses and queue readahead requests.
+ * @param pio  Page I/O control of the requested page.
+ * @param fn   Read function for the page.
+ *
+ * Sequential page reads are detected per context. Once a sequence
+ * is long enough, the stored pages which follow within the
+ * readahead window are queued for prefetching. Pages which are not
+ * stored in the dump file are skipped using the @c next_pfn method
+ * of the file format.
+ *
+ * Readahead must be enabled, and the shared lock must be held by the
+ * caller.
+ */
+void
+readahead_note(struct page_io *pio, read_page_fn *fn)
+{
+	kdump_ctx_t *ctx = pio->ctx;
+	struct readahead *ra = ctx->shared->readahead;
+	struct readahead_state *st = &ctx->ra;
+	unsigned shift = get_page_shift(ctx);
+	kdump_addr_t pgsz = get_page_size(ctx);
+	struct readahead_req *req;
+	kdump_addr_t limit;
+	kdump_pfn_t pfn;
+	unsigned queued;
+
+	if (pio->addr.as == st->next.as) {
+		/* Another read from the same page. */
+		if (pio->addr.addr + pgsz == st->next.addr)
+			return;
+		if (pio->addr.addr != st->next.addr)
+			st->seq = 0;
+		else if (st->seq < READAHEAD_MIN_SEQ)
+			++st->seq;
+	} else
+		st->seq = 0;
+
+	st->next.as = pio->addr.as;
+	st->next.addr = pio->addr.addr + pgsz;
+	if (!st->seq)
+		st->end = st->next.addr;
+	if (st->seq < READAHEAD_MIN_SEQ)
+		return;
+
+	limit = st->next.addr + (kdump_addr_t)ra->window * pgsz;
+	if (st->end < st->next.addr)
+		st->end = st->next.addr;
+	if (st->end >= limit)
+		return;
+
+	queued = 0;
+	pfn = st->end >> shift;
+	mutex_lock(&ra->lock);
+	while (ra->count < ra->size) {
+		if (!ctx->shared->ops->next_pfn(ctx, &pfn) ||
+		    (pfn << shift) >= limit) {
+			st->end = limit;
+			break;
+		}
+		req = &ra->queue[(ra->head + ra->count) % ra->size];
+		req->addr.addr = pfn << shift;
+		req->addr.as = pio->addr.as;
+		req->fn = fn;
+		++ra->count;
+		++queued;
+		st->end = ++pfn << shift;
+	}
+	if (queued)
+		cond_broadcast(&ra->cond);
+	mutex_unlock(&ra->lock);
+}
+
+#else  /* USE_PTHREAD */
+
+void
+readahead_stop(struct kdump_shared *shared)
+{
+}
+
+kdump_status
+update_readahead(kdump_ctx_t *ctx)
+{
+	/* Readahead needs worker threads. */
+	return KDUMP_OK;
+}
+
+void
+readahead_note(struct page_io *pio, read_page_fn *fn)
+{
+}
+
+#endif	/* USE_PTHREAD */
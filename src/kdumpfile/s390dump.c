@@ -101,16 +101,17 @@ s390_get_page(struct page_io *pio)
 	kdump_ctx_t *ctx = pio->ctx;
 	struct s390dump_priv *sdp = ctx->shared->fmtdata;
 	off_t pos;
+	uint64_t start;
 	kdump_status status;
 
 	if ((pio->addr.addr >> get_page_shift(ctx)) >= get_max_pfn(ctx))
 		return set_error(ctx, KDUMP_ERR_NODATA, "Out-of-bounds PFN");
 
 	pos = (off_t)pio->addr.addr + (off_t)sdp->dataoff;
-	mutex_lock(&ctx->shared->cache_lock);
+	start = stats_start(ctx->shared);
 	status = fcache_get_chunk(ctx->shared->fcache, &pio->chunk,
 				  get_page_size(ctx), 0, pos);
-	mutex_unlock(&ctx->shared->cache_lock);
+	stats_end(ctx->shared, STAGE_io, start);
 	return status;
 }
 
@@ -585,6 +585,7 @@ sadump_read_page(struct page_io *pio)
 	const struct pfn_region *rgn;
 	unsigned disknum;
 	off_t pos;
+	uint64_t start;
 	kdump_status ret;
 
 	if (pfn >= get_max_pfn(ctx))
@@ -609,10 +610,10 @@ sadump_read_page(struct page_io *pio)
 	}
 	pos += sp->ext[disknum].data_pos;
 
-	mutex_lock(&ctx->shared->cache_lock);
+	start = stats_start(ctx->shared);
 	ret = fcache_pread(ctx->shared->fcache, pio->chunk.data,
 			   get_page_size(ctx), sp->ext[disknum].fidx, pos);
-	mutex_unlock(&ctx->shared->cache_lock);
+	stats_end(ctx->shared, STAGE_io, start);
 	if (ret != KDUMP_OK)
 		return set_error(ctx, ret,
 				 "Cannot read page data at %llu",
@@ -621,10 +622,31 @@ sadump_read_page(struct page_io *pio)
 	return KDUMP_OK;
 }
 
+/** Check whether a page can be served from the zero page.
+ * @param pio  Page I/O control.
+ * @returns    @c true if the page is excluded and @c file.zero_excluded
+ *             is set.
+ */
+static bool
+sadump_zero_page(struct page_io *pio)
+{
+	kdump_ctx_t *ctx = pio->ctx;
+	struct sadump_priv *sp = ctx->shared->fmtdata;
+	kdump_pfn_t pfn = pio->addr.addr >> get_page_shift(ctx);
+	const struct pfn_region *rgn;
+
+	if (!get_zero_excluded(ctx) || pfn >= get_max_pfn(ctx))
+		return false;
+	rgn = find_pfn_region(&sp->pfm, pfn);
+	return !rgn || pfn < rgn->pfn;
+}
+
 static kdump_status
 sadump_get_page(struct page_io *pio)
 {
-	return cache_get_page(pio, sadump_read_page);
+	if (sadump_zero_page(pio))
+		return get_zero_page(pio);
+	return cache_get_page(pio, sadump_read_page, NULL);
 }
 
 /* Initialize data structures for SADUMP.
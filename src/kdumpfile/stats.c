@@ -0,0 +1,265 @@
+/** @internal @file src/kdumpfile/stats.c
+ * @brief Read latency statistics.
+ */
+/* Copyright (C) Petr Tesarik <petr@tesarici.cz>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include "kdumpfile-priv.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+/** Attribute keys of a read stage.
+ */
+struct stage_keys {
+	enum global_keyidx dir;	  /**< Stage directory. */
+	enum global_keyidx count; /**< Number of operations. */
+	enum global_keyidx time;  /**< Total time. */
+	enum global_keyidx hist;  /**< Latency histogram. */
+};
+
+static const struct stage_keys stage_keys[] = {
+#define STAGE(id)					\
+	[STAGE_ ## id] = {				\
+		GKI_dir_stats_ ## id,			\
+		GKI_stats_ ## id ## _count,		\
+		GKI_stats_ ## id ## _time,		\
+		GKI_stats_ ## id ## _hist,		\
+	},
+#include "stats.def"
+#undef STAGE
+};
+
+/** Get the current time for statistics.
+ * @returns  Monotonic time in nanoseconds.
+ */
+uint64_t
+stats_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/** Get the histogram bucket for a given latency.
+ * @param ns  Latency in nanoseconds.
+ * @returns   Bucket index (base-2 logarithm of @p ns).
+ */
+static inline unsigned
+hist_bucket(uint64_t ns)
+{
+	if (ns >> 32)
+		return 63 - clz(ns >> 32);
+	return ns
+		? 31 - clz(ns)
+		: 0;
+}
+
+/** Account one operation to a read stage.
+ * @param stats  Read statistics.
+ * @param stage  Read stage.
+ * @param ns     Duration of the operation in nanoseconds.
+ */
+void
+stats_record(struct read_stats *stats, enum stats_stage stage, uint64_t ns)
+{
+	struct stage_stats *st = &stats->stage[stage];
+	uint64_t *hist = st->hist->data;
+
+	__atomic_add_fetch(&st->count.number, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&st->time.number, ns, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&hist[hist_bucket(ns)], 1, __ATOMIC_RELAXED);
+}
+
+/** Free read statistics.
+ * @param stats  Read statistics (may be @c NULL).
+ *
+ * Histogram blobs are only released here. They are not freed while
+ * the corresponding attribute value is still referenced.
+ */
+void
+stats_free(struct read_stats *stats)
+{
+	unsigned i;
+
+	if (!stats)
+		return;
+
+	for (i = 0; i < NR_STATS_STAGES; ++i)
+		if (stats->stage[i].hist)
+			internal_blob_decref(stats->stage[i].hist);
+	free(stats);
+}
+
+/** Allocate read statistics.
+ * @returns  Zero-initialized read statistics, or @c NULL on failure.
+ */
+static struct read_stats *
+stats_alloc(void)
+{
+	struct read_stats *stats;
+	void *hist;
+	unsigned i;
+
+	stats = calloc(1, sizeof *stats);
+	if (!stats)
+		return NULL;
+
+	for (i = 0; i < NR_STATS_STAGES; ++i) {
+		hist = calloc(STATS_HIST_BUCKETS, sizeof(uint64_t));
+		if (!hist)
+			goto err;
+		stats->stage[i].hist = internal_blob_new(
+			hist, STATS_HIST_BUCKETS * sizeof(uint64_t));
+		if (!stats->stage[i].hist) {
+			free(hist);
+			goto err;
+		}
+	}
+
+	return stats;
+
+ err:
+	stats_free(stats);
+	return NULL;
+}
+
+/** Remove statistics attributes.
+ * @param ctx  Dump file object.
+ */
+static void
+clear_stats_attrs(kdump_ctx_t *ctx)
+{
+	unsigned i;
+
+	for (i = 0; i < NR_STATS_STAGES; ++i)
+		clear_attr(ctx, gattr(ctx, stage_keys[i].dir));
+}
+
+/** Start collecting read statistics.
+ * @param ctx  Dump file object.
+ * @returns    Error status.
+ *
+ * The caller must hold the shared lock for writing.
+ */
+static kdump_status
+stats_enable(kdump_ctx_t *ctx)
+{
+	struct attr_flags flags = ATTR_PERSIST_INDIRECT;
+	struct read_stats *stats;
+	kdump_attr_value_t val;
+	kdump_status status;
+	unsigned i;
+
+	if (ctx->shared->stats)
+		return KDUMP_OK;
+
+	stats = stats_alloc();
+	if (!stats)
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot allocate read statistics");
+
+	for (i = 0; i < NR_STATS_STAGES; ++i) {
+		const struct stage_keys *keys = &stage_keys[i];
+		struct stage_stats *st = &stats->stage[i];
+
+		status = set_attr(ctx, gattr(ctx, keys->count), flags,
+				  &st->count);
+		if (status != KDUMP_OK)
+			goto err;
+		status = set_attr(ctx, gattr(ctx, keys->time), flags,
+				  &st->time);
+		if (status != KDUMP_OK)
+			goto err;
+		internal_blob_incref(st->hist);
+		val.blob = st->hist;
+		status = set_attr(ctx, gattr(ctx, keys->hist), ATTR_PERSIST,
+				  &val);
+		if (status != KDUMP_OK)
+			goto err;
+	}
+
+	__atomic_store_n(&ctx->shared->stats, stats, __ATOMIC_RELAXED);
+	return KDUMP_OK;
+
+ err:
+	clear_stats_attrs(ctx);
+	stats_free(stats);
+	return set_error(ctx, status, "Cannot set up read statistics");
+}
+
+/** Stop collecting read statistics.
+ * @param ctx  Dump file object.
+ *
+ * All collected statistics are discarded. The caller must hold
+ * the shared lock for writing.
+ */
+static void
+stats_disable(kdump_ctx_t *ctx)
+{
+	struct read_stats *stats = ctx->shared->stats;
+
+	if (!stats)
+		return;
+
+	__atomic_store_n(&ctx->shared->stats, NULL, __ATOMIC_RELAXED);
+	clear_stats_attrs(ctx);
+	stats_free(stats);
+}
+
+/** Enable or disable read statistics after changing "stats.enabled".
+ * @param ctx   Dump file object.
+ * @param attr  "stats.enabled" attribute.
+ * @returns     Error status.
+ */
+static kdump_status
+stats_enabled_post_hook(kdump_ctx_t *ctx, struct attr_data *attr)
+{
+	if (attr_value(attr)->number)
+		return stats_enable(ctx);
+
+	stats_disable(ctx);
+	return KDUMP_OK;
+}
+
+/** Disable read statistics when "stats.enabled" is cleared.
+ * @param ctx   Dump file object.
+ * @param attr  "stats.enabled" attribute.
+ */
+static void
+stats_enabled_pre_clear_hook(kdump_ctx_t *ctx, struct attr_data *attr)
+{
+	stats_disable(ctx);
+}
+
+const struct attr_ops stats_enabled_ops = {
+	.post_set = stats_enabled_post_hook,
+	.pre_clear = stats_enabled_pre_clear_hook,
+};
@@ -33,6 +33,7 @@
 #include "kdumpfile-priv.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #define TEST_OK     0
 #define TEST_FAIL   1
@@ -40,6 +41,12 @@
 
 #define CACHE_SIZE  8
 
+/* Parameters for the random access test. */
+#define RANDOM_CACHE_SIZE	256
+#define RANDOM_KEYS		1024
+#define RANDOM_ITER		200000
+#define RANDOM_PINNED		16
+
 static void
 poison_stack(void)
 {
@@ -51,6 +58,87 @@ poison_stack(void)
 	__asm__ volatile("" :: "g" (largearray) : "memory");
 }
 
+/* Access random keys in a large cache. Each entry stores its own key,
+ * so a stale hash index or a shared data buffer is detected.
+ */
+static int
+test_random(void)
+{
+	struct cache *cache;
+	struct cache_entry *entry;
+	struct cache_entry *pinned[RANDOM_PINNED] = { NULL };
+	cache_key_t key;
+	unsigned i, slot;
+	int rc = TEST_OK;
+
+	cache = cache_alloc(RANDOM_CACHE_SIZE, sizeof(cache_key_t));
+	if (!cache) {
+		perror("Cannot allocate cache");
+		return TEST_ERR;
+	}
+
+	srandom(1);
+	for (i = 0; i < RANDOM_ITER; ++i) {
+		/* Skew the distribution to get both hits and misses. */
+		key = random() % RANDOM_KEYS;
+		if (key & 1)
+			key %= RANDOM_CACHE_SIZE / 2;
+		key <<= 12;
+
+		entry = cache_get_entry(cache, key);
+		if (!entry) {
+			fprintf(stderr, "Cannot get entry for 0x%llx\n",
+				(unsigned long long) key);
+			rc = TEST_FAIL;
+			break;
+		}
+		if (!entry->data) {
+			fprintf(stderr, "NULL data for 0x%llx\n",
+				(unsigned long long) key);
+			rc = TEST_FAIL;
+			break;
+		}
+		if (entry->key != key) {
+			fprintf(stderr, "Wrong entry for 0x%llx: 0x%llx\n",
+				(unsigned long long) key,
+				(unsigned long long) entry->key);
+			rc = TEST_FAIL;
+			break;
+		}
+
+		if (cache_entry_valid(entry)) {
+			if (*(cache_key_t *)entry->data != key) {
+				fprintf(stderr, "Corrupted data for 0x%llx\n",
+					(unsigned long long) key);
+				rc = TEST_FAIL;
+				break;
+			}
+		} else if (random() % 16) {
+			*(cache_key_t *)entry->data = key;
+			cache_insert(cache, entry);
+		} else {
+			cache_discard(cache, entry);
+			continue;
+		}
+
+		/* Keep a few random entries pinned. */
+		slot = random() % (2 * RANDOM_PINNED);
+		if (slot < RANDOM_PINNED) {
+			if (pinned[slot])
+				cache_put_entry(cache, pinned[slot]);
+			pinned[slot] = entry;
+		} else
+			cache_put_entry(cache, entry);
+	}
+
+	for (slot = 0; slot < RANDOM_PINNED; ++slot)
+		if (pinned[slot])
+			cache_put_entry(cache, pinned[slot]);
+
+	cache_free(cache);
+	return rc;
+}
+
 int
 main(int argc, char **argv)
 {
@@ -201,5 +289,6 @@ main(int argc, char **argv)
 	cache_put_entry(cache, entry);
 
 	cache_free(cache);
-	return TEST_OK;
+
+	return test_random();
 }
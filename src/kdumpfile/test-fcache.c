@@ -64,6 +64,8 @@ static char *mmapbuf;
 
 static int failmmap;
 
+static int mmap_whole;
+
 #ifdef HAVE_MMAP64
 
 #define STR_MMAP	XSTRINGIFY(mmap64)
@@ -85,7 +87,8 @@ mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
 		if (failmmap)
 			return MAP_FAILED;
 
-		if (length != pagesize * (1UL << CACHE_ORDER)) {
+		if (!mmap_whole &&
+		    length != pagesize * (1UL << CACHE_ORDER)) {
 			fprintf(stderr, "Incorrect mmap size: %zu\n",
 				length);
 			exitcode = TEST_FAIL;
@@ -393,6 +396,101 @@ test_chunks(struct fcache *fc)
 	return exitcode;
 }
 
+static int
+test_whole(struct fcache *fc)
+{
+	struct fcache_entry ent, ent2;
+	struct fcache_chunk fch;
+	char *map;
+	off_t pos;
+	size_t len;
+	kdump_status status;
+
+	exitcode = TEST_OK;
+	fc->mmap_policy.number = KDUMP_MMAP_WHOLE;
+	mmap_whole = 1;
+	failmmap = 0;
+
+	/* Check that the whole file is returned. */
+	pos = 1;
+	status = fcache_get(fc, &ent, 1, pos);
+	if (status != KDUMP_OK) {
+		fprintf(stderr, "Cannot get entry at 1:%ld: %s\n",
+			(long)pos, kdump_strerror(status));
+		return TEST_ERR;
+	}
+	if (ent.len != ((1UL << CACHE_ORDER) + 3) * pagesize - pos) {
+		printf("length at 1:%ld: %zu != %lu\n", (long)pos, ent.len,
+		       ((1UL << CACHE_ORDER) + 3) * pagesize - pos);
+		exitcode = TEST_FAIL;
+	}
+	if (ent.cache) {
+		printf("whole-file entry is reference-counted\n");
+		exitcode = TEST_FAIL;
+	}
+	prepare_buf(1UL << (CACHE_ORDER + 1), 1UL << CACHE_ORDER);
+	if (memcmp(ent.data, mmapbuf + pos, (pagesize << CACHE_ORDER) - pos)) {
+		printf("data mismatch at 1:%ld\n", (long)pos);
+		exitcode = TEST_FAIL;
+	}
+	map = ent.data - pos;
+	fcache_put(&ent);
+
+	/* Check that later positions use the same mapping. */
+	pos = (pagesize << CACHE_ORDER) + pagesize;
+	status = fcache_get(fc, &ent2, 1, pos);
+	if (status != KDUMP_OK) {
+		fprintf(stderr, "Cannot get entry at 1:%ld: %s\n",
+			(long)pos, kdump_strerror(status));
+		return TEST_ERR;
+	}
+	if (ent2.data != map + pos) {
+		printf("data pointer mismatch at 1:%ld: %p != %p\n",
+		       (long)pos, ent2.data, map + pos);
+		exitcode = TEST_FAIL;
+	}
+	fcache_put(&ent2);
+
+	/* Check that a chunk across block boundaries is not copied. */
+	pos = (pagesize << CACHE_ORDER) - 8;
+	len = 2 * pagesize;
+	status = fcache_get_chunk(fc, &fch, len, 1, pos);
+	if (status != KDUMP_OK) {
+		fprintf(stderr, "Cannot get %zd-byte chunk at 1:%ld: %s\n",
+			len, (long)pos, kdump_strerror(status));
+		return TEST_ERR;
+	}
+	if (fch.nent != 1 || fch.data != map + pos) {
+		printf("chunk at 1:%ld not in whole-file map\n", (long)pos);
+		exitcode = TEST_FAIL;
+	}
+	fcache_put_chunk(&fch);
+
+	/* Check partial page at EOF. */
+	pos = (pagesize << CACHE_ORDER) + 2 * pagesize;
+	status = fcache_get(fc, &ent, 1, pos);
+	if (status != KDUMP_OK) {
+		fprintf(stderr, "Cannot get entry at 1:%ld: %s\n",
+			(long)pos, kdump_strerror(status));
+		return TEST_ERR;
+	}
+	if (ent.len != pagesize) {
+		printf("length at 1:%ld: %zu != %lu\n",
+		       (long)pos, ent.len, pagesize);
+		exitcode = TEST_FAIL;
+	}
+	prepare_buf((1UL << (CACHE_ORDER + 1)) + (1UL << CACHE_ORDER) + 2, 1);
+	memset(mmapbuf + (pagesize >> 1), 0, pagesize >> 1);
+	if (memcmp(ent.data, mmapbuf, ent.len)) {
+		printf("data mismatch at 1:%ld\n", (long)pos);
+		exitcode = TEST_FAIL;
+	}
+	fcache_put(&ent);
+
+	mmap_whole = 0;
+	return exitcode;
+}
+
 static int
 test_fcache(struct fcache *fc)
 {
@@ -496,6 +594,19 @@ main(int argc, char **argv)
 
 	ret = test_fcache(fc);
 	fcache_free(fc);
+
+	if (ret == TEST_OK) {
+		fc = fcache_new(2, dumpfd, CACHE_SIZE, CACHE_ORDER);
+		if (!fc) {
+			perror("Allocation failure");
+			close(dumpfd[1]);
+			close(dumpfd[0]);
+			return TEST_ERR;
+		}
+		ret = test_whole(fc);
+		fcache_free(fc);
+	}
+
 	close(dumpfd[1]);
 	close(dumpfd[0]);
 	return ret;
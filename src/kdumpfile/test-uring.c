@@ -0,0 +1,264 @@
+/** @internal @file src/kdumpfile/test-uring.c
+ * @brief Test io_uring reads.
+ */
+/* Copyright (C) Petr Tesarik <petr@tesarici.cz>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include "kdumpfile-priv.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <sys/syscall.h>
+
+#define TEST_OK     0
+#define TEST_FAIL   1
+#define TEST_SKIP  77
+#define TEST_ERR   99
+
+#define TEST_FNAME	"tmp.uring"
+
+/** Number of submission queue entries. */
+#define RING_SIZE	4
+
+/** Number of read requests in a batch. */
+#define NREQS		64
+
+/** Size of each read request. */
+#define REQ_SIZE	4096
+
+/** Fill byte for buffers which must not be written. */
+#define POISON		0xa5
+
+#if USE_IO_URING
+
+static long (*orig_syscall)(long number, ...);
+
+/** Number of io_uring_enter(2) calls which succeed, negative if all. */
+static int enter_ok = -1;
+
+/** Number of io_uring_enter(2) calls which failed. */
+static unsigned enter_failed;
+
+/** File descriptor of the last io_uring instance. */
+static int ring_fd = -1;
+
+long
+syscall(long number, ...)
+{
+	long a1, a2, a3, a4, a5, a6;
+	va_list ap;
+	long ret;
+
+	va_start(ap, number);
+	a1 = va_arg(ap, long);
+	a2 = va_arg(ap, long);
+	a3 = va_arg(ap, long);
+	a4 = va_arg(ap, long);
+	a5 = va_arg(ap, long);
+	a6 = va_arg(ap, long);
+	va_end(ap);
+
+	if (number == __NR_io_uring_enter && enter_ok >= 0) {
+		if (!enter_ok) {
+			++enter_failed;
+			errno = EOWNERDEAD;
+			return -1;
+		}
+		--enter_ok;
+	}
+
+	ret = orig_syscall(number, a1, a2, a3, a4, a5, a6);
+	if (number == __NR_io_uring_setup && ret >= 0)
+		ring_fd = ret;
+	return ret;
+}
+
+static unsigned char
+data_byte(off_t pos)
+{
+	return pos / REQ_SIZE * 7 + pos % 251;
+}
+
+static int
+write_file(int fd)
+{
+	unsigned char buf[REQ_SIZE];
+	unsigned i, j;
+
+	for (i = 0; i < NREQS; ++i) {
+		for (j = 0; j < REQ_SIZE; ++j)
+			buf[j] = data_byte((off_t)i * REQ_SIZE + j);
+		if (write(fd, buf, REQ_SIZE) != REQ_SIZE) {
+			perror("Cannot write test file");
+			return TEST_ERR;
+		}
+	}
+	return TEST_OK;
+}
+
+static int
+check_reqs(const struct uring_req *reqs)
+{
+	const unsigned char *p;
+	unsigned i, j;
+
+	for (i = 0; i < NREQS; ++i) {
+		if (!reqs[i].done || reqs[i].res != REQ_SIZE) {
+			fprintf(stderr, "Request %u: done=%d res=%zd\n",
+				i, reqs[i].done, reqs[i].res);
+			return TEST_FAIL;
+		}
+		p = reqs[i].buf;
+		for (j = 0; j < REQ_SIZE; ++j)
+			if (p[j] != data_byte(reqs[i].pos + j)) {
+				fprintf(stderr, "Request %u: data mismatch"
+					" at offset %u\n", i, j);
+				return TEST_FAIL;
+			}
+	}
+	return TEST_OK;
+}
+
+/* Make io_uring_enter(2) fail after the first call of a batch. All
+ * requests must be read, and no buffer may be written after return.
+ */
+static int
+test_enter_failure(struct uring *ur, int fd, unsigned char *bufs)
+{
+	struct uring_req reqs[NREQS];
+	unsigned i, j;
+	int ret;
+
+	memset(bufs, POISON, NREQS * REQ_SIZE);
+	for (i = 0; i < NREQS; ++i) {
+		/* Read in reverse order to defeat any readahead. */
+		reqs[i].fd = fd;
+		reqs[i].buf = bufs + i * REQ_SIZE;
+		reqs[i].len = REQ_SIZE;
+		reqs[i].pos = (off_t)(NREQS - 1 - i) * REQ_SIZE;
+	}
+
+	enter_ok = 1;
+	uring_read(ur, reqs, NREQS);
+	if (!enter_failed) {
+		fprintf(stderr, "io_uring_enter() was not failed\n");
+		return TEST_ERR;
+	}
+
+	ret = check_reqs(reqs);
+	if (ret != TEST_OK)
+		return ret;
+
+	/* Any request still in flight or left in the submission queue
+	 * would overwrite the poison once the queue is submitted.
+	 */
+	memset(bufs, POISON, NREQS * REQ_SIZE);
+	orig_syscall(__NR_io_uring_enter, ring_fd, RING_SIZE, 0, 0, NULL, 0);
+	usleep(100000);
+	for (i = 0; i < NREQS * REQ_SIZE; ++i)
+		if (bufs[i] != POISON) {
+			fprintf(stderr, "Buffer written after return"
+				" at offset %u\n", i);
+			return TEST_FAIL;
+		}
+
+	/* Subsequent reads use pread(2). */
+	j = enter_failed;
+	uring_read(ur, reqs, NREQS);
+	ret = check_reqs(reqs);
+	if (ret == TEST_OK && enter_failed != j) {
+		fprintf(stderr, "io_uring used after a permanent failure\n");
+		ret = TEST_FAIL;
+	}
+	return ret;
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned char *bufs;
+	struct uring *ur;
+	int fd, ret;
+
+	orig_syscall = dlsym(RTLD_NEXT, "syscall");
+	if (!orig_syscall) {
+		fprintf(stderr, "Cannot get original syscall() address: %s\n",
+			dlerror());
+		return TEST_ERR;
+	}
+
+	fd = open(TEST_FNAME, O_RDWR | O_TRUNC | O_CREAT, 0666);
+	if (fd < 0) {
+		perror("Cannot open test file");
+		return TEST_ERR;
+	}
+	ret = write_file(fd);
+	if (ret != TEST_OK) {
+		close(fd);
+		return ret;
+	}
+
+	bufs = malloc(NREQS * REQ_SIZE);
+	if (!bufs) {
+		perror("Cannot allocate buffers");
+		close(fd);
+		return TEST_ERR;
+	}
+
+	ur = uring_new(RING_SIZE);
+	if (!ur) {
+		perror("Cannot set up io_uring");
+		free(bufs);
+		close(fd);
+		return TEST_SKIP;
+	}
+
+	ret = test_enter_failure(ur, fd, bufs);
+
+	uring_free(ur);
+	free(bufs);
+	close(fd);
+	return ret;
+}
+
+#else  /* USE_IO_URING */
+
+int
+main(int argc, char **argv)
+{
+	return TEST_SKIP;
+}
+
+#endif	/* USE_IO_URING */
@@ -0,0 +1,501 @@
+/** @internal @file src/kdumpfile/uring.c
+ * @brief Asynchronous file reads using io_uring.
+ */
+/* Copyright (C) Petr Tesarik <petr@tesarici.cz>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include "kdumpfile-priv.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+
+/**  Read data synchronously.
+ * @param req  Read request.
+ *
+ * This is used as a fallback if io_uring is not available or if it
+ * cannot handle a request.
+ */
+static void
+sync_read(struct uring_req *req)
+{
+	do {
+		req->res = pread(req->fd, req->buf, req->len, req->pos);
+	} while (req->res < 0 && errno == EINTR);
+	if (req->res < 0)
+		req->res = -errno;
+	req->done = true;
+}
+
+#if USE_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/**  Submission queue ring.
+ */
+struct uring_sq {
+	unsigned *head;		/**< Consumer index (kernel). */
+	unsigned *tail;		/**< Producer index (library). */
+	unsigned mask;		/**< Ring index mask. */
+	unsigned entries;	/**< Number of ring entries. */
+	unsigned *array;	/**< Indices into @c sqes. */
+	struct io_uring_sqe *sqes; /**< Submission queue entries. */
+};
+
+/**  Completion queue ring.
+ */
+struct uring_cq {
+	unsigned *head;		/**< Consumer index (library). */
+	unsigned *tail;		/**< Producer index (kernel). */
+	unsigned mask;		/**< Ring index mask. */
+	struct io_uring_cqe *cqes; /**< Completion queue entries. */
+};
+
+/**  io_uring instance.
+ *
+ * Any thread may submit requests and reap completions. At most one
+ * thread sleeps in the kernel waiting for completions at a time. Other
+ * threads wait on a condition variable, which is signalled whenever
+ * the sleeping thread returns and reaps completions on their behalf.
+ */
+struct uring {
+	mutex_t lock;		/**< Protects the rings and fields below. */
+	cond_t cond;		/**< Signalled after reaping completions. */
+	bool waiting;		/**< Some thread is waiting in the kernel. */
+	bool failed;		/**< io_uring_enter(2) failed permanently. */
+
+	int fd;			/**< io_uring file descriptor. */
+	struct uring_sq sq;	/**< Submission queue. */
+	struct uring_cq cq;	/**< Completion queue. */
+
+	void *sqring;		/**< Mapped submission queue ring. */
+	size_t sqring_sz;	/**< Size of @c sqring. */
+	void *cqring;		/**< Mapped completion queue ring. */
+	size_t cqring_sz;	/**< Size of @c cqring. */
+	size_t sqes_sz;		/**< Size of mapped submission entries. */
+};
+
+static inline int
+sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int
+sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+		   unsigned flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, NULL, 0);
+}
+
+/**  Unmap io_uring rings.
+ * @param ur  io_uring instance.
+ */
+static void
+unmap_rings(struct uring *ur)
+{
+	if (ur->sq.sqes && ur->sq.sqes != MAP_FAILED)
+		munmap(ur->sq.sqes, ur->sqes_sz);
+	if (ur->cqring && ur->cqring != MAP_FAILED &&
+	    ur->cqring != ur->sqring)
+		munmap(ur->cqring, ur->cqring_sz);
+	if (ur->sqring && ur->sqring != MAP_FAILED)
+		munmap(ur->sqring, ur->sqring_sz);
+}
+
+/**  Allocate a new io_uring instance.
+ * @param entries  Number of submission queue entries.
+ * @returns        io_uring instance, or @c NULL on failure.
+ *
+ * On failure, @c errno is set. In particular, it is @c ENOSYS if
+ * the kernel does not support io_uring.
+ */
+struct uring *
+uring_new(unsigned entries)
+{
+	struct io_uring_params p;
+	struct uring *ur;
+	int err;
+
+	ur = calloc(1, sizeof *ur);
+	if (!ur)
+		return NULL;
+
+	memset(&p, 0, sizeof p);
+	ur->fd = sys_io_uring_setup(entries, &p);
+	if (ur->fd < 0)
+		goto err_free;
+
+	ur->sqring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ur->cqring_sz = p.cq_off.cqes +
+		p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ur->cqring_sz > ur->sqring_sz)
+			ur->sqring_sz = ur->cqring_sz;
+		ur->cqring_sz = ur->sqring_sz;
+	}
+
+	ur->sqring = mmap(NULL, ur->sqring_sz, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, ur->fd,
+			  IORING_OFF_SQ_RING);
+	if (ur->sqring == MAP_FAILED)
+		goto err_close;
+	ur->cqring = (p.features & IORING_FEAT_SINGLE_MMAP)
+		? ur->sqring
+		: mmap(NULL, ur->cqring_sz, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_POPULATE, ur->fd,
+		       IORING_OFF_CQ_RING);
+	if (ur->cqring == MAP_FAILED)
+		goto err_unmap;
+	ur->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+	ur->sq.sqes = mmap(NULL, ur->sqes_sz, PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_POPULATE, ur->fd,
+			   IORING_OFF_SQES);
+	if (ur->sq.sqes == MAP_FAILED)
+		goto err_unmap;
+
+	ur->sq.head = ur->sqring + p.sq_off.head;
+	ur->sq.tail = ur->sqring + p.sq_off.tail;
+	ur->sq.mask = *(unsigned *)(ur->sqring + p.sq_off.ring_mask);
+	ur->sq.entries = *(unsigned *)(ur->sqring + p.sq_off.ring_entries);
+	ur->sq.array = ur->sqring + p.sq_off.array;
+	ur->cq.head = ur->cqring + p.cq_off.head;
+	ur->cq.tail = ur->cqring + p.cq_off.tail;
+	ur->cq.mask = *(unsigned *)(ur->cqring + p.cq_off.ring_mask);
+	ur->cq.cqes = ur->cqring + p.cq_off.cqes;
+
+	if (mutex_init(&ur->lock, NULL))
+		goto err_unmap;
+	if (cond_init(&ur->cond, NULL)) {
+		mutex_destroy(&ur->lock);
+		goto err_unmap;
+	}
+
+	return ur;
+
+ err_unmap:
+	err = errno;
+	unmap_rings(ur);
+	errno = err;
+ err_close:
+	err = errno;
+	close(ur->fd);
+	errno = err;
+ err_free:
+	free(ur);
+	return NULL;
+}
+
+/**  Free an io_uring instance.
+ * @param ur  io_uring instance.
+ *
+ * No requests may be in flight.
+ */
+void
+uring_free(struct uring *ur)
+{
+	cond_destroy(&ur->cond);
+	mutex_destroy(&ur->lock);
+	unmap_rings(ur);
+	close(ur->fd);
+	free(ur);
+}
+
+/**  Queue a read request.
+ * @param ur   io_uring instance.
+ * @param req  Read request.
+ * @returns    @c true if queued, @c false if the queue is full.
+ *
+ * The caller must hold @c ur->lock.
+ */
+static bool
+queue_req(struct uring *ur, struct uring_req *req)
+{
+	struct uring_sq *sq = &ur->sq;
+	struct io_uring_sqe *sqe;
+	unsigned tail, idx;
+
+	tail = *sq->tail;
+	if (tail - __atomic_load_n(sq->head, __ATOMIC_ACQUIRE) >= sq->entries)
+		return false;
+
+	idx = tail & sq->mask;
+	sqe = &sq->sqes[idx];
+	memset(sqe, 0, sizeof *sqe);
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = req->fd;
+	sqe->addr = (uintptr_t)req->buf;
+	sqe->len = req->len;
+	sqe->off = req->pos;
+	sqe->user_data = (uintptr_t)req;
+	sq->array[idx] = idx;
+	__atomic_store_n(sq->tail, tail + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+/**  Reap all available completions.
+ * @param ur  io_uring instance.
+ *
+ * Completions may belong to requests of any thread. The caller must
+ * hold @c ur->lock.
+ */
+static void
+reap_completions(struct uring *ur)
+{
+	struct uring_cq *cq = &ur->cq;
+	struct io_uring_cqe *cqe;
+	struct uring_req *req;
+	unsigned head, tail;
+
+	head = *cq->head;
+	tail = __atomic_load_n(cq->tail, __ATOMIC_ACQUIRE);
+	while (head != tail) {
+		cqe = &cq->cqes[head & cq->mask];
+		req = (struct uring_req *)(uintptr_t)cqe->user_data;
+		if (req) {
+			req->res = cqe->res;
+			req->done = true;
+		}
+		++head;
+	}
+	__atomic_store_n(cq->head, head, __ATOMIC_RELEASE);
+}
+
+/**  Submit all queued requests.
+ * @param ur     io_uring instance.
+ * @param flags  Flags for io_uring_enter(2).
+ * @returns      @c false if io_uring cannot be used any more.
+ *
+ * If @c IORING_ENTER_GETEVENTS is included in @p flags, wait for at
+ * least one completion. Temporary errors (@c EINTR, @c EAGAIN and
+ * @c EBUSY) are ignored. If a request cannot be submitted now, it
+ * stays in the queue and is submitted next time.
+ */
+static bool
+submit_queued(struct uring *ur, unsigned flags)
+{
+	unsigned to_submit;
+
+	to_submit = *ur->sq.tail -
+		__atomic_load_n(ur->sq.head, __ATOMIC_ACQUIRE);
+	if (sys_io_uring_enter(ur->fd, to_submit,
+			       (flags & IORING_ENTER_GETEVENTS) ? 1 : 0,
+			       flags) >= 0)
+		return true;
+	return errno == EINTR || errno == EAGAIN || errno == EBUSY;
+}
+
+/**  Withdraw requests which have not been submitted yet.
+ * @param ur    io_uring instance.
+ * @param reqs  Read requests.
+ * @param n     Number of requests in @p reqs.
+ *
+ * Entries of @p reqs which are still in the submission queue are
+ * replaced with no-op entries which do not refer to any request, and
+ * the requests are marked as failed with @c ECANCELED.
+ *
+ * The caller must hold @c ur->lock, and no other thread may be in
+ * io_uring_enter(2), so that the kernel does not consume submission
+ * queue entries meanwhile.
+ */
+static void
+withdraw_queued(struct uring *ur, struct uring_req *reqs, unsigned n)
+{
+	struct uring_sq *sq = &ur->sq;
+	struct io_uring_sqe *sqe;
+	struct uring_req *req;
+	unsigned pos, tail;
+
+	tail = *sq->tail;
+	for (pos = __atomic_load_n(sq->head, __ATOMIC_ACQUIRE);
+	     pos != tail; ++pos) {
+		sqe = &sq->sqes[pos & sq->mask];
+		req = (struct uring_req *)(uintptr_t)sqe->user_data;
+		if (req < reqs || req >= reqs + n)
+			continue;
+		memset(sqe, 0, sizeof *sqe);
+		sqe->opcode = IORING_OP_NOP;
+		req->res = -ECANCELED;
+		req->done = true;
+	}
+}
+
+/**  Wait until all submitted requests are complete.
+ * @param ur    io_uring instance.
+ * @param reqs  Read requests.
+ * @param n     Number of requests in @p reqs.
+ *
+ * This is used after io_uring_enter(2) failed permanently. Requests
+ * which have been submitted may still be in flight, and the kernel
+ * writes into their buffers and posts their completions to the ring
+ * even though nothing can be submitted any more. If waiting in the
+ * kernel fails, too, the completion ring is checked periodically.
+ *
+ * The caller must hold @c ur->lock, and all requests in @p reqs which
+ * are not done must have been consumed by the kernel.
+ */
+static void
+wait_submitted(struct uring *ur, struct uring_req *reqs, unsigned n)
+{
+	static const struct timespec interval = { 0, 1000000 };
+	unsigned i;
+	int ret;
+
+	for (;;) {
+		reap_completions(ur);
+		for (i = 0; i < n; ++i)
+			if (!reqs[i].done)
+				break;
+		if (i >= n)
+			break;
+
+		if (ur->waiting) {
+			cond_wait(&ur->cond, &ur->lock);
+			continue;
+		}
+
+		ur->waiting = true;
+		mutex_unlock(&ur->lock);
+		ret = sys_io_uring_enter(ur->fd, 0, 1, IORING_ENTER_GETEVENTS);
+		if (ret < 0 && errno != EINTR)
+			nanosleep(&interval, NULL);
+		mutex_lock(&ur->lock);
+		ur->waiting = false;
+		reap_completions(ur);
+		cond_broadcast(&ur->cond);
+	}
+}
+
+/**  Read data using io_uring.
+ * @param ur    io_uring instance, or @c NULL.
+ * @param reqs  Read requests.
+ * @param n     Number of requests in @p reqs.
+ *
+ * Submit all requests and wait until they are complete. Requests
+ * from multiple threads may be in flight at the same time. Requests
+ * which fail are retried with pread(2), e.g. if the kernel does not
+ * support the read operation. If io_uring_enter(2) fails with any
+ * other than a temporary error, io_uring is not used any more. Requests
+ * which have not been submitted yet are withdrawn, and all submitted
+ * requests are waited for, so that no completion can refer to @p reqs
+ * after return. Then all pending requests are read with pread(2).
+ * On return, the @c res field of each request has the same meaning as
+ * the return value of pread(2), except that errors are stored as
+ * negative error numbers.
+ */
+void
+uring_read(struct uring *ur, struct uring_req *reqs, unsigned n)
+{
+	unsigned queued, i;
+
+	for (i = 0; i < n; ++i)
+		reqs[i].done = false;
+	if (!ur) {
+		for (i = 0; i < n; ++i)
+			sync_read(&reqs[i]);
+		return;
+	}
+
+	mutex_lock(&ur->lock);
+	queued = 0;
+	while (!ur->failed) {
+		bool ok;
+
+		while (queued < n && queue_req(ur, &reqs[queued]))
+			++queued;
+
+		reap_completions(ur);
+		for (i = 0; i < queued; ++i)
+			if (!reqs[i].done)
+				break;
+		if (i >= n)
+			break;
+
+		if (ur->waiting) {
+			/* Another thread reaps completions for us. */
+			if (!submit_queued(ur, 0))
+				ur->failed = true;
+			else
+				cond_wait(&ur->cond, &ur->lock);
+			continue;
+		}
+
+		ur->waiting = true;
+		mutex_unlock(&ur->lock);
+		ok = submit_queued(ur, IORING_ENTER_GETEVENTS);
+		mutex_lock(&ur->lock);
+		ur->waiting = false;
+		if (!ok)
+			ur->failed = true;
+		reap_completions(ur);
+		cond_broadcast(&ur->cond);
+	}
+	if (ur->failed) {
+		/* Keep the kernel from consuming submission entries. */
+		while (ur->waiting)
+			cond_wait(&ur->cond, &ur->lock);
+		withdraw_queued(ur, reqs, queued);
+		wait_submitted(ur, reqs, queued);
+	}
+	mutex_unlock(&ur->lock);
+
+	for (i = 0; i < n; ++i)
+		if (!reqs[i].done || reqs[i].res < 0)
+			sync_read(&reqs[i]);
+}
+
+#else  /* USE_IO_URING */
+
+struct uring *
+uring_new(unsigned entries)
+{
+	errno = ENOSYS;
+	return NULL;
+}
+
+void
+uring_free(struct uring *ur)
+{
+}
+
+void
+uring_read(struct uring *ur, struct uring_req *reqs, unsigned n)
+{
+	unsigned i;
+
+	for (i = 0; i < n; ++i)
+		sync_read(&reqs[i]);
+}
+
+#endif	/* USE_IO_URING */
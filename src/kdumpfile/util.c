@@ -39,10 +39,22 @@
 #include <stdarg.h>
 #include <errno.h>
 #include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 #if USE_ZLIB
 # include <zlib.h>
 #endif
+#if USE_LZO
+# include <lzo/lzo1x.h>
+#endif
+#if USE_SNAPPY
+# include <snappy-c.h>
+#endif
+#if USE_ZSTD
+# include <zstd.h>
+#endif
 
 #define FN_VMCOREINFO	"/sys/kernel/vmcoreinfo"
 
@@ -554,33 +566,58 @@ const struct attr_ops xen_ver_ops = {
  *
  * This function can be used as the @c realloc_caches method if
  * the cache is organized as @c cache.size elements of @c arch.page_size
- * bytes each.
+ * bytes each, split into @c cache.shards shards.
  */
 kdump_status
 def_realloc_caches(kdump_ctx_t *ctx)
 {
 	unsigned cache_size = get_cache_size(ctx);
-	struct cache *cache;
+	unsigned nshards = get_cache_shards(ctx);
+	struct page_cache *cache;
 	kdump_status status;
 
-	cache = cache_alloc(cache_size, get_page_size(ctx));
+	cache = page_cache_alloc(nshards, cache_size, get_page_size(ctx));
 	if (!cache)
 		return set_error(ctx, KDUMP_ERR_SYSTEM,
 				 "Cannot allocate cache (%u * %zu bytes)",
 				 cache_size, get_page_size(ctx));
 
-	status = cache_set_attrs(cache, ctx,
-				 gattr(ctx, GKI_cache_hits),
-				 gattr(ctx, GKI_cache_misses));
+	status = page_cache_set_attrs(cache, ctx,
+				      gattr(ctx, GKI_cache_hits),
+				      gattr(ctx, GKI_cache_misses));
 	if (status != KDUMP_OK) {
-		cache_free(cache);
+		page_cache_free(cache);
 		return status;
 	}
 
 	if (ctx->shared->cache)
-		cache_free(ctx->shared->cache);
+		page_cache_free(ctx->shared->cache);
 	ctx->shared->cache = cache;
 
+	status = update_cache_wait(ctx);
+	if (status != KDUMP_OK)
+		return status;
+
+	return update_readahead(ctx);
+}
+
+/**  Check that the page cache can be re-allocated.
+ * @param ctx  Dump file object.
+ * @returns    Error status.
+ *
+ * The page cache cannot be replaced while the user holds references
+ * to its pages (see @ref kdump_get_page_ref). The caller must hold
+ * the shared lock for writing, so no new references can be taken.
+ */
+static kdump_status
+check_page_refs(kdump_ctx_t *ctx)
+{
+	unsigned long refs = __atomic_load_n(&ctx->shared->page_refs,
+					     __ATOMIC_RELAXED);
+	if (refs)
+		return set_error(ctx, KDUMP_ERR_BUSY,
+				 "Cannot re-allocate cache with %lu page"
+				 " references held", refs);
 	return KDUMP_OK;
 }
 
@@ -591,7 +628,7 @@ cache_size_pre_hook(kdump_ctx_t *ctx, struct attr_data *attr,
 	if (val->number > UINT_MAX)
 		return set_error(ctx, KDUMP_ERR_INVALID,
 				 "Cache size too big (max %u)", UINT_MAX);
-	return KDUMP_OK;
+	return check_page_refs(ctx);
 }
 
 static kdump_status
@@ -607,11 +644,79 @@ const struct attr_ops cache_size_ops = {
 	.post_set = cache_size_post_hook,
 };
 
+/** Maximum number of page cache shards.
+ * Shards are selected using a 16-bit key hash, so more shards
+ * would never be used.
+ */
+#define MAX_CACHE_SHARDS	(1U << 16)
+
+static kdump_status
+cache_shards_pre_hook(kdump_ctx_t *ctx, struct attr_data *attr,
+		      kdump_attr_value_t *val)
+{
+	if (val->number < 1 || val->number > MAX_CACHE_SHARDS)
+		return set_error(ctx, KDUMP_ERR_INVALID,
+				 "Invalid number of cache shards (1 to %u)",
+				 MAX_CACHE_SHARDS);
+	return check_page_refs(ctx);
+}
+
+const struct attr_ops cache_shards_ops = {
+	.pre_set = cache_shards_pre_hook,
+	.post_set = cache_size_post_hook,
+};
+
+static kdump_status
+cache_wait_post_hook(kdump_ctx_t *ctx, struct attr_data *attr)
+{
+	return update_cache_wait(ctx);
+}
+
+const struct attr_ops cache_wait_ops = {
+	.post_set = cache_wait_post_hook,
+};
+
+/** Maximum number of readahead threads. */
+#define MAX_READAHEAD_THREADS	256
+
+static kdump_status
+readahead_pre_hook(kdump_ctx_t *ctx, struct attr_data *attr,
+		   kdump_attr_value_t *val)
+{
+	unsigned max = attr == gattr(ctx, GKI_cache_readahead_threads)
+		? MAX_READAHEAD_THREADS
+		: UINT_MAX;
+
+	if (val->number > max)
+		return set_error(ctx, KDUMP_ERR_INVALID,
+				 "Value too big (max %u)", max);
+	return KDUMP_OK;
+}
+
+static kdump_status
+readahead_post_hook(kdump_ctx_t *ctx, struct attr_data *attr)
+{
+	if (ctx->shared->fcache && attr == gattr(ctx, GKI_cache_readahead))
+		fcache_advise(ctx->shared->fcache,
+			      attr_value(attr)->number != 0);
+	return update_readahead(ctx);
+}
+
+const struct attr_ops readahead_ops = {
+	.pre_set = readahead_pre_hook,
+	.post_set = readahead_post_hook,
+};
+
 static kdump_status
 page_size_pre_hook(kdump_ctx_t *ctx, struct attr_data *attr,
 		   kdump_attr_value_t *newval)
 {
 	size_t page_size = newval->number;
+	kdump_status status;
+
+	status = check_page_refs(ctx);
+	if (status != KDUMP_OK)
+		return status;
 
 	/* It must be a power of 2 */
 	if (page_size != (page_size & ~(page_size - 1)))
@@ -777,49 +882,104 @@ set_zlib_error(kdump_ctx_t *ctx, const char *what,
 }
 #endif
 
+/** Reusable decompression state.
+ *
+ * Initializing a decompressor is expensive compared to decompressing
+ * a single page, so the state is kept in a per-context slot and reused
+ * for all pages read through the same context. Each decompressor is
+ * initialized on first use.
+ */
+struct decomp_state {
+#if USE_ZLIB
+	bool zstream_ready;	/**< Non-zero if @c zstream is initialized. */
+	z_stream zstream;	/**< Inflate stream. */
+#endif
+#if USE_ZSTD
+	ZSTD_DCtx *zstd;	/**< Zstandard decompression context. */
+#endif
+#if !USE_ZLIB && !USE_ZSTD
+	char unused;		/**< Per-context data must not be empty. */
+#endif
+};
+
+/**  Release resources held by a decompression state.
+ * @param data  Decompression state.
+ */
+static void
+decomp_cleanup(void *data)
+{
+	struct decomp_state *ds = data;
+
+#if USE_ZLIB
+	if (ds->zstream_ready)
+		inflateEnd(&ds->zstream);
+#endif
+#if USE_ZSTD
+	ZSTD_freeDCtx(ds->zstd);
+#endif
+}
+
+/**  Allocate a per-context slot for decompression state.
+ * @param shared  Dump file shared data.
+ * @returns       Per-context slot number, or -1 on error.
+ *
+ * The per-context data can be passed to the page decompression
+ * functions, e.g. @ref uncompress_page_gzip.
+ */
+int
+decomp_alloc(struct kdump_shared *shared)
+{
+	return per_ctx_alloc(shared, sizeof(struct decomp_state),
+			     decomp_cleanup);
+}
+
 /**  Uncompress a gzipp'ed page.
  * @param ctx     Dump file object.
+ * @param ds      Decompression state.
  * @param dst     Destination buffer.
  * @param src     Source (compressed) data.
  * @param srclen  Length of source data.
  */
 kdump_status
-uncompress_page_gzip(kdump_ctx_t *ctx, unsigned char *dst,
-		     unsigned char *src, size_t srclen)
+uncompress_page_gzip(kdump_ctx_t *ctx, struct decomp_state *ds,
+		     unsigned char *dst, unsigned char *src, size_t srclen)
 {
 #if USE_ZLIB
-	z_stream zstream;
+	z_stream *zstream = &ds->zstream;
+	uint64_t start;
 	int res;
 
-	memset(&zstream, 0, sizeof zstream);
-	zstream.next_in = (z_const Bytef *)src;
-	zstream.avail_in = srclen;
-	zstream.next_out = dst;
-	zstream.avail_out = get_page_size(ctx);
-
-	res = inflateInit(&zstream);
+	if (!ds->zstream_ready)
+		memset(zstream, 0, sizeof *zstream);
+	zstream->next_in = (z_const Bytef *)src;
+	zstream->avail_in = srclen;
+	zstream->next_out = dst;
+	zstream->avail_out = get_page_size(ctx);
+
+	if (ds->zstream_ready) {
+		res = inflateReset(zstream);
+	} else {
+		res = inflateInit(zstream);
+		ds->zstream_ready = (res == Z_OK);
+	}
 	if (res != Z_OK)
-		return set_zlib_error(ctx, "Cannot init zlib", &zstream, res);
+		return set_zlib_error(ctx, "Cannot init zlib", zstream, res);
 
-	res = inflate(&zstream, Z_FINISH);
+	start = stats_start(ctx->shared);
+	res = inflate(zstream, Z_FINISH);
+	stats_end(ctx->shared, STAGE_zlib, start);
 	if (res != Z_STREAM_END) {
-		inflateEnd(&zstream);
 		if (res == Z_NEED_DICT ||
-		    (res == Z_BUF_ERROR && zstream.avail_in == 0))
+		    (res == Z_BUF_ERROR && zstream->avail_in == 0))
 			res = Z_DATA_ERROR;
 		return set_zlib_error(ctx, "Decompresion failed",
-				      &zstream, res);
+				      zstream, res);
 	}
 
-	res = inflateEnd(&zstream);
-	if (res != Z_OK)
-		return set_zlib_error(ctx, "Decompression failed",
-				      &zstream, res);
-
-	if (zstream.avail_out)
+	if (zstream->avail_out)
 		return set_error(ctx, KDUMP_ERR_CORRUPT,
 				 "Wrong uncompressed size: %lu",
-				 (unsigned long) zstream.total_out);
+				 (unsigned long) zstream->total_out);
 
 	return KDUMP_OK;
 
@@ -829,6 +989,123 @@ uncompress_page_gzip(kdump_ctx_t *ctx, unsigned char *dst,
 #endif
 }
 
+/**  Uncompress an LZO1X-compressed page.
+ * @param ctx     Dump file object.
+ * @param ds      Decompression state (unused).
+ * @param dst     Destination buffer.
+ * @param src     Source (compressed) data.
+ * @param srclen  Length of source data.
+ *
+ * LZO1X decompression needs no work memory (@c LZO1X_MEM_DECOMPRESS
+ * is zero), so there is no state to reuse. The parameter is accepted
+ * for symmetry with the other page decompression functions.
+ */
+kdump_status
+uncompress_page_lzo(kdump_ctx_t *ctx, struct decomp_state *ds,
+		    unsigned char *dst, unsigned char *src, size_t srclen)
+{
+#if USE_LZO
+	lzo_uint retlen = get_page_size(ctx);
+	uint64_t start;
+	int ret;
+
+	start = stats_start(ctx->shared);
+	ret = lzo1x_decompress_safe(src, srclen, dst, &retlen,
+				    LZO1X_MEM_DECOMPRESS);
+	stats_end(ctx->shared, STAGE_lzo, start);
+	if (ret != LZO_E_OK)
+		return set_error(ctx, KDUMP_ERR_CORRUPT,
+				 "Decompression failed: %d", ret);
+	if (retlen != get_page_size(ctx))
+		return set_error(ctx, KDUMP_ERR_CORRUPT,
+				 "Wrong uncompressed size: %lu",
+				 (unsigned long) retlen);
+	return KDUMP_OK;
+
+#else
+	return set_error(ctx, KDUMP_ERR_NOTIMPL,
+			 "Unsupported compression method: %s", "lzo");
+#endif
+}
+
+/**  Uncompress a snappy-compressed page.
+ * @param ctx     Dump file object.
+ * @param ds      Decompression state (unused).
+ * @param dst     Destination buffer.
+ * @param src     Source (compressed) data.
+ * @param srclen  Length of source data.
+ *
+ * The snappy C interface keeps no state between calls.
+ */
+kdump_status
+uncompress_page_snappy(kdump_ctx_t *ctx, struct decomp_state *ds,
+		       unsigned char *dst, unsigned char *src, size_t srclen)
+{
+#if USE_SNAPPY
+	size_t retlen = get_page_size(ctx);
+	snappy_status ret;
+	uint64_t start;
+
+	start = stats_start(ctx->shared);
+	ret = snappy_uncompress((const char *)src, srclen,
+				(char *)dst, &retlen);
+	stats_end(ctx->shared, STAGE_snappy, start);
+	if (ret != SNAPPY_OK)
+		return set_error(ctx, KDUMP_ERR_CORRUPT,
+				 "Decompression failed: %d", (int) ret);
+	if (retlen != get_page_size(ctx))
+		return set_error(ctx, KDUMP_ERR_CORRUPT,
+				 "Wrong uncompressed size: %lu",
+				 (unsigned long) retlen);
+	return KDUMP_OK;
+
+#else
+	return set_error(ctx, KDUMP_ERR_NOTIMPL,
+			 "Unsupported compression method: %s", "snappy");
+#endif
+}
+
+/**  Uncompress a zstd-compressed page.
+ * @param ctx     Dump file object.
+ * @param ds      Decompression state.
+ * @param dst     Destination buffer.
+ * @param src     Source (compressed) data.
+ * @param srclen  Length of source data.
+ */
+kdump_status
+uncompress_page_zstd(kdump_ctx_t *ctx, struct decomp_state *ds,
+		     unsigned char *dst, unsigned char *src, size_t srclen)
+{
+#if USE_ZSTD
+	uint64_t start;
+	size_t ret;
+
+	if (!ds->zstd) {
+		ds->zstd = ZSTD_createDCtx();
+		if (!ds->zstd)
+			return set_error(ctx, KDUMP_ERR_SYSTEM,
+					 "Cannot allocate zstd context");
+	}
+
+	start = stats_start(ctx->shared);
+	ret = ZSTD_decompressDCtx(ds->zstd, dst, get_page_size(ctx),
+				  src, srclen);
+	stats_end(ctx->shared, STAGE_zstd, start);
+	if (ZSTD_isError(ret))
+		return set_error(ctx, KDUMP_ERR_CORRUPT,
+				 "Decompression failed: %s",
+				 ZSTD_getErrorName(ret));
+	if (ret != get_page_size(ctx))
+		return set_error(ctx, KDUMP_ERR_CORRUPT,
+				 "Wrong uncompressed size: %zu", ret);
+	return KDUMP_OK;
+
+#else
+	return set_error(ctx, KDUMP_ERR_NOTIMPL,
+			 "Unsupported compression method: %s", "zstd");
+#endif
+}
+
 uint32_t
 cksum32(void *buffer, size_t size, uint32_t csum)
 {
@@ -1507,3 +1784,132 @@ err_filename(kdump_ctx_t *ctx, unsigned fidx)
 	}
 	return ctx->err_filename;
 }
+
+/** Update a 64-bit FNV-1a hash.
+ * @param hash  Hash of preceding data.
+ * @param data  Data to be hashed.
+ * @param len   Length of @p data.
+ * @returns     Updated hash.
+ */
+uint64_t
+fnv64_update(uint64_t hash, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	while (len--) {
+		hash ^= *p++;
+		hash *= FNV64_PRIME;
+	}
+	return hash;
+}
+
+/** Get the identification of a dump file.
+ * @param fc        File cache.
+ * @param fidx      File index.
+ * @param hashsize  Number of bytes to hash at the beginning of the file.
+ * @param key       Identification, filled in on success.
+ * @returns         @c true on success, @c false on failure.
+ */
+bool
+get_file_key(struct fcache *fc, unsigned fidx, off_t hashsize,
+	     struct file_key *key)
+{
+	char buf[4096];
+	struct stat st;
+	off_t pos, len;
+	size_t chunk;
+	uint64_t hash;
+
+	if (fstat(fc->info[fidx].fd, &st))
+		return false;
+
+	len = st.st_size < hashsize
+		? st.st_size
+		: hashsize;
+	hash = FNV64_OFFSET;
+	for (pos = 0; pos < len; pos += chunk) {
+		chunk = len - pos < sizeof buf ? len - pos : sizeof buf;
+		if (fcache_pread(fc, buf, chunk, fidx, pos) != KDUMP_OK)
+			return false;
+		hash = fnv64_update(hash, buf, chunk);
+	}
+
+	memset(key, 0, sizeof *key);
+	key->filesz = st.st_size;
+	key->mtime_sec = st.st_mtim.tv_sec;
+	key->mtime_nsec = st.st_mtim.tv_nsec;
+	key->hash = hash;
+	return true;
+}
+
+/** Read a whole file into memory.
+ * @param path   File path.
+ * @param psize  Set to the file size on success.
+ * @returns      Newly allocated buffer, or @c NULL on failure.
+ */
+void *
+slurp_file(const char *path, size_t *psize)
+{
+	struct stat st;
+	char *buf;
+	size_t done;
+	ssize_t rd;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	buf = NULL;
+	if (fstat(fd, &st) || !(buf = malloc(st.st_size ?: 1)))
+		goto err;
+
+	for (done = 0; done < st.st_size; done += rd) {
+		rd = read(fd, buf + done, st.st_size - done);
+		if (rd <= 0)
+			goto err;
+	}
+	close(fd);
+	*psize = done;
+	return buf;
+
+ err:
+	free(buf);
+	close(fd);
+	return NULL;
+}
+
+/** Save data to a file.
+ * @param path  File path.
+ * @param data  File contents.
+ * @param size  Size of @p data.
+ *
+ * The data is written to a temporary file, which is then renamed,
+ * so concurrent users never see an incomplete file. Errors are
+ * ignored, because this is used only for index files, which are
+ * an optimization.
+ */
+void
+save_file(const char *path, const void *data, size_t size)
+{
+	const char *p, *endp;
+	char *tmppath;
+	ssize_t wr;
+	int fd;
+
+	if (asprintf(&tmppath, "%s.XXXXXX", path) < 0)
+		return;
+	fd = mkstemp(tmppath);
+	if (fd < 0)
+		goto out;
+
+	endp = (const char *) data + size;
+	for (p = data; p < endp; p += wr) {
+		wr = write(fd, p, endp - p);
+		if (wr <= 0)
+			break;
+	}
+	if (close(fd) || p != endp || rename(tmppath, path))
+		unlink(tmppath);
+
+ out:
+	free(tmppath);
+}
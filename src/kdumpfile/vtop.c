@@ -35,6 +35,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <limits.h>
 
 #define RGN_ALLOC_INC 32
 
@@ -540,6 +541,86 @@ const struct attr_ops xen_dirty_xlat_ops = {
 	.pre_clear = (attr_pre_clear_fn*)xen_dirty_xlat_hook,
 };
 
+/**  Update TLB statistics attributes.
+ * @param ctx   Dump file object.
+ * @param attr  Attribute to be revalidated.
+ * @returns     Error status.
+ *
+ * The statistics are kept by the translation context of @p ctx.
+ * The attribute stays invalid, so it is updated on every access.
+ */
+static kdump_status
+xlat_tlb_revalidate(kdump_ctx_t *ctx, struct attr_data *attr)
+{
+	addrxlat_tlb_stats_t stats;
+
+	addrxlat_ctx_get_tlb_stats(ctx->xlatctx, &stats);
+	attr->val.number = (attr == gattr(ctx, GKI_xlat_tlb_hits))
+		? stats.hits
+		: stats.misses;
+	return KDUMP_OK;
+}
+
+const struct attr_ops xlat_tlb_ops = {
+	.revalidate = xlat_tlb_revalidate,
+};
+
+/** Minimum number of page table read cache slots.
+ * This is the minimum accepted by @ref addrxlat_ctx_set_read_cache_size.
+ */
+#define XLAT_READ_CACHE_MIN	4
+
+static kdump_status
+xlat_read_cache_pre_hook(kdump_ctx_t *ctx, struct attr_data *attr,
+			 kdump_attr_value_t *val)
+{
+	if (val->number < XLAT_READ_CACHE_MIN || val->number > UINT_MAX)
+		return set_error(ctx, KDUMP_ERR_INVALID,
+				 "Invalid read cache size (%u to %u)",
+				 XLAT_READ_CACHE_MIN, UINT_MAX);
+	return KDUMP_OK;
+}
+
+/**  Resize the page table read cache after changing its size attribute.
+ * @param ctx   Dump file object.
+ * @param attr  "addrxlat.read_cache_size" attribute.
+ * @returns     Error status.
+ *
+ * Only the translation context of @p ctx is resized. The attribute
+ * is left invalid, so other clones get their own value.
+ */
+static kdump_status
+xlat_read_cache_post_hook(kdump_ctx_t *ctx, struct attr_data *attr)
+{
+	addrxlat_status status;
+
+	attr->flags.invalid = true;
+	status = addrxlat_ctx_set_read_cache_size(
+		ctx->xlatctx, attr_value(attr)->number);
+	if (status != ADDRXLAT_OK)
+		return set_error(ctx, addrxlat2kdump(ctx, status),
+				 "Cannot set read cache size");
+	return KDUMP_OK;
+}
+
+/**  Get the page table read cache size.
+ * @param ctx   Dump file object.
+ * @param attr  Attribute to be revalidated.
+ * @returns     Error status.
+ */
+static kdump_status
+xlat_read_cache_revalidate(kdump_ctx_t *ctx, struct attr_data *attr)
+{
+	attr->val.number = addrxlat_ctx_get_read_cache_size(ctx->xlatctx);
+	return KDUMP_OK;
+}
+
+const struct attr_ops xlat_read_cache_ops = {
+	.pre_set = xlat_read_cache_pre_hook,
+	.post_set = xlat_read_cache_post_hook,
+	.revalidate = xlat_read_cache_revalidate,
+};
+
 /**  Addrxlat put_page callback.
  * @param buf   Page buffer metadata.
  * @returns     Error status.
@@ -90,6 +90,12 @@ rwlock_rdlock(rwlock_t *rwlock)
 	return pthread_rwlock_rdlock(rwlock);
 }
 
+static inline int
+rwlock_tryrdlock(rwlock_t *rwlock)
+{
+	return pthread_rwlock_tryrdlock(rwlock);
+}
+
 static inline int
 rwlock_wrlock(rwlock_t *rwlock)
 {
@@ -102,8 +108,49 @@ rwlock_unlock(rwlock_t *rwlock)
 	return pthread_rwlock_unlock(rwlock);
 }
 
+typedef pthread_cond_t cond_t;
+typedef pthread_condattr_t condattr_t;
+
+static inline int
+cond_init(cond_t *cond, const condattr_t *attr)
+{
+	return pthread_cond_init(cond, attr);
+}
+
+static inline int
+cond_destroy(cond_t *cond)
+{
+	return pthread_cond_destroy(cond);
+}
+
+static inline int
+cond_wait(cond_t *cond, mutex_t *mutex)
+{
+	return pthread_cond_wait(cond, mutex);
+}
+
+static inline int
+cond_timedwait(cond_t *cond, mutex_t *mutex, const struct timespec *abstime)
+{
+	return pthread_cond_timedwait(cond, mutex, abstime);
+}
+
+static inline int
+cond_signal(cond_t *cond)
+{
+	return pthread_cond_signal(cond);
+}
+
+static inline int
+cond_broadcast(cond_t *cond)
+{
+	return pthread_cond_broadcast(cond);
+}
+
 #else  /* USE_PTHREAD */
 
+#include <time.h>
+
 typedef struct { } mutex_t;
 typedef struct { } mutexattr_t;
 
@@ -158,6 +205,12 @@ rwlock_rdlock(rwlock_t *rwlock)
 	return 0;
 }
 
+static inline int
+rwlock_tryrdlock(rwlock_t *rwlock)
+{
+	return 0;
+}
+
 static inline int
 rwlock_wrlock(rwlock_t *rwlock)
 {
@@ -170,6 +223,45 @@ rwlock_unlock(rwlock_t *rwlock)
 	return 0;
 }
 
+typedef struct { } cond_t;
+typedef struct { } condattr_t;
+
+static inline int
+cond_init(cond_t *cond, const condattr_t *attr)
+{
+	return 0;
+}
+
+static inline int
+cond_destroy(cond_t *cond)
+{
+	return 0;
+}
+
+static inline int
+cond_wait(cond_t *cond, mutex_t *mutex)
+{
+	return 0;
+}
+
+static inline int
+cond_timedwait(cond_t *cond, mutex_t *mutex, const struct timespec *abstime)
+{
+	return 0;
+}
+
+static inline int
+cond_signal(cond_t *cond)
+{
+	return 0;
+}
+
+static inline int
+cond_broadcast(cond_t *cond)
+{
+	return 0;
+}
+
 #endif
 
 #endif	/* threads.h */
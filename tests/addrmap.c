@@ -28,6 +28,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <libkdumpfile/addrxlat.h>
 
 #include "testutil.h"
@@ -50,6 +51,78 @@ printmap(const addrxlat_map_t *map)
 	}
 }
 
+static int
+checkmap(const addrxlat_map_t *map)
+{
+	addrxlat_addr_t addr, start;
+	const addrxlat_range_t *range;
+	size_t i, n, idx;
+
+	n = addrxlat_map_len(map);
+	addr = 0;
+	range = addrxlat_map_ranges(map);
+	for (i = 0; i < n; ++i) {
+		idx = addrxlat_map_find(map, addr + range->endoff, &start);
+		if (idx != i || start != addr) {
+			fprintf(stderr, "Wrong range for 0x%"ADDRXLAT_PRIxADDR
+				": %zu (expected %zu)\n",
+				addr + range->endoff, idx, i);
+			return TEST_FAIL;
+		}
+		if (addrxlat_map_search(map, addr) != range->meth) {
+			fprintf(stderr, "Wrong method for 0x%"ADDRXLAT_PRIxADDR
+				"\n", addr);
+			return TEST_FAIL;
+		}
+		addr += range->endoff + 1;
+		++range;
+	}
+	return TEST_OK;
+}
+
+/* Check that a map can be re-created from its ranges. */
+static int
+checkranges(const addrxlat_map_t *map)
+{
+	const addrxlat_range_t *ranges = addrxlat_map_ranges(map);
+	size_t n = addrxlat_map_len(map);
+	addrxlat_map_t *copy;
+	addrxlat_status status;
+	int rc;
+
+	copy = addrxlat_map_new();
+	if (!copy) {
+		perror("Cannot allocate map");
+		return TEST_ERR;
+	}
+
+	rc = TEST_OK;
+	if (n > 1) {
+		status = addrxlat_map_set_ranges(copy, ranges, n - 1);
+		if (status != ADDRXLAT_ERR_INVALID) {
+			fprintf(stderr, "Incomplete ranges not rejected: %s\n",
+				addrxlat_strerror(status));
+			rc = TEST_FAIL;
+		}
+	}
+
+	status = addrxlat_map_set_ranges(copy, ranges, n);
+	if (status != ADDRXLAT_OK) {
+		fprintf(stderr, "Cannot set ranges: %s\n",
+			addrxlat_strerror(status));
+		rc = TEST_FAIL;
+	} else if (addrxlat_map_len(copy) != n ||
+		   memcmp(addrxlat_map_ranges(copy), ranges,
+			  n * sizeof(*ranges))) {
+		fprintf(stderr, "Ranges do not match\n");
+		rc = TEST_FAIL;
+	} else if (checkmap(copy) != TEST_OK)
+		rc = TEST_FAIL;
+
+	addrxlat_map_decref(copy);
+	return rc;
+}
+
 int
 main(int argc, char **argv)
 {
@@ -93,8 +166,14 @@ main(int argc, char **argv)
 				addrxlat_strerror(status));
 			return TEST_ERR;
 		}
+
+		if (checkmap(map) != TEST_OK)
+			return TEST_FAIL;
 	}
 
+	if (checkranges(map) != TEST_OK)
+		return TEST_FAIL;
+
 	if (map) {
 		printmap(map);
 		addrxlat_map_decref(map);
@@ -0,0 +1,57 @@
+/* Benchmark helpers.
+   Copyright (C) 2016 Petr Tesarik <ptesarik@suse.com>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "bench.h"
+
+static int
+cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+/* Print the result line. The latency array is sorted in place. */
+void
+bench_report(struct bench_result *res)
+{
+	double secs;
+
+	qsort(res->lat, res->reads, sizeof(*res->lat), cmp_u64);
+	secs = (res->end - res->start) / 1e9;
+	printf("%s,%s,%lu,%lu,%lu,%.6f,%.1f,%.2f,%.3f,%.3f\n",
+	       res->label, res->workload, res->threads,
+	       res->reads, res->errors, secs,
+	       res->reads / secs,
+	       (double)res->reads * res->pagesz / secs / 1e6,
+	       res->lat[res->reads / 2] / 1e3,
+	       res->lat[res->reads - 1 - res->reads / 100] / 1e3);
+}
@@ -0,0 +1,63 @@
+/* Benchmark helpers.
+   Copyright (C) 2016 Petr Tesarik <ptesarik@suse.com>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _BENCH_H
+#define _BENCH_H 1
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+/** Column names of the result line. */
+#define BENCH_CSV_HEADER \
+	"label,workload,threads,reads,errors,seconds," \
+	"pages_per_s,mb_per_s,p50_us,p99_us"
+
+/** Results of one benchmark run. */
+struct bench_result {
+	const char *label;	/**< Label (dump type or codec). */
+	const char *workload;	/**< Workload name. */
+	unsigned long threads;	/**< Number of threads. */
+	unsigned long reads;	/**< Total number of page reads. */
+	unsigned long errors;	/**< Number of failed reads. */
+	size_t pagesz;		/**< Page size in bytes. */
+	uint64_t start, end;	/**< Time of the first and last read. */
+	uint64_t *lat;		/**< Latency of each read (in ns). */
+};
+
+static inline uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void bench_report(struct bench_result *res);
+
+#endif	/* bench.h */
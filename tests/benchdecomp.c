@@ -0,0 +1,460 @@
+/* Page decompression benchmark.
+   Copyright (C) 2016 Petr Tesarik <ptesarik@suse.com>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/* This program calls internal library functions, so it is linked
+ * with the check library and must not include "testutil.h".
+ */
+
+#include "kdumpfile-priv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if USE_ZLIB
+# include <zlib.h>
+#endif
+#if USE_LZO
+# include <lzo/lzo1x.h>
+#endif
+#if USE_SNAPPY
+# include <snappy-c.h>
+#endif
+#if USE_ZSTD
+# include <zstd.h>
+#endif
+
+#include "bench.h"
+
+#define TEST_OK     0
+#define TEST_FAIL   1
+#define TEST_ERR   99
+
+#define PAGE_SIZE	4096
+#define NPAGES		256
+#define DEFAULT_ITER	100
+
+/** Compressed test page. */
+struct cpage {
+	size_t len;
+	unsigned char *data;
+};
+
+/** Compress one page.
+ * @param cp    Compressed page (filled on success).
+ * @param page  Page data (@ref PAGE_SIZE bytes).
+ * @returns     Zero on success, non-zero on failure.
+ */
+typedef int compress_fn(struct cpage *cp, const unsigned char *page);
+
+/** Decompress one page without any saved state.
+ * @param dst  Destination buffer (@ref PAGE_SIZE bytes).
+ * @param cp   Compressed page.
+ * @returns    Zero on success, non-zero on failure.
+ */
+typedef int oneshot_fn(unsigned char *dst, const struct cpage *cp);
+
+/** Library page decompression function. */
+typedef kdump_status uncompress_fn(
+	kdump_ctx_t *ctx, struct decomp_state *ds,
+	unsigned char *dst, unsigned char *src, size_t srclen);
+
+struct codec {
+	const char *name;
+	compress_fn *compress;
+	oneshot_fn *oneshot;
+	uncompress_fn *uncompress;
+};
+
+static unsigned char pages[NPAGES][PAGE_SIZE];
+static unsigned char out[PAGE_SIZE];
+static unsigned long iter = DEFAULT_ITER;
+
+/* Fill pages with data which compresses roughly like kernel memory:
+ * runs of zeroes, repeated words and some random bytes.
+ */
+static void
+make_pages(void)
+{
+	unsigned i, j;
+
+	srandom(1);
+	for (i = 0; i < NPAGES; ++i) {
+		for (j = 0; j < PAGE_SIZE; j += 8) {
+			switch (random() % 8) {
+			case 0: case 1: case 2: case 3:
+				break;
+			case 4: case 5:
+				memcpy(&pages[i][j], "kdumpfil", 8);
+				break;
+			default:
+				pages[i][j] = random();
+				pages[i][j + 3] = random();
+			}
+		}
+	}
+}
+
+#if USE_ZLIB
+
+static int
+compress_gzip(struct cpage *cp, const unsigned char *page)
+{
+	uLongf len = compressBound(PAGE_SIZE);
+
+	cp->data = malloc(len);
+	if (!cp->data || compress(cp->data, &len, page, PAGE_SIZE) != Z_OK)
+		return -1;
+	cp->len = len;
+	return 0;
+}
+
+static int
+oneshot_gzip(unsigned char *dst, const struct cpage *cp)
+{
+	z_stream zstream;
+
+	memset(&zstream, 0, sizeof zstream);
+	zstream.next_in = cp->data;
+	zstream.avail_in = cp->len;
+	zstream.next_out = dst;
+	zstream.avail_out = PAGE_SIZE;
+	if (inflateInit(&zstream) != Z_OK)
+		return -1;
+	if (inflate(&zstream, Z_FINISH) != Z_STREAM_END) {
+		inflateEnd(&zstream);
+		return -1;
+	}
+	return inflateEnd(&zstream) == Z_OK ? 0 : -1;
+}
+
+#endif	/* USE_ZLIB */
+
+#if USE_LZO
+
+static int
+compress_lzo(struct cpage *cp, const unsigned char *page)
+{
+	static lzo_align_t wrkmem[(LZO1X_1_MEM_COMPRESS + sizeof(lzo_align_t)
+				   - 1) / sizeof(lzo_align_t)];
+	lzo_uint len;
+
+	cp->data = malloc(PAGE_SIZE + PAGE_SIZE / 16 + 64 + 3);
+	if (!cp->data ||
+	    lzo1x_1_compress(page, PAGE_SIZE, cp->data, &len,
+			     wrkmem) != LZO_E_OK)
+		return -1;
+	cp->len = len;
+	return 0;
+}
+
+static int
+oneshot_lzo(unsigned char *dst, const struct cpage *cp)
+{
+	lzo_uint len = PAGE_SIZE;
+
+	return lzo1x_decompress_safe(cp->data, cp->len, dst, &len,
+				     LZO1X_MEM_DECOMPRESS) != LZO_E_OK ||
+		len != PAGE_SIZE;
+}
+
+#endif	/* USE_LZO */
+
+#if USE_SNAPPY
+
+static int
+compress_snappy(struct cpage *cp, const unsigned char *page)
+{
+	size_t len = snappy_max_compressed_length(PAGE_SIZE);
+
+	cp->data = malloc(len);
+	if (!cp->data ||
+	    snappy_compress((const char *)page, PAGE_SIZE,
+			    (char *)cp->data, &len) != SNAPPY_OK)
+		return -1;
+	cp->len = len;
+	return 0;
+}
+
+static int
+oneshot_snappy(unsigned char *dst, const struct cpage *cp)
+{
+	size_t len = PAGE_SIZE;
+
+	return snappy_uncompress((const char *)cp->data, cp->len,
+				 (char *)dst, &len) != SNAPPY_OK ||
+		len != PAGE_SIZE;
+}
+
+#endif	/* USE_SNAPPY */
+
+#if USE_ZSTD
+
+static int
+compress_zstd(struct cpage *cp, const unsigned char *page)
+{
+	size_t len = ZSTD_compressBound(PAGE_SIZE);
+
+	cp->data = malloc(len);
+	if (!cp->data)
+		return -1;
+	len = ZSTD_compress(cp->data, len, page, PAGE_SIZE, 1);
+	if (ZSTD_isError(len))
+		return -1;
+	cp->len = len;
+	return 0;
+}
+
+static int
+oneshot_zstd(unsigned char *dst, const struct cpage *cp)
+{
+	return ZSTD_decompress(dst, PAGE_SIZE, cp->data, cp->len)
+		!= PAGE_SIZE;
+}
+
+#endif	/* USE_ZSTD */
+
+static const struct codec codecs[] = {
+#if USE_ZLIB
+	{ "zlib", compress_gzip, oneshot_gzip, uncompress_page_gzip },
+#endif
+#if USE_LZO
+	{ "lzo", compress_lzo, oneshot_lzo, uncompress_page_lzo },
+#endif
+#if USE_SNAPPY
+	{ "snappy", compress_snappy, oneshot_snappy, uncompress_page_snappy },
+#endif
+#if USE_ZSTD
+	{ "zstd", compress_zstd, oneshot_zstd, uncompress_page_zstd },
+#endif
+};
+
+#define NCODECS	(sizeof(codecs) / sizeof(codecs[0]))
+
+/* Decompress all pages iter times and print the result line.
+ * If reused is non-zero, use the library function with saved state.
+ */
+static int
+run_codec(const struct codec *codec, const struct cpage *cp,
+	  kdump_ctx_t *ctx, struct decomp_state *ds, int reused)
+{
+	struct bench_result res;
+	uint64_t *lat, t;
+	unsigned long n, i;
+	int rc;
+
+	lat = malloc(iter * NPAGES * sizeof(*lat));
+	if (!lat) {
+		perror("Cannot allocate latency buffer");
+		return TEST_ERR;
+	}
+
+	res.label = codec->name;
+	res.workload = reused ? "reused" : "oneshot";
+	res.threads = 1;
+	res.reads = iter * NPAGES;
+	res.errors = 0;
+	res.pagesz = PAGE_SIZE;
+	res.lat = lat;
+
+	res.start = now_ns();
+	for (n = 0; n < iter; ++n)
+		for (i = 0; i < NPAGES; ++i) {
+			t = now_ns();
+			rc = reused
+				? codec->uncompress(ctx, ds, out, cp[i].data,
+						    cp[i].len) != KDUMP_OK
+				: codec->oneshot(out, &cp[i]);
+			*lat++ = now_ns() - t;
+			if (rc)
+				++res.errors;
+		}
+	res.end = now_ns();
+
+	rc = TEST_OK;
+	if (res.errors) {
+		fprintf(stderr, "%s %s decompression failed: %s\n",
+			res.label, res.workload,
+			reused ? kdump_get_err(ctx) : "error");
+		rc = TEST_FAIL;
+	} else if (memcmp(out, pages[NPAGES - 1], PAGE_SIZE)) {
+		fprintf(stderr, "%s %s data mismatch\n",
+			res.label, res.workload);
+		rc = TEST_FAIL;
+	}
+
+	bench_report(&res);
+	free(res.lat);
+	return rc;
+}
+
+static int
+bench_codec(const struct codec *codec, kdump_ctx_t *ctx,
+	    struct decomp_state *ds)
+{
+	static struct cpage cp[NPAGES];
+	unsigned i;
+	int rc;
+
+	for (i = 0; i < NPAGES; ++i)
+		if (codec->compress(&cp[i], pages[i])) {
+			fprintf(stderr, "Cannot compress with %s\n",
+				codec->name);
+			return TEST_ERR;
+		}
+
+	rc = run_codec(codec, cp, ctx, ds, 0);
+	if (rc == TEST_OK)
+		rc = run_codec(codec, cp, ctx, ds, 1);
+
+	for (i = 0; i < NPAGES; ++i) {
+		free(cp[i].data);
+		cp[i].data = NULL;
+	}
+	return rc;
+}
+
+static const struct codec *
+find_codec(const char *name)
+{
+	unsigned i;
+
+	for (i = 0; i < NCODECS; ++i)
+		if (!strcmp(codecs[i].name, name))
+			return &codecs[i];
+	return NULL;
+}
+
+static void
+usage(const char *name)
+{
+	unsigned i;
+
+	fprintf(stderr,
+		"Usage: %s [<options>] [<codec>...]\n"
+		"\n"
+		"Options:\n"
+		"  -H             Print the CSV header and exit\n"
+		"  -i iterations  Number of passes over %u pages"
+		" (default: %u)\n"
+		"\n"
+		"Available codecs:",
+		name, NPAGES, DEFAULT_ITER);
+	for (i = 0; i < NCODECS; ++i)
+		fprintf(stderr, " %s", codecs[i].name);
+	fputs("\n\nResults are printed as comma-separated values.\n",
+	      stderr);
+}
+
+int
+main(int argc, char **argv)
+{
+	const struct codec *codec;
+	struct decomp_state *ds;
+	kdump_ctx_t *ctx;
+	char *endp;
+	int slot, rc;
+	int opt;
+	int i;
+
+	while ((opt = getopt(argc, argv, "Hhi:")) != -1) {
+		switch (opt) {
+		case 'H':
+			puts(BENCH_CSV_HEADER);
+			return TEST_OK;
+
+		case 'i':
+			iter = strtoul(optarg, &endp, 0);
+			if (*endp || !iter) {
+				fprintf(stderr, "Invalid number: %s\n",
+					optarg);
+				return TEST_ERR;
+			}
+			break;
+
+		case 'h':
+		default:
+			usage(argv[0]);
+			return (opt == 'h') ? TEST_OK : TEST_ERR;
+		}
+	}
+
+	/* Uncompressed pages are accepted for convenience. */
+	for (i = optind; i < argc; ++i)
+		if (strcmp(argv[i], "raw") && !find_codec(argv[i])) {
+			fprintf(stderr, "Unknown codec: %s\n", argv[i]);
+			return TEST_ERR;
+		}
+
+	ctx = kdump_new();
+	if (!ctx) {
+		perror("Cannot allocate dump file object");
+		return TEST_ERR;
+	}
+	if (set_page_size(ctx, PAGE_SIZE) != KDUMP_OK) {
+		fprintf(stderr, "Cannot set page size: %s\n",
+			kdump_get_err(ctx));
+		kdump_free(ctx);
+		return TEST_ERR;
+	}
+	slot = decomp_alloc(ctx->shared);
+	if (slot < 0) {
+		perror("Cannot allocate decompression state");
+		kdump_free(ctx);
+		return TEST_ERR;
+	}
+	ds = ctx->data[slot];
+
+#if USE_LZO
+	if (lzo_init() != LZO_E_OK) {
+		fputs("lzo_init() failed\n", stderr);
+		per_ctx_free(ctx->shared, slot);
+		kdump_free(ctx);
+		return TEST_ERR;
+	}
+#endif
+
+	make_pages();
+	rc = TEST_OK;
+	if (optind < argc) {
+		for (i = optind; rc == TEST_OK && i < argc; ++i) {
+			codec = find_codec(argv[i]);
+			if (codec)
+				rc = bench_codec(codec, ctx, ds);
+		}
+	} else {
+		for (i = 0; rc == TEST_OK && i < NCODECS; ++i)
+			rc = bench_codec(&codecs[i], ctx, ds);
+	}
+
+	per_ctx_free(ctx->shared, slot);
+	kdump_free(ctx);
+	return rc;
+}
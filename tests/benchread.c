@@ -0,0 +1,532 @@
+/* Read throughput benchmark.
+   Copyright (C) 2016 Petr Tesarik <ptesarik@suse.com>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <libkdumpfile/kdumpfile.h>
+
+#include "testutil.h"
+#include "bench.h"
+
+#define DEFTHREADS	1
+
+enum workload {
+	WL_SEQ,			/**< Each thread reads its own sequence. */
+	WL_RANDOM,		/**< Uniformly distributed random pages. */
+	WL_STRIDE,		/**< Every n-th page. */
+};
+
+static const char *label = "-";
+static const char *workload_name = "seq";
+static enum workload workload = WL_SEQ;
+static unsigned long stride = 1;
+
+static unsigned long base_pfn, npages;
+static unsigned long niter;
+static unsigned long nthreads = DEFTHREADS;
+static kdump_num_t page_shift;
+
+/** Number of pages visited by the stride workload before it wraps. */
+static unsigned long stride_cycle;
+
+/* Start gate: threads wait until all of them have been created. */
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static int start_state;		/**< Zero to wait, >0 to run, <0 to abort. */
+
+struct thread_info {
+	pthread_t id;
+	kdump_ctx_t *ctx;
+	unsigned idx;
+	unsigned long errors;
+	uint64_t start, end;	/**< Time of the first and last read. */
+	uint64_t *lat;		/**< Latency of each read (in ns). */
+};
+
+/* xorshift64*, so that each thread has its own reproducible sequence */
+static inline uint64_t
+next_random(uint64_t *state)
+{
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 0x2545f4914f6cdd1dULL;
+}
+
+/* Wait until the start gate is opened.
+ * Returns non-zero if the reads should run.
+ */
+static int
+wait_start(void)
+{
+	int state;
+
+	pthread_mutex_lock(&start_lock);
+	while (!start_state)
+		pthread_cond_wait(&start_cond, &start_lock);
+	state = start_state;
+	pthread_mutex_unlock(&start_lock);
+	return state > 0;
+}
+
+/* Open the start gate with the given state. */
+static void
+open_start(int state)
+{
+	pthread_mutex_lock(&start_lock);
+	start_state = state;
+	pthread_cond_broadcast(&start_cond);
+	pthread_mutex_unlock(&start_lock);
+}
+
+static unsigned long
+gcd(unsigned long a, unsigned long b)
+{
+	while (b) {
+		unsigned long t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static void *
+run_reads(void *arg)
+{
+	struct thread_info *ti = arg;
+	size_t pagesz = (size_t)1 << page_shift;
+	unsigned long first, off;
+	uint64_t rnd, t;
+	unsigned long i;
+	void *buf;
+	size_t sz;
+	kdump_status res;
+
+	buf = malloc(pagesz);
+	if (!buf)
+		return (void*) "Cannot allocate page buffer";
+
+	rnd = 0x9e3779b97f4a7c15ULL * (ti->idx + 1);
+	first = off = (npages / nthreads) * ti->idx;
+
+	if (!wait_start()) {
+		free(buf);
+		return NULL;
+	}
+	ti->start = now_ns();
+	for (i = 0; i < niter; ++i) {
+		switch (workload) {
+		case WL_SEQ:
+			off = (off + 1) % npages;
+			break;
+		case WL_RANDOM:
+			off = next_random(&rnd) % npages;
+			break;
+		case WL_STRIDE:
+			/* Start one page later after each full cycle, so
+			 * all pages are visited even if the stride and the
+			 * number of pages have a common divisor.
+			 */
+			off = (first + (i % stride_cycle) * stride +
+			       i / stride_cycle) % npages;
+			break;
+		}
+
+		sz = pagesz;
+		t = now_ns();
+		res = kdump_read(ti->ctx, KDUMP_MACHPHYSADDR,
+				 (base_pfn + off) << page_shift, buf, &sz);
+		ti->lat[i] = now_ns() - t;
+		if (res != KDUMP_OK)
+			++ti->errors;
+	}
+	ti->end = now_ns();
+
+	free(buf);
+	return NULL;
+}
+
+static int
+run_threads(kdump_ctx_t *ctx)
+{
+	struct thread_info tinfo[nthreads];
+	struct bench_result result;
+	unsigned i, nstarted;
+	uint64_t *lat;
+	int res;
+	int rc;
+
+	lat = malloc(nthreads * niter * sizeof(*lat));
+	if (!lat) {
+		perror("Cannot allocate latency buffer");
+		return TEST_ERR;
+	}
+
+	rc = TEST_OK;
+	start_state = 0;
+	for (i = 0; i < nthreads; ++i) {
+		tinfo[i].idx = i;
+		tinfo[i].errors = 0;
+		tinfo[i].lat = lat + i * niter;
+		tinfo[i].ctx = kdump_clone(ctx, 0);
+		if (!tinfo[i].ctx) {
+			fprintf(stderr, "Cannot allocate clone\n");
+			rc = TEST_ERR;
+			break;
+		}
+
+		res = pthread_create(&tinfo[i].id, NULL, run_reads, &tinfo[i]);
+		if (res) {
+			fprintf(stderr, "pthread_create: %s\n", strerror(res));
+			kdump_free(tinfo[i].ctx);
+			rc = TEST_ERR;
+			break;
+		}
+	}
+	nstarted = i;
+
+	/* Let the threads run, or make them exit if any setup failed. */
+	open_start(rc == TEST_OK ? 1 : -1);
+
+	result.label = label;
+	result.workload = workload_name;
+	result.threads = nthreads;
+	result.reads = nthreads * niter;
+	result.errors = 0;
+	result.pagesz = (size_t)1 << page_shift;
+	result.start = UINT64_MAX;
+	result.end = 0;
+	result.lat = lat;
+	for (i = 0; i < nstarted; ++i) {
+		void *retval;
+		res = pthread_join(tinfo[i].id, &retval);
+		if (res) {
+			fprintf(stderr, "pthread_join: %s\n", strerror(res));
+			rc = TEST_ERR;
+			continue;
+		}
+		if (retval) {
+			fprintf(stderr, "Thread %u failed: %s\n",
+				i, (const char*) retval);
+			rc = TEST_FAIL;
+		}
+		result.errors += tinfo[i].errors;
+		if (tinfo[i].start < result.start)
+			result.start = tinfo[i].start;
+		if (tinfo[i].end > result.end)
+			result.end = tinfo[i].end;
+		kdump_free(tinfo[i].ctx);
+	}
+
+	if (rc != TEST_ERR)
+		bench_report(&result);
+
+	free(lat);
+	return rc;
+}
+
+static int
+set_number(kdump_ctx_t *ctx, const char *key, kdump_num_t num)
+{
+	kdump_status res;
+
+	res = kdump_set_number_attr(ctx, key, num);
+	if (res != KDUMP_OK) {
+		fprintf(stderr, "Cannot set %s: %s\n",
+			key, kdump_get_err(ctx));
+		return TEST_ERR;
+	}
+	return TEST_OK;
+}
+
+struct settings {
+	unsigned long cache_size;
+	unsigned long cache_shards;
+	unsigned long readahead;
+	long mmap_policy;
+	const char *io_engine;
+};
+
+static int
+run_bench(int nfds, const int *fds, const struct settings *set)
+{
+	kdump_ctx_t *ctx;
+	kdump_status res;
+	int rc;
+
+	ctx = kdump_new();
+	if (!ctx) {
+		perror("Cannot initialize dump context");
+		return TEST_ERR;
+	}
+
+	res = kdump_open_fdset(ctx, nfds, fds);
+	if (res != KDUMP_OK) {
+		fprintf(stderr, "Cannot open dump: %s\n", kdump_get_err(ctx));
+		kdump_free(ctx);
+		return TEST_ERR;
+	}
+
+	res = kdump_get_number_attr(ctx, KDUMP_ATTR_PAGE_SHIFT, &page_shift);
+	if (res != KDUMP_OK) {
+		fprintf(stderr, "Cannot get page shift: %s\n",
+			kdump_get_err(ctx));
+		kdump_free(ctx);
+		return TEST_ERR;
+	}
+
+	rc = TEST_OK;
+	if (set->cache_size)
+		rc = set_number(ctx, "cache.size", set->cache_size);
+	if (rc == TEST_OK && set->cache_shards)
+		rc = set_number(ctx, "cache.shards", set->cache_shards);
+	if (rc == TEST_OK && set->readahead)
+		rc = set_number(ctx, "cache.readahead", set->readahead);
+	if (rc == TEST_OK && set->mmap_policy >= 0)
+		rc = set_number(ctx, KDUMP_ATTR_FILE_MMAP_POLICY,
+				set->mmap_policy);
+	if (rc == TEST_OK && set->io_engine) {
+		res = kdump_set_string_attr(ctx, KDUMP_ATTR_FILE_IO_ENGINE,
+					    set->io_engine);
+		if (res != KDUMP_OK) {
+			fprintf(stderr, "Cannot set I/O engine: %s\n",
+				kdump_get_err(ctx));
+			rc = TEST_ERR;
+		}
+	}
+
+	if (rc == TEST_OK)
+		rc = run_threads(ctx);
+
+	kdump_free(ctx);
+	return rc;
+}
+
+static int
+parse_workload(const char *arg)
+{
+	char *p;
+
+	workload_name = arg;
+	if (!strcmp(arg, "seq"))
+		workload = WL_SEQ;
+	else if (!strcmp(arg, "random"))
+		workload = WL_RANDOM;
+	else if (!strncmp(arg, "stride:", 7)) {
+		workload = WL_STRIDE;
+		stride = strtoul(arg + 7, &p, 0);
+		if (*p || !stride) {
+			fprintf(stderr, "Invalid stride: %s\n", arg + 7);
+			return TEST_ERR;
+		}
+	} else {
+		fprintf(stderr, "Unknown workload: %s\n", arg);
+		return TEST_ERR;
+	}
+	return TEST_OK;
+}
+
+static int
+parse_mmap_policy(const char *arg, long *policy)
+{
+	static const char *const names[] = {
+		[KDUMP_MMAP_NEVER] = "never",
+		[KDUMP_MMAP_ALWAYS] = "always",
+		[KDUMP_MMAP_TRY] = "try",
+		[KDUMP_MMAP_TRY_ONCE] = "try_once",
+		[KDUMP_MMAP_WHOLE] = "whole",
+	};
+	unsigned i;
+
+	for (i = 0; i < ARRAY_SIZE(names); ++i)
+		if (!strcmp(arg, names[i])) {
+			*policy = i;
+			return TEST_OK;
+		}
+	fprintf(stderr, "Unknown mmap policy: %s\n", arg);
+	return TEST_ERR;
+}
+
+static int
+parse_ulong(const char *arg, unsigned long *num)
+{
+	char *p;
+
+	*num = strtoul(arg, &p, 0);
+	if (*p) {
+		fprintf(stderr, "Invalid number: %s\n", arg);
+		return TEST_ERR;
+	}
+	return TEST_OK;
+}
+
+static void
+usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [<options>] <dump>... <base-pfn> <num-pages>\n"
+		"       %s -H\n"
+		"\n"
+		"Options:\n"
+		"  -e io-engine    I/O engine (pread or uring)\n"
+		"  -f num-files    Number of dump files (default: 1)\n"
+		"  -H              Print the CSV header and exit\n"
+		"  -i iterations   Number of reads per thread\n"
+		"                  (default: num-pages / num-threads)\n"
+		"  -l label        Label of the result line\n"
+		"  -m policy       mmap policy (never, always, try, try_once,\n"
+		"                  whole)\n"
+		"  -n num-threads  Number of threads (default: %u)\n"
+		"  -r window       Readahead window in pages\n"
+		"  -s cache-size   Cache size\n"
+		"  -S num-shards   Number of cache shards\n"
+		"  -w workload     seq, random or stride:<n> (default: seq)\n"
+		"\n"
+		"Results are printed as one line of comma-separated values.\n",
+		name, name, DEFTHREADS);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct settings set;
+	unsigned long nfiles;
+	int *fds;
+	int opt;
+	int rc;
+	int i;
+
+	memset(&set, 0, sizeof set);
+	set.mmap_policy = -1;
+	nfiles = 1;
+	while ((opt = getopt(argc, argv, "e:f:Hhi:l:m:n:r:s:S:w:")) != -1) {
+		rc = TEST_OK;
+		switch (opt) {
+		case 'e':
+			set.io_engine = optarg;
+			break;
+
+		case 'f':
+			rc = parse_ulong(optarg, &nfiles);
+			break;
+
+		case 'H':
+			puts(BENCH_CSV_HEADER);
+			return TEST_OK;
+
+		case 'i':
+			rc = parse_ulong(optarg, &niter);
+			break;
+
+		case 'l':
+			label = optarg;
+			break;
+
+		case 'm':
+			rc = parse_mmap_policy(optarg, &set.mmap_policy);
+			break;
+
+		case 'n':
+			rc = parse_ulong(optarg, &nthreads);
+			break;
+
+		case 'r':
+			rc = parse_ulong(optarg, &set.readahead);
+			break;
+
+		case 's':
+			rc = parse_ulong(optarg, &set.cache_size);
+			break;
+
+		case 'S':
+			rc = parse_ulong(optarg, &set.cache_shards);
+			break;
+
+		case 'w':
+			rc = parse_workload(optarg);
+			break;
+
+		case 'h':
+		default:
+			usage(argv[0]);
+			return (opt == 'h') ? TEST_OK : TEST_ERR;
+		}
+		if (rc != TEST_OK)
+			return rc;
+	}
+
+	if (!nfiles || !nthreads || argc - optind != nfiles + 2) {
+		usage(argv[0]);
+		return TEST_ERR;
+	}
+
+	rc = parse_ulong(argv[optind + nfiles], &base_pfn);
+	if (rc == TEST_OK)
+		rc = parse_ulong(argv[optind + nfiles + 1], &npages);
+	if (rc != TEST_OK)
+		return rc;
+	if (!npages) {
+		fprintf(stderr, "No pages to read\n");
+		return TEST_ERR;
+	}
+	if (!niter)
+		niter = npages / nthreads ?: 1;
+	stride %= npages;
+	stride_cycle = npages / gcd(stride, npages);
+
+	fds = malloc(nfiles * sizeof(*fds));
+	if (!fds) {
+		perror("Cannot allocate file descriptors");
+		return TEST_ERR;
+	}
+	for (i = 0; i < nfiles; ++i) {
+		fds[i] = open(argv[optind + i], O_RDONLY);
+		if (fds[i] < 0) {
+			perror(argv[optind + i]);
+			while (i--)
+				close(fds[i]);
+			free(fds);
+			return TEST_ERR;
+		}
+	}
+
+	rc = run_bench(nfiles, fds, &set);
+
+	for (i = 0; i < nfiles; ++i)
+		close(fds[i]);
+	free(fds);
+	return rc;
+}
@@ -42,6 +42,7 @@
 static const char *ostype = NULL;
 static unsigned long valsz = 1;
 static int zero_excluded;
+static int p2m_preload;
 
 static inline int
 endofline(unsigned long long addr)
@@ -184,6 +185,15 @@ dump_data_fds(unsigned long nfds, const int *fds, char **argv)
 		}
 	}
 
+	if (p2m_preload) {
+		res = kdump_set_number_attr(ctx, KDUMP_ATTR_XEN_P2M_PRELOAD, 1);
+		if (res != KDUMP_OK) {
+			fprintf(stderr, "Cannot set p2m_preload: %s\n",
+				kdump_get_err(ctx));
+			goto err;
+		}
+	}
+
 	res = kdump_open_fdset(ctx, nfds, fds);
 	if (res != KDUMP_OK) {
 		fprintf(stderr, "Cannot open dump: %s\n", kdump_get_err(ctx));
@@ -246,6 +256,7 @@ usage(const char *name)
 		"Options:\n"
 		"  -n num     Number of dump files\n"
 		"  -o ostype  Set OS type\n"
+		"  -p         Load the Xen p2m table into memory\n"
 		"  -s size    Set value size in bytes\n"
 		"  -z         Fill excluded pages with zeroes\n",
 		name);
@@ -284,7 +295,7 @@ main(int argc, char **argv)
 	char *endp;
 	int opt;
 
-	while ((opt = getopt(argc, argv, "hn:o:s:z")) != -1) {
+	while ((opt = getopt(argc, argv, "hn:o:ps:z")) != -1) {
 		switch (opt) {
 		case 'n':
 			nfiles = strtoul(optarg, &endp, 0);
@@ -299,6 +310,10 @@ main(int argc, char **argv)
 			ostype = optarg;
 			break;
 
+		case 'p':
+			p2m_preload = 1;
+			break;
+
 		case 's':
 			valsz = strtoul(optarg, &endp, 0);
 			if (endp == optarg || *endp ||
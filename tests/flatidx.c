@@ -0,0 +1,295 @@
+/* Flattened file and page index check.
+   Copyright (C) Petr Tesarik <petr@tesarici.cz>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <libkdumpfile/kdumpfile.h>
+
+#include "testutil.h"
+
+#define FLAT_SUFFIX	".flatidx"
+#define PAGE_SUFFIX	".lkcdidx"
+
+static const char *index_attr = KDUMP_ATTR_FILE_FLAT_INDEX_DIR;
+static const char *index_suffix = FLAT_SUFFIX;
+static int page_index;
+static int index_thread;
+
+/* Open a dump, optionally with an index directory, and read data. */
+static int
+read_dump(const char *dump, const char *idxdir,
+	  kdump_addr_t addr, void *buf, size_t len)
+{
+	kdump_ctx_t *ctx;
+	kdump_status status;
+	size_t rd;
+	int fd, rc;
+
+	fd = open(dump, O_RDONLY);
+	if (fd < 0) {
+		perror(dump);
+		return TEST_ERR;
+	}
+
+	ctx = kdump_new();
+	if (!ctx) {
+		perror("Cannot initialize dump context");
+		close(fd);
+		return TEST_ERR;
+	}
+
+	rc = TEST_OK;
+	if (idxdir) {
+		status = kdump_set_string_attr(ctx, index_attr, idxdir);
+		if (status != KDUMP_OK) {
+			fprintf(stderr, "Cannot set index directory: %s\n",
+				kdump_get_err(ctx));
+			rc = TEST_ERR;
+			goto out;
+		}
+	}
+	if (index_thread) {
+		status = kdump_set_number_attr(
+			ctx, KDUMP_ATTR_FILE_PAGE_INDEX_THREAD, 1);
+		if (status != KDUMP_OK) {
+			fprintf(stderr, "Cannot enable index thread: %s\n",
+				kdump_get_err(ctx));
+			rc = TEST_ERR;
+			goto out;
+		}
+	}
+
+	status = kdump_open_fd(ctx, fd);
+	if (status != KDUMP_OK) {
+		fprintf(stderr, "Cannot open dump: %s\n", kdump_get_err(ctx));
+		rc = TEST_FAIL;
+		goto out;
+	}
+
+	rd = len;
+	status = kdump_read(ctx, KDUMP_MACHPHYSADDR, addr, buf, &rd);
+	if (status != KDUMP_OK) {
+		fprintf(stderr, "Cannot read dump: %s\n", kdump_get_err(ctx));
+		rc = TEST_FAIL;
+		goto out;
+	}
+
+	/* The page index is complete after scanning all descriptors. */
+	if (page_index) {
+		kdump_num_t max_pfn;
+		status = kdump_get_number_attr(ctx, "max_pfn", &max_pfn);
+		if (status != KDUMP_OK) {
+			fprintf(stderr, "Cannot get max_pfn: %s\n",
+				kdump_get_err(ctx));
+			rc = TEST_FAIL;
+		}
+	}
+
+ out:
+	kdump_free(ctx);
+	close(fd);
+	return rc;
+}
+
+/* Find the only index file in a directory. */
+static int
+find_index(const char *idxdir, char *path, size_t pathsz, struct stat *st)
+{
+	struct dirent *de;
+	unsigned count;
+	size_t namelen;
+	DIR *dir;
+
+	dir = opendir(idxdir);
+	if (!dir) {
+		perror(idxdir);
+		return TEST_ERR;
+	}
+	count = 0;
+	while ( (de = readdir(dir)) ) {
+		namelen = strlen(de->d_name);
+		if (namelen <= strlen(index_suffix) ||
+		    strcmp(de->d_name + namelen - strlen(index_suffix),
+			   index_suffix))
+			continue;
+		snprintf(path, pathsz, "%s/%s", idxdir, de->d_name);
+		++count;
+	}
+	closedir(dir);
+
+	if (count != 1) {
+		fprintf(stderr, "Found %u index files, expected 1\n", count);
+		return TEST_FAIL;
+	}
+	if (stat(path, st)) {
+		perror(path);
+		return TEST_ERR;
+	}
+	return TEST_OK;
+}
+
+/* Overwrite the last bytes of a file. */
+static int
+corrupt_file(const char *path)
+{
+	static const char garbage[8] = "garbage";
+	struct stat st;
+	int fd;
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0 || fstat(fd, &st) ||
+	    pwrite(fd, garbage, sizeof garbage,
+		   st.st_size - sizeof garbage) != sizeof garbage) {
+		perror(path);
+		return TEST_ERR;
+	}
+	close(fd);
+	return TEST_OK;
+}
+
+static int
+check_data(const char *what, const void *expect, const void *buf, size_t len)
+{
+	if (memcmp(expect, buf, len)) {
+		fprintf(stderr, "Data mismatch %s\n", what);
+		return TEST_FAIL;
+	}
+	printf("Data OK %s\n", what);
+	return TEST_OK;
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *dump, *idxdir;
+	char path[4096];
+	struct stat st, newst;
+	kdump_addr_t addr;
+	void *expect, *buf;
+	size_t len;
+	char *endp;
+	int opt;
+	int rc;
+
+	while ((opt = getopt(argc, argv, "pt")) != -1) {
+		switch (opt) {
+		case 'p':
+			page_index = 1;
+			index_attr = KDUMP_ATTR_FILE_PAGE_INDEX_DIR;
+			index_suffix = PAGE_SUFFIX;
+			break;
+
+		case 't':
+			index_thread = 1;
+			break;
+
+		default:
+			argc = 0;
+		}
+	}
+
+	if (argc - optind != 4) {
+		fprintf(stderr,
+			"Usage: %s [-p] [-t] <dump> <index-dir> <addr> <len>\n"
+			"\n"
+			"Options:\n"
+			"  -p  Check the page index instead of the flattened index\n"
+			"  -t  Build the page index in a background thread\n",
+			argv[0]);
+		return TEST_ERR;
+	}
+	dump = argv[optind];
+	idxdir = argv[optind + 1];
+	addr = strtoull(argv[optind + 2], &endp, 0);
+	if (*endp) {
+		fprintf(stderr, "Invalid address: %s\n", argv[optind + 2]);
+		return TEST_ERR;
+	}
+	len = strtoul(argv[optind + 3], &endp, 0);
+	if (*endp) {
+		fprintf(stderr, "Invalid length: %s\n", argv[optind + 3]);
+		return TEST_ERR;
+	}
+
+	expect = malloc(len);
+	buf = malloc(len);
+	if (!expect || !buf) {
+		perror("Cannot allocate buffers");
+		return TEST_ERR;
+	}
+
+	rc = read_dump(dump, NULL, addr, expect, len);
+	if (rc != TEST_OK)
+		return rc;
+
+	/* First open creates the index. */
+	rc = read_dump(dump, idxdir, addr, buf, len);
+	if (rc == TEST_OK)
+		rc = check_data("after creating index", expect, buf, len);
+	if (rc == TEST_OK)
+		rc = find_index(idxdir, path, sizeof path, &st);
+	if (rc != TEST_OK)
+		return rc;
+
+	/* Second open uses the index and must not rewrite it. */
+	rc = read_dump(dump, idxdir, addr, buf, len);
+	if (rc == TEST_OK)
+		rc = check_data("with index", expect, buf, len);
+	if (rc == TEST_OK)
+		rc = find_index(idxdir, path, sizeof path, &newst);
+	if (rc != TEST_OK)
+		return rc;
+	if (newst.st_ino != st.st_ino) {
+		fprintf(stderr, "Valid index was rewritten\n");
+		return TEST_FAIL;
+	}
+
+	/* A corrupted index is ignored and replaced. */
+	rc = corrupt_file(path);
+	if (rc == TEST_OK)
+		rc = read_dump(dump, idxdir, addr, buf, len);
+	if (rc == TEST_OK)
+		rc = check_data("with corrupted index", expect, buf, len);
+	if (rc == TEST_OK)
+		rc = find_index(idxdir, path, sizeof path, &newst);
+	if (rc != TEST_OK)
+		return rc;
+	if (newst.st_ino == st.st_ino) {
+		fprintf(stderr, "Corrupted index was not replaced\n");
+		return TEST_FAIL;
+	}
+
+	free(expect);
+	free(buf);
+	return TEST_OK;
+}
@@ -77,6 +77,17 @@ static off_t pdoff, dataoff;
 
 static unsigned char *bitmap1, *bitmap2;
 
+/** Page data which has already been written to the dump file. */
+struct written_data {
+	off_t off;
+	size_t len;
+	uint32_t flags;
+	void *data;
+};
+
+static struct written_data *written;
+static size_t nwritten;
+
 enum compress_method {
 	COMPRESS_NONE,
 	COMPRESS_ZLIB,
@@ -117,6 +128,7 @@ static unsigned long long dump_level;
 static unsigned long long split;
 static unsigned long long start_pfn;
 static unsigned long long end_pfn;
+static bool dedup;
 
 static struct blob *vmcoreinfo;
 static struct blob *notes;
@@ -166,6 +178,7 @@ static const struct param param_array[] = {
 	PARAM_NUMBER("split", split),
 	PARAM_NUMBER("start_pfn", start_pfn),
 	PARAM_NUMBER("end_pfn", end_pfn),
+	PARAM_YESNO("dedup", dedup),
 
 	/* data files */
 	PARAM_STRING("VMCOREINFO", vmcoreinfo_file),
@@ -671,6 +684,57 @@ bitmap_index(const unsigned char *bmp, unsigned long bit)
 	return ret;
 }
 
+/** Find identical page data which has already been written.
+ * @param buf     Page data.
+ * @param buflen  Length of @p buf.
+ * @param flags   Page descriptor flags.
+ * @returns       Written data descriptor, or @c NULL if not found.
+ */
+static const struct written_data *
+find_written(const void *buf, size_t buflen, uint32_t flags)
+{
+	size_t i;
+
+	for (i = 0; i < nwritten; ++i)
+		if (written[i].len == buflen && written[i].flags == flags &&
+		    !memcmp(written[i].data, buf, buflen))
+			return &written[i];
+	return NULL;
+}
+
+/** Remember page data which has been written.
+ * @param buf     Page data.
+ * @param buflen  Length of @p buf.
+ * @param flags   Page descriptor flags.
+ * @returns       Error status.
+ */
+static int
+add_written(const void *buf, size_t buflen, uint32_t flags)
+{
+	struct written_data *newwritten;
+	struct written_data *wd;
+
+	newwritten = realloc(written, (nwritten + 1) * sizeof(*written));
+	if (!newwritten) {
+		perror("Cannot allocate written data");
+		return TEST_ERR;
+	}
+	written = newwritten;
+
+	wd = &written[nwritten];
+	wd->data = malloc(buflen);
+	if (!wd->data) {
+		perror("Cannot allocate written data");
+		return TEST_ERR;
+	}
+	memcpy(wd->data, buf, buflen);
+	wd->off = dataoff;
+	wd->len = buflen;
+	wd->flags = flags;
+	++nwritten;
+	return TEST_OK;
+}
+
 static int
 writepage(struct page_data *pg)
 {
@@ -681,6 +745,7 @@ writepage(struct page_data *pg)
 	unsigned long pfn;
 	size_t buflen;
 	uint32_t flags;
+	off_t off;
 
 	if (pgkdump->compress == compress_exclude)
 		return TEST_OK;
@@ -711,7 +776,18 @@ writepage(struct page_data *pg)
 		buflen = pg->len;
 		buf = pg->buf;
 	}
-	pd.offset = htodump64(be, dataoff);
+
+	off = dataoff;
+	if (dedup) {
+		const struct written_data *wd =
+			find_written(buf, buflen, flags);
+		if (wd)
+			off = wd->off;
+		else if (add_written(buf, buflen, flags) != TEST_OK)
+			return TEST_ERR;
+	}
+
+	pd.offset = htodump64(be, off);
 	pd.size = htodump32(be, buflen);
 	pd.flags = htodump32(be, flags);
 	pd.page_flags = htodump64(be, 0);
@@ -721,6 +797,10 @@ writepage(struct page_data *pg)
 			&pd, sizeof pd, "page desc"))
 		return TEST_ERR;
 
+	/* Shared data has already been written. */
+	if (off != dataoff)
+		return TEST_OK;
+
 	if (write_chunk(pgkdump->f, dataoff, buf, buflen, "page data"))
 		return TEST_ERR;
 	dataoff += buflen;
@@ -820,6 +900,11 @@ writedata(FILE *f)
 
 	rc = process_data(&pg, data_file);
 
+	while (nwritten)
+		free(written[--nwritten].data);
+	free(written);
+	written = NULL;
+
 	if (pgkdump.cbuf)
 		free(pgkdump.cbuf);
  out_bitmap2:
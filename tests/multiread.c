@@ -43,6 +43,16 @@
 
 static unsigned long base_pfn, npages;
 static unsigned long niter = DEFITER;
+static unsigned long cache_shards;
+static int cache_wait;
+static unsigned long cache_wait_timeout;
+static unsigned long readahead;
+static const char *io_engine;
+static int page_index_thread;
+static int sequential;
+static int stats;
+static int verify;
+static int zero_excluded;
 
 static void *
 run_reads(void *arg)
@@ -59,21 +69,115 @@ run_reads(void *arg)
 	if (res != KDUMP_OK)
 		return (void*) kdump_get_err(ctx);
 
-	sz = sizeof buf;
+	pfn = base_pfn + lrand48() % npages;
 	for (i = 0; i < niter; ++i) {
-		pfn = base_pfn + lrand48() % npages;
+		if (sequential) {
+			if (++pfn >= base_pfn + npages)
+				pfn = base_pfn;
+		} else
+			pfn = base_pfn + lrand48() % npages;
+
+		sz = sizeof buf;
 		res = kdump_read(ctx, KDUMP_MACHPHYSADDR, pfn << page_shift,
 				 &buf, &sz);
+		if (res == KDUMP_ERR_NODATA && sequential)
+			continue;
 		if (res != KDUMP_OK) {
 			fprintf(stderr, "Read failed at 0x%llx\n",
 				(unsigned long long) pfn << page_shift);
 			return (void*) kdump_get_err(ctx);
 		}
+		if (verify && (unsigned char)buf[0] != (pfn & 0xff)) {
+			fprintf(stderr, "Wrong data at 0x%llx: 0x%02x\n",
+				(unsigned long long) pfn << page_shift,
+				(unsigned char)buf[0]);
+			return (void*) "Data mismatch";
+		}
 	}
 
 	return NULL;
 }
 
+static int
+check_stage(kdump_ctx_t *ctx, const char *stage)
+{
+	char key[64];
+	kdump_attr_value_t hist;
+	kdump_num_t count, time, sum;
+	const uint64_t *data;
+	size_t i, n;
+	kdump_status res;
+
+	sprintf(key, "stats.%s.count", stage);
+	res = kdump_get_number_attr(ctx, key, &count);
+	if (res == KDUMP_OK) {
+		sprintf(key, "stats.%s.time", stage);
+		res = kdump_get_number_attr(ctx, key, &time);
+	}
+	if (res == KDUMP_OK) {
+		sprintf(key, "stats.%s.hist", stage);
+		res = kdump_get_typed_attr(ctx, key, KDUMP_BLOB, &hist);
+	}
+	if (res != KDUMP_OK) {
+		fprintf(stderr, "Cannot get %s: %s\n",
+			key, kdump_get_err(ctx));
+		return TEST_ERR;
+	}
+
+	data = kdump_blob_pin(hist.blob);
+	n = kdump_blob_size(hist.blob) / sizeof(uint64_t);
+	sum = 0;
+	for (i = 0; i < n; ++i)
+		sum += data[i];
+	kdump_blob_unpin(hist.blob);
+
+	printf("%s: count=%llu time=%llu\n", stage,
+	       (unsigned long long) count, (unsigned long long) time);
+	if (!count) {
+		fprintf(stderr, "No %s operations measured\n", stage);
+		return TEST_FAIL;
+	}
+	if (sum != count) {
+		fprintf(stderr, "Wrong %s histogram sum: %llu != %llu\n",
+			stage, (unsigned long long) sum,
+			(unsigned long long) count);
+		return TEST_FAIL;
+	}
+	return TEST_OK;
+}
+
+static int
+check_stats(kdump_ctx_t *ctx)
+{
+	static const char *const stages[] = { "lock", "cache", "io" };
+	kdump_num_t hits, misses;
+	kdump_status res;
+	unsigned i;
+	int rc;
+
+	rc = TEST_OK;
+	for (i = 0; i < ARRAY_SIZE(stages); ++i) {
+		int tmprc = check_stage(ctx, stages[i]);
+		if (tmprc == TEST_ERR)
+			return tmprc;
+		if (tmprc != TEST_OK)
+			rc = tmprc;
+	}
+
+	res = kdump_get_number_attr(ctx, "cache.hits", &hits);
+	if (res == KDUMP_OK)
+		res = kdump_get_number_attr(ctx, "cache.misses", &misses);
+	if (res != KDUMP_OK) {
+		fprintf(stderr, "Cannot get cache statistics: %s\n",
+			kdump_get_err(ctx));
+		return TEST_ERR;
+	}
+	printf("cache: hits=%llu misses=%llu\n",
+	       (unsigned long long) hits, (unsigned long long) misses);
+
+	return rc;
+}
+
 static int
 run_threads(kdump_ctx_t *ctx, unsigned long nthreads, unsigned long cache_size)
 {
@@ -98,6 +202,82 @@ run_threads(kdump_ctx_t *ctx, unsigned long nthreads, unsigned long cache_size)
 		}
 	}
 
+	if (cache_shards) {
+		val.type = KDUMP_NUMBER;
+		val.val.number = cache_shards;
+		res = kdump_set_attr(ctx, "cache.shards", &val);
+		if (res != KDUMP_OK) {
+			fprintf(stderr, "Cannot set cache shards: %s\n",
+				kdump_get_err(ctx));
+			return TEST_ERR;
+		}
+	}
+
+	if (cache_wait) {
+		val.type = KDUMP_NUMBER;
+		val.val.number = cache_wait_timeout;
+		res = kdump_set_attr(ctx, "cache.wait_timeout", &val);
+		if (res == KDUMP_OK) {
+			val.val.number = 1;
+			res = kdump_set_attr(ctx, "cache.wait", &val);
+		}
+		if (res != KDUMP_OK) {
+			fprintf(stderr, "Cannot enable cache wait: %s\n",
+				kdump_get_err(ctx));
+			return TEST_ERR;
+		}
+	}
+
+	if (readahead) {
+		val.type = KDUMP_NUMBER;
+		val.val.number = readahead;
+		res = kdump_set_attr(ctx, "cache.readahead", &val);
+		if (res != KDUMP_OK) {
+			fprintf(stderr, "Cannot enable readahead: %s\n",
+				kdump_get_err(ctx));
+			return TEST_ERR;
+		}
+	}
+
+	if (io_engine) {
+		val.type = KDUMP_NUMBER;
+		val.val.number = KDUMP_MMAP_NEVER;
+		res = kdump_set_attr(ctx, KDUMP_ATTR_FILE_MMAP_POLICY, &val);
+		if (res == KDUMP_OK) {
+			val.type = KDUMP_STRING;
+			val.val.string = io_engine;
+			res = kdump_set_attr(ctx, KDUMP_ATTR_FILE_IO_ENGINE,
+					     &val);
+		}
+		if (res != KDUMP_OK) {
+			fprintf(stderr, "Cannot set I/O engine: %s\n",
+				kdump_get_err(ctx));
+			return TEST_ERR;
+		}
+	}
+
+	if (zero_excluded) {
+		val.type = KDUMP_NUMBER;
+		val.val.number = 1;
+		res = kdump_set_attr(ctx, KDUMP_ATTR_ZERO_EXCLUDED, &val);
+		if (res != KDUMP_OK) {
+			fprintf(stderr, "Cannot set zero_excluded: %s\n",
+				kdump_get_err(ctx));
+			return TEST_ERR;
+		}
+	}
+
+	if (stats) {
+		val.type = KDUMP_NUMBER;
+		val.val.number = 1;
+		res = kdump_set_attr(ctx, KDUMP_ATTR_STATS_ENABLED, &val);
+		if (res != KDUMP_OK) {
+			fprintf(stderr, "Cannot enable statistics: %s\n",
+				kdump_get_err(ctx));
+			return TEST_ERR;
+		}
+	}
+
 	res = pthread_attr_init(&attr);
 	if (res) {
 		fprintf(stderr, "pthread_attr_init: %s\n", strerror(res));
@@ -136,6 +316,9 @@ run_threads(kdump_ctx_t *ctx, unsigned long nthreads, unsigned long cache_size)
 		kdump_free(tinfo[i].ctx);
 	}
 
+	if (stats && rc == TEST_OK)
+		rc = check_stats(ctx);
+
 	return rc;
 }
 
@@ -152,6 +335,17 @@ run_threads_fd(int fd, unsigned long nthreads, unsigned long cache_size)
 		return TEST_ERR;
 	}
 
+	if (page_index_thread) {
+		res = kdump_set_number_attr(
+			ctx, KDUMP_ATTR_FILE_PAGE_INDEX_THREAD, 1);
+		if (res != KDUMP_OK) {
+			fprintf(stderr, "Cannot enable index thread: %s\n",
+				kdump_get_err(ctx));
+			kdump_free(ctx);
+			return TEST_ERR;
+		}
+	}
+
 	res = kdump_open_fd(ctx, fd);
 	if (res != KDUMP_OK) {
 		fprintf(stderr, "Cannot open dump: %s\n", kdump_get_err(ctx));
@@ -170,10 +364,19 @@ usage(const char *name)
 		"Usage: %s [<options>] <dump> <base-pfn> <num-pages>\n"
 		"\n"
 		"Options:\n"
+		"  -e io-engine    Read with this I/O engine (disables mmap)\n"
 		"  -i iterations   Number of reads per thread (default: %u)\n"
 		"  -n num-threads  Number of threads (default: %u)\n"
+		"  -P              Build the page index in a background thread\n"
+		"  -q              Read pages sequentially, skipping excluded pages\n"
+		"  -r window       Readahead window in pages\n"
 		"  -s cache-size   Cache size\n"
-		"  -t timeout      Maximum execution time in seconds\n",
+		"  -S num-shards   Number of cache shards\n"
+		"  -t timeout      Maximum execution time in seconds\n"
+		"  -T              Collect and check read statistics\n"
+		"  -v              Verify that each page starts with its PFN\n"
+		"  -w wait-ms      Wait for a free cache entry (0 means forever)\n"
+		"  -z              Read excluded pages as zeroes\n",
 		name, DEFITER, DEFTHREADS);
 }
 
@@ -190,8 +393,12 @@ main(int argc, char **argv)
 	nthreads = DEFTHREADS;
 	cache_size = 0;
 	timeout = 0;
-	while ((opt = getopt(argc, argv, "hi:n:s:t:")) != -1) {
+	while ((opt = getopt(argc, argv, "e:hi:n:Pqr:s:S:t:Tvw:z")) != -1) {
 		switch (opt) {
+		case 'e':
+			io_engine = optarg;
+			break;
+
 		case 'i':
 			niter = strtoul(optarg, &p, 0);
 			if (*p) {
@@ -208,6 +415,22 @@ main(int argc, char **argv)
 			}
 			break;
 
+		case 'P':
+			page_index_thread = 1;
+			break;
+
+		case 'q':
+			sequential = 1;
+			break;
+
+		case 'r':
+			readahead = strtoul(optarg, &p, 0);
+			if (*p) {
+				fprintf(stderr, "Invalid number: %s\n", optarg);
+				return TEST_ERR;
+			}
+			break;
+
 		case 's':
 			cache_size = strtoul(optarg, &p, 0);
 			if (*p) {
@@ -216,6 +439,14 @@ main(int argc, char **argv)
 			}
 			break;
 
+		case 'S':
+			cache_shards = strtoul(optarg, &p, 0);
+			if (*p) {
+				fprintf(stderr, "Invalid number: %s\n", optarg);
+				return TEST_ERR;
+			}
+			break;
+
 		case 't':
 			timeout = strtoul(optarg, &p, 0);
 			if (*p) {
@@ -224,6 +455,26 @@ main(int argc, char **argv)
 			}
 			break;
 
+		case 'T':
+			stats = 1;
+			break;
+
+		case 'v':
+			verify = 1;
+			break;
+
+		case 'w':
+			cache_wait = 1;
+			cache_wait_timeout = strtoul(optarg, &p, 0);
+			if (*p) {
+				fprintf(stderr, "Invalid number: %s\n", optarg);
+				return TEST_ERR;
+			}
+			break;
+
+		case 'z':
+			zero_excluded = 1;
+			break;
 
 		case 'h':
 		default:
@@ -0,0 +1,344 @@
+/* Page table enumeration with addrxlat_pgt_iter
+   Copyright (C) Petr Tesarik <petr@tesarici.cz>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <libkdumpfile/addrxlat.h>
+
+#include "testutil.h"
+
+#define PAGE_SHIFT	12
+#define PAGE_SIZE	(1UL << PAGE_SHIFT)
+#define PTRS_PER_PAGE	(PAGE_SIZE / sizeof(uint64_t))
+
+#define _PAGE_PRESENT	(1ULL << 0)
+#define _PAGE_PSE	(1ULL << 7)
+
+#define PGD_ADDR	0x1000
+#define PUD_ADDR	0x2000
+#define PMD_ADDR	0x3000
+#define PT_ADDR		0x4000
+#define KPUD_ADDR	0x5000
+
+#define NWORKERS	2
+#define MAX_EXTENTS	16
+
+static uint64_t pgd[PTRS_PER_PAGE];
+static uint64_t pud[PTRS_PER_PAGE];
+static uint64_t pmd[PTRS_PER_PAGE];
+static uint64_t pt[PTRS_PER_PAGE];
+static uint64_t kpud[PTRS_PER_PAGE];
+
+static addrxlat_meth_t pgt_meth;
+
+struct extent {
+	addrxlat_addr_t addr;
+	addrxlat_addr_t target;
+	addrxlat_addr_t size;
+};
+
+struct extents {
+	unsigned n;
+	unsigned limit;
+	struct extent ext[MAX_EXTENTS];
+};
+
+static addrxlat_status
+get_page(const addrxlat_cb_t *cb, addrxlat_buffer_t *buf)
+{
+	addrxlat_addr_t addr = buf->addr.addr & ~(PAGE_SIZE - 1);
+
+	if (buf->addr.as != ADDRXLAT_MACHPHYSADDR)
+		return addrxlat_ctx_err(cb->priv, ADDRXLAT_ERR_NOTIMPL,
+					"Unexpected address space: %ld",
+					(long)buf->addr.as);
+
+	switch (addr) {
+	case PGD_ADDR:	buf->ptr = pgd; break;
+	case PUD_ADDR:	buf->ptr = pud; break;
+	case PMD_ADDR:	buf->ptr = pmd; break;
+	case PT_ADDR:	buf->ptr = pt; break;
+	case KPUD_ADDR:	buf->ptr = kpud; break;
+	default:
+		return addrxlat_ctx_err(cb->priv, ADDRXLAT_ERR_NODATA,
+					"No data at 0x%llx",
+					(unsigned long long)buf->addr.addr);
+	}
+
+	buf->addr.addr = addr;
+	buf->size = PAGE_SIZE;
+	buf->byte_order = ADDRXLAT_HOST_ENDIAN;
+	return ADDRXLAT_OK;
+}
+
+static unsigned long
+read_caps(const addrxlat_cb_t *cb)
+{
+	return ADDRXLAT_CAPS(ADDRXLAT_MACHPHYSADDR);
+}
+
+static addrxlat_ctx_t *
+new_ctx(void)
+{
+	addrxlat_ctx_t *ctx;
+	addrxlat_cb_t *cb;
+
+	ctx = addrxlat_ctx_new();
+	if (!ctx) {
+		fputs("Cannot allocate translation context", stderr);
+		return NULL;
+	}
+	cb = addrxlat_ctx_add_cb(ctx);
+	if (!cb) {
+		fputs("Cannot allocate translation callbacks", stderr);
+		addrxlat_ctx_decref(ctx);
+		return NULL;
+	}
+	cb->priv = ctx;
+	cb->get_page = get_page;
+	cb->read_caps = read_caps;
+	return ctx;
+}
+
+static void
+setup_pgt(void)
+{
+	unsigned i;
+
+	/* User space: 4 contiguous pages, a hole, a remapped page,
+	 * and a page which is followed by a contiguous 2M page.
+	 */
+	pgd[0] = PUD_ADDR | _PAGE_PRESENT;
+	pud[0] = PMD_ADDR | _PAGE_PRESENT;
+	pmd[0] = PT_ADDR | _PAGE_PRESENT;
+	pmd[1] = 0x200000 | _PAGE_PSE | _PAGE_PRESENT;
+	for (i = 0; i < 4; ++i)
+		pt[i] = ((0x100 + i) << PAGE_SHIFT) | _PAGE_PRESENT;
+	pt[5] = 0x300000 | _PAGE_PRESENT;
+	pt[511] = 0x1ff000 | _PAGE_PRESENT;
+
+	/* Kernel space: one 1G page. */
+	pgd[256] = KPUD_ADDR | _PAGE_PRESENT;
+	kpud[0] = 0x40000000 | _PAGE_PSE | _PAGE_PRESENT;
+
+	pgt_meth.kind = ADDRXLAT_PGT;
+	pgt_meth.target_as = ADDRXLAT_MACHPHYSADDR;
+	pgt_meth.param.pgt.root.addr = PGD_ADDR;
+	pgt_meth.param.pgt.root.as = ADDRXLAT_MACHPHYSADDR;
+	pgt_meth.param.pgt.pf.pte_format = ADDRXLAT_PTE_X86_64;
+	pgt_meth.param.pgt.pf.nfields = 5;
+	pgt_meth.param.pgt.pf.fieldsz[0] = PAGE_SHIFT;
+	for (i = 1; i < 5; ++i)
+		pgt_meth.param.pgt.pf.fieldsz[i] = 9;
+}
+
+static addrxlat_status
+store_extent(void *data, const addrxlat_pgt_extent_t *ext)
+{
+	struct extents *exts = data;
+
+	if (ext->target.as != ADDRXLAT_MACHPHYSADDR) {
+		fprintf(stderr, "Unexpected address space: %ld\n",
+			(long)ext->target.as);
+		return ADDRXLAT_ERR_INVALID;
+	}
+	if (exts->n >= exts->limit)
+		return ADDRXLAT_ERR_CUSTOM_BASE;
+	exts->ext[exts->n].addr = ext->addr;
+	exts->ext[exts->n].target = ext->target.addr;
+	exts->ext[exts->n].size = ext->size;
+	++exts->n;
+	return ADDRXLAT_OK;
+}
+
+static int
+cmp_extent(const void *a, const void *b)
+{
+	const struct extent *ea = a, *eb = b;
+	return ea->addr < eb->addr ? -1 : ea->addr > eb->addr;
+}
+
+static int
+check_iter(addrxlat_pgt_iter_t *iter, unsigned limit,
+	   addrxlat_status expect_status,
+	   unsigned n, const struct extent *expect)
+{
+	struct extents exts;
+	addrxlat_status status;
+	unsigned i;
+
+	exts.n = 0;
+	exts.limit = limit;
+	iter->data = &exts;
+	status = addrxlat_pgt_iter(iter);
+	if (status != expect_status) {
+		fprintf(stderr, "Range 0x%llx-0x%llx: %s (expected %s)\n",
+			(unsigned long long) iter->first,
+			(unsigned long long) iter->last,
+			addrxlat_strerror(status),
+			addrxlat_strerror(expect_status));
+		if (status != ADDRXLAT_OK)
+			fprintf(stderr, "Error: %s\n",
+				addrxlat_ctx_get_err(iter->ctx));
+		return TEST_FAIL;
+	}
+
+	if (exts.n != n) {
+		fprintf(stderr, "Range 0x%llx-0x%llx: %u extents"
+			" (expected %u)\n",
+			(unsigned long long) iter->first,
+			(unsigned long long) iter->last, exts.n, n);
+		return TEST_FAIL;
+	}
+
+	/* Subtrees may be walked in any order by worker threads. */
+	if (iter->nworkers)
+		qsort(exts.ext, exts.n, sizeof(*exts.ext), cmp_extent);
+
+	for (i = 0; i < n; ++i) {
+		if (exts.ext[i].addr != expect[i].addr ||
+		    exts.ext[i].target != expect[i].target ||
+		    exts.ext[i].size != expect[i].size) {
+			fprintf(stderr, "Extent %u is 0x%llx->0x%llx+0x%llx"
+				" (expected 0x%llx->0x%llx+0x%llx)\n", i,
+				(unsigned long long) exts.ext[i].addr,
+				(unsigned long long) exts.ext[i].target,
+				(unsigned long long) exts.ext[i].size,
+				(unsigned long long) expect[i].addr,
+				(unsigned long long) expect[i].target,
+				(unsigned long long) expect[i].size);
+			return TEST_FAIL;
+		}
+	}
+
+	return TEST_OK;
+}
+
+int
+main(int argc, char **argv)
+{
+	static const struct extent all[] = {
+		{ 0x0000, 0x100000, 0x1000 },
+		{ 0x1000, 0x101000, 0x1000 },
+		{ 0x2000, 0x102000, 0x1000 },
+		{ 0x3000, 0x103000, 0x1000 },
+		{ 0x5000, 0x300000, 0x1000 },
+		{ 0x1ff000, 0x1ff000, 0x1000 },
+		{ 0x200000, 0x200000, 0x200000 },
+		{ 0xffff800000000000, 0x40000000, 0x40000000 },
+	};
+	static const struct extent merged[] = {
+		{ 0x0000, 0x100000, 0x4000 },
+		{ 0x5000, 0x300000, 0x1000 },
+		{ 0x1ff000, 0x1ff000, 0x201000 },
+		{ 0xffff800000000000, 0x40000000, 0x40000000 },
+	};
+	static const struct extent partial[] = {
+		{ 0x2800, 0x102800, 0x800 },
+		{ 0x3000, 0x103000, 0x1000 },
+		{ 0x5000, 0x300000, 0x1000 },
+		{ 0x1ff000, 0x1ff000, 0x1000 },
+		{ 0x200000, 0x200000, 0x1000 },
+	};
+	addrxlat_ctx_t *ctx;
+	addrxlat_ctx_t *workers[NWORKERS];
+	addrxlat_pgt_iter_t iter;
+	unsigned i;
+	int ret;
+
+	setup_pgt();
+
+	ctx = new_ctx();
+	if (!ctx)
+		return TEST_ERR;
+	for (i = 0; i < NWORKERS; ++i) {
+		workers[i] = new_ctx();
+		if (!workers[i])
+			return TEST_ERR;
+	}
+
+	iter.ctx = ctx;
+	iter.sys = NULL;
+	iter.meth = &pgt_meth;
+	iter.first = 0;
+	iter.last = ADDRXLAT_ADDR_MAX;
+	iter.fn = store_extent;
+	iter.flags = 0;
+	iter.nworkers = 0;
+	iter.workers = workers;
+
+	/* Every page is a separate extent. */
+	ret = check_iter(&iter, MAX_EXTENTS, ADDRXLAT_OK,
+			 ARRAY_SIZE(all), all);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* Contiguous pages are merged, including huge pages. */
+	iter.flags = ADDRXLAT_PGT_ITER_MERGE;
+	ret = check_iter(&iter, MAX_EXTENTS, ADDRXLAT_OK,
+			 ARRAY_SIZE(merged), merged);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* Extents are clipped to the iterated range. */
+	iter.flags = 0;
+	iter.first = 0x2800;
+	iter.last = 0x200fff;
+	ret = check_iter(&iter, MAX_EXTENTS, ADDRXLAT_OK,
+			 ARRAY_SIZE(partial), partial);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* Callback errors stop the iteration. */
+	iter.first = 0;
+	iter.last = ADDRXLAT_ADDR_MAX;
+	ret = check_iter(&iter, 2, ADDRXLAT_ERR_CUSTOM_BASE, 2, all);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* Same result with worker threads. */
+	iter.flags = ADDRXLAT_PGT_ITER_MERGE;
+	iter.nworkers = NWORKERS;
+	ret = check_iter(&iter, MAX_EXTENTS, ADDRXLAT_OK,
+			 ARRAY_SIZE(merged), merged);
+	if (ret != TEST_OK)
+		goto out;
+
+	puts("OK");
+
+ out:
+	for (i = 0; i < NWORKERS; ++i)
+		addrxlat_ctx_decref(workers[i]);
+	addrxlat_ctx_decref(ctx);
+
+	return ret;
+}
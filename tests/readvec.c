@@ -0,0 +1,229 @@
+/* Vectored read check.
+   Copyright (C) Petr Tesarik <petr@tesarici.cz>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libkdumpfile/kdumpfile.h>
+
+#include "testutil.h"
+
+/* Parse an "[p]addr:len" request and allocate its buffer.
+ * Addresses with a "p" prefix are kernel physical addresses.
+ */
+static int
+parse_req(const char *spec, struct kdump_iovec *iov)
+{
+	const char *p = spec;
+	char *endp;
+
+	iov->as = KDUMP_MACHPHYSADDR;
+	if (*p == 'p') {
+		iov->as = KDUMP_KPHYSADDR;
+		++p;
+	}
+	iov->addr = strtoull(p, &endp, 0);
+	if (*endp != ':') {
+		fprintf(stderr, "Invalid request: %s\n", spec);
+		return TEST_ERR;
+	}
+	iov->len = strtoul(endp + 1, &endp, 0);
+	if (*endp) {
+		fprintf(stderr, "Invalid request: %s\n", spec);
+		return TEST_ERR;
+	}
+	iov->buf = malloc(iov->len);
+	if (iov->len && !iov->buf) {
+		perror("Cannot allocate buffer");
+		return TEST_ERR;
+	}
+	return TEST_OK;
+}
+
+/* Compare data with a referenced page. */
+static int
+check_page_ref(kdump_ctx_t *ctx, const struct kdump_iovec *iov)
+{
+	kdump_page_ref_t *ref;
+	kdump_status status;
+	kdump_num_t pagesz;
+	const void *data;
+	size_t off, len;
+	int rc = TEST_OK;
+
+	status = kdump_get_number_attr(ctx, KDUMP_ATTR_PAGE_SIZE, &pagesz);
+	if (status != KDUMP_OK) {
+		fprintf(stderr, "Cannot get page size: %s\n",
+			kdump_get_err(ctx));
+		return TEST_ERR;
+	}
+
+	status = kdump_get_page_ref(ctx, iov->as, iov->addr, &data, &ref);
+	if (status != KDUMP_OK) {
+		fprintf(stderr, "0x%llx: Cannot get page reference: %s\n",
+			(unsigned long long) iov->addr, kdump_get_err(ctx));
+		return TEST_FAIL;
+	}
+
+	off = iov->addr % pagesz;
+	len = pagesz - off;
+	if (len > iov->len)
+		len = iov->len;
+	if (memcmp((const char *)data + off, iov->buf, len)) {
+		fprintf(stderr, "0x%llx: page reference data mismatch\n",
+			(unsigned long long) iov->addr);
+		rc = TEST_FAIL;
+	}
+
+	/* The cache must not be re-allocated under the reference. */
+	status = kdump_set_number_attr(ctx, "cache.size", 16);
+	if (status != KDUMP_ERR_BUSY) {
+		fprintf(stderr, "0x%llx: cache size changed with a page"
+			" reference held: %s\n",
+			(unsigned long long) iov->addr,
+			status == KDUMP_OK ? "OK" : kdump_get_err(ctx));
+		rc = TEST_FAIL;
+	}
+
+	kdump_put_page_ref(ref);
+	return rc;
+}
+
+/* Compare one element with the result of kdump_read(). */
+static int
+check_req(kdump_ctx_t *ctx, const struct kdump_iovec *iov, size_t origlen)
+{
+	kdump_status status;
+	unsigned char *buf;
+	size_t len;
+	int rc = TEST_OK;
+
+	printf("%s0x%llx+%zu: %s, %zu bytes\n",
+	       iov->as == KDUMP_KPHYSADDR ? "p" : "",
+	       (unsigned long long) iov->addr, origlen,
+	       iov->status == KDUMP_OK ? "OK" : kdump_strerror(iov->status),
+	       iov->len);
+
+	buf = malloc(origlen);
+	if (origlen && !buf) {
+		perror("Cannot allocate buffer");
+		return TEST_ERR;
+	}
+	len = origlen;
+	status = kdump_read(ctx, iov->as, iov->addr, buf, &len);
+	if (status != iov->status || len != iov->len) {
+		fprintf(stderr, "0x%llx: kdump_read() returns %s, %zu bytes\n",
+			(unsigned long long) iov->addr,
+			kdump_strerror(status), len);
+		rc = TEST_FAIL;
+	} else if (len && memcmp(buf, iov->buf, len)) {
+		fprintf(stderr, "0x%llx: data mismatch\n",
+			(unsigned long long) iov->addr);
+		rc = TEST_FAIL;
+	} else if (len)
+		rc = check_page_ref(ctx, iov);
+
+	free(buf);
+	return rc;
+}
+
+int
+main(int argc, char **argv)
+{
+	struct kdump_iovec *iov;
+	size_t *origlen;
+	kdump_ctx_t *ctx;
+	kdump_status status;
+	size_t i, n;
+	int fd, rc;
+
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <dump> [[p]addr:len]...\n", argv[0]);
+		return TEST_ERR;
+	}
+
+	n = argc - 2;
+	iov = calloc(n + 1, sizeof(*iov));
+	origlen = calloc(n + 1, sizeof(*origlen));
+	if (!iov || !origlen) {
+		perror("Cannot allocate requests");
+		return TEST_ERR;
+	}
+	for (i = 0; i < n; ++i) {
+		rc = parse_req(argv[i + 2], &iov[i]);
+		if (rc != TEST_OK)
+			return rc;
+		origlen[i] = iov[i].len;
+	}
+
+	fd = open(argv[1], O_RDONLY);
+	if (fd < 0) {
+		perror(argv[1]);
+		return TEST_ERR;
+	}
+
+	ctx = kdump_new();
+	if (!ctx) {
+		perror("Cannot initialize dump context");
+		return TEST_ERR;
+	}
+
+	status = kdump_open_fd(ctx, fd);
+	if (status != KDUMP_OK) {
+		fprintf(stderr, "Cannot open dump: %s\n", kdump_get_err(ctx));
+		return TEST_ERR;
+	}
+
+	/* Kernel physical addresses are translated by the Linux system. */
+	status = kdump_set_string_attr(ctx, KDUMP_ATTR_OSTYPE, "linux");
+	if (status != KDUMP_OK) {
+		fprintf(stderr, "Cannot set ostype: %s\n", kdump_get_err(ctx));
+		return TEST_ERR;
+	}
+
+	status = kdump_read_vec(ctx, iov, n);
+	printf("Result: %s\n",
+	       status == KDUMP_OK ? "OK" : kdump_get_err(ctx));
+
+	rc = TEST_OK;
+	for (i = 0; i < n; ++i) {
+		int res = check_req(ctx, &iov[i], origlen[i]);
+		if (res > rc)
+			rc = res;
+		free(iov[i].buf);
+	}
+
+	kdump_free(ctx);
+	close(fd);
+	free(iov);
+	free(origlen);
+
+	return rc;
+}
@@ -0,0 +1,300 @@
+/* Reverse mapping with addrxlat_sys_rmap
+   Copyright (C) Petr Tesarik <petr@tesarici.cz>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <libkdumpfile/addrxlat.h>
+
+#include "testutil.h"
+
+#define PAGE_SHIFT	12
+#define PAGE_SIZE	(1UL << PAGE_SHIFT)
+#define PTRS_PER_PAGE	(PAGE_SIZE / sizeof(uint64_t))
+
+#define _PAGE_PRESENT	(1ULL << 0)
+#define _PAGE_PSE	(1ULL << 7)
+
+#define PGD_ADDR	0x1000
+#define PUD_ADDR	0x2000
+#define PMD_ADDR	0x3000
+#define PT_ADDR		0x4000
+#define KPUD_ADDR	0x5000
+
+#define MAX_ADDRS	4
+
+static uint64_t pgd[PTRS_PER_PAGE];
+static uint64_t pud[PTRS_PER_PAGE];
+static uint64_t pmd[PTRS_PER_PAGE];
+static uint64_t pt[PTRS_PER_PAGE];
+static uint64_t kpud[PTRS_PER_PAGE];
+
+static addrxlat_meth_t pgt_meth;
+
+struct addrs {
+	unsigned n;
+	addrxlat_addr_t addr[MAX_ADDRS];
+};
+
+static addrxlat_status
+get_page(const addrxlat_cb_t *cb, addrxlat_buffer_t *buf)
+{
+	addrxlat_addr_t addr = buf->addr.addr & ~(PAGE_SIZE - 1);
+
+	if (buf->addr.as != ADDRXLAT_MACHPHYSADDR)
+		return addrxlat_ctx_err(cb->priv, ADDRXLAT_ERR_NOTIMPL,
+					"Unexpected address space: %ld",
+					(long)buf->addr.as);
+
+	switch (addr) {
+	case PGD_ADDR:	buf->ptr = pgd; break;
+	case PUD_ADDR:	buf->ptr = pud; break;
+	case PMD_ADDR:	buf->ptr = pmd; break;
+	case PT_ADDR:	buf->ptr = pt; break;
+	case KPUD_ADDR:	buf->ptr = kpud; break;
+	default:
+		return addrxlat_ctx_err(cb->priv, ADDRXLAT_ERR_NODATA,
+					"No data at 0x%llx",
+					(unsigned long long)buf->addr.addr);
+	}
+
+	buf->addr.addr = addr;
+	buf->size = PAGE_SIZE;
+	buf->byte_order = ADDRXLAT_HOST_ENDIAN;
+	return ADDRXLAT_OK;
+}
+
+static unsigned long
+read_caps(const addrxlat_cb_t *cb)
+{
+	return ADDRXLAT_CAPS(ADDRXLAT_MACHPHYSADDR);
+}
+
+static addrxlat_ctx_t *
+new_ctx(void)
+{
+	addrxlat_ctx_t *ctx;
+	addrxlat_cb_t *cb;
+
+	ctx = addrxlat_ctx_new();
+	if (!ctx) {
+		fputs("Cannot allocate translation context", stderr);
+		return NULL;
+	}
+	cb = addrxlat_ctx_add_cb(ctx);
+	if (!cb) {
+		fputs("Cannot allocate translation callbacks", stderr);
+		addrxlat_ctx_decref(ctx);
+		return NULL;
+	}
+	cb->priv = ctx;
+	cb->get_page = get_page;
+	cb->read_caps = read_caps;
+	return ctx;
+}
+
+static void
+setup_pgt(addrxlat_sys_t *sys)
+{
+	unsigned i;
+
+	/* User space: 4 contiguous pages, a hole, a remapped page,
+	 * and a page which is followed by a contiguous 2M page.
+	 */
+	pgd[0] = PUD_ADDR | _PAGE_PRESENT;
+	pud[0] = PMD_ADDR | _PAGE_PRESENT;
+	pmd[0] = PT_ADDR | _PAGE_PRESENT;
+	pmd[1] = 0x200000 | _PAGE_PSE | _PAGE_PRESENT;
+	for (i = 0; i < 4; ++i)
+		pt[i] = ((0x100 + i) << PAGE_SHIFT) | _PAGE_PRESENT;
+	pt[5] = 0x300000 | _PAGE_PRESENT;
+	pt[6] = 0x101000 | _PAGE_PRESENT;
+	pt[511] = 0x1ff000 | _PAGE_PRESENT;
+
+	/* Kernel space: a 1G page which maps all of the above. */
+	pgd[256] = KPUD_ADDR | _PAGE_PRESENT;
+	kpud[0] = 0 | _PAGE_PSE | _PAGE_PRESENT;
+
+	pgt_meth.kind = ADDRXLAT_PGT;
+	pgt_meth.target_as = ADDRXLAT_MACHPHYSADDR;
+	pgt_meth.param.pgt.root.addr = PGD_ADDR;
+	pgt_meth.param.pgt.root.as = ADDRXLAT_MACHPHYSADDR;
+	pgt_meth.param.pgt.pf.pte_format = ADDRXLAT_PTE_X86_64;
+	pgt_meth.param.pgt.pf.nfields = 5;
+	pgt_meth.param.pgt.pf.fieldsz[0] = PAGE_SHIFT;
+	for (i = 1; i < 5; ++i)
+		pgt_meth.param.pgt.pf.fieldsz[i] = 9;
+	addrxlat_sys_set_meth(sys, ADDRXLAT_SYS_METH_PGT, &pgt_meth);
+}
+
+static addrxlat_status
+store_addr(void *data, addrxlat_addr_t addr)
+{
+	struct addrs *addrs = data;
+
+	if (addrs->n >= MAX_ADDRS) {
+		fputs("Too many addresses\n", stderr);
+		return ADDRXLAT_ERR_INVALID;
+	}
+	addrs->addr[addrs->n++] = addr;
+	return ADDRXLAT_OK;
+}
+
+static int
+check_rmap(addrxlat_sys_t *sys, addrxlat_ctx_t *ctx,
+	   addrxlat_addr_t paddr, addrxlat_status expect_status,
+	   unsigned n, const addrxlat_addr_t *expect)
+{
+	addrxlat_fulladdr_t faddr;
+	struct addrs addrs;
+	addrxlat_status status;
+	unsigned i;
+
+	faddr.addr = paddr;
+	faddr.as = ADDRXLAT_MACHPHYSADDR;
+	addrs.n = 0;
+	status = addrxlat_sys_rmap(sys, ctx, &faddr, store_addr, &addrs);
+	if (status != expect_status) {
+		fprintf(stderr, "Reverse map of 0x%llx: %s (expected %s)\n",
+			(unsigned long long) paddr,
+			addrxlat_strerror(status),
+			addrxlat_strerror(expect_status));
+		if (status != ADDRXLAT_OK)
+			fprintf(stderr, "Error: %s\n",
+				addrxlat_ctx_get_err(ctx));
+		return TEST_FAIL;
+	}
+
+	if (addrs.n != n) {
+		fprintf(stderr, "Reverse map of 0x%llx: %u addresses"
+			" (expected %u)\n",
+			(unsigned long long) paddr, addrs.n, n);
+		return TEST_FAIL;
+	}
+	for (i = 0; i < n; ++i) {
+		if (addrs.addr[i] != expect[i]) {
+			fprintf(stderr, "Reverse map of 0x%llx: address %u"
+				" is 0x%llx (expected 0x%llx)\n",
+				(unsigned long long) paddr, i,
+				(unsigned long long) addrs.addr[i],
+				(unsigned long long) expect[i]);
+			return TEST_FAIL;
+		}
+	}
+
+	return TEST_OK;
+}
+
+int
+main(int argc, char **argv)
+{
+	static const addrxlat_addr_t aliased[] = {
+		0x1234, 0x6234, 0xffff800000101234,
+	};
+	static const addrxlat_addr_t remapped[] = {
+		0x5010, 0x300010, 0xffff800000300010,
+	};
+	static const addrxlat_addr_t huge[] = {
+		0x1fffff, 0xffff8000001fffff,
+	};
+	static const addrxlat_addr_t kernel_only[] = {
+		0xffff800000104000,
+	};
+	static const addrxlat_addr_t user_only[] = {
+		0x1234, 0x6234,
+	};
+	addrxlat_ctx_t *ctx;
+	addrxlat_sys_t *sys;
+	int ret;
+
+	ctx = new_ctx();
+	if (!ctx)
+		return TEST_ERR;
+	sys = addrxlat_sys_new();
+	if (!sys) {
+		fputs("Cannot allocate translation system", stderr);
+		return TEST_ERR;
+	}
+	setup_pgt(sys);
+
+	/* A page mapped by two user pages and the kernel huge page. */
+	ret = check_rmap(sys, ctx, 0x101234, ADDRXLAT_OK,
+			 ARRAY_SIZE(aliased), aliased);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* A page which is also mapped by the 2M page. */
+	ret = check_rmap(sys, ctx, 0x300010, ADDRXLAT_OK,
+			 ARRAY_SIZE(remapped), remapped);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* Last byte of a 4K page followed by a 2M page. */
+	ret = check_rmap(sys, ctx, 0x1fffff, ADDRXLAT_OK,
+			 ARRAY_SIZE(huge), huge);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* The hole in user space is still mapped by the kernel. */
+	ret = check_rmap(sys, ctx, 0x104000, ADDRXLAT_OK,
+			 ARRAY_SIZE(kernel_only), kernel_only);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* Beyond the kernel huge page. */
+	ret = check_rmap(sys, ctx, 0x40000000, ADDRXLAT_ERR_NOTPRESENT,
+			 0, NULL);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* The index is rebuilt when the page table method changes. */
+	kpud[0] = 0;
+	addrxlat_sys_set_meth(sys, ADDRXLAT_SYS_METH_PGT, &pgt_meth);
+	ret = check_rmap(sys, ctx, 0x104000, ADDRXLAT_ERR_NOTPRESENT,
+			 0, NULL);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* A page table which cannot be read is skipped. */
+	pmd[2] = 0x7000 | _PAGE_PRESENT;
+	addrxlat_sys_set_meth(sys, ADDRXLAT_SYS_METH_PGT, &pgt_meth);
+	ret = check_rmap(sys, ctx, 0x101234, ADDRXLAT_OK,
+			 ARRAY_SIZE(user_only), user_only);
+	if (ret != TEST_OK)
+		goto out;
+
+	puts("OK");
+
+ out:
+	addrxlat_sys_decref(sys);
+	addrxlat_ctx_decref(ctx);
+
+	return ret;
+}
@@ -0,0 +1,286 @@
+/* Page table walks cached in the translation lookaside buffer
+   Copyright (C) Petr Tesarik <petr@tesarici.cz>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <libkdumpfile/addrxlat.h>
+
+#include "testutil.h"
+
+#define PAGE_SHIFT	12
+#define PAGE_SIZE	(1UL << PAGE_SHIFT)
+#define PTRS_PER_PAGE	(PAGE_SIZE / sizeof(uint64_t))
+
+#define ROOT_ADDR	0x1000
+#define PT_ADDR		0x2000
+
+static uint64_t root_table[PTRS_PER_PAGE];
+static uint64_t page_table[PTRS_PER_PAGE];
+
+static addrxlat_meth_t pgt_meth;
+
+static addrxlat_status
+get_page(const addrxlat_cb_t *cb, addrxlat_buffer_t *buf)
+{
+	addrxlat_addr_t addr = buf->addr.addr & ~(PAGE_SIZE - 1);
+
+	if (buf->addr.as != ADDRXLAT_MACHPHYSADDR)
+		return addrxlat_ctx_err(cb->priv, ADDRXLAT_ERR_NOTIMPL,
+					"Unexpected address space: %ld",
+					(long)buf->addr.as);
+
+	if (addr == ROOT_ADDR)
+		buf->ptr = root_table;
+	else if (addr == PT_ADDR)
+		buf->ptr = page_table;
+	else
+		return addrxlat_ctx_err(cb->priv, ADDRXLAT_ERR_NODATA,
+					"No data at 0x%llx",
+					(unsigned long long)buf->addr.addr);
+
+	buf->addr.addr = addr;
+	buf->size = PAGE_SIZE;
+	buf->byte_order = ADDRXLAT_HOST_ENDIAN;
+	return ADDRXLAT_OK;
+}
+
+static unsigned long
+read_caps(const addrxlat_cb_t *cb)
+{
+	return ADDRXLAT_CAPS(ADDRXLAT_MACHPHYSADDR);
+}
+
+static int
+setup_pgt(addrxlat_sys_t *sys)
+{
+	addrxlat_range_t range;
+	addrxlat_map_t *map;
+	addrxlat_status status;
+	unsigned i;
+
+	root_table[0] = PT_ADDR >> PAGE_SHIFT;
+	for (i = 0; i < PTRS_PER_PAGE; ++i)
+		page_table[i] = 0x100 + i;
+
+	pgt_meth.kind = ADDRXLAT_PGT;
+	pgt_meth.target_as = ADDRXLAT_MACHPHYSADDR;
+	pgt_meth.param.pgt.root.addr = ROOT_ADDR;
+	pgt_meth.param.pgt.root.as = ADDRXLAT_MACHPHYSADDR;
+	pgt_meth.param.pgt.pf.pte_format = ADDRXLAT_PTE_PFN64;
+	pgt_meth.param.pgt.pf.nfields = 3;
+	pgt_meth.param.pgt.pf.fieldsz[0] = PAGE_SHIFT;
+	pgt_meth.param.pgt.pf.fieldsz[1] = 9;
+	pgt_meth.param.pgt.pf.fieldsz[2] = 9;
+	addrxlat_sys_set_meth(sys, ADDRXLAT_SYS_METH_PGT, &pgt_meth);
+
+	range.endoff = ADDRXLAT_ADDR_MAX;
+	range.meth = ADDRXLAT_SYS_METH_PGT;
+	map = addrxlat_map_new();
+	if (!map) {
+		perror("Cannot allocate translation map");
+		return TEST_ERR;
+	}
+	status = addrxlat_map_set(map, 0, &range);
+	if (status != ADDRXLAT_OK) {
+		fprintf(stderr, "Cannot add translation map range: %s\n",
+			addrxlat_strerror(status));
+		return TEST_ERR;
+	}
+	addrxlat_sys_set_map(sys, ADDRXLAT_SYS_MAP_KV_PHYS, map);
+	addrxlat_map_decref(map);
+
+	return TEST_OK;
+}
+
+static addrxlat_status
+store_addr(void *data, const addrxlat_fulladdr_t *paddr)
+{
+	*(addrxlat_addr_t *)data = paddr->addr;
+	return ADDRXLAT_OK;
+}
+
+static int
+check_xlat(addrxlat_op_ctl_t *opctl, addrxlat_addr_t addr,
+	   addrxlat_addr_t expect,
+	   unsigned long hits, unsigned long misses)
+{
+	addrxlat_tlb_stats_t stats;
+	addrxlat_fulladdr_t faddr;
+	addrxlat_addr_t result;
+	addrxlat_status status;
+
+	faddr.addr = addr;
+	faddr.as = ADDRXLAT_KVADDR;
+	opctl->data = &result;
+	status = addrxlat_op(opctl, &faddr);
+	if (status != ADDRXLAT_OK) {
+		fprintf(stderr, "Cannot translate 0x%llx: %s\n",
+			(unsigned long long) addr,
+			addrxlat_ctx_get_err(opctl->ctx));
+		return TEST_ERR;
+	}
+	if (result != expect) {
+		fprintf(stderr, "0x%llx translated to 0x%llx"
+			" (expected 0x%llx)\n",
+			(unsigned long long) addr,
+			(unsigned long long) result,
+			(unsigned long long) expect);
+		return TEST_FAIL;
+	}
+
+	addrxlat_ctx_get_tlb_stats(opctl->ctx, &stats);
+	if (stats.hits != hits || stats.misses != misses) {
+		fprintf(stderr, "0x%llx: %lu hits, %lu misses"
+			" (expected %lu hits, %lu misses)\n",
+			(unsigned long long) addr,
+			stats.hits, stats.misses, hits, misses);
+		return TEST_FAIL;
+	}
+
+	return TEST_OK;
+}
+
+int
+main(int argc, char **argv)
+{
+	addrxlat_ctx_t *ctx;
+	addrxlat_cb_t *cb;
+	addrxlat_sys_t *sys;
+	addrxlat_op_ctl_t opctl;
+	int ret;
+
+	ctx = addrxlat_ctx_new();
+	if (!ctx) {
+		fputs("Cannot allocate translation context", stderr);
+		return TEST_ERR;
+	}
+	cb = addrxlat_ctx_add_cb(ctx);
+	if (!cb) {
+		fputs("Cannot allocate translation callbacks", stderr);
+		return TEST_ERR;
+	}
+	cb->priv = ctx;
+	cb->get_page = get_page;
+	cb->read_caps = read_caps;
+
+	sys = addrxlat_sys_new();
+	if (!sys) {
+		fputs("Cannot allocate translation system", stderr);
+		return TEST_ERR;
+	}
+	ret = setup_pgt(sys);
+	if (ret != TEST_OK)
+		return ret;
+
+	opctl.ctx = ctx;
+	opctl.sys = sys;
+	opctl.op = store_addr;
+	opctl.caps = ADDRXLAT_CAPS(ADDRXLAT_MACHPHYSADDR);
+
+	/* First access must walk the page tables. */
+	ret = check_xlat(&opctl, 0x3123, 0x103123, 0, 1);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* Another address in the same page is a hit. */
+	ret = check_xlat(&opctl, 0x3456, 0x103456, 1, 1);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* A different page is a miss. */
+	ret = check_xlat(&opctl, 0x4000, 0x104000, 1, 2);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* Page table changes are not seen until the TLB is flushed. */
+	page_table[3] = 0x200;
+	ret = check_xlat(&opctl, 0x3123, 0x103123, 2, 2);
+	if (ret != TEST_OK)
+		goto out;
+	addrxlat_ctx_flush_tlb(ctx);
+	ret = check_xlat(&opctl, 0x3123, 0x200123, 2, 3);
+	if (ret != TEST_OK)
+		goto out;
+	ret = check_xlat(&opctl, 0x3124, 0x200124, 3, 3);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* Changing the translation system invalidates the TLB. */
+	page_table[3] = 0x300;
+	addrxlat_sys_set_meth(sys, ADDRXLAT_SYS_METH_PGT, &pgt_meth);
+	ret = check_xlat(&opctl, 0x3123, 0x300123, 3, 4);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* Resizing the read cache does not affect the TLB. */
+	if (addrxlat_ctx_set_read_cache_size(ctx, 1) == ADDRXLAT_OK ||
+	    addrxlat_ctx_set_read_cache_size(ctx, 3) == ADDRXLAT_OK) {
+		fputs("Too small read cache accepted\n", stderr);
+		ret = TEST_FAIL;
+		goto out;
+	}
+	if (addrxlat_ctx_set_read_cache_size(ctx, 16) != ADDRXLAT_OK ||
+	    addrxlat_ctx_get_read_cache_size(ctx) != 16) {
+		fprintf(stderr, "Cannot resize read cache: %s\n",
+			addrxlat_ctx_get_err(ctx));
+		ret = TEST_FAIL;
+		goto out;
+	}
+	ret = check_xlat(&opctl, 0x3123, 0x300123, 4, 4);
+	if (ret != TEST_OK)
+		goto out;
+	ret = check_xlat(&opctl, 0x5123, 0x105123, 4, 5);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* Adding or removing callbacks invalidates the TLB. */
+	cb = addrxlat_ctx_add_cb(ctx);
+	if (!cb) {
+		fputs("Cannot allocate translation callbacks", stderr);
+		ret = TEST_ERR;
+		goto out;
+	}
+	ret = check_xlat(&opctl, 0x3123, 0x300123, 4, 6);
+	if (ret != TEST_OK)
+		goto out;
+	addrxlat_ctx_del_cb(ctx, cb);
+	ret = check_xlat(&opctl, 0x3123, 0x300123, 4, 7);
+	if (ret != TEST_OK)
+		goto out;
+
+	puts("OK");
+
+ out:
+	addrxlat_sys_decref(sys);
+	addrxlat_ctx_decref(ctx);
+
+	return ret;
+}
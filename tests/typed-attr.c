@@ -33,6 +33,7 @@
 #define ATTR_CACHE_SIZE	"cache.size"
 #define ATTR_SYSNAME	"linux.uts.sysname"
 #define ATTR_PHYS_BASE	"linux.phys_base"
+#define ATTR_READ_CACHE	"addrxlat.read_cache_size"
 
 #define GOOD_NUMBER	0x600d
 
@@ -205,6 +206,28 @@ int main(int argc, char **argv)
 		printf("%s as a number: %s\n",
 		       ATTR_SYSNAME, kdump_get_err(ctx));
 
+	puts("\n# Test value range:");
+
+	status = kdump_set_number_attr(ctx, ATTR_READ_CACHE, 3);
+	if (status == KDUMP_OK) {
+		fprintf(stderr, "%s accepts 3\n", ATTR_READ_CACHE);
+		rc = TEST_FAIL;
+	} else if (status != KDUMP_ERR_INVALID) {
+		fprintf(stderr, "Cannot set %s: %s\n",
+			ATTR_READ_CACHE, kdump_get_err(ctx));
+		rc = TEST_FAIL;
+	} else
+		printf("%s = 3: %s\n",
+		       ATTR_READ_CACHE, kdump_get_err(ctx));
+
+	status = kdump_set_number_attr(ctx, ATTR_READ_CACHE, 4);
+	if (status != KDUMP_OK) {
+		fprintf(stderr, "Cannot set %s: %s\n",
+			ATTR_READ_CACHE, kdump_get_err(ctx));
+		rc = TEST_FAIL;
+	} else
+		printf("%s = 4: OK\n", ATTR_READ_CACHE);
+
 	kdump_free(ctx);
 	return rc;
 }
@@ -0,0 +1,314 @@
+/* Range translation with addrxlat_op_range
+   Copyright (C) Petr Tesarik <petr@tesarici.cz>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <libkdumpfile/addrxlat.h>
+
+#include "testutil.h"
+
+#define PAGE_SHIFT	12
+#define PAGE_SIZE	(1UL << PAGE_SHIFT)
+#define PTRS_PER_PAGE	(PAGE_SIZE / sizeof(uint64_t))
+
+#define ROOT_ADDR	0x1000
+#define PT_ADDR		0x2000
+
+#define MAX_EXTENTS	8
+
+static uint64_t root_table[PTRS_PER_PAGE];
+static uint64_t page_table[PTRS_PER_PAGE];
+
+static addrxlat_meth_t pgt_meth;
+
+struct extent {
+	addrxlat_addr_t addr;
+	addrxlat_addr_t size;
+};
+
+struct extents {
+	unsigned n;
+	struct extent ext[MAX_EXTENTS];
+};
+
+static addrxlat_status
+get_page(const addrxlat_cb_t *cb, addrxlat_buffer_t *buf)
+{
+	addrxlat_addr_t addr = buf->addr.addr & ~(PAGE_SIZE - 1);
+
+	if (buf->addr.as != ADDRXLAT_MACHPHYSADDR)
+		return addrxlat_ctx_err(cb->priv, ADDRXLAT_ERR_NOTIMPL,
+					"Unexpected address space: %ld",
+					(long)buf->addr.as);
+
+	if (addr == ROOT_ADDR)
+		buf->ptr = root_table;
+	else if (addr == PT_ADDR)
+		buf->ptr = page_table;
+	else
+		return addrxlat_ctx_err(cb->priv, ADDRXLAT_ERR_NODATA,
+					"No data at 0x%llx",
+					(unsigned long long)buf->addr.addr);
+
+	buf->addr.addr = addr;
+	buf->size = PAGE_SIZE;
+	buf->byte_order = ADDRXLAT_HOST_ENDIAN;
+	return ADDRXLAT_OK;
+}
+
+static unsigned long
+read_caps(const addrxlat_cb_t *cb)
+{
+	return ADDRXLAT_CAPS(ADDRXLAT_MACHPHYSADDR);
+}
+
+static int
+setup_pgt(addrxlat_sys_t *sys)
+{
+	addrxlat_range_t range;
+	addrxlat_map_t *map;
+	addrxlat_status status;
+	unsigned i;
+
+	root_table[0] = PT_ADDR >> PAGE_SHIFT;
+	for (i = 0; i < PTRS_PER_PAGE; ++i)
+		page_table[i] = 0x100 + i;
+	page_table[5] = 0x300;
+
+	pgt_meth.kind = ADDRXLAT_PGT;
+	pgt_meth.target_as = ADDRXLAT_MACHPHYSADDR;
+	pgt_meth.param.pgt.root.addr = ROOT_ADDR;
+	pgt_meth.param.pgt.root.as = ADDRXLAT_MACHPHYSADDR;
+	pgt_meth.param.pgt.pf.pte_format = ADDRXLAT_PTE_PFN64;
+	pgt_meth.param.pgt.pf.nfields = 3;
+	pgt_meth.param.pgt.pf.fieldsz[0] = PAGE_SHIFT;
+	pgt_meth.param.pgt.pf.fieldsz[1] = 9;
+	pgt_meth.param.pgt.pf.fieldsz[2] = 9;
+	addrxlat_sys_set_meth(sys, ADDRXLAT_SYS_METH_PGT, &pgt_meth);
+
+	range.endoff = ADDRXLAT_ADDR_MAX;
+	range.meth = ADDRXLAT_SYS_METH_PGT;
+	map = addrxlat_map_new();
+	if (!map) {
+		perror("Cannot allocate translation map");
+		return TEST_ERR;
+	}
+	status = addrxlat_map_set(map, 0, &range);
+	if (status != ADDRXLAT_OK) {
+		fprintf(stderr, "Cannot add translation map range: %s\n",
+			addrxlat_strerror(status));
+		return TEST_ERR;
+	}
+	addrxlat_sys_set_map(sys, ADDRXLAT_SYS_MAP_KV_PHYS, map);
+	addrxlat_map_decref(map);
+
+	return TEST_OK;
+}
+
+/* Switch to sign-extended addresses with x86_64 PTEs. The highest
+ * translated bit (bit 29) must be copied to all higher bits.
+ */
+static void
+setup_saddr(addrxlat_sys_t *sys)
+{
+	unsigned i;
+
+	root_table[0] = 0;
+	root_table[255] = PT_ADDR | 1;
+	for (i = 0; i < PTRS_PER_PAGE; ++i)
+		page_table[i] = ((0x100 + i) << PAGE_SHIFT) | 1;
+
+	pgt_meth.param.pgt.pf.pte_format = ADDRXLAT_PTE_X86_64;
+	addrxlat_sys_set_meth(sys, ADDRXLAT_SYS_METH_PGT, &pgt_meth);
+}
+
+static addrxlat_status
+store_extent(void *data, const addrxlat_fulladdr_t *paddr,
+	     addrxlat_addr_t size)
+{
+	struct extents *exts = data;
+
+	if (paddr->as != ADDRXLAT_MACHPHYSADDR) {
+		fprintf(stderr, "Unexpected address space: %ld\n",
+			(long)paddr->as);
+		return ADDRXLAT_ERR_INVALID;
+	}
+	if (exts->n >= MAX_EXTENTS) {
+		fputs("Too many extents\n", stderr);
+		return ADDRXLAT_ERR_INVALID;
+	}
+	exts->ext[exts->n].addr = paddr->addr;
+	exts->ext[exts->n].size = size;
+	++exts->n;
+	return ADDRXLAT_OK;
+}
+
+static int
+check_range(addrxlat_op_ctl_t *opctl, addrxlat_addr_t addr,
+	    addrxlat_addr_t size, addrxlat_status expect_status,
+	    unsigned n, const struct extent *expect)
+{
+	struct extents exts;
+	addrxlat_fulladdr_t faddr;
+	addrxlat_status status;
+	unsigned i;
+
+	faddr.addr = addr;
+	faddr.as = ADDRXLAT_KVADDR;
+	exts.n = 0;
+	opctl->data = &exts;
+	status = addrxlat_op_range(opctl, store_extent, &faddr, size);
+	if (status != expect_status) {
+		fprintf(stderr, "Range 0x%llx+0x%llx: %s (expected %s)\n",
+			(unsigned long long) addr,
+			(unsigned long long) size,
+			addrxlat_strerror(status),
+			addrxlat_strerror(expect_status));
+		if (status != ADDRXLAT_OK)
+			fprintf(stderr, "Error: %s\n",
+				addrxlat_ctx_get_err(opctl->ctx));
+		return TEST_FAIL;
+	}
+
+	if (exts.n != n) {
+		fprintf(stderr, "Range 0x%llx+0x%llx: %u extents"
+			" (expected %u)\n",
+			(unsigned long long) addr,
+			(unsigned long long) size, exts.n, n);
+		return TEST_FAIL;
+	}
+	for (i = 0; i < n; ++i) {
+		if (exts.ext[i].addr != expect[i].addr ||
+		    exts.ext[i].size != expect[i].size) {
+			fprintf(stderr, "Range 0x%llx+0x%llx: extent %u"
+				" is 0x%llx+0x%llx (expected 0x%llx+0x%llx)\n",
+				(unsigned long long) addr,
+				(unsigned long long) size, i,
+				(unsigned long long) exts.ext[i].addr,
+				(unsigned long long) exts.ext[i].size,
+				(unsigned long long) expect[i].addr,
+				(unsigned long long) expect[i].size);
+			return TEST_FAIL;
+		}
+	}
+
+	return TEST_OK;
+}
+
+int
+main(int argc, char **argv)
+{
+	static const struct extent within_page[] = {
+		{ 0x101234, 0x100 },
+	};
+	static const struct extent merged[] = {
+		{ 0x101800, 0x3800 },
+		{ 0x300000, 0x1000 },
+		{ 0x106000, 0x1800 },
+	};
+	static const struct extent partial[] = {
+		{ 0x2fe800, 0x1800 },
+	};
+	static const struct extent canonical[] = {
+		{ 0x2ff000, 0x1000 },
+	};
+	addrxlat_ctx_t *ctx;
+	addrxlat_cb_t *cb;
+	addrxlat_sys_t *sys;
+	addrxlat_op_ctl_t opctl;
+	int ret;
+
+	ctx = addrxlat_ctx_new();
+	if (!ctx) {
+		fputs("Cannot allocate translation context", stderr);
+		return TEST_ERR;
+	}
+	cb = addrxlat_ctx_add_cb(ctx);
+	if (!cb) {
+		fputs("Cannot allocate translation callbacks", stderr);
+		return TEST_ERR;
+	}
+	cb->priv = ctx;
+	cb->get_page = get_page;
+	cb->read_caps = read_caps;
+
+	sys = addrxlat_sys_new();
+	if (!sys) {
+		fputs("Cannot allocate translation system", stderr);
+		return TEST_ERR;
+	}
+	ret = setup_pgt(sys);
+	if (ret != TEST_OK)
+		return ret;
+
+	opctl.ctx = ctx;
+	opctl.sys = sys;
+	opctl.op = NULL;
+	opctl.caps = ADDRXLAT_CAPS(ADDRXLAT_MACHPHYSADDR);
+
+	/* Empty range. */
+	ret = check_range(&opctl, 0x1000, 0, ADDRXLAT_OK, 0, NULL);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* Range within a single page. */
+	ret = check_range(&opctl, 0x1234, 0x100, ADDRXLAT_OK,
+			  ARRAY_SIZE(within_page), within_page);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* Contiguous pages are merged; page 5 is mapped elsewhere. */
+	ret = check_range(&opctl, 0x1800, 0x6000, ADDRXLAT_OK,
+			  ARRAY_SIZE(merged), merged);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* Translated part is passed to the callback before the error. */
+	ret = check_range(&opctl, 0x1fe800, 0x2000, ADDRXLAT_ERR_NOTPRESENT,
+			  ARRAY_SIZE(partial), partial);
+	if (ret != TEST_OK)
+		goto out;
+
+	/* Cached page tables are not reused for a non-canonical address. */
+	setup_saddr(sys);
+	ret = check_range(&opctl, 0x1ffff000, 0x2000, ADDRXLAT_ERR_INVALID,
+			  ARRAY_SIZE(canonical), canonical);
+	if (ret != TEST_OK)
+		goto out;
+
+	puts("OK");
+
+ out:
+	addrxlat_sys_decref(sys);
+	addrxlat_ctx_decref(ctx);
+
+	return ret;
+}